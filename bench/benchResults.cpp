@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "benchResults.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+
+
+// Percentile
+double benchSamples::Percentile( double p ) const
+{
+	if( mSamples.empty() )
+		return 0.0;
+
+	std::vector<uint64_t> sorted(mSamples);
+	std::sort(sorted.begin(), sorted.end());
+
+	// nearest rank
+	size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+
+	if( rank < 1 )
+		rank = 1;
+
+	return sorted[std::min(rank, sorted.size()) - 1] * 0.000001;
+}
+
+
+// Mean
+double benchSamples::Mean() const
+{
+	if( mSamples.empty() )
+		return 0.0;
+
+	double sum = 0.0;
+
+	for( size_t n=0; n < mSamples.size(); n++ )
+		sum += mSamples[n];
+
+	return sum / mSamples.size() * 0.000001;
+}
+
+
+// Begin
+void benchResults::Begin( const std::string& name )
+{
+	mResults.push_back(result());
+	mResults.back().name = name;
+}
+
+
+// Metric
+void benchResults::Metric( const char* key, double value, Better better )
+{
+	if( mResults.empty() || !key )
+		return;
+
+	metric m;
+
+	m.key    = key;
+	m.value  = value;
+	m.better = better;
+
+	mResults.back().metrics.push_back(m);
+}
+
+
+// Latency
+void benchResults::Latency( const char* key, const benchSamples& samples )
+{
+	const std::string prefix = key;
+
+	Metric((prefix + "_p50_ms").c_str(), samples.Percentile(50), LOWER);
+	Metric((prefix + "_p90_ms").c_str(), samples.Percentile(90), LOWER);
+	Metric((prefix + "_p99_ms").c_str(), samples.Percentile(99), LOWER);
+}
+
+
+// Skip
+void benchResults::Skip( const char* reason )
+{
+	if( mResults.empty() )
+		return;
+
+	mResults.back().skipped = reason != NULL ? reason : "skipped";
+	mResults.back().metrics.clear();
+}
+
+
+// writeString
+static void writeString( FILE* file, const std::string& str )
+{
+	fputc('"', file);
+
+	for( size_t n=0; n < str.size(); n++ )
+	{
+		if( str[n] == '"' || str[n] == '\\' )
+			fputc('\\', file);
+
+		if( (unsigned char)str[n] >= 0x20 )
+			fputc(str[n], file);
+	}
+
+	fputc('"', file);
+}
+
+
+// Save
+bool benchResults::Save( const char* filename, const char* benchmark ) const
+{
+	FILE* file = stdout;
+
+	if( filename != NULL )
+	{
+		file = fopen(filename, "w");
+
+		if( !file )
+		{
+			printf("bench -- failed to open '%s' for writing\n", filename);
+			return false;
+		}
+	}
+
+	// one result per line, which is what Load() expects
+	fprintf(file, "{\n  \"benchmark\": ");
+	writeString(file, benchmark != NULL ? benchmark : "");
+	fprintf(file, ",\n  \"results\": [\n");
+
+	for( size_t n=0; n < mResults.size(); n++ )
+	{
+		const result& r = mResults[n];
+
+		fprintf(file, "    {\"name\": ");
+		writeString(file, r.name);
+
+		if( !r.skipped.empty() )
+		{
+			fprintf(file, ", \"skipped\": ");
+			writeString(file, r.skipped);
+		}
+		else
+		{
+			fprintf(file, ", \"metrics\": {");
+
+			for( size_t i=0; i < r.metrics.size(); i++ )
+			{
+				fprintf(file, "%s", (i > 0) ? ", " : "");
+				writeString(file, r.metrics[i].key);
+				fprintf(file, ": %.6g", r.metrics[i].value);
+			}
+
+			fprintf(file, "}");
+		}
+
+		fprintf(file, "}%s\n", (n + 1 < mResults.size()) ? "," : "");
+	}
+
+	fprintf(file, "  ]\n}\n");
+
+	if( file == stdout )
+		return true;
+
+	const bool failed = ferror(file) != 0;
+
+	if( fclose(file) != 0 || failed )
+	{
+		printf("bench -- failed to write '%s'\n", filename);
+		return false;
+	}
+
+	printf("bench -- wrote %zu results to '%s'\n", mResults.size(), filename);
+	return true;
+}
+
+
+// readString
+static const char* readString( const char* str, std::string* out )
+{
+	if( *str != '"' )
+		return NULL;
+
+	out->clear();
+
+	for( str++; *str != '"'; str++ )
+	{
+		if( *str == 0 )
+			return NULL;
+
+		if( *str == '\\' && str[1] != 0 )
+			str++;
+
+		out->push_back(*str);
+	}
+
+	return str + 1;
+}
+
+
+// skipSpace
+static inline const char* skipSpace( const char* str )
+{
+	while( *str == ' ' || *str == '\t' || *str == '\r' || *str == '\n' )
+		str++;
+
+	return str;
+}
+
+
+// Load
+bool benchResults::Load( const char* filename )
+{
+	FILE* file = fopen(filename, "r");
+
+	if( !file )
+	{
+		printf("bench -- failed to open '%s'\n", filename);
+		return false;
+	}
+
+	mResults.clear();
+
+	char line[8192];
+	bool valid = true;
+
+	while( fgets(line, sizeof(line), file) != NULL )
+	{
+		const char* name = strstr(line, "\"name\":");
+
+		if( !name )
+			continue;
+
+		result r;
+
+		if( !readString(skipSpace(name + 7), &r.name) )
+		{
+			valid = false;
+			break;
+		}
+
+		const char* skipped = strstr(line, "\"skipped\":");
+
+		if( skipped != NULL )
+			readString(skipSpace(skipped + 10), &r.skipped);
+
+		const char* str = strstr(line, "\"metrics\":");
+
+		if( str != NULL )
+		{
+			str = skipSpace(str + 10);
+
+			if( *str != '{' )
+			{
+				valid = false;
+				break;
+			}
+
+			str = skipSpace(str + 1);
+
+			while( str != NULL && *str == '"' )
+			{
+				metric m;
+				m.better = NEITHER;
+
+				str = readString(str, &m.key);
+
+				if( !str || *(str = skipSpace(str)) != ':' )
+				{
+					str = NULL;
+					break;
+				}
+
+				char* end = NULL;
+				m.value = strtod(str + 1, &end);
+
+				if( end == str + 1 )
+				{
+					str = NULL;
+					break;
+				}
+
+				r.metrics.push_back(m);
+
+				str = skipSpace(end);
+
+				if( *str == ',' )
+					str = skipSpace(str + 1);
+			}
+
+			if( !str || *str != '}' )
+			{
+				valid = false;
+				break;
+			}
+		}
+
+		mResults.push_back(r);
+	}
+
+	fclose(file);
+
+	if( !valid )
+	{
+		printf("bench -- failed to parse '%s'\n", filename);
+		return false;
+	}
+
+	printf("bench -- loaded %zu results from '%s'\n", mResults.size(), filename);
+	return true;
+}
+
+
+// find
+const benchResults::result* benchResults::find( const std::string& name ) const
+{
+	for( size_t n=0; n < mResults.size(); n++ )
+	{
+		if( mResults[n].name == name )
+			return &mResults[n];
+	}
+
+	return NULL;
+}
+
+
+// Compare
+uint32_t benchResults::Compare( const benchResults& baseline, double tolerance ) const
+{
+	uint32_t regressions = 0;
+	uint32_t compared    = 0;
+
+	for( size_t n=0; n < mResults.size(); n++ )
+	{
+		const result& r = mResults[n];
+		const result* b = baseline.find(r.name);
+
+		if( !b || !b->skipped.empty() )
+			continue;
+
+		// a configuration that used to run is a regression of its own
+		if( !r.skipped.empty() )
+		{
+			printf("bench -- REGRESSION  %s  no longer runs (%s)\n", r.name.c_str(), r.skipped.c_str());
+			regressions++;
+			continue;
+		}
+
+		for( size_t i=0; i < r.metrics.size(); i++ )
+		{
+			const metric& m = r.metrics[i];
+
+			if( m.better == NEITHER )
+				continue;
+
+			for( size_t j=0; j < b->metrics.size(); j++ )
+			{
+				if( b->metrics[j].key != m.key || b->metrics[j].value <= 0.0 )
+					continue;
+
+				const double base   = b->metrics[j].value;
+				const double change = (m.value - base) / base;
+				const bool   worse  = (m.better == LOWER) ? (change > tolerance) : (change < -tolerance);
+
+				if( worse )
+				{
+					printf("bench -- REGRESSION  %s  %s  %.4g -> %.4g  (%+.1f%%)\n", r.name.c_str(), m.key.c_str(), base, m.value, change * 100.0);
+					regressions++;
+				}
+
+				compared++;
+				break;
+			}
+		}
+	}
+
+	printf("bench -- compared %u metrics against the baseline, %u regressed by more than %.1f%%\n", compared, regressions, tolerance * 100.0);
+	return regressions;
+}
+
+
+// benchSplitList
+std::vector<std::string> benchSplitList( const char* str )
+{
+	std::vector<std::string> list;
+	std::string item;
+
+	for( const char* c=str; ; c++ )
+	{
+		if( *c == ',' || *c == 0 )
+		{
+			if( !item.empty() )
+				list.push_back(item);
+
+			item.clear();
+
+			if( *c == 0 )
+				break;
+		}
+		else
+		{
+			item.push_back(*c);
+		}
+	}
+
+	return list;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __BENCH_RESULTS_H_
+#define __BENCH_RESULTS_H_
+
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+/**
+ * Timings of repeated runs of something, in nanoseconds.
+ * @ingroup util
+ */
+class benchSamples
+{
+public:
+	/**
+	 * Add a sample.
+	 */
+	inline void Add( uint64_t ns )		{ mSamples.push_back(ns); }
+
+	/**
+	 * Number of samples.
+	 */
+	inline size_t GetCount() const		{ return mSamples.size(); }
+
+	/**
+	 * Percentile of the samples in milliseconds, i.e. Percentile(50) for the median.
+	 */
+	double Percentile( double p ) const;
+
+	/**
+	 * Mean of the samples in milliseconds.
+	 */
+	double Mean() const;
+
+	/**
+	 * Drop the samples.
+	 */
+	inline void Clear()				{ mSamples.clear(); }
+
+private:
+	std::vector<uint64_t> mSamples;
+};
+
+
+/**
+ * Results of a benchmark run, saved as JSON and compared against a saved baseline.
+ *
+ * Each result is a named configuration (i.e. "googlenet/1280x720/b1/fp16") with a set
+ * of metrics, that each know whether lower or higher values are better.  Results that
+ * couldn't be run are kept with the reason they were skipped.
+ *
+ * @ingroup util
+ */
+class benchResults
+{
+public:
+	/**
+	 * Direction of a metric, for the comparisons.
+	 */
+	enum Better
+	{
+		LOWER,		/**< i.e. latency */
+		HIGHER,		/**< i.e. throughput */
+		NEITHER		/**< informational, not compared */
+	};
+
+	/**
+	 * Start a new result, which the following metrics are added to.
+	 */
+	void Begin( const std::string& name );
+
+	/**
+	 * Add a metric to the current result.
+	 */
+	void Metric( const char* key, double value, Better better=LOWER );
+
+	/**
+	 * Add the p50/p90/p99 of the samples as the metrics <key>_p50_ms, <key>_p90_ms and <key>_p99_ms.
+	 */
+	void Latency( const char* key, const benchSamples& samples );
+
+	/**
+	 * Mark the current result as skipped.
+	 */
+	void Skip( const char* reason );
+
+	/**
+	 * Write the results as JSON, to stdout if the filename is NULL.
+	 */
+	bool Save( const char* filename, const char* benchmark ) const;
+
+	/**
+	 * Read results saved with Save().
+	 */
+	bool Load( const char* filename );
+
+	/**
+	 * Compare against a baseline, printing every metric that got worse by more than the
+	 * tolerance (i.e. 0.1 for 10%).  Results that are missing from either side are ignored.
+	 * @returns the number of regressions.
+	 */
+	uint32_t Compare( const benchResults& baseline, double tolerance ) const;
+
+	/**
+	 * Number of results.
+	 */
+	inline size_t GetCount() const		{ return mResults.size(); }
+
+private:
+	struct metric
+	{
+		std::string key;
+		double      value;
+		Better      better;
+	};
+
+	struct result
+	{
+		std::string name;
+		std::string skipped;
+		std::vector<metric> metrics;
+	};
+
+	const result* find( const std::string& name ) const;
+
+	std::vector<result> mResults;
+};
+
+
+
+/**
+ * Split a comma-separated list from the command line, i.e. "640x480,1280x720".
+ * @ingroup util
+ */
+std::vector<std::string> benchSplitList( const char* list );
+
+
+#endif
@@ -0,0 +1,1383 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cudaYUV.h"
+#include "cudaRGB.h"
+#include "cudaBayer.h"
+#include "cudaResize.h"
+#include "cudaNormalize.h"
+#include "cudaOverlay.h"
+#include "cudaFont.h"
+
+#include "cudaMappedMemory.h"
+#include "commandLine.h"
+#include "loadImage.h"
+
+#include "benchResults.h"
+#include "kernelReference.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+// bytes before and after each image that a kernel must leave alone
+#define GUARD_BYTES  4096
+#define SENTINEL     0xCD
+
+
+// the buffers and geometry a kernel runs on
+struct kernelBuffers
+{
+	uint8_t* input;
+	uint8_t* output;
+	size_t   inputPitch;
+	size_t   outputPitch;
+	uint32_t width;
+	uint32_t height;
+};
+
+
+// the font map shared by the text checks, loaded when they run
+static cudaFont* font       = NULL;
+static float4*   fontCPU    = NULL;
+static float4*   fontGPU    = NULL;
+static int       fontWidth  = 0;
+static int       fontHeight = 0;
+
+static const int fontCellWidth  = 24;	// cudaFont's glyph cells
+static const int fontCellHeight = 32;
+
+static const char* fontText = "The quick brown fox jumps over the lazy dog 0123456789";
+
+static const float4 overlayColor = make_float4(0.0f, 255.0f, 128.0f, 100.0f);
+
+
+// deterministic noise, so failures reproduce
+static uint32_t randomState = 1;
+
+static inline uint32_t randomInt()
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+static void randomBytes( std::vector<uint8_t>& data )
+{
+	for( size_t n=0; n < data.size(); n++ )
+		data[n] = randomInt() & 0xFF;
+}
+
+static void randomFloats( std::vector<float>& data, float range )
+{
+	for( size_t n=0; n < data.size(); n++ )
+		data[n] = float(randomInt() & 0xFFFF) / 65535.0f * range;
+}
+
+
+// round up to a multiple of the alignment
+static inline size_t alignUp( size_t size, size_t alignment )
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+// a pitch wider than the row, for the kernels that take one
+static inline size_t paddedPitch( size_t rowBytes )
+{
+	return alignUp(rowBytes, 64) + 64;
+}
+
+
+// allocDevice
+static uint8_t* allocDevice( size_t size, const void* contents=NULL )
+{
+	uint8_t* ptr = NULL;
+
+	if( CUDA_FAILED(cudaMalloc((void**)&ptr, GUARD_BYTES + size + GUARD_BYTES)) )
+		return NULL;
+
+	if( CUDA_FAILED(cudaMemset(ptr, SENTINEL, GUARD_BYTES + size + GUARD_BYTES)) ||
+	    (contents != NULL && CUDA_FAILED(cudaMemcpy(ptr + GUARD_BYTES, contents, size, cudaMemcpyHostToDevice))) )
+	{
+		CUDA(cudaFree(ptr));
+		return NULL;
+	}
+
+	return ptr + GUARD_BYTES;
+}
+
+
+// freeDevice
+static void freeDevice( void* ptr )
+{
+	if( ptr != NULL )
+		CUDA(cudaFree((uint8_t*)ptr - GUARD_BYTES));
+}
+
+
+// reportCheck
+template<typename E>
+static bool reportCheck( const char* kernel, const kernelBuffers& buffers, bool matched, const imageDiff& diff, size_t overruns, E tolerance )
+{
+	if( matched && overruns == 0 )
+	{
+		printf("bench -- check %-24s %5ux%-5u pitch %5zu/%-5zu passed (max error %g)\n", kernel, buffers.width, buffers.height, buffers.inputPitch, buffers.outputPitch, diff.maxError);
+		return true;
+	}
+
+	printf("bench -- check %-24s %5ux%-5u pitch %5zu/%-5zu FAILED", kernel, buffers.width, buffers.height, buffers.inputPitch, buffers.outputPitch);
+
+	if( !matched )
+		printf(" (%llu values off by more than %g, max error %g, first at %i,%i channel %i)", (unsigned long long)diff.mismatches, (double)tolerance, diff.maxError, diff.x, diff.y, diff.channel);
+
+	if( overruns > 0 )
+		printf(" (%zu bytes written outside the image)", overruns);
+
+	printf("\n");
+	return false;
+}
+
+
+// checkOutput
+template<typename T, typename E>
+static bool checkOutput( const char* kernel, const kernelBuffers& buffers, const std::vector<T>& reference, E tolerance )
+{
+	const size_t rowBytes = buffers.width * sizeof(T) * 4;
+	const size_t size     = GUARD_BYTES + buffers.outputPitch * buffers.height + GUARD_BYTES;
+
+	std::vector<uint8_t> output(size);
+
+	if( CUDA_FAILED(cudaDeviceSynchronize()) || CUDA_FAILED(cudaMemcpy(output.data(), buffers.output - GUARD_BYTES, size, cudaMemcpyDeviceToHost)) )
+	{
+		printf("bench -- check %-24s %5ux%-5u pitch %5zu/%-5zu FAILED (CUDA error)\n", kernel, buffers.width, buffers.height, buffers.inputPitch, buffers.outputPitch);
+		return false;
+	}
+
+	imageDiff diff;
+
+	const uint8_t* image = output.data() + GUARD_BYTES;
+
+	const bool matched = cpuCompareImages((const T*)image, buffers.outputPitch, reference.data(), rowBytes, buffers.width, buffers.height, tolerance, &diff);
+	size_t overruns = cpuCountOverruns(image, buffers.outputPitch, rowBytes, buffers.height, GUARD_BYTES, SENTINEL);
+
+	for( size_t n=0; n < GUARD_BYTES; n++ )
+	{
+		if( output[n] != SENTINEL )
+			overruns++;
+	}
+
+	return reportCheck(kernel, buffers, matched, diff, overruns, tolerance);
+}
+
+
+// freeBuffers
+static void freeBuffers( kernelBuffers* buffers )
+{
+	freeDevice(buffers->input);
+	freeDevice(buffers->output);
+
+	buffers->input  = NULL;
+	buffers->output = NULL;
+}
+
+
+//-----------------------------------------------------------------------------------
+// the kernels, as they're launched for both the checks and the timings
+//-----------------------------------------------------------------------------------
+
+static cudaError_t launchNV12( const kernelBuffers& b )
+{
+	return cudaNV12ToRGBAf(b.input, b.inputPitch, (float4*)b.output, b.outputPitch, b.width, b.height);
+}
+
+// the pitch of cudaYUVToRGBAf() is in pixels
+static cudaError_t launchUYVY( const kernelBuffers& b )
+{
+	return cudaYUVToRGBAf(b.input, b.inputPitch / 2, (float4*)b.output, b.outputPitch, b.width, b.height);
+}
+
+static cudaError_t launchRGBAfNV12( const kernelBuffers& b )
+{
+	return cudaRGBAToNV12((float4*)b.input, b.inputPitch, b.output, b.outputPitch, b.width, b.height);
+}
+
+static cudaError_t launchRGBA8NV12( const kernelBuffers& b )
+{
+	return cudaRGBAToNV12((uchar4*)b.input, b.inputPitch, b.output, b.outputPitch, b.width, b.height);
+}
+
+static cudaError_t launchYUYV( const kernelBuffers& b )
+{
+	return cudaYUYVToRGBA((uchar2*)b.input, b.inputPitch, (uchar4*)b.output, b.outputPitch, b.width, b.height);
+}
+
+static cudaError_t launchBayer( const kernelBuffers& b )
+{
+	return cudaBAYER_GR8toRGBA(b.input, (float4*)b.output, b.width, b.height);
+}
+
+// white balance gains, typical of a sensor under daylight
+static const float3 bayerBalance = make_float3(1.2f, 1.0f, 1.6f);
+
+// mean pixel subtracted by the tensor conversion (BGR)
+static const float3 bayerMean = make_float3(104.0f, 117.0f, 123.0f);
+
+static cudaError_t launchBayerBilinear( const kernelBuffers& b )
+{
+	return cudaBayerToRGBA(b.input, b.inputPitch, (float4*)b.output, b.outputPitch, b.width, b.height, BAYER_GRBG, BAYER_BILINEAR, bayerBalance);
+}
+
+static cudaError_t launchBayerMalvar( const kernelBuffers& b )
+{
+	return cudaBayerToRGBA(b.input, b.inputPitch, (float4*)b.output, b.outputPitch, b.width, b.height, BAYER_GRBG, BAYER_MALVAR, bayerBalance);
+}
+
+static cudaError_t launchBayerMalvar8( const kernelBuffers& b )
+{
+	return cudaBayerToRGBA(b.input, b.inputPitch, (uchar4*)b.output, b.outputPitch, b.width, b.height, BAYER_GRBG, BAYER_MALVAR, bayerBalance);
+}
+
+static cudaError_t launchBayerTensor( const kernelBuffers& b )
+{
+	return cudaBayerToTensor(b.input, b.inputPitch, b.width, b.height, (float*)b.output, b.width, b.height, BAYER_GRBG, BAYER_MALVAR, bayerBalance, bayerMean);
+}
+
+static cudaError_t launchNormalize( const kernelBuffers& b )
+{
+	return cudaNormalizeRGBA((float4*)b.input, make_float2(0.0f, 255.0f), (float4*)b.output, make_float2(0.0f, 1.0f), b.width, b.height);
+}
+
+// boxes that overlap, have fractional edges, and run off the image
+static std::vector<float4> overlayRects( uint32_t width, uint32_t height )
+{
+	std::vector<float4> rects;
+
+	rects.push_back(make_float4(0.0f, 0.0f, 0.0f, 0.0f));
+	rects.push_back(make_float4(width * 0.1f, height * 0.2f + 0.5f, width * 0.6f, height * 0.7f));
+	rects.push_back(make_float4(width * 0.4f - 0.25f, height * 0.5f, width + 10.0f, height + 10.0f));
+	rects.push_back(make_float4(-5.0f, height * 0.3f, width * 0.25f, height * 0.35f + 0.75f));
+
+	return rects;
+}
+
+static float4* rectsGPU = NULL;
+static size_t  numRects = 0;
+
+static cudaError_t launchRects( const kernelBuffers& b )
+{
+	return cudaRectOutlineOverlay((float4*)b.input, (float4*)b.output, b.width, b.height, rectsGPU, numRects, overlayColor);
+}
+
+static cudaError_t launchText( const kernelBuffers& b )
+{
+	// the text is drawn over the output
+	if( !font->RenderOverlay((float4*)b.output, (float4*)b.output, b.width, b.height, fontText, b.width / 4, b.height / 3, overlayColor) )
+		return cudaErrorInvalidValue;
+
+	return cudaGetLastError();
+}
+
+
+//-----------------------------------------------------------------------------------
+// correctness against the CPU references
+//-----------------------------------------------------------------------------------
+
+// the colorspaces checked, which cover each matrix, range and siting
+struct yuvTestColorspace
+{
+	const char*     name;
+	yuvMatrix       matrix;
+	yuvRange        range;
+	yuvChromaSiting siting;
+};
+
+static const yuvTestColorspace yuvColorspaces[] =
+{
+	{ "601",        YUV_BT601, YUV_RANGE_LIMITED, YUV_CHROMA_LEFT },
+	{ "709",        YUV_BT709, YUV_RANGE_LIMITED, YUV_CHROMA_LEFT },
+	{ "709-full",   YUV_BT709, YUV_RANGE_FULL,    YUV_CHROMA_CENTER },
+	{ "601-full",   YUV_BT601, YUV_RANGE_FULL,    YUV_CHROMA_TOPLEFT }
+};
+
+
+// checkNV12
+static bool checkNV12( uint32_t width, uint32_t height, bool padded )
+{
+	// each row holds whole CbCr pairs, so odd widths round the pitch up
+	const size_t tightPitch = alignUp(width, 2);
+
+	kernelBuffers b;
+
+	b.width       = width;
+	b.height      = height;
+	b.inputPitch  = padded ? paddedPitch(tightPitch) : tightPitch;
+	b.outputPitch = padded ? paddedPitch(width * sizeof(float4)) : width * sizeof(float4);
+
+	std::vector<uint8_t> input(b.inputPitch * (height + (height + 1) / 2));
+	randomBytes(input);
+
+	b.input  = allocDevice(input.size(), input.data());
+	b.output = NULL;
+
+	const yuvColorspace original = cudaYUVGetColorspace();
+	bool result = (b.input != NULL);
+
+	for( uint32_t n=0; n < 4 && result; n++ )
+	{
+		const yuvTestColorspace& c = yuvColorspaces[n];
+
+		std::vector<float> reference(width * height * 4);
+		cpuNV12ToRGBAf(input.data(), b.inputPitch, reference.data(), width * sizeof(float4), width, height, c.matrix, c.range, c.siting);
+
+		char name[64];
+		sprintf(name, "nv12-rgbaf/%s", c.name);
+
+		b.output = allocDevice(b.outputPitch * height);
+
+		result = b.output && !CUDA_FAILED(cudaYUVSetColorspace(make_yuvColorspace(c.matrix, c.range, c.siting))) &&
+			    !CUDA_FAILED(launchNV12(b)) && checkOutput(name, b, reference, 0.01f);
+
+		freeDevice(b.output);
+		b.output = NULL;
+	}
+
+	cudaYUVSetColorspace(original);
+	freeBuffers(&b);
+	return result;
+}
+
+
+// checkUYVY
+static bool checkUYVY( uint32_t width, uint32_t height, bool padded )
+{
+	kernelBuffers b;
+
+	b.width       = width & ~1;		// UYVY comes in pairs of pixels
+	b.height      = height;
+	b.inputPitch  = padded ? paddedPitch(b.width * 2) : b.width * 2;
+	b.outputPitch = padded ? paddedPitch(b.width * sizeof(float4)) : b.width * sizeof(float4);
+
+	if( b.width == 0 )
+		return true;
+
+	std::vector<uint8_t> input(b.inputPitch * height);
+	randomBytes(input);
+
+	b.input  = allocDevice(input.size(), input.data());
+	b.output = NULL;
+
+	const yuvColorspace original = cudaYUVGetColorspace();
+	bool result = (b.input != NULL);
+
+	for( uint32_t n=0; n < 4 && result; n++ )
+	{
+		const yuvTestColorspace& c = yuvColorspaces[n];
+
+		std::vector<float> reference(b.width * height * 4);
+		cpuUYVYToRGBAf(input.data(), b.inputPitch, reference.data(), b.width * sizeof(float4), b.width, height, c.matrix, c.range);
+
+		char name[64];
+		sprintf(name, "uyvy-rgbaf/%s", c.name);
+
+		b.output = allocDevice(b.outputPitch * height);
+
+		result = b.output && !CUDA_FAILED(cudaYUVSetColorspace(make_yuvColorspace(c.matrix, c.range, c.siting))) &&
+			    !CUDA_FAILED(launchUYVY(b)) && checkOutput(name, b, reference, 0.01f);
+
+		freeDevice(b.output);
+		b.output = NULL;
+	}
+
+	cudaYUVSetColorspace(original);
+	freeBuffers(&b);
+	return result;
+}
+
+
+// checkNV12Output
+static bool checkNV12Output( const char* kernel, const kernelBuffers& buffers, const std::vector<uint8_t>& reference, int tolerance )
+{
+	// the Y plane, followed by the CbCr plane of whole pairs
+	const size_t chromaBytes = alignUp(buffers.width, 2);
+	const size_t chromaRows  = (buffers.height + 1) / 2;
+	const size_t size        = GUARD_BYTES + buffers.outputPitch * (buffers.height + chromaRows) + GUARD_BYTES;
+
+	std::vector<uint8_t> output(size);
+
+	if( CUDA_FAILED(cudaDeviceSynchronize()) || CUDA_FAILED(cudaMemcpy(output.data(), buffers.output - GUARD_BYTES, size, cudaMemcpyDeviceToHost)) )
+	{
+		printf("bench -- check %-24s %5ux%-5u pitch %5zu/%-5zu FAILED (CUDA error)\n", kernel, buffers.width, buffers.height, buffers.inputPitch, buffers.outputPitch);
+		return false;
+	}
+
+	const uint8_t* luma   = output.data() + GUARD_BYTES;
+	const uint8_t* chroma = luma + buffers.outputPitch * buffers.height;
+
+	imageDiff diff;
+	imageDiff chromaDiff;
+
+	bool matched = cpuCompareBytes(luma, buffers.outputPitch, reference.data(), chromaBytes, buffers.width, buffers.height, tolerance, &diff);
+
+	if( !cpuCompareBytes(chroma, buffers.outputPitch, reference.data() + chromaBytes * buffers.height, chromaBytes, chromaBytes, chromaRows, tolerance, &chromaDiff) )
+	{
+		// report the chroma mismatch by its row in the whole buffer
+		if( matched )
+		{
+			diff = chromaDiff;
+			diff.y += buffers.height;
+		}
+		else
+			diff.mismatches += chromaDiff.mismatches;
+
+		matched = false;
+	}
+
+	diff.maxError = std::max(diff.maxError, chromaDiff.maxError);
+
+	size_t overruns = cpuCountOverruns(luma, buffers.outputPitch, buffers.width, buffers.height, 0, SENTINEL) +
+				   cpuCountOverruns(chroma, buffers.outputPitch, chromaBytes, chromaRows, GUARD_BYTES, SENTINEL);
+
+	for( size_t n=0; n < GUARD_BYTES; n++ )
+	{
+		if( output[n] != SENTINEL )
+			overruns++;
+	}
+
+	return reportCheck(kernel, buffers, matched, diff, overruns, tolerance);
+}
+
+
+// checkRGBAToNV12
+template<typename T>
+static bool checkRGBAToNV12( const char* kernel, uint32_t width, uint32_t height, bool padded )
+{
+	kernelBuffers b;
+
+	b.width       = width;
+	b.height      = height;
+	b.inputPitch  = padded ? paddedPitch(width * sizeof(T) * 4) : width * sizeof(T) * 4;
+	b.outputPitch = padded ? paddedPitch(width) : alignUp(width, 2);
+
+	// the reference takes float pixels, whichever type the kernel does
+	std::vector<float>   pixels(width * height * 4);
+	std::vector<uint8_t> input(b.inputPitch * height);
+
+	randomFloats(pixels, 255.0f);
+
+	for( uint32_t y=0; y < height; y++ )
+	{
+		T* row = (T*)(input.data() + y * b.inputPitch);
+
+		for( uint32_t x=0; x < width * 4; x++ )
+		{
+			row[x] = (T)pixels[y * width * 4 + x];
+			pixels[y * width * 4 + x] = row[x];
+		}
+	}
+
+	b.input  = allocDevice(input.size(), input.data());
+	b.output = NULL;
+
+	const yuvColorspace original = cudaYUVGetColorspace();
+	const size_t chromaBytes = alignUp(width, 2);
+	bool result = (b.input != NULL);
+
+	for( uint32_t n=0; n < 4 && result; n++ )
+	{
+		const yuvTestColorspace& c = yuvColorspaces[n];
+
+		std::vector<uint8_t> reference(chromaBytes * (height + (height + 1) / 2));
+		cpuRGBAToNV12(pixels.data(), width * sizeof(float4), reference.data(), chromaBytes, width, height, c.matrix, c.range);
+
+		char name[64];
+		sprintf(name, "%s/%s", kernel, c.name);
+
+		b.output = allocDevice(b.outputPitch * (height + (height + 1) / 2));
+
+		// the float math can round across a whole value
+		result = b.output && !CUDA_FAILED(cudaYUVSetColorspace(make_yuvColorspace(c.matrix, c.range, c.siting))) &&
+			    !CUDA_FAILED(sizeof(T) == 1 ? launchRGBA8NV12(b) : launchRGBAfNV12(b)) && checkNV12Output(name, b, reference, 1);
+
+		freeDevice(b.output);
+		b.output = NULL;
+	}
+
+	cudaYUVSetColorspace(original);
+	freeBuffers(&b);
+	return result;
+}
+
+static bool checkRGBAfNV12( uint32_t width, uint32_t height, bool padded )	{ return checkRGBAToNV12<float>("rgbaf-nv12", width, height, padded); }
+static bool checkRGBA8NV12( uint32_t width, uint32_t height, bool padded )	{ return checkRGBAToNV12<uint8_t>("rgba8-nv12", width, height, padded); }
+
+
+// checkYUYV
+static bool checkYUYV( uint32_t width, uint32_t height, bool padded )
+{
+	kernelBuffers b;
+
+	b.width       = width & ~1;		// YUYV comes in pairs of pixels
+	b.height      = height;
+	b.inputPitch  = padded ? paddedPitch(b.width * 2) : b.width * 2;
+	b.outputPitch = padded ? paddedPitch(b.width * sizeof(uchar4)) : b.width * sizeof(uchar4);
+
+	if( b.width == 0 )
+		return true;
+
+	std::vector<uint8_t> input(b.inputPitch * height);
+	std::vector<uint8_t> reference(b.width * height * 4);
+
+	randomBytes(input);
+	cpuYUYVToRGBA(input.data(), b.inputPitch, reference.data(), b.width * sizeof(uchar4), b.width, height);
+
+	b.input  = allocDevice(input.size(), input.data());
+	b.output = allocDevice(b.outputPitch * height);
+
+	// the float math can round across a whole value
+	const bool result = b.input && b.output && !CUDA_FAILED(launchYUYV(b)) && checkOutput("yuyv-rgba", b, reference, 1);
+
+	freeBuffers(&b);
+	return result;
+}
+
+
+// checkBayer
+static bool checkBayer( uint32_t width, uint32_t height, bool padded )
+{
+	if( padded )
+		return true;	// no pitch arguments
+
+	kernelBuffers b;
+
+	b.width       = width;
+	b.height      = height;
+	b.inputPitch  = width;
+	b.outputPitch = width * sizeof(float4);
+
+	std::vector<uint8_t> input(width * height);
+	std::vector<float>   reference(width * height * 4);
+
+	randomBytes(input);
+	cpuBAYER_GR8toRGBA(input.data(), width, reference.data(), b.outputPitch, width, height);
+
+	b.input  = allocDevice(input.size(), input.data());
+	b.output = allocDevice(b.outputPitch * height);
+
+	const bool result = b.input && b.output && !CUDA_FAILED(launchBayer(b)) && checkOutput("bayer-gr8-rgbaf", b, reference, 0.01f);
+
+	freeBuffers(&b);
+	return result;
+}
+
+
+// the four CFA patterns, with the position of their red pixel
+struct bayerTestPattern
+{
+	const char*  name;
+	bayerPattern pattern;
+	int          redX;
+	int          redY;
+};
+
+static const bayerTestPattern bayerPatterns[] =
+{
+	{ "rggb", BAYER_RGGB, 0, 0 },
+	{ "bggr", BAYER_BGGR, 1, 1 },
+	{ "grbg", BAYER_GRBG, 1, 0 },
+	{ "gbrg", BAYER_GBRG, 0, 1 }
+};
+
+
+// checkBayerRGBA
+template<typename T>
+static bool checkBayerRGBA( const char* kernel, uint32_t width, uint32_t height, bool padded, bayerQuality quality )
+{
+	const float balance[] = { bayerBalance.x, bayerBalance.y, bayerBalance.z };
+
+	kernelBuffers b;
+
+	b.width       = width;
+	b.height      = height;
+	b.inputPitch  = padded ? paddedPitch(width) : width;
+	b.outputPitch = padded ? paddedPitch(width * sizeof(T) * 4) : width * sizeof(T) * 4;
+
+	std::vector<uint8_t> input(b.inputPitch * height);
+	randomBytes(input);
+
+	b.input = allocDevice(input.size(), input.data());
+	bool result = (b.input != NULL);
+
+	for( uint32_t n=0; n < 4 && result; n++ )
+	{
+		const bayerTestPattern& p = bayerPatterns[n];
+
+		std::vector<float> rgba(width * height * 4);
+		cpuBayerToRGBA(input.data(), b.inputPitch, rgba.data(), width * sizeof(float4), width, height, p.redX, p.redY, quality == BAYER_MALVAR, balance);
+
+		// the 8-bit output rounds to the nearest value
+		std::vector<T> reference(rgba.size());
+
+		for( size_t i=0; i < rgba.size(); i++ )
+			reference[i] = (sizeof(T) == 1) ? (T)(rgba[i] + 0.5f) : (T)rgba[i];
+
+		char name[64];
+		sprintf(name, "%s/%s", kernel, p.name);
+
+		b.output = allocDevice(b.outputPitch * height);
+
+		if( sizeof(T) == 1 )
+			result = b.output && !CUDA_FAILED(cudaBayerToRGBA(b.input, b.inputPitch, (uchar4*)b.output, b.outputPitch, width, height, p.pattern, quality, bayerBalance));
+		else
+			result = b.output && !CUDA_FAILED(cudaBayerToRGBA(b.input, b.inputPitch, (float4*)b.output, b.outputPitch, width, height, p.pattern, quality, bayerBalance));
+
+		// the 8-bit output can round across a whole value
+		const float tolerance = (sizeof(T) == 1) ? 1.0f : 0.01f;
+
+		if( result )
+			result = checkOutput(name, b, reference, (T)tolerance);
+
+		freeDevice(b.output);
+		b.output = NULL;
+	}
+
+	freeBuffers(&b);
+	return result;
+}
+
+static bool checkBayerBilinear( uint32_t width, uint32_t height, bool padded )	{ return checkBayerRGBA<float>("bayer-bilinear-rgbaf", width, height, padded, BAYER_BILINEAR); }
+static bool checkBayerMalvar( uint32_t width, uint32_t height, bool padded )	{ return checkBayerRGBA<float>("bayer-malvar-rgbaf", width, height, padded, BAYER_MALVAR); }
+static bool checkBayerMalvar8( uint32_t width, uint32_t height, bool padded )	{ return checkBayerRGBA<uint8_t>("bayer-malvar-rgba8", width, height, padded, BAYER_MALVAR); }
+
+
+// checkTensor
+static bool checkTensor( const char* kernel, const kernelBuffers& buffers, const std::vector<float>& reference, float tolerance )
+{
+	const size_t planeSize = buffers.width * buffers.height;
+	const size_t size      = GUARD_BYTES + planeSize * sizeof(float) * 3 + GUARD_BYTES;
+
+	std::vector<uint8_t> output(size);
+
+	if( CUDA_FAILED(cudaDeviceSynchronize()) || CUDA_FAILED(cudaMemcpy(output.data(), buffers.output - GUARD_BYTES, size, cudaMemcpyDeviceToHost)) )
+	{
+		printf("bench -- check %-24s %5ux%-5u pitch %5zu/%-5zu FAILED (CUDA error)\n", kernel, buffers.width, buffers.height, buffers.inputPitch, buffers.outputPitch);
+		return false;
+	}
+
+	// interleave the planes, so they compare like an image
+	const float* planes = (const float*)(output.data() + GUARD_BYTES);
+	std::vector<float> tensor(planeSize * 4);
+
+	for( size_t i=0; i < planeSize; i++ )
+	{
+		tensor[i * 4 + 0] = planes[planeSize * 0 + i];
+		tensor[i * 4 + 1] = planes[planeSize * 1 + i];
+		tensor[i * 4 + 2] = planes[planeSize * 2 + i];
+		tensor[i * 4 + 3] = 0.0f;
+	}
+
+	imageDiff diff;
+
+	const size_t rowBytes = buffers.width * sizeof(float4);
+	const bool   matched  = cpuCompareImages(tensor.data(), rowBytes, reference.data(), rowBytes, buffers.width, buffers.height, tolerance, &diff);
+
+	size_t overruns = cpuCountOverruns(output.data() + GUARD_BYTES, planeSize * sizeof(float) * 3, planeSize * sizeof(float) * 3, 1, GUARD_BYTES, SENTINEL);
+
+	for( size_t n=0; n < GUARD_BYTES; n++ )
+	{
+		if( output[n] != SENTINEL )
+			overruns++;
+	}
+
+	return reportCheck(kernel, buffers, matched, diff, overruns, tolerance);
+}
+
+
+// checkBayerTensor
+static bool checkBayerTensor( uint32_t width, uint32_t height, bool padded )
+{
+	const float balance[] = { bayerBalance.x, bayerBalance.y, bayerBalance.z };
+
+	kernelBuffers b;
+
+	b.inputPitch = padded ? paddedPitch(width) : width;
+
+	std::vector<uint8_t> input(b.inputPitch * height);
+	randomBytes(input);
+
+	b.input = allocDevice(input.size(), input.data());
+	bool result = (b.input != NULL);
+
+	// the same size as the image, and resampled to a typical network input
+	const uint32_t sizes[][2] = { { width, height }, { 224, 224 } };
+
+	for( uint32_t n=0; n < 4 && result; n++ )
+	{
+		const bayerTestPattern& p = bayerPatterns[n];
+
+		std::vector<float> rgba(width * height * 4);
+		cpuBayerToRGBA(input.data(), b.inputPitch, rgba.data(), width * sizeof(float4), width, height, p.redX, p.redY, true, balance);
+
+		for( uint32_t s=0; s < 2 && result; s++ )
+		{
+			b.width       = sizes[s][0];
+			b.height      = sizes[s][1];
+			b.outputPitch = b.width * sizeof(float) * 3;
+
+			// nearest sampling, computed the way the kernel does
+			const float scaleX = float(width) / float(b.width);
+			const float scaleY = float(height) / float(b.height);
+
+			std::vector<float> reference(b.width * b.height * 4);
+
+			for( uint32_t y=0; y < b.height; y++ )
+			{
+				for( uint32_t x=0; x < b.width; x++ )
+				{
+					const float* px = &rgba[((int)(y * scaleY) * width + (int)(x * scaleX)) * 4];
+					float* out = &reference[(y * b.width + x) * 4];
+
+					out[0] = px[2] - bayerMean.x;
+					out[1] = px[1] - bayerMean.y;
+					out[2] = px[0] - bayerMean.z;
+					out[3] = 0.0f;
+				}
+			}
+
+			char name[64];
+			sprintf(name, "bayer-malvar-tensor/%s", p.name);
+
+			b.output = allocDevice(b.width * b.height * sizeof(float) * 3);
+
+			result = b.output && !CUDA_FAILED(cudaBayerToTensor(b.input, b.inputPitch, width, height, (float*)b.output, b.width, b.height, 
+													  p.pattern, BAYER_MALVAR, bayerBalance, bayerMean)) &&
+				    checkTensor(name, b, reference, 0.01f);
+
+			freeDevice(b.output);
+			b.output = NULL;
+		}
+	}
+
+	freeBuffers(&b);
+	return result;
+}
+
+
+// checkResize
+static bool checkResize( uint32_t width, uint32_t height, bool padded )
+{
+	if( padded )
+		return true;	// no pitch arguments
+
+	std::vector<float> input(width * height * 4);
+	randomFloats(input, 255.0f);
+
+	kernelBuffers b;
+
+	b.input      = allocDevice(input.size() * sizeof(float), input.data());
+	b.output     = NULL;
+	b.inputPitch = width * sizeof(float4);
+
+	// shrink, grow, and a ratio that doesn't divide evenly
+	const uint32_t sizes[][2] = { { (width + 1) / 2, (height + 1) / 2 }, { width * 2, height * 2 }, { width * 2 / 3 + 1, height * 3 / 4 + 1 } };
+	bool result = (b.input != NULL);
+
+	for( uint32_t n=0; n < 3 && result; n++ )
+	{
+		b.width       = sizes[n][0];
+		b.height      = sizes[n][1];
+		b.outputPitch = b.width * sizeof(float4);
+		b.output      = allocDevice(b.outputPitch * b.height);
+
+		std::vector<float> reference(b.width * b.height * 4);
+		cpuResizeRGBA(input.data(), width, height, reference.data(), b.width, b.height);
+
+		result = b.output && !CUDA_FAILED(cudaResizeRGBA((float4*)b.input, width, height, (float4*)b.output, b.width, b.height)) &&
+			    checkOutput("resize-rgba", b, reference, 0.0f);
+
+		freeDevice(b.output);
+		b.output = NULL;
+	}
+
+	freeBuffers(&b);
+	return result;
+}
+
+
+// checkNormalize
+static bool checkNormalize( uint32_t width, uint32_t height, bool padded )
+{
+	if( padded )
+		return true;	// no pitch arguments
+
+	kernelBuffers b;
+
+	b.width       = width;
+	b.height      = height;
+	b.inputPitch  = width * sizeof(float4);
+	b.outputPitch = width * sizeof(float4);
+
+	std::vector<float> input(width * height * 4);
+	std::vector<float> reference(width * height * 4);
+
+	randomFloats(input, 255.0f);
+	cpuNormalizeRGBA(input.data(), 0.0f, 255.0f, reference.data(), 0.0f, 1.0f, width, height);
+
+	b.input  = allocDevice(input.size() * sizeof(float), input.data());
+	b.output = allocDevice(b.outputPitch * height);
+
+	const bool result = b.input && b.output && !CUDA_FAILED(launchNormalize(b)) && checkOutput("normalize-rgba", b, reference, 1e-6f);
+
+	freeBuffers(&b);
+	return result;
+}
+
+
+// checkRects
+static bool checkRects( uint32_t width, uint32_t height, bool padded )
+{
+	if( padded )
+		return true;	// no pitch arguments
+
+	kernelBuffers b;
+
+	b.width       = width;
+	b.height      = height;
+	b.inputPitch  = width * sizeof(float4);
+	b.outputPitch = width * sizeof(float4);
+
+	const std::vector<float4> rects = overlayRects(width, height);
+	const float color[] = { overlayColor.x, overlayColor.y, overlayColor.z, overlayColor.w };
+
+	std::vector<float> input(width * height * 4);
+	std::vector<float> reference(width * height * 4);
+
+	randomFloats(input, 255.0f);
+	cpuRectOutlineOverlay(input.data(), reference.data(), width, height, (const float*)rects.data(), rects.size(), color);
+
+	b.input  = allocDevice(input.size() * sizeof(float), input.data());
+	b.output = allocDevice(b.outputPitch * height);
+
+	rectsGPU = (float4*)allocDevice(rects.size() * sizeof(float4), rects.data());
+	numRects = rects.size();
+
+	const bool result = b.input && b.output && rectsGPU && !CUDA_FAILED(launchRects(b)) && checkOutput("rect-overlay", b, reference, 1e-3f);
+
+	freeDevice(rectsGPU);
+
+	rectsGPU = NULL;
+	freeBuffers(&b);
+	return result;
+}
+
+
+// checkText
+static bool checkText( uint32_t width, uint32_t height, bool padded )
+{
+	if( padded )
+		return true;	// no pitch arguments
+
+	kernelBuffers b;
+
+	b.width       = width;
+	b.height      = height;
+	b.inputPitch  = width * sizeof(float4);
+	b.outputPitch = width * sizeof(float4);
+
+	const float color[] = { overlayColor.x, overlayColor.y, overlayColor.z, overlayColor.w };
+
+	std::vector<float> reference(width * height * 4);
+	randomFloats(reference, 255.0f);
+
+	b.input  = NULL;
+	b.output = allocDevice(reference.size() * sizeof(float), reference.data());
+
+	cpuOverlayText((const float*)fontCPU, fontWidth, fontCellWidth, fontCellHeight, fontText, width / 4, height / 3, color, reference.data(), width, height);
+
+	const bool result = b.output && !CUDA_FAILED(launchText(b)) && checkOutput("text-overlay", b, reference, 1e-3f);
+
+	freeBuffers(&b);
+	return result;
+}
+
+
+//-----------------------------------------------------------------------------------
+// timings
+//-----------------------------------------------------------------------------------
+
+// the buffers a kernel is timed with, and the bytes it moves
+typedef void (*kernelSizes)( uint32_t width, uint32_t height, kernelBuffers* buffers, size_t* inputSize, size_t* outputSize, double* traffic );
+
+static void sizesNV12( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = alignUp(width, 2);
+	b->outputPitch = width * sizeof(float4);
+
+	*inputSize  = b->inputPitch * (height + (height + 1) / 2);
+	*outputSize = b->outputPitch * height;
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesUYVY( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = width * 2;
+	b->outputPitch = width * sizeof(float4);
+
+	*inputSize  = b->inputPitch * height;
+	*outputSize = b->outputPitch * height;
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesRGBAfNV12( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = width * sizeof(float4);
+	b->outputPitch = alignUp(width, 2);
+
+	*inputSize  = b->inputPitch * height;
+	*outputSize = b->outputPitch * (height + (height + 1) / 2);
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesRGBA8NV12( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	sizesRGBAfNV12(width, height, b, inputSize, outputSize, traffic);
+
+	b->inputPitch = width * sizeof(uchar4);
+	*inputSize    = b->inputPitch * height;
+	*traffic      = *inputSize + *outputSize;
+}
+
+static void sizesYUYV( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = width * 2;
+	b->outputPitch = width * sizeof(uchar4);
+
+	*inputSize  = b->inputPitch * height;
+	*outputSize = b->outputPitch * height;
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesBayer( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = width;
+	b->outputPitch = width * sizeof(float4);
+
+	*inputSize  = b->inputPitch * height;
+	*outputSize = b->outputPitch * height;
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesBayer8( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = width;
+	b->outputPitch = width * sizeof(uchar4);
+
+	*inputSize  = b->inputPitch * height;
+	*outputSize = b->outputPitch * height;
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesTensor( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = width;
+	b->outputPitch = width * sizeof(float) * 3;
+
+	*inputSize  = b->inputPitch * height;
+	*outputSize = b->outputPitch * height;
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesRGBA( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	b->inputPitch  = width * sizeof(float4);
+	b->outputPitch = width * sizeof(float4);
+
+	*inputSize  = b->inputPitch * height;
+	*outputSize = b->outputPitch * height;
+	*traffic    = *inputSize + *outputSize;
+}
+
+static void sizesText( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	sizesRGBA(width, height, b, inputSize, outputSize, traffic);
+
+	// only the glyph cells are touched:  read from the font, then read and written in the image
+	*traffic = double(strlen(fontText) * fontCellWidth * fontCellHeight * sizeof(float4) * 3);
+}
+
+// the resize halves the image, reading only the pixels it keeps
+static cudaError_t launchResize( const kernelBuffers& b )
+{
+	return cudaResizeRGBA((float4*)b.input, b.width, b.height, (float4*)b.output, b.width / 2, b.height / 2);
+}
+
+static void sizesResize( uint32_t width, uint32_t height, kernelBuffers* b, size_t* inputSize, size_t* outputSize, double* traffic )
+{
+	sizesRGBA(width, height, b, inputSize, outputSize, traffic);
+
+	*outputSize = (width / 2) * (height / 2) * sizeof(float4);
+	*traffic    = *outputSize * 2;
+}
+
+
+// the kernels under test
+struct kernelTest
+{
+	const char* name;
+	bool (*check)( uint32_t width, uint32_t height, bool padded );
+	cudaError_t (*launch)( const kernelBuffers& buffers );
+	kernelSizes sizes;
+};
+
+static const kernelTest kernels[] = 
+{
+	{ "nv12-rgbaf",           checkNV12,          launchNV12,          sizesNV12 },
+	{ "uyvy-rgbaf",           checkUYVY,          launchUYVY,          sizesUYVY },
+	{ "rgbaf-nv12",           checkRGBAfNV12,     launchRGBAfNV12,     sizesRGBAfNV12 },
+	{ "rgba8-nv12",           checkRGBA8NV12,     launchRGBA8NV12,     sizesRGBA8NV12 },
+	{ "yuyv-rgba",            checkYUYV,          launchYUYV,          sizesYUYV },
+	{ "bayer-gr8-rgbaf",      checkBayer,         launchBayer,         sizesBayer },
+	{ "bayer-bilinear-rgbaf", checkBayerBilinear, launchBayerBilinear, sizesBayer },
+	{ "bayer-malvar-rgbaf",   checkBayerMalvar,   launchBayerMalvar,   sizesBayer },
+	{ "bayer-malvar-rgba8",   checkBayerMalvar8,  launchBayerMalvar8,  sizesBayer8 },
+	{ "bayer-malvar-tensor",  checkBayerTensor,   launchBayerTensor,   sizesTensor },
+	{ "resize-rgba",          checkResize,        launchResize,        sizesResize },
+	{ "normalize-rgba",       checkNormalize,     launchNormalize,     sizesRGBA },
+	{ "rect-overlay",         checkRects,         launchRects,         sizesRGBA },
+	{ "text-overlay",         checkText,          launchText,          sizesText }
+};
+
+static const uint32_t numKernels = sizeof(kernels) / sizeof(kernelTest);
+
+
+// benchKernel
+static void benchKernel( const kernelTest* kernel, uint32_t width, uint32_t height, uint32_t iterations, double peak, benchResults* results )
+{
+	char name[256];
+	sprintf(name, "%s/%ux%u", kernel->name, width, height);
+
+	results->Begin(name);
+
+	kernelBuffers b;
+
+	b.width  = width;
+	b.height = height;
+
+	size_t inputSize  = 0;
+	size_t outputSize = 0;
+	double traffic    = 0;
+
+	kernel->sizes(width, height, &b, &inputSize, &outputSize, &traffic);
+
+	std::vector<uint8_t> input(inputSize);
+	randomBytes(input);
+
+	// the float images get values in range, rather than random bit patterns
+	if( kernel->sizes == sizesRGBA || kernel->sizes == sizesResize || kernel->sizes == sizesText || kernel->sizes == sizesRGBAfNV12 )
+	{
+		std::vector<float> pixels(inputSize / sizeof(float));
+		randomFloats(pixels, 255.0f);
+		memcpy(input.data(), pixels.data(), inputSize);
+	}
+
+	b.input  = allocDevice(inputSize, input.data());
+	b.output = allocDevice(std::max(outputSize, inputSize), input.data());
+
+	std::vector<float4> rects = overlayRects(width, height);
+
+	rectsGPU = (float4*)allocDevice(rects.size() * sizeof(float4), rects.data());
+	numRects = rects.size();
+
+	cudaEvent_t begin = NULL;
+	cudaEvent_t end   = NULL;
+
+	if( !b.input || !b.output || !rectsGPU || CUDA_FAILED(cudaEventCreate(&begin)) || CUDA_FAILED(cudaEventCreate(&end)) )
+	{
+		results->Skip("failed to allocate the buffers");
+	}
+	else
+	{
+		benchSamples samples;
+		bool failed = false;
+
+		for( uint32_t i=0; i < iterations + 5 && !failed; i++ )		// the first few warm up
+		{
+			CUDA(cudaEventRecord(begin));
+
+			if( CUDA_FAILED(kernel->launch(b)) )
+				failed = true;
+
+			CUDA(cudaEventRecord(end));
+
+			float ms = 0.0f;
+
+			if( CUDA_FAILED(cudaEventSynchronize(end)) || CUDA_FAILED(cudaEventElapsedTime(&ms, begin, end)) )
+				failed = true;
+
+			if( i >= 5 )
+				samples.Add(uint64_t(ms * 1000000.0));
+		}
+
+		if( failed || samples.GetCount() == 0 )
+		{
+			results->Skip("the kernel failed");
+		}
+		else
+		{
+			const double median = samples.Percentile(50);
+			const double gbps   = (median > 0.0) ? traffic / (median * 0.001) * 1e-9 : 0.0;
+
+			results->Latency("kernel", samples);
+			results->Metric("gb_per_sec", gbps, benchResults::HIGHER);
+
+			if( peak > 0.0 )
+				results->Metric("peak_percent", gbps / peak * 100.0, benchResults::NEITHER);
+
+			printf("bench -- %-28s %8.3f ms (p50)  %7.2f GB/s", name, median, gbps);
+
+			if( peak > 0.0 )
+				printf("  %5.1f%% of peak", gbps / peak * 100.0);
+
+			printf("\n");
+		}
+	}
+
+	if( begin != NULL )
+		CUDA(cudaEventDestroy(begin));
+
+	if( end != NULL )
+		CUDA(cudaEventDestroy(end));
+
+	freeDevice(rectsGPU);
+
+	rectsGPU = NULL;
+	freeBuffers(&b);
+}
+
+
+// print usage
+static int usage()
+{
+	printf("usage: cuda-kernel-bench [--kernels=<list>] [--resolutions=<list>] [--iterations=N] [--peak=<GB/s>]\n");
+	printf("                         [--check-only] [--output=<file>] [--baseline=<file>] [--tolerance=<percent>]\n\n");
+	printf("  --kernels      comma-separated kernels, or 'all' (default), from:\n                 ");
+
+	for( uint32_t n=0; n < numKernels; n++ )
+		printf("%s%s", kernels[n].name, (n + 1 < numKernels) ? ", " : "\n");
+
+	printf("  --resolutions  resolutions the kernels are timed at (default 640x480,1280x720,1920x1080)\n");
+	printf("  --iterations   timed launches per resolution (default 100)\n");
+	printf("  --peak         memory bandwidth to compare against, in GB/s (default from the device)\n");
+	printf("  --font         font map for the text overlay (default fontmapA.png)\n");
+	printf("  --check-only   only check the kernels against the CPU references\n");
+	printf("  --output       write the timings as JSON to the file (default stdout)\n");
+	printf("  --baseline     compare the timings against saved results, and fail on regressions\n");
+	printf("  --tolerance    allowed regression in percent (default 10)\n\n");
+	printf("Without a CUDA device, only the CPU references are checked.\n");
+	return 0;
+}
+
+
+// main entry point
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	// the references are checked first, since everything else relies on them
+	if( cpuReferenceSelfTest() > 0 )
+	{
+		printf("bench -- FAILED:  the CPU references are wrong, not checking the kernels\n");
+		return 1;
+	}
+
+	int devices = 0;
+
+	if( cudaGetDeviceCount(&devices) != cudaSuccess || devices == 0 )
+	{
+		printf("bench -- no CUDA device, only the CPU references were checked\n");
+		return 0;
+	}
+
+	// kernels
+	const char* kernelList = cmdLine.GetString("kernels");
+	std::vector<const kernelTest*> selected;
+
+	if( !kernelList || strcasecmp(kernelList, "all") == 0 )
+	{
+		for( uint32_t n=0; n < numKernels; n++ )
+			selected.push_back(&kernels[n]);
+	}
+	else
+	{
+		const std::vector<std::string> names = benchSplitList(kernelList);
+
+		for( size_t i=0; i < names.size(); i++ )
+		{
+			const kernelTest* kernel = NULL;
+
+			for( uint32_t n=0; n < numKernels && !kernel; n++ )
+			{
+				if( strcasecmp(names[i].c_str(), kernels[n].name) == 0 )
+					kernel = &kernels[n];
+			}
+
+			if( !kernel )
+			{
+				printf("bench -- unknown kernel '%s'\n", names[i].c_str());
+				return usage();
+			}
+
+			selected.push_back(kernel);
+		}
+	}
+
+	// resolutions
+	const char* resolutionList = cmdLine.GetString("resolutions");
+	const std::vector<std::string> resolutions = benchSplitList(resolutionList != NULL ? resolutionList : "640x480,1280x720,1920x1080");
+
+	std::vector<uint32_t> widths;
+	std::vector<uint32_t> heights;
+
+	for( size_t n=0; n < resolutions.size(); n++ )
+	{
+		uint32_t width  = 0;
+		uint32_t height = 0;
+
+		if( sscanf(resolutions[n].c_str(), "%ux%u", &width, &height) != 2 || width < 2 || height < 2 )
+		{
+			printf("bench -- invalid resolution '%s'\n", resolutions[n].c_str());
+			return usage();
+		}
+
+		widths.push_back(width);
+		heights.push_back(height);
+	}
+
+	// the font map, for the text overlay
+	for( size_t n=0; n < selected.size(); n++ )
+	{
+		if( selected[n]->check != checkText )
+			continue;
+
+		const char* fontPath = cmdLine.GetString("font");
+
+		if( !fontPath )
+			fontPath = "fontmapA.png";
+
+		font = cudaFont::Create(fontPath);
+
+		if( !font || !loadImageRGBA(fontPath, &fontCPU, &fontGPU, &fontWidth, &fontHeight) )
+		{
+			printf("bench -- failed to load the font map '%s', skipping text-overlay\n", fontPath);
+			selected.erase(selected.begin() + n);
+		}
+
+		break;
+	}
+
+	// correctness, over odd sizes and padded pitches
+	const uint32_t checkSizes[][2] = { { 2, 2 }, { 17, 9 }, { 64, 31 }, { 321, 241 }, { 640, 481 }, { 1281, 721 } };
+	const uint32_t numCheckSizes = sizeof(checkSizes) / sizeof(checkSizes[0]);
+
+	uint32_t failures = 0;
+
+	for( size_t n=0; n < selected.size(); n++ )
+	{
+		for( uint32_t s=0; s < numCheckSizes; s++ )
+		{
+			for( int padded=0; padded < 2; padded++ )
+			{
+				if( !selected[n]->check(checkSizes[s][0], checkSizes[s][1], padded) )
+					failures++;
+			}
+		}
+	}
+
+	if( failures > 0 )
+		printf("\nbench -- FAILED:  %u kernel checks didn't match the CPU references\n\n", failures);
+	else
+		printf("\nbench -- every kernel matched the CPU references\n\n");
+
+	if( cmdLine.GetFlag("check-only") )
+		return (failures > 0) ? 1 : 0;
+
+	// timings, against the peak memory bandwidth
+	double peak = cmdLine.GetFloat("peak");
+
+	if( peak <= 0.0 )
+	{
+		cudaDeviceProp props;
+
+		if( cudaGetDeviceProperties(&props, 0) == cudaSuccess )
+		{
+			peak = 2.0 * props.memoryClockRate * 1000.0 * (props.memoryBusWidth / 8) * 1e-9;
+			printf("bench -- %s, peak memory bandwidth %.1f GB/s (%i-bit at %.0f MHz)\n", props.name, peak, props.memoryBusWidth, props.memoryClockRate * 0.001);
+		}
+	}
+
+	const int iterations = cmdLine.GetInt("iterations") > 0 ? cmdLine.GetInt("iterations") : 100;
+
+	benchResults results;
+
+	for( size_t n=0; n < selected.size(); n++ )
+		for( size_t r=0; r < widths.size(); r++ )
+			benchKernel(selected[n], widths[r], heights[r], iterations, peak, &results);
+
+	if( !results.Save(cmdLine.GetString("output"), "cuda-kernel-bench") )
+		return 1;
+
+	if( font != NULL )
+		delete font;
+
+	if( fontCPU != NULL )
+		CUDA(cudaFreeHost(fontCPU));
+
+	// compare against the baseline
+	const char* baselinePath = cmdLine.GetString("baseline");
+
+	if( baselinePath != NULL )
+	{
+		benchResults baseline;
+
+		if( !baseline.Load(baselinePath) )
+			return 1;
+
+		const float tolerance = cmdLine.GetString("tolerance") != NULL ? cmdLine.GetFloat("tolerance") : 10.0f;
+		const uint32_t regressions = results.Compare(baseline, tolerance * 0.01);
+
+		if( regressions > 0 )
+		{
+			printf("\nbench -- FAILED:  %u regressions against '%s'\n", regressions, baselinePath);
+			return 1;
+		}
+	}
+
+	return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,583 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "imageNet.h"
+#include "detectNet.h"
+#include "segNet.h"
+
+#include "camera.h"
+#include "commandLine.h"
+#include "cudaMappedMemory.h"
+#include "trace.h"
+
+#include "benchResults.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+
+// kinds of networks
+enum netKind
+{
+	KIND_IMAGENET,
+	KIND_DETECTNET,
+	KIND_SEGNET
+};
+
+
+// the networks that ship with the repo, by the names their consoles take
+struct benchNetwork
+{
+	const char* name;
+	netKind     kind;
+	int         type;
+};
+
+static const benchNetwork networks[] = 
+{
+	{ "alexnet",                       KIND_IMAGENET,  imageNet::ALEXNET },
+	{ "googlenet",                     KIND_IMAGENET,  imageNet::GOOGLENET },
+	{ "pednet",                        KIND_DETECTNET, detectNet::PEDNET },
+	{ "multiped",                      KIND_DETECTNET, detectNet::PEDNET_MULTI },
+	{ "facenet",                       KIND_DETECTNET, detectNet::FACENET },
+	{ "coco-airplane",                 KIND_DETECTNET, detectNet::COCO_AIRPLANE },
+	{ "coco-bottle",                   KIND_DETECTNET, detectNet::COCO_BOTTLE },
+	{ "coco-chair",                    KIND_DETECTNET, detectNet::COCO_CHAIR },
+	{ "coco-dog",                      KIND_DETECTNET, detectNet::COCO_DOG },
+	{ "fcn-alexnet-pascal-voc",        KIND_SEGNET,    segNet::FCN_ALEXNET_PASCAL_VOC },
+	{ "fcn-alexnet-synthia-cvpr16",    KIND_SEGNET,    segNet::FCN_ALEXNET_SYNTHIA_CVPR16 },
+	{ "fcn-alexnet-synthia-summer-hd", KIND_SEGNET,    segNet::FCN_ALEXNET_SYNTHIA_SUMMER_HD },
+	{ "fcn-alexnet-synthia-summer-sd", KIND_SEGNET,    segNet::FCN_ALEXNET_SYNTHIA_SUMMER_SD },
+	{ "fcn-alexnet-cityscapes-hd",     KIND_SEGNET,    segNet::FCN_ALEXNET_CITYSCAPES_HD },
+	{ "fcn-alexnet-cityscapes-sd",     KIND_SEGNET,    segNet::FCN_ALEXNET_CITYSCAPES_SD },
+	{ "fcn-alexnet-aerial-fpv-720p",   KIND_SEGNET,    segNet::FCN_ALEXNET_AERIAL_FPV_720p }
+};
+
+static const uint32_t numNetworks = sizeof(networks) / sizeof(benchNetwork);
+
+
+// settings shared by every run
+struct benchConfig
+{
+	const char* input;
+	uint32_t    iterations;
+	uint32_t    warmup;
+
+	std::vector<uint32_t> widths;
+	std::vector<uint32_t> heights;
+	std::vector<uint32_t> batchSizes;
+};
+
+
+// the network being benchmarked, with its output buffers
+struct benchNet
+{
+	const benchNetwork* network;
+	tensorNet*          net;
+
+	int*   classesCPU;
+	int*   classesCUDA;
+	float* bbCPU;
+	float* bbCUDA;
+	float* confCPU;
+	float* confCUDA;
+};
+
+
+// timestamp
+static inline uint64_t timestamp()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+
+// createNet
+static bool createNet( const benchNetwork* network, uint32_t maxBatchSize, benchNet* bench )
+{
+	memset(bench, 0, sizeof(benchNet));
+	bench->network = network;
+
+	if( network->kind == KIND_IMAGENET )
+	{
+		imageNet* net = imageNet::Create((imageNet::NetworkType)network->type, maxBatchSize);
+
+		if( !net )
+			return false;
+
+		bench->net = net;
+
+		if( !cudaAllocMapped((void**)&bench->classesCPU, (void**)&bench->classesCUDA, maxBatchSize * sizeof(int)) ||
+		    !cudaAllocMapped((void**)&bench->confCPU, (void**)&bench->confCUDA, maxBatchSize * sizeof(float)) )
+			return false;
+	}
+	else if( network->kind == KIND_DETECTNET )
+	{
+		detectNet* net = detectNet::Create((detectNet::NetworkType)network->type, 0.5f, maxBatchSize);
+
+		if( !net )
+			return false;
+
+		bench->net = net;
+
+		const uint32_t maxBoxes = net->GetMaxBoundingBoxes();
+
+		if( !cudaAllocMapped((void**)&bench->bbCPU, (void**)&bench->bbCUDA, maxBoxes * sizeof(float4)) ||
+		    !cudaAllocMapped((void**)&bench->confCPU, (void**)&bench->confCUDA, maxBoxes * net->GetNumClasses() * sizeof(float)) )
+			return false;
+	}
+	else
+	{
+		segNet* net = segNet::Create((segNet::NetworkType)network->type, maxBatchSize);
+
+		if( !net )
+			return false;
+
+		bench->net = net;
+	}
+
+	bench->net->EnableTiming();
+	return true;
+}
+
+
+// freeNet
+static void freeNet( benchNet* bench )
+{
+	if( bench->classesCPU != NULL )
+		CUDA(cudaFreeHost(bench->classesCPU));
+
+	if( bench->bbCPU != NULL )
+		CUDA(cudaFreeHost(bench->bbCPU));
+
+	if( bench->confCPU != NULL )
+		CUDA(cudaFreeHost(bench->confCPU));
+
+	delete bench->net;
+	memset(bench, 0, sizeof(benchNet));
+}
+
+
+// runNet
+static bool runNet( benchNet* bench, float** images, uint32_t batchSize, uint32_t width, uint32_t height )
+{
+	if( bench->network->kind == KIND_IMAGENET )
+		return ((imageNet*)bench->net)->ClassifyTopK(images, batchSize, width, height, 1, bench->classesCPU, bench->confCPU);
+
+	if( bench->network->kind == KIND_DETECTNET )
+	{
+		int numBoxes = ((detectNet*)bench->net)->GetMaxBoundingBoxes();
+		return ((detectNet*)bench->net)->Detect(images[0], width, height, bench->bbCPU, &numBoxes, bench->confCPU);
+	}
+
+	return ((segNet*)bench->net)->Process(images[0], width, height);
+}
+
+
+// benchResolution
+static void benchResolution( benchNet* bench, const char* precision, uint32_t reqWidth, uint32_t reqHeight, const benchConfig& config, benchResults* results )
+{
+	const benchNetwork* network = bench->network;
+
+	camera* cam = camera::Create(config.input, reqWidth, reqHeight);
+
+	if( !cam || !cam->Open() )
+	{
+		printf("bench -- failed to open '%s' at %ux%u\n", config.input, reqWidth, reqHeight);
+		delete cam;
+		return;
+	}
+
+	// replayed files keep their own resolution
+	const uint32_t width  = cam->GetWidth();
+	const uint32_t height = cam->GetHeight();
+
+	uint32_t maxBatchSize = 0;
+
+	for( size_t n=0; n < config.batchSizes.size(); n++ )
+		maxBatchSize = std::max(maxBatchSize, config.batchSizes[n]);
+
+	std::vector<float*> images(maxBatchSize, NULL);
+
+	for( uint32_t n=0; n < maxBatchSize; n++ )
+	{
+		void* cuda = NULL;
+
+		if( !cudaAllocMapped((void**)&images[n], &cuda, width * height * sizeof(float4)) )
+		{
+			printf("bench -- failed to allocate %ux%u images\n", width, height);
+			maxBatchSize = n;
+			break;
+		}
+	}
+
+	for( size_t b=0; b < config.batchSizes.size(); b++ )
+	{
+		const uint32_t batchSize = config.batchSizes[b];
+
+		char name[512];
+		sprintf(name, "%s/%ux%u/b%u/%s", network->name, width, height, batchSize, precision);
+
+		results->Begin(name);
+
+		if( batchSize > maxBatchSize || batchSize > bench->net->GetMaxBatchSize() )
+		{
+			results->Skip("batch size exceeds the engine's maximum");
+			continue;
+		}
+
+		if( batchSize > 1 && network->kind != KIND_IMAGENET )
+		{
+			results->Skip(network->kind == KIND_DETECTNET ? "detectNet runs one image at a time" : "segNet runs one image at a time");
+			continue;
+		}
+
+		benchSamples convert;
+		benchSamples preprocess;
+		benchSamples infer;
+		benchSamples postprocess;
+		benchSamples total;
+
+		uint64_t totalTime = 0;
+		uint32_t failures  = 0;
+
+		for( uint32_t i=0; i < config.warmup + config.iterations; i++ )
+		{
+			// convert the batch's frames to RGBA
+			bool captured = true;
+
+			for( uint32_t n=0; n < batchSize && captured; n++ )
+			{
+				cameraFrame* frame = cam->CaptureFrame(1000);
+
+				if( !frame )
+				{
+					captured = false;
+					break;
+				}
+
+				const uint64_t convertBegin = timestamp();
+
+				captured = camera::ConvertRGBA(*frame, images[n]) && !CUDA_FAILED(cudaStreamSynchronize(0));
+
+				if( i >= config.warmup )
+					convert.Add(timestamp() - convertBegin);
+
+				frame->Release();
+			}
+
+			if( !captured )
+			{
+				failures++;
+				continue;
+			}
+
+			// run the network, which notes when its engine started and finished
+			const uint64_t begin = timestamp();
+			const bool result = runNet(bench, images.data(), batchSize, width, height) && !CUDA_FAILED(cudaStreamSynchronize(0));
+			const uint64_t end = timestamp();
+
+			if( !result )
+			{
+				failures++;
+				continue;
+			}
+
+			if( i < config.warmup )
+				continue;
+
+			// the engine is skipped when segNet follows the motion instead
+			uint64_t executeBegin = bench->net->GetExecuteBegin();
+			uint64_t executeEnd   = bench->net->GetExecuteEnd();
+
+			if( executeBegin < begin || executeEnd > end )
+				executeBegin = executeEnd = begin;
+
+			preprocess.Add(executeBegin - begin);
+			infer.Add(executeEnd - executeBegin);
+			postprocess.Add(end - executeEnd);
+			total.Add(end - begin);
+
+			totalTime += end - begin;
+		}
+
+		if( total.GetCount() == 0 )
+		{
+			results->Skip("every iteration failed");
+			continue;
+		}
+
+		results->Latency("convert", convert);
+		results->Latency("preprocess", preprocess);
+		results->Latency("infer", infer);
+		results->Latency("postprocess", postprocess);
+		results->Latency("total", total);
+
+		const double fps = double(total.GetCount() * batchSize) / (double(totalTime) * 0.000000001);
+
+		results->Metric("images_per_sec", fps, benchResults::HIGHER);
+		results->Metric("failures", failures, benchResults::NEITHER);
+
+		printf("bench -- %-44s  pre %7.3f  infer %7.3f  post %7.3f  total %7.3f ms (p50)  %8.1f images/sec\n", name,
+			  preprocess.Percentile(50), infer.Percentile(50), postprocess.Percentile(50), total.Percentile(50), fps);
+	}
+
+	for( size_t n=0; n < images.size(); n++ )
+	{
+		if( images[n] != NULL )
+			CUDA(cudaFreeHost(images[n]));
+	}
+
+	delete cam;
+}
+
+
+// benchNetwork
+static void benchNetworkPrecision( const benchNetwork* network, const char* precision, const benchConfig& config, benchResults* results )
+{
+	// skip every configuration of the precision, so the results line up with the baseline
+	const char* skipped = NULL;
+	benchNet bench;
+
+	if( strcasecmp(precision, "int8") == 0 )
+		skipped = "INT8 needs a calibration set, which tensorNet doesn't support";
+	else if( strcasecmp(precision, "fp32") != 0 && strcasecmp(precision, "fp16") != 0 )
+		skipped = "unknown precision";
+
+	uint32_t maxBatchSize = 2;		// the default that the samples' engine caches are built for
+
+	for( size_t n=0; n < config.batchSizes.size(); n++ )
+		maxBatchSize = std::max(maxBatchSize, config.batchSizes[n]);
+
+	if( !skipped )
+	{
+		tensorNet::SetDefaultPrecision(precisionTypeFromStr(precision));
+
+		if( !createNet(network, maxBatchSize, &bench) )
+			skipped = "failed to load the network";
+		else if( strcasecmp(precision, "fp16") == 0 && !bench.net->HasFP16() )
+			skipped = "the platform doesn't have fast FP16";
+	}
+
+	if( skipped != NULL )
+	{
+		printf("bench -- skipping %s %s:  %s\n", network->name, precision, skipped);
+
+		for( size_t r=0; r < config.widths.size(); r++ )
+		{
+			for( size_t b=0; b < config.batchSizes.size(); b++ )
+			{
+				char name[512];
+				sprintf(name, "%s/%ux%u/b%u/%s", network->name, config.widths[r], config.heights[r], config.batchSizes[b], precision);
+
+				results->Begin(name);
+				results->Skip(skipped);
+			}
+		}
+
+		if( bench.net != NULL )
+			freeNet(&bench);
+
+		return;
+	}
+
+	for( size_t r=0; r < config.widths.size(); r++ )
+		benchResolution(&bench, precision, config.widths[r], config.heights[r], config, results);
+
+	freeNet(&bench);
+}
+
+
+// print usage
+static int usage()
+{
+	printf("usage: jetson-inference-bench [--networks=<list>] [--resolutions=<list>] [--batch=<list>] [--precision=<list>]\n");
+	printf("                              [--input=<uri>] [--iterations=N] [--warmup=N]\n");
+	printf("                              [--output=<file>] [--baseline=<file>] [--tolerance=<percent>]\n\n");
+	printf("  --networks     comma-separated networks, or 'all' (default), from:\n                 ");
+
+	for( uint32_t n=0; n < numNetworks; n++ )
+		printf("%s%s", networks[n].name, (n + 1 < numNetworks) ? ", " : "\n");
+
+	printf("  --resolutions  input resolutions, i.e. 640x480,1280x720 (default 1280x720)\n");
+	printf("  --batch        batch sizes, i.e. 1,2,4 (default 1, only imageNet runs batches)\n");
+	printf("  --precision    fp32, fp16 and/or int8 (default fp32,fp16)\n");
+	printf("  --input        camera URI of the frames (default test://?fps=0, a synthetic pattern),\n");
+	printf("                 i.e. file://<dir|file>?fps=0 to replay images or a camera log\n");
+	printf("  --iterations   timed iterations per configuration (default 100)\n");
+	printf("  --warmup       untimed iterations first (default 10)\n");
+	printf("  --output       write the results as JSON to the file (default stdout)\n");
+	printf("  --baseline     compare against saved results, and fail on regressions\n");
+	printf("  --tolerance    allowed regression in percent (default 10)\n");
+	return 0;
+}
+
+
+// main entry point
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	trace::Init(argc, argv);
+
+	benchConfig config;
+
+	config.input      = cmdLine.GetString("input");
+	config.iterations = cmdLine.GetInt("iterations");
+	config.warmup     = cmdLine.GetInt("warmup");
+
+	if( !config.input )
+		config.input = "test://?fps=0";
+
+	if( cmdLine.GetInt("iterations") <= 0 )
+		config.iterations = 100;
+
+	if( cmdLine.GetInt("warmup") < 0 )
+		config.warmup = 0;
+	else if( !cmdLine.GetString("warmup") )
+		config.warmup = 10;
+
+	// resolutions
+	const char* resolutionList = cmdLine.GetString("resolutions");
+	const std::vector<std::string> resolutions = benchSplitList(resolutionList != NULL ? resolutionList : "1280x720");
+
+	for( size_t n=0; n < resolutions.size(); n++ )
+	{
+		uint32_t width  = 0;
+		uint32_t height = 0;
+
+		if( sscanf(resolutions[n].c_str(), "%ux%u", &width, &height) != 2 || width == 0 || height == 0 )
+		{
+			printf("bench -- invalid resolution '%s'\n", resolutions[n].c_str());
+			return usage();
+		}
+
+		config.widths.push_back(width);
+		config.heights.push_back(height);
+	}
+
+	// batch sizes
+	const char* batchList = cmdLine.GetString("batch");
+	const std::vector<std::string> batches = benchSplitList(batchList != NULL ? batchList : "1");
+
+	for( size_t n=0; n < batches.size(); n++ )
+	{
+		const int batchSize = atoi(batches[n].c_str());
+
+		if( batchSize < 1 )
+		{
+			printf("bench -- invalid batch size '%s'\n", batches[n].c_str());
+			return usage();
+		}
+
+		config.batchSizes.push_back(batchSize);
+	}
+
+	// networks
+	const char* networkList = cmdLine.GetString("networks");
+	std::vector<const benchNetwork*> selected;
+
+	if( !networkList || strcasecmp(networkList, "all") == 0 )
+	{
+		for( uint32_t n=0; n < numNetworks; n++ )
+			selected.push_back(&networks[n]);
+	}
+	else
+	{
+		const std::vector<std::string> names = benchSplitList(networkList);
+
+		for( size_t i=0; i < names.size(); i++ )
+		{
+			const benchNetwork* network = NULL;
+
+			for( uint32_t n=0; n < numNetworks && !network; n++ )
+			{
+				if( strcasecmp(names[i].c_str(), networks[n].name) == 0 )
+					network = &networks[n];
+			}
+
+			if( !network )
+			{
+				printf("bench -- unknown network '%s'\n", names[i].c_str());
+				return usage();
+			}
+
+			selected.push_back(network);
+		}
+	}
+
+	// precisions
+	const char* precisionList = cmdLine.GetString("precision");
+	const std::vector<std::string> precisions = benchSplitList(precisionList != NULL ? precisionList : "fp32,fp16");
+
+	if( selected.empty() || precisions.empty() || config.widths.empty() || config.batchSizes.empty() )
+		return usage();
+
+	printf("bench -- %zu networks, %zu precisions, %zu resolutions, %zu batch sizes, %u iterations from '%s'\n", 
+		  selected.size(), precisions.size(), config.widths.size(), config.batchSizes.size(), config.iterations, config.input);
+
+	// run every configuration
+	benchResults results;
+
+	for( size_t n=0; n < selected.size(); n++ )
+		for( size_t p=0; p < precisions.size(); p++ )
+			benchNetworkPrecision(selected[n], precisions[p].c_str(), config, &results);
+
+	tensorNet::SetDefaultPrecision(TYPE_FASTEST);
+
+	if( !results.Save(cmdLine.GetString("output"), "jetson-inference-bench") )
+		return 1;
+
+	trace::Shutdown();
+
+	// compare against the baseline
+	const char* baselinePath = cmdLine.GetString("baseline");
+
+	if( baselinePath != NULL )
+	{
+		benchResults baseline;
+
+		if( !baseline.Load(baselinePath) )
+			return 1;
+
+		const float tolerance = cmdLine.GetString("tolerance") != NULL ? cmdLine.GetFloat("tolerance") : 10.0f;
+		const uint32_t regressions = results.Compare(baseline, tolerance * 0.01);
+
+		if( regressions > 0 )
+		{
+			printf("\nbench -- FAILED:  %u regressions against '%s'\n", regressions, baselinePath);
+			return 1;
+		}
+
+		printf("bench -- passed, no regressions against '%s'\n", baselinePath);
+	}
+
+	return 0;
+}
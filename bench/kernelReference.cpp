@@ -0,0 +1,975 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "kernelReference.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+
+// pixel of a pitched RGBA float image
+static inline float* pixelRGBA( float* image, size_t pitch, size_t x, size_t y )
+{
+	return (float*)((uint8_t*)image + y * pitch) + x * 4;
+}
+
+static inline const float* pixelRGBA( const float* image, size_t pitch, size_t x, size_t y )
+{
+	return (const float*)((const uint8_t*)image + y * pitch) + x * 4;
+}
+
+
+// Y, Pb and Pr from normalized RGB, as the standards define them
+static void standardMatrix( int matrix, double f[9] )
+{
+	const double kr = (matrix == 1) ? 0.2126 : 0.299;
+	const double kb = (matrix == 1) ? 0.0722 : 0.114;
+	const double kg = 1.0 - kr - kb;
+
+	const double m[9] = { kr,                      kg,                      kb,
+					  -kr / (2.0 * (1.0 - kb)), -kg / (2.0 * (1.0 - kb)), 0.5,
+					  0.5,                     -kg / (2.0 * (1.0 - kr)), -kb / (2.0 * (1.0 - kr)) };
+
+	memcpy(f, m, sizeof(m));
+}
+
+
+// YCbCr to RGB matrix, by inverting the RGB to YCbCr one that the standards define
+static void yuvMatrix( int matrix, int range, double m[9], double offset[3] )
+{
+	double f[9];
+	standardMatrix(matrix, f);
+
+	const double det = f[0] * (f[4] * f[8] - f[5] * f[7]) - f[1] * (f[3] * f[8] - f[5] * f[6]) + f[2] * (f[3] * f[7] - f[4] * f[6]);
+
+	const double inv[9] = { (f[4] * f[8] - f[5] * f[7]) / det, (f[2] * f[7] - f[1] * f[8]) / det, (f[1] * f[5] - f[2] * f[4]) / det,
+					    (f[5] * f[6] - f[3] * f[8]) / det, (f[0] * f[8] - f[2] * f[6]) / det, (f[2] * f[3] - f[0] * f[5]) / det,
+					    (f[3] * f[7] - f[4] * f[6]) / det, (f[1] * f[6] - f[0] * f[7]) / det, (f[0] * f[4] - f[1] * f[3]) / det };
+
+	// the codes of Y and CbCr span 219 and 224 values in limited range
+	const bool   full   = (range == 1);
+	const double yRange = full ? 255.0 : 219.0;
+	const double cRange = full ? 255.0 : 224.0;
+
+	for( int r=0; r < 3; r++ )
+	{
+		m[r * 3 + 0] = inv[r * 3 + 0] * 255.0 / yRange;
+		m[r * 3 + 1] = inv[r * 3 + 1] * 255.0 / cRange;
+		m[r * 3 + 2] = inv[r * 3 + 2] * 255.0 / cRange;
+	}
+
+	offset[0] = full ? 0.0 : 16.0;
+	offset[1] = 128.0;
+	offset[2] = 128.0;
+}
+
+
+// convert one pixel, clamped to 0-255
+static void yuvToRGB( const double m[9], const double offset[3], double y, double cb, double cr, float* rgb )
+{
+	y  -= offset[0];
+	cb -= offset[1];
+	cr -= offset[2];
+
+	for( int c=0; c < 3; c++ )
+		rgb[c] = fmax(0.0, fmin(m[c * 3 + 0] * y + m[c * 3 + 1] * cb + m[c * 3 + 2] * cr, 255.0));
+}
+
+
+// cpuNV12ToRGBAf
+void cpuNV12ToRGBAf( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height,
+				 int matrix, int range, int siting )
+{
+	double m[9], offset[3];
+	yuvMatrix(matrix, range, m, offset);
+
+	const uint8_t* chroma = input + inputPitch * height;
+
+	const int chromaWidth  = (width + 1) / 2;
+	const int chromaHeight = (height + 1) / 2;
+
+	// where the first chroma sample is, in luma pixels
+	const double sitingX = (siting == 1) ? 0.5 : 0.0;
+	const double sitingY = (siting == 2) ? 0.0 : 0.5;
+
+	for( size_t y=0; y < height; y++ )
+	{
+		// the chroma rows above and below, and how far it is between them
+		const double cy  = fmin(fmax((y - sitingY) / 2.0, 0.0), chromaHeight - 1);
+		const int    cy0 = (int)floor(cy);
+		const int    cy1 = std::min(cy0 + 1, chromaHeight - 1);
+
+		for( size_t x=0; x < width; x++ )
+		{
+			const double cx  = fmin(fmax((x - sitingX) / 2.0, 0.0), chromaWidth - 1);
+			const int    cx0 = (int)floor(cx);
+			const int    cx1 = std::min(cx0 + 1, chromaWidth - 1);
+
+			double cbcr[2];
+
+			for( int c=0; c < 2; c++ )
+			{
+				const double top    = chroma[cy0 * inputPitch + cx0 * 2 + c] * (1.0 - (cx - cx0)) + chroma[cy0 * inputPitch + cx1 * 2 + c] * (cx - cx0);
+				const double bottom = chroma[cy1 * inputPitch + cx0 * 2 + c] * (1.0 - (cx - cx0)) + chroma[cy1 * inputPitch + cx1 * 2 + c] * (cx - cx0);
+
+				cbcr[c] = top * (1.0 - (cy - cy0)) + bottom * (cy - cy0);
+			}
+
+			float* px = pixelRGBA(output, outputPitch, x, y);
+
+			yuvToRGB(m, offset, input[y * inputPitch + x], cbcr[0], cbcr[1], px);
+			px[3] = 1.0f;		// cudaNV12ToRGBAf leaves alpha at 1
+		}
+	}
+}
+
+
+// cpuRGBAToNV12
+void cpuRGBAToNV12( const float* input, size_t inputPitch, uint8_t* output, size_t outputPitch, size_t width, size_t height,
+				int matrix, int range )
+{
+	double f[9];
+	standardMatrix(matrix, f);
+
+	const bool   full   = (range == 1);
+	const double yRange = full ? 255.0 : 219.0;
+	const double cRange = full ? 255.0 : 224.0;
+	const double yZero  = full ? 0.0 : 16.0;
+
+	// the code of each channel, rounded to the nearest
+	#define YUV_CODE(row, rgb, scale, zero) \
+		(uint8_t)(fmax(0.0, fmin((f[row * 3] * rgb[0] + f[row * 3 + 1] * rgb[1] + f[row * 3 + 2] * rgb[2]) * scale / 255.0 + zero, 255.0)) + 0.5)
+
+	for( size_t y=0; y < height; y++ )
+		for( size_t x=0; x < width; x++ )
+			output[y * outputPitch + x] = YUV_CODE(0, pixelRGBA(input, inputPitch, x, y), yRange, yZero);
+
+	// the chroma of each 2x2 block is that of its average, repeating the last column and row
+	uint8_t* chroma = output + outputPitch * height;
+
+	for( size_t y=0; y < height; y += 2 )
+	{
+		for( size_t x=0; x < width; x += 2 )
+		{
+			const size_t x1 = std::min(x + 1, width - 1);
+			const size_t y1 = std::min(y + 1, height - 1);
+
+			double mean[3];
+
+			for( int c=0; c < 3; c++ )
+				mean[c] = (pixelRGBA(input, inputPitch, x, y)[c] + pixelRGBA(input, inputPitch, x1, y)[c] +
+						 pixelRGBA(input, inputPitch, x, y1)[c] + pixelRGBA(input, inputPitch, x1, y1)[c]) * 0.25;
+
+			chroma[(y / 2) * outputPitch + x]     = YUV_CODE(1, mean, cRange, 128.0);
+			chroma[(y / 2) * outputPitch + x + 1] = YUV_CODE(2, mean, cRange, 128.0);
+		}
+	}
+
+	#undef YUV_CODE
+}
+
+
+// cpuUYVYToRGBAf
+void cpuUYVYToRGBAf( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height,
+				 int matrix, int range )
+{
+	double m[9], offset[3];
+	yuvMatrix(matrix, range, m, offset);
+
+	for( size_t y=0; y < height; y++ )
+	{
+		for( size_t x=0; x < width; x++ )
+		{
+			// [ U0 | Y0 | V0 | Y1 ]
+			const uint8_t* macroPx = input + y * inputPitch + (x & ~1) * 2;
+
+			float* px = pixelRGBA(output, outputPitch, x, y);
+
+			yuvToRGB(m, offset, macroPx[(x & 1) ? 3 : 1], macroPx[0], macroPx[2], px);
+			px[3] = 1.0f;
+		}
+	}
+}
+
+
+// clamp to a byte, truncating like the kernels' float to uint8_t conversions
+static inline uint8_t clampByte( float f )
+{
+	return (uint8_t)fmaxf(0.0f, fminf(f, 255.0f));
+}
+
+
+// cpuYUYVToRGBA
+void cpuYUYVToRGBA( const uint8_t* input, size_t inputPitch, uint8_t* output, size_t outputPitch, size_t width, size_t height )
+{
+	for( size_t y=0; y < height; y++ )
+	{
+		for( size_t x=0; x < width / 2; x++ )
+		{
+			// YUYV [ Y0 | U0 | Y1 | V0 ]
+			const uint8_t* macroPx = input + y * inputPitch + x * 4;
+
+			const float u = float(macroPx[1]) - 128.0f;
+			const float v = float(macroPx[3]) - 128.0f;
+
+			for( size_t n=0; n < 2; n++ )
+			{
+				const float luma = macroPx[n * 2];
+				uint8_t* px = output + y * outputPitch + (x * 2 + n) * 4;
+
+				px[0] = clampByte(luma + 1.4065f * v);
+				px[1] = clampByte(luma - 0.3455f * u - 0.7169f * v);
+				px[2] = clampByte(luma + 1.7790f * u);
+				px[3] = 255;
+			}
+		}
+	}
+}
+
+
+// mirror a coordinate back into the image, without repeating the edge (-1 -> 1)
+static inline int mirror( int i, int size )
+{
+	if( size == 1 )
+		return 0;
+
+	const int period = 2 * (size - 1);
+
+	i = abs(i) % period;
+	return (i < size) ? i : period - i;
+}
+
+
+// Malvar-He-Cutler filters (in eighths), centered on the pixel being filled in
+static const float malvarGreen[5][5] =			// green at red and blue sites
+{
+	{  0.0f,  0.0f, -1.0f,  0.0f,  0.0f },
+	{  0.0f,  0.0f,  2.0f,  0.0f,  0.0f },
+	{ -1.0f,  2.0f,  4.0f,  2.0f, -1.0f },
+	{  0.0f,  0.0f,  2.0f,  0.0f,  0.0f },
+	{  0.0f,  0.0f, -1.0f,  0.0f,  0.0f }
+};
+
+static const float malvarHorizontal[5][5] =		// at green sites, the color to the left and right
+{
+	{  0.0f,  0.0f,  0.5f,  0.0f,  0.0f },
+	{  0.0f, -1.0f,  0.0f, -1.0f,  0.0f },
+	{ -1.0f,  4.0f,  5.0f,  4.0f, -1.0f },
+	{  0.0f, -1.0f,  0.0f, -1.0f,  0.0f },
+	{  0.0f,  0.0f,  0.5f,  0.0f,  0.0f }
+};
+
+static const float malvarVertical[5][5] =		// at green sites, the color above and below
+{
+	{  0.0f,  0.0f, -1.0f,  0.0f,  0.0f },
+	{  0.0f, -1.0f,  4.0f, -1.0f,  0.0f },
+	{  0.5f,  0.0f,  5.0f,  0.0f,  0.5f },
+	{  0.0f, -1.0f,  4.0f, -1.0f,  0.0f },
+	{  0.0f,  0.0f, -1.0f,  0.0f,  0.0f }
+};
+
+static const float malvarOpposite[5][5] =		// blue at red sites, and red at blue sites
+{
+	{  0.0f,  0.0f, -1.5f,  0.0f,  0.0f },
+	{  0.0f,  2.0f,  0.0f,  2.0f,  0.0f },
+	{ -1.5f,  0.0f,  6.0f,  0.0f, -1.5f },
+	{  0.0f,  2.0f,  0.0f,  2.0f,  0.0f },
+	{  0.0f,  0.0f, -1.5f,  0.0f,  0.0f }
+};
+
+
+// cpuBayerToRGBA
+void cpuBayerToRGBA( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height,
+				 int redX, int redY, bool malvar, const float whiteBalance[3] )
+{
+	const int w = width;
+	const int h = height;
+
+	#define BAYER(dx, dy)  float(input[mirror(y + (dy), h) * inputPitch + mirror(x + (dx), w)])
+
+	for( int y=0; y < h; y++ )
+	{
+		for( int x=0; x < w; x++ )
+		{
+			// which color was sampled here, and which are on this row
+			const bool redRow   = ((y ^ redY) & 1) == 0;
+			const bool redSite  = redRow && ((x ^ redX) & 1) == 0;
+			const bool blueSite = !redRow && ((x ^ redX) & 1) != 0;
+			const bool green    = !redSite && !blueSite;
+
+			float rgb[3];
+
+			if( !malvar )
+			{
+				const float center = BAYER(0,0);
+				const float across = (BAYER(-1,0) + BAYER(1,0)) * 0.5f;
+				const float upDown = (BAYER(0,-1) + BAYER(0,1)) * 0.5f;
+				const float cross  = (BAYER(-1,0) + BAYER(1,0) + BAYER(0,-1) + BAYER(0,1)) * 0.25f;
+				const float diag   = (BAYER(-1,-1) + BAYER(1,-1) + BAYER(-1,1) + BAYER(1,1)) * 0.25f;
+
+				rgb[0] = redSite ? center : blueSite ? diag : redRow ? across : upDown;
+				rgb[1] = green ? center : cross;
+				rgb[2] = blueSite ? center : redSite ? diag : redRow ? upDown : across;
+			}
+			else
+			{
+				float filtered[4] = { 0.0f, 0.0f, 0.0f, 0.0f };	// green, horizontal, vertical, opposite
+
+				for( int dy=-2; dy <= 2; dy++ )
+				{
+					for( int dx=-2; dx <= 2; dx++ )
+					{
+						const float px = BAYER(dx, dy);
+
+						filtered[0] += malvarGreen[dy+2][dx+2] * px;
+						filtered[1] += malvarHorizontal[dy+2][dx+2] * px;
+						filtered[2] += malvarVertical[dy+2][dx+2] * px;
+						filtered[3] += malvarOpposite[dy+2][dx+2] * px;
+					}
+				}
+
+				for( int n=0; n < 4; n++ )
+					filtered[n] *= 0.125f;
+
+				const float center = BAYER(0,0);
+
+				rgb[0] = redSite ? center : blueSite ? filtered[3] : redRow ? filtered[1] : filtered[2];
+				rgb[1] = green ? center : filtered[0];
+				rgb[2] = blueSite ? center : redSite ? filtered[3] : redRow ? filtered[2] : filtered[1];
+			}
+
+			float* px = pixelRGBA(output, outputPitch, x, y);
+
+			for( int c=0; c < 3; c++ )
+				px[c] = fmaxf(0.0f, fminf(rgb[c] * whiteBalance[c], 255.0f));
+
+			px[3] = 255.0f;
+		}
+	}
+
+	#undef BAYER
+}
+
+
+// cpuBAYER_GR8toRGBA
+void cpuBAYER_GR8toRGBA( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height )
+{
+	const float unity[] = { 1.0f, 1.0f, 1.0f };
+	cpuBayerToRGBA(input, inputPitch, output, outputPitch, width, height, 1, 0, false, unity);
+}
+
+
+// cpuResizeRGBA
+void cpuResizeRGBA( const float* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight )
+{
+	const float scaleX = float(inputWidth) / float(outputWidth);
+	const float scaleY = float(inputHeight) / float(outputHeight);
+
+	for( size_t y=0; y < outputHeight; y++ )
+	{
+		for( size_t x=0; x < outputWidth; x++ )
+		{
+			const int dx = ((float)x * scaleX);
+			const int dy = ((float)y * scaleY);
+
+			memcpy(output + (y * outputWidth + x) * 4, input + (dy * inputWidth + dx) * 4, sizeof(float) * 4);
+		}
+	}
+}
+
+
+// cpuNormalizeRGBA
+void cpuNormalizeRGBA( const float* input, float inputMin, float inputMax, float* output, float outputMin, float outputMax, size_t width, size_t height )
+{
+	const float scale = (outputMax - outputMin) / (inputMax - inputMin);
+
+	for( size_t n=0; n < width * height * 4; n++ )
+		output[n] = (input[n] - inputMin) * scale + outputMin;
+}
+
+
+// cpuRectOutlineOverlay
+void cpuRectOutlineOverlay( const float* input, float* output, size_t width, size_t height, const float* rects, int numRects, const float color[4] )
+{
+	const float alpha = color[3] / 255.0f;
+	const float ialph = 1.0f - alpha;
+
+	for( size_t y=0; y < height; y++ )
+	{
+		for( size_t x=0; x < width; x++ )
+		{
+			float px[4];
+			memcpy(px, input + (y * width + x) * 4, sizeof(px));
+
+			for( int n=0; n < numRects; n++ )
+			{
+				const float* r = rects + n * 4;
+
+				if( float(x) < r[0] || float(x) > r[2] || float(y) < r[1] || float(y) > r[3] )
+					continue;
+
+				for( int c=0; c < 3; c++ )
+					px[c] = alpha * color[c] + ialph * px[c];
+			}
+
+			memcpy(output + (y * width + x) * 4, px, sizeof(px));
+		}
+	}
+}
+
+
+// cpuOverlayText
+void cpuOverlayText( const float* font, int fontWidth, int cellWidth, int cellHeight, const char* str, int x, int y, 
+				 const float color[4], float* output, size_t width, size_t height )
+{
+	const int cellsPerRow = fontWidth / cellWidth;
+	const int numChars    = strlen(str);
+
+	for( int n=0; n < numChars; n++ )
+	{
+		int c = str[n];
+
+		if( c < 32 || c > 126 )
+			continue;
+
+		c -= 32;
+
+		const int cellX = (c % cellsPerRow) * (cellWidth + 1);
+		const int cellY = (c / cellsPerRow) * (cellHeight + 1);
+
+		for( int v=0; v < cellHeight; v++ )
+		{
+			for( int u=0; u < cellWidth; u++ )
+			{
+				const int ox = x + u;
+				const int oy = y + v;
+
+				if( ox < 0 || oy < 0 || ox >= (int)width || oy >= (int)height )
+					continue;
+
+				const float* glyph = font + ((cellY + v) * fontWidth + cellX + u) * 4;
+				float* px = output + (oy * width + ox) * 4;
+
+				// the glyph is tinted by the color, then blended by its alpha
+				const float alpha = glyph[3] * (color[3] / 255.0f) / 255.0f;
+				const float ialph = 1.0f - alpha;
+
+				for( int ch=0; ch < 3; ch++ )
+					px[ch] = alpha * (glyph[ch] * (color[ch] / 255.0f)) + ialph * px[ch];
+			}
+		}
+
+		x += cellWidth;
+	}
+}
+
+
+// compareImages
+template<typename T, typename E>
+static bool compareImages( const T* a, size_t pitchA, const T* b, size_t pitchB, size_t width, size_t height, int channels, E tolerance, imageDiff* diff )
+{
+	imageDiff d;
+	memset(&d, 0, sizeof(imageDiff));
+
+	d.x = -1;
+	d.y = -1;
+	d.channel = -1;
+
+	for( size_t y=0; y < height; y++ )
+	{
+		const T* rowA = (const T*)((const uint8_t*)a + y * pitchA);
+		const T* rowB = (const T*)((const uint8_t*)b + y * pitchB);
+
+		for( size_t x=0; x < width; x++ )
+		{
+			for( int c=0; c < channels; c++ )
+			{
+				const double va = rowA[x * channels + c];
+				const double vb = rowB[x * channels + c];
+
+				const double error = (va != va || vb != vb) ? INFINITY : fabs(va - vb);
+
+				if( error > d.maxError )
+					d.maxError = error;
+
+				if( error <= (double)tolerance )
+					continue;
+
+				if( d.mismatches == 0 )
+				{
+					d.x = x;
+					d.y = y;
+					d.channel = c;
+				}
+
+				d.mismatches++;
+			}
+		}
+	}
+
+	if( diff != NULL )
+		*diff = d;
+
+	return (d.mismatches == 0);
+}
+
+
+// cpuCompareImages
+bool cpuCompareImages( const float* a, size_t pitchA, const float* b, size_t pitchB, size_t width, size_t height, float tolerance, imageDiff* diff )
+{
+	return compareImages(a, pitchA, b, pitchB, width, height, 4, tolerance, diff);
+}
+
+
+// cpuCompareImages
+bool cpuCompareImages( const uint8_t* a, size_t pitchA, const uint8_t* b, size_t pitchB, size_t width, size_t height, int tolerance, imageDiff* diff )
+{
+	return compareImages(a, pitchA, b, pitchB, width, height, 4, tolerance, diff);
+}
+
+
+// cpuCompareBytes
+bool cpuCompareBytes( const uint8_t* a, size_t pitchA, const uint8_t* b, size_t pitchB, size_t rowBytes, size_t rows, int tolerance, imageDiff* diff )
+{
+	return compareImages(a, pitchA, b, pitchB, rowBytes, rows, 1, tolerance, diff);
+}
+
+
+// cpuCountOverruns
+size_t cpuCountOverruns( const uint8_t* buffer, size_t pitch, size_t rowBytes, size_t height, size_t guardBytes, uint8_t sentinel )
+{
+	size_t overruns = 0;
+
+	for( size_t y=0; y < height; y++ )
+	{
+		for( size_t n=rowBytes; n < pitch; n++ )
+		{
+			if( buffer[y * pitch + n] != sentinel )
+				overruns++;
+		}
+	}
+
+	for( size_t n=0; n < guardBytes; n++ )
+	{
+		if( buffer[height * pitch + n] != sentinel )
+			overruns++;
+	}
+
+	return overruns;
+}
+
+
+//-----------------------------------------------------------------------------------
+// known answers for the references themselves
+//-----------------------------------------------------------------------------------
+
+static uint32_t selfTestFailures = 0;
+
+static void selfCheck( bool passed, const char* name )
+{
+	printf("bench -- reference %-36s %s\n", name, passed ? "passed" : "FAILED");
+
+	if( !passed )
+		selfTestFailures++;
+}
+
+
+// every pixel of an RGBA float image matches the expected color
+static bool checkColor( const std::vector<float>& image, size_t width, size_t height, const float expected[4], float tolerance )
+{
+	for( size_t n=0; n < width * height; n++ )
+	{
+		for( int c=0; c < 4; c++ )
+		{
+			if( !(fabsf(image[n * 4 + c] - expected[c]) <= tolerance) )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+// cpuReferenceSelfTest
+uint32_t cpuReferenceSelfTest()
+{
+	selfTestFailures = 0;
+
+	// NV12:  neutral chroma stays grey, and follows the luma (stretched from 16-235 in limited range)
+	{
+		const size_t width = 7, height = 5, pitch = 8;
+
+		std::vector<uint8_t> nv12(pitch * (height + (height + 1) / 2), 128);
+		std::vector<float>   rgba(width * height * 4);
+
+		for( size_t y=0; y < height; y++ )
+			for( size_t x=0; x < width; x++ )
+				nv12[y * pitch + x] = x * 36 + y;
+
+		bool grey = true;
+
+		for( int range=0; range < 2; range++ )
+		{
+			cpuNV12ToRGBAf(nv12.data(), pitch, rgba.data(), width * sizeof(float) * 4, width, height, 1, range, 0);
+
+			for( size_t y=0; y < height; y++ )
+			{
+				for( size_t x=0; x < width; x++ )
+				{
+					const float* px = &rgba[(y * width + x) * 4];
+					const float luma = nv12[y * pitch + x];
+					const float expected = range ? luma : fmaxf(0.0f, fminf((luma - 16.0f) * 255.0f / 219.0f, 255.0f));
+
+					if( fabsf(px[0] - px[1]) > 1e-3f || fabsf(px[1] - px[2]) > 1e-3f || fabsf(px[0] - expected) > 1e-3f )
+						grey = false;
+				}
+			}
+		}
+
+		selfCheck(grey, "NV12 grey");
+	}
+
+	// YUV:  the codes of pure red in each matrix and range
+	{
+		// Y, Cb, Cr, matrix, range
+		const int red[][5] = { { 81, 90, 240, 0, 0 }, { 63, 102, 240, 1, 0 }, { 76, 85, 255, 0, 1 }, { 54, 99, 255, 1, 1 } };
+		bool passed = true;
+
+		for( int n=0; n < 4; n++ )
+		{
+			const uint8_t uyvy[] = { (uint8_t)red[n][1], (uint8_t)red[n][0], (uint8_t)red[n][2], (uint8_t)red[n][0] };
+			float rgba[8];
+
+			cpuUYVYToRGBAf(uyvy, sizeof(uyvy), rgba, sizeof(rgba), 2, 1, red[n][3], red[n][4]);
+
+			if( rgba[0] < 253.0f || rgba[1] > 2.0f || rgba[2] > 2.0f || rgba[4] != rgba[0] )
+				passed = false;
+		}
+
+		selfCheck(passed, "YUV red primaries");
+	}
+
+	// NV12:  pure red has the codes of the standards, and converts back to red
+	{
+		const size_t width = 3, height = 3, pitch = 4;
+
+		// Y, Cb, Cr, matrix, range
+		const int red[][5] = { { 81, 90, 240, 0, 0 }, { 63, 102, 240, 1, 0 }, { 76, 85, 255, 0, 1 }, { 54, 99, 255, 1, 1 } };
+		bool passed = true;
+
+		std::vector<float>   rgba(width * height * 4);
+		std::vector<uint8_t> nv12(pitch * (height + (height + 1) / 2));
+
+		for( size_t n=0; n < width * height; n++ )
+		{
+			rgba[n * 4 + 0] = 255.0f;
+			rgba[n * 4 + 1] = 0.0f;
+			rgba[n * 4 + 2] = 0.0f;
+			rgba[n * 4 + 3] = 255.0f;
+		}
+
+		for( int n=0; n < 4; n++ )
+		{
+			cpuRGBAToNV12(rgba.data(), width * sizeof(float) * 4, nv12.data(), pitch, width, height, red[n][3], red[n][4]);
+
+			for( size_t y=0; y < height; y++ )
+				for( size_t x=0; x < width; x++ )
+					if( nv12[y * pitch + x] != red[n][0] )
+						passed = false;
+
+			for( size_t y=0; y < (height + 1) / 2; y++ )
+				if( nv12[(height + y) * pitch + 2] != red[n][1] || nv12[(height + y) * pitch + 3] != red[n][2] )
+					passed = false;
+		}
+
+		selfCheck(passed, "RGBA to NV12 red primaries");
+	}
+
+	// NV12:  a smooth image survives the round trip, within the rounding and chroma subsampling
+	{
+		const size_t width = 9, height = 7;
+		const size_t pitch = width + 1;
+
+		std::vector<float>   rgba(width * height * 4);
+		std::vector<float>   back(width * height * 4);
+		std::vector<uint8_t> nv12(pitch * (height + (height + 1) / 2));
+
+		for( size_t y=0; y < height; y++ )
+		{
+			for( size_t x=0; x < width; x++ )
+			{
+				float* px = &rgba[(y * width + x) * 4];
+
+				px[0] = 40.0f + x * 4.0f;
+				px[1] = 200.0f - y * 5.0f;
+				px[2] = 100.0f + (x + y) * 2.0f;
+				px[3] = 255.0f;
+			}
+		}
+
+		bool passed = true;
+
+		for( int n=0; n < 4; n++ )
+		{
+			cpuRGBAToNV12(rgba.data(), width * sizeof(float) * 4, nv12.data(), pitch, width, height, n & 1, n >> 1);
+			cpuNV12ToRGBAf(nv12.data(), pitch, back.data(), width * sizeof(float) * 4, width, height, n & 1, n >> 1, 1);
+
+			for( size_t i=0; i < width * height; i++ )
+				for( int c=0; c < 3; c++ )
+					if( fabsf(back[i * 4 + c] - rgba[i * 4 + c]) > 8.0f )
+						passed = false;
+		}
+
+		selfCheck(passed, "RGBA to NV12 round trip");
+	}
+
+	// NV12:  the chroma is interpolated from where it was sited
+	{
+		const size_t width = 8, height = 4, pitch = 8;
+		const size_t chroma = pitch * height;
+
+		std::vector<uint8_t> nv12(pitch * (height + height / 2), 128);
+		std::vector<float>   rgba(width * height * 4);
+
+		std::fill(nv12.begin(), nv12.begin() + chroma, 100);
+
+		// full range BT.601, where red is Y + 1.402 (Cr - 128)
+		#define NV12_RED(x, y)  (rgba[((y) * width + (x)) * 4] - 100.0f) / 1.402f + 128.0f
+
+		// a column of Cr, which MPEG-2 sites on the even pixels and MPEG-1 between them
+		nv12[chroma + 3] = 192;
+		nv12[chroma + pitch + 3] = 192;
+
+		cpuNV12ToRGBAf(nv12.data(), pitch, rgba.data(), width * sizeof(float) * 4, width, height, 0, 1, 0);
+		const bool left = fabsf(NV12_RED(2, 0) - 192.0f) < 1e-3f && fabsf(NV12_RED(3, 0) - 160.0f) < 1e-3f && fabsf(NV12_RED(1, 0) - 160.0f) < 1e-3f;
+
+		cpuNV12ToRGBAf(nv12.data(), pitch, rgba.data(), width * sizeof(float) * 4, width, height, 0, 1, 1);
+		const bool center = fabsf(NV12_RED(2, 0) - 176.0f) < 1e-3f && fabsf(NV12_RED(3, 0) - 176.0f) < 1e-3f && fabsf(NV12_RED(1, 0) - 144.0f) < 1e-3f;
+
+		// a row of Cr, which BT.2020 sites on the even rows and MPEG-2 between them
+		nv12[chroma + 3] = 128;
+
+		cpuNV12ToRGBAf(nv12.data(), pitch, rgba.data(), width * sizeof(float) * 4, width, height, 0, 1, 2);
+		const bool top = fabsf(NV12_RED(2, 0) - 128.0f) < 1e-3f && fabsf(NV12_RED(2, 1) - 160.0f) < 1e-3f && fabsf(NV12_RED(2, 2) - 192.0f) < 1e-3f;
+
+		cpuNV12ToRGBAf(nv12.data(), pitch, rgba.data(), width * sizeof(float) * 4, width, height, 0, 1, 0);
+		const bool between = fabsf(NV12_RED(2, 0) - 128.0f) < 1e-3f && fabsf(NV12_RED(2, 1) - 144.0f) < 1e-3f && 
+						 fabsf(NV12_RED(2, 2) - 176.0f) < 1e-3f && fabsf(NV12_RED(2, 3) - 192.0f) < 1e-3f;
+
+		#undef NV12_RED
+
+		selfCheck(left && center, "NV12 chroma siting (horizontal)");
+		selfCheck(top && between, "NV12 chroma siting (vertical)");
+	}
+
+	// YUYV:  grey is exact, and out-of-range colors clamp
+	{
+		const size_t width = 4, height = 3;
+
+		std::vector<uint8_t> yuyv(width * height * 2);
+		std::vector<uint8_t> rgba(width * height * 4);
+
+		for( size_t n=0; n < width * height / 2; n++ )
+		{
+			yuyv[n * 4 + 0] = n * 20;
+			yuyv[n * 4 + 1] = 128;
+			yuyv[n * 4 + 2] = n * 20 + 10;
+			yuyv[n * 4 + 3] = 128;
+		}
+
+		cpuYUYVToRGBA(yuyv.data(), width * 2, rgba.data(), width * 4, width, height);
+
+		bool grey = true;
+
+		for( size_t n=0; n < width * height; n++ )
+		{
+			const uint8_t luma = yuyv[n * 2];
+
+			if( rgba[n * 4] != luma || rgba[n * 4 + 1] != luma || rgba[n * 4 + 2] != luma || rgba[n * 4 + 3] != 255 )
+				grey = false;
+		}
+
+		selfCheck(grey, "YUYV grey");
+
+		const uint8_t saturated[] = { 255, 0, 255, 255,	// bright red, past the top of the range
+		                              0, 0, 0, 0 };		// dark, past the bottom
+		memcpy(yuyv.data(), saturated, sizeof(saturated));
+
+		cpuYUYVToRGBA(yuyv.data(), width * 2, rgba.data(), width * 4, width, height);
+		selfCheck(rgba[0] == 255 && rgba[8] == 0 && rgba[10] == 0, "YUYV clamping");
+	}
+
+	// bayer:  a flat field stays flat, and each channel only comes from its own sites,
+	// for every pattern and both qualities
+	{
+		const size_t width = 9, height = 7;
+		const int red[][2] = { { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };	// RGGB, BGGR, GRBG, GBRG
+
+		std::vector<uint8_t> flat(width * height, 100);
+		std::vector<uint8_t> bayer(width * height);
+		std::vector<float>   rgba(width * height * 4);
+
+		const float unity[]   = { 1.0f, 1.0f, 1.0f };
+		const float balance[] = { 2.0f, 1.0f, 3.0f };
+
+		bool flatPassed = true;
+		bool redPassed  = true;
+		bool wbPassed   = true;
+
+		for( int pattern=0; pattern < 4; pattern++ )
+		{
+			for( int malvar=0; malvar < 2; malvar++ )
+			{
+				cpuBayerToRGBA(flat.data(), width, rgba.data(), width * sizeof(float) * 4, width, height, red[pattern][0], red[pattern][1], malvar, unity);
+
+				const float flatColor[] = { 100.0f, 100.0f, 100.0f, 255.0f };
+				flatPassed &= checkColor(rgba, width, height, flatColor, 1e-4f);
+
+				// the gains apply after the interpolation, and clamp
+				cpuBayerToRGBA(flat.data(), width, rgba.data(), width * sizeof(float) * 4, width, height, red[pattern][0], red[pattern][1], malvar, balance);
+
+				const float balanced[] = { 200.0f, 100.0f, 255.0f, 255.0f };
+				wbPassed &= checkColor(rgba, width, height, balanced, 1e-4f);
+
+				for( size_t y=0; y < height; y++ )
+					for( size_t x=0; x < width; x++ )
+						bayer[y * width + x] = (((y ^ red[pattern][1]) & 1) == 0 && ((x ^ red[pattern][0]) & 1) == 0) ? 200 : 0;
+
+				cpuBayerToRGBA(bayer.data(), width, rgba.data(), width * sizeof(float) * 4, width, height, red[pattern][0], red[pattern][1], malvar, unity);
+
+				const float redColor[] = { 200.0f, 0.0f, 0.0f, 255.0f };
+				redPassed &= checkColor(rgba, width, height, redColor, 1e-4f);
+			}
+		}
+
+		selfCheck(flatPassed, "bayer flat field");
+		selfCheck(redPassed, "bayer red field");
+		selfCheck(wbPassed, "bayer white balance");
+	}
+
+	// resize:  the same size is a copy, and halving takes every other pixel
+	{
+		const size_t width = 6, height = 4;
+
+		std::vector<float> input(width * height * 4);
+		std::vector<float> output(width * height * 4);
+
+		for( size_t n=0; n < input.size(); n++ )
+			input[n] = n;
+
+		cpuResizeRGBA(input.data(), width, height, output.data(), width, height);
+		selfCheck(input == output, "resize identity");
+
+		cpuResizeRGBA(input.data(), width, height, output.data(), width / 2, height / 2);
+
+		bool halved = true;
+
+		for( size_t y=0; y < height / 2; y++ )
+			for( size_t x=0; x < width / 2; x++ )
+				if( memcmp(&output[(y * width / 2 + x) * 4], &input[(y * 2 * width + x * 2) * 4], sizeof(float) * 4) != 0 )
+					halved = false;
+
+		selfCheck(halved, "resize halving");
+	}
+
+	// normalize:  the ends of the ranges map to each other
+	{
+		const float in[] = { 0.0f, 51.0f, 127.5f, 255.0f };
+		float out[4];
+
+		cpuNormalizeRGBA(in, 0.0f, 255.0f, out, 0.0f, 1.0f, 1, 1);
+		selfCheck(out[0] == 0.0f && fabsf(out[1] - 0.2f) < 1e-6f && fabsf(out[3] - 1.0f) < 1e-6f, "normalize 0-255 to 0-1");
+
+		cpuNormalizeRGBA(in, 0.0f, 255.0f, out, -1.0f, 1.0f, 1, 1);
+		selfCheck(out[0] == -1.0f && fabsf(out[2]) < 1e-6f && fabsf(out[3] - 1.0f) < 1e-6f, "normalize 0-255 to -1-1");
+	}
+
+	// rects:  an opaque color replaces the inside, including the edges, and half alpha averages
+	{
+		const size_t width = 8, height = 6;
+
+		std::vector<float> input(width * height * 4, 100.0f);
+		std::vector<float> output(width * height * 4);
+
+		const float rect[]   = { 2.0f, 1.0f, 4.0f, 3.0f };
+		const float opaque[] = { 255.0f, 0.0f, 0.0f, 255.0f };
+		const float half[]   = { 200.0f, 0.0f, 0.0f, 127.5f };
+
+		cpuRectOutlineOverlay(input.data(), output.data(), width, height, rect, 1, opaque);
+
+		bool filled = true;
+
+		for( size_t y=0; y < height; y++ )
+		{
+			for( size_t x=0; x < width; x++ )
+			{
+				const bool inside = (x >= 2 && x <= 4 && y >= 1 && y <= 3);
+				const float* px = &output[(y * width + x) * 4];
+
+				if( inside ? (px[0] != 255.0f || px[1] != 0.0f || px[3] != 100.0f) : (px[0] != 100.0f || px[1] != 100.0f) )
+					filled = false;
+			}
+		}
+
+		selfCheck(filled, "rect opaque");
+
+		cpuRectOutlineOverlay(input.data(), output.data(), width, height, rect, 1, half);
+		selfCheck(fabsf(output[(2 * width + 3) * 4] - 150.0f) < 1e-4f && fabsf(output[(2 * width + 3) * 4 + 1] - 50.0f) < 1e-4f, "rect blending");
+	}
+
+	// text:  a solid font tints whole cells, skips unprintable characters and clips at the edges
+	{
+		const int cellWidth = 2, cellHeight = 3;
+		const int fontWidth = 32, fontHeight = 24;
+		const size_t width = 7, height = 4;
+
+		std::vector<float> font(fontWidth * fontHeight * 4, 255.0f);
+		std::vector<float> output(width * height * 4, 0.0f);
+
+		const float color[] = { 10.0f, 20.0f, 30.0f, 255.0f };
+
+		cpuOverlayText(font.data(), fontWidth, cellWidth, cellHeight, "A\nBC", 2, 2, color, output.data(), width, height);
+
+		bool rendered = true;
+
+		for( size_t y=0; y < height; y++ )
+		{
+			for( size_t x=0; x < width; x++ )
+			{
+				const bool inside = (x >= 2 && y >= 2);		// three cells from x=2 run past the right edge
+				const float* px = &output[(y * width + x) * 4];
+
+				if( inside ? (fabsf(px[0] - 10.0f) > 1e-4f || fabsf(px[2] - 30.0f) > 1e-4f) : (px[0] != 0.0f) )
+					rendered = false;
+			}
+		}
+
+		selfCheck(rendered, "text");
+	}
+
+	return selfTestFailures;
+}
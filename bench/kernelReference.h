@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __KERNEL_REFERENCE_H_
+#define __KERNEL_REFERENCE_H_
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*
+ * CPU reference versions of the util/cuda kernels, that cuda-kernel-bench checks them against.
+ *
+ * They are written for clarity rather than speed, one pixel at a time, and don't depend on
+ * CUDA so they build and run on machines without a GPU.  Images are interleaved RGBA with
+ * 4 floats (or 4 bytes) per pixel, and pitches are in bytes like the kernels take them.
+ */
+
+
+/**
+ * NV12 to RGBA float (0-255), like cudaNV12ToRGBAf().  The colorspace takes the values of
+ * the yuvMatrix, yuvRange and yuvChromaSiting enums in cudaYUV.h (by default BT.601, limited
+ * range and MPEG-2 siting), and the chroma is interpolated bilinearly from where it's sited.
+ * @ingroup util
+ */
+void cpuNV12ToRGBAf( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height,
+				 int matrix=0, int range=0, int siting=0 );
+
+/**
+ * RGBA float (0-255) to NV12, like cudaRGBAToNV12().  The matrix and range are like
+ * cpuNV12ToRGBAf(), and the chroma of each 2x2 block is the average of its pixels.
+ * The CbCr plane follows the Y plane, with the same pitch.
+ * @ingroup util
+ */
+void cpuRGBAToNV12( const float* input, size_t inputPitch, uint8_t* output, size_t outputPitch, size_t width, size_t height,
+				int matrix=0, int range=0 );
+
+/**
+ * UYVY to RGBA float (0-255), like cudaYUVToRGBAf() but with the pitch in bytes.
+ * The matrix and range are like cpuNV12ToRGBAf().  The width must be even.
+ * @ingroup util
+ */
+void cpuUYVYToRGBAf( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height,
+				 int matrix=0, int range=0 );
+
+/**
+ * YUYV to RGBA uchar4, like cudaYUYVToRGBA().  The width must be even.
+ * @ingroup util
+ */
+void cpuYUYVToRGBA( const uint8_t* input, size_t inputPitch, uint8_t* output, size_t outputPitch, size_t width, size_t height );
+
+/**
+ * Demosaic of 8-bit bayer to RGBA float (0-255), like cudaBayerToRGBA().  The pattern is
+ * given by the position of the red pixel in the top-left 2x2 block (i.e. 1,0 for GRBG),
+ * and the interpolation is either bilinear or Malvar-He-Cutler.  The white balance gains
+ * are applied to the interpolated colors, which are then clamped to 0-255.  The borders
+ * are mirrored, which keeps the CFA pattern intact.
+ * @ingroup util
+ */
+void cpuBayerToRGBA( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height,
+				 int redX, int redY, bool malvar, const float whiteBalance[3] );
+
+/**
+ * Bilinear demosaic of 8-bit GRBG bayer to RGBA float (0-255), like cudaBAYER_GR8toRGBA().
+ * @ingroup util
+ */
+void cpuBAYER_GR8toRGBA( const uint8_t* input, size_t inputPitch, float* output, size_t outputPitch, size_t width, size_t height );
+
+/**
+ * Nearest-neighbour resize of RGBA float, like cudaResizeRGBA().
+ * @ingroup util
+ */
+void cpuResizeRGBA( const float* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight );
+
+/**
+ * Rescale RGBA float from one range to another, like cudaNormalizeRGBA().
+ * @ingroup util
+ */
+void cpuNormalizeRGBA( const float* input, float inputMin, float inputMax, float* output, float outputMin, float outputMax, size_t width, size_t height );
+
+/**
+ * Blend rectangles (left, top, right, bottom) of a color over RGBA float, like cudaRectOutlineOverlay().
+ * The alpha of the color (0-255) sets the opacity, and overlapping rectangles are blended in order.
+ * @ingroup util
+ */
+void cpuRectOutlineOverlay( const float* input, float* output, size_t width, size_t height, const float* rects, int numRects, const float color[4] );
+
+/**
+ * Render a string from a font map over RGBA float, like cudaFont::RenderOverlay().
+ * The glyphs of characters 32-126 are laid out in cells with a one pixel gap between them.
+ * @ingroup util
+ */
+void cpuOverlayText( const float* font, int fontWidth, int cellWidth, int cellHeight, const char* str, int x, int y, 
+				 const float color[4], float* output, size_t width, size_t height );
+
+
+/**
+ * Differences found between two images.
+ * @ingroup util
+ */
+struct imageDiff
+{
+	uint64_t mismatches;	/**< values that differ by more than the tolerance */
+	double   maxError;	/**< largest difference */
+	int      x;		/**< location of the first mismatch */
+	int      y;
+	int      channel;
+};
+
+/**
+ * Compare two RGBA float images, returning true if every value is within the tolerance.
+ * NaNs never match.
+ * @ingroup util
+ */
+bool cpuCompareImages( const float* a, size_t pitchA, const float* b, size_t pitchB, size_t width, size_t height, float tolerance, imageDiff* diff );
+
+/**
+ * Compare two RGBA uchar4 images, returning true if every value is within the tolerance.
+ * @ingroup util
+ */
+bool cpuCompareImages( const uint8_t* a, size_t pitchA, const uint8_t* b, size_t pitchB, size_t width, size_t height, int tolerance, imageDiff* diff );
+
+/**
+ * Compare the rows of two byte planes (i.e. the Y or CbCr plane of NV12), returning true
+ * if every byte is within the tolerance.  The channel of a mismatch is always 0.
+ * @ingroup util
+ */
+bool cpuCompareBytes( const uint8_t* a, size_t pitchA, const uint8_t* b, size_t pitchB, size_t rowBytes, size_t rows, int tolerance, imageDiff* diff );
+
+/**
+ * Count the bytes a kernel wrote outside of its image:  in the padding at the end of
+ * each row, and in the guard bytes after the last row, which were filled with the
+ * sentinel beforehand.
+ * @ingroup util
+ */
+size_t cpuCountOverruns( const uint8_t* buffer, size_t pitch, size_t rowBytes, size_t height, size_t guardBytes, uint8_t sentinel );
+
+/**
+ * Check the references against known answers (flat fields, grey, identity resizes, etc).
+ * @returns the number of failed checks.
+ * @ingroup util
+ */
+uint32_t cpuReferenceSelfTest();
+
+#endif
@@ -27,6 +27,10 @@
 #include "cudaResize.h"
 
 #include "commandLine.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <time.h>
 
 #define OUTPUT_CVG  0
 #define OUTPUT_BBOX 1
@@ -39,6 +43,10 @@ detectNet::detectNet() : tensorNet()
 {
 	mCoverageThreshold = 0.5f;
 	mMeanPixel         = 0.0f;
+
+	mPyramidLevels  = 1;
+	mPyramidScale   = 0.7071f;
+	mPyramidOverlap = 0.5f;
 	
 	mClassColors[0] = NULL;	// cpu ptr
 	mClassColors[1] = NULL; // gpu ptr
@@ -77,7 +85,7 @@ detectNet* detectNet::Create( const char* prototxt, const char* model, float mea
 	output_blobs.push_back(coverage_blob);
 	output_blobs.push_back(bbox_blob);
 	
-	if( !net->LoadNetwork(prototxt, model, NULL, input_blob, output_blobs) )
+	if( !net->LoadNetwork(prototxt, model, NULL, input_blob, output_blobs, maxBatchSize) )
 	{
 		printf("detectNet -- failed to initialize.\n");
 		return NULL;
@@ -117,7 +125,7 @@ detectNet* detectNet::Create( const char* prototxt, const char* model, const cha
 	output_blobs.push_back(coverage_blob);
 	output_blobs.push_back(bbox_blob);
 	
-	if( !net->LoadNetwork(prototxt, model, mean_binary, input_blob, output_blobs) )
+	if( !net->LoadNetwork(prototxt, model, mean_binary, input_blob, output_blobs, maxBatchSize) )
 	{
 		printf("detectNet -- failed to initialize.\n");
 		return NULL;
@@ -207,9 +215,10 @@ detectNet* detectNet::Create( int argc, char** argv )
 
 	if( !modelName )
 	{
-		if( argc == 2 )
+		// positional model name, unless the arguments are all options (i.e. --images=<dir>)
+		if( argc == 2 && argv[1][0] != '-' )
 			modelName = argv[1];
-		else if( argc == 4 )
+		else if( argc == 4 && argv[3][0] != '-' )
 			modelName = argv[3];
 		else
 			modelName = "pednet";
@@ -218,6 +227,21 @@ detectNet* detectNet::Create( int argc, char** argv )
 	//if( argc > 3 )
 	//	modelName = argv[3];	
 
+	// pyramid levels are packed into the batch, so make sure the engine is built for it
+	const int pyramidLevels = cmdLine.GetInt("pyramid");
+	float pyramidScale = cmdLine.GetFloat("pyramid_scale");
+
+	if( pyramidScale == 0.0f )
+		pyramidScale = 0.7071f;
+
+	int maxBatchSize = cmdLine.GetInt("batch_size");
+		
+	if( maxBatchSize < 1 )
+		maxBatchSize = 2;
+
+	if( maxBatchSize < pyramidLevels )
+		maxBatchSize = pyramidLevels;
+
 	detectNet::NetworkType type = detectNet::PEDNET_MULTI;
 
 	if( strcasecmp(modelName, "multiped") == 0 || strcasecmp(modelName, "multiped-500") == 0 )
@@ -250,22 +274,28 @@ detectNet* detectNet::Create( int argc, char** argv )
 		
 		if( threshold == 0.0f )
 			threshold = 0.5f;
-		
-		int maxBatchSize = cmdLine.GetInt("batch_size");
-		
-		if( maxBatchSize < 1 )
-			maxBatchSize = 2;
 
-		return detectNet::Create(prototxt, modelName, meanPixel, threshold, input, out_cvg, out_bbox, maxBatchSize);
+		detectNet* net = detectNet::Create(prototxt, modelName, meanPixel, threshold, input, out_cvg, out_bbox, maxBatchSize);
+
+		if( net != NULL && pyramidLevels > 1 )
+			net->SetPyramid(pyramidLevels, pyramidScale);
+
+		return net;
 	}
 
-	// create segnet from pretrained model
-	return detectNet::Create(type);
+	// create detectNet from pretrained model
+	detectNet* net = detectNet::Create(type, 0.5f, maxBatchSize);
+
+	if( net != NULL && pyramidLevels > 1 )
+		net->SetPyramid(pyramidLevels, pyramidScale);
+
+	return net;
 }
 	
 
 cudaError_t cudaPreImageNet( float4* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight );	
 cudaError_t cudaPreImageNetMean( float4* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight, const float3& mean_value );
+cudaError_t cudaPreImageNetPyramid( float4* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight, const int2* levels, uint32_t numLevels, const float3& mean_value );
 
 
 
@@ -313,9 +343,87 @@ static void mergeRect( std::vector<float6>& rects, const float6& rect )
 }
 
 
+// clusterRects
+static void clusterRects( const float* net_cvg, const float* net_rects, int ow, int oh, int cls,
+					 float cell_width, float cell_height, float scale_x, float scale_y, float threshold,
+					 std::vector< std::vector<float6> >& rects )
+{
+	const int owh = ow * oh;	// total number of bbox in grid
+
+	rects.resize(cls);
+	
+	// extract and cluster the raw bounding boxes that meet the coverage threshold
+	for( uint32_t z=0; z < cls; z++ )
+	{
+		rects[z].reserve(owh);
+		
+		for( uint32_t y=0; y < oh; y++ )
+		{
+			for( uint32_t x=0; x < ow; x++)
+			{
+				const float coverage = net_cvg[z * owh + y * ow + x];
+				
+				if( coverage > threshold )
+				{
+					const float mx = x * cell_width;
+					const float my = y * cell_height;
+					
+					const float x1 = (net_rects[0 * owh + y * ow + x] + mx) * scale_x;	// left
+					const float y1 = (net_rects[1 * owh + y * ow + x] + my) * scale_y;	// top
+					const float x2 = (net_rects[2 * owh + y * ow + x] + mx) * scale_x;	// right
+					const float y2 = (net_rects[3 * owh + y * ow + x] + my) * scale_y;	// bottom 
+					
+				#ifdef DEBUG_CLUSTERING
+					printf("rect x=%u y=%u  cvg=%f  %f %f   %f %f \n", x, y, coverage, x1, x2, y1, y2);
+				#endif					
+					mergeRect( rects[z], make_float6(x1, y1, x2, y2, coverage, z) );
+				}
+			}
+		}
+	}
+}
+
+
+// condenseRects
+static int condenseRects( const std::vector< std::vector<float6> >& rects, float* boundingBoxes, uint32_t numMax, float* confidence )
+{
+	const uint32_t cls = rects.size();
+	int n = 0;
+	
+	// condense the multiple class lists down to 1 list of detections
+	for( uint32_t z = 0; z < cls; z++ )
+	{
+		const uint32_t numBox = rects[z].size();
+		
+		for( uint32_t b = 0; b < numBox && n < numMax; b++ )
+		{
+			const float6 r = rects[z][b];
+			
+			boundingBoxes[n * 4 + 0] = r.x;
+			boundingBoxes[n * 4 + 1] = r.y;
+			boundingBoxes[n * 4 + 2] = r.z;
+			boundingBoxes[n * 4 + 3] = r.w;
+			
+			if( confidence != NULL )
+			{
+				confidence[n * 2 + 0] = r.v;	// coverage
+				confidence[n * 2 + 1] = r.u;	// class ID
+			}
+			
+			n++;
+		}
+	}
+
+	return n;
+}
+
+
 // Detect
 bool detectNet::Detect( float* rgba, uint32_t width, uint32_t height, float* boundingBoxes, int* numBoxes, float* confidence )
 {
+	if( mPyramidLevels > 1 )
+		return DetectPyramid(rgba, width, height, boundingBoxes, numBoxes, confidence);
+
 	if( !rgba || width == 0 || height == 0 || !boundingBoxes || !numBoxes || *numBoxes < 1 )
 	{
 		printf("detectNet::Detect( 0x%p, %u, %u ) -> invalid parameters\n", rgba, width, height);
@@ -345,7 +453,7 @@ bool detectNet::Detect( float* rgba, uint32_t width, uint32_t height, float* bou
 	// process with GIE
 	void* inferenceBuffers[] = { mInputCUDA, mOutputs[OUTPUT_CVG].CUDA, mOutputs[OUTPUT_BBOX].CUDA };
 	
-	if( !mContext->execute(1, inferenceBuffers) )
+	if( !execute(1, inferenceBuffers) )
 	{
 		printf(LOG_GIE "detectNet::Classify() -- failed to execute tensorRT context\n");
 		*numBoxes = 0;
@@ -353,6 +461,7 @@ bool detectNet::Detect( float* rgba, uint32_t width, uint32_t height, float* bou
 	}
 	
 	PROFILER_REPORT();
+	TRACE_ZONE("postprocess");
 
 	// cluster detection bboxes
 	float* net_cvg   = mOutputs[OUTPUT_CVG].CPU;
@@ -360,7 +469,6 @@ bool detectNet::Detect( float* rgba, uint32_t width, uint32_t height, float* bou
 	
 	const int ow  = DIMS_W(mOutputs[OUTPUT_BBOX].dims);		// number of columns in bbox grid in X dimension
 	const int oh  = DIMS_H(mOutputs[OUTPUT_BBOX].dims);		// number of rows in bbox grid in Y dimension
-	const int owh = ow * oh;							// total number of bbox in grid
 	const int cls = GetNumClasses();					// number of object classes in coverage map
 	
 	const float cell_width  = /*width*/ DIMS_W(mInputDims) / ow;
@@ -377,71 +485,248 @@ bool detectNet::Detect( float* rgba, uint32_t width, uint32_t height, float* bou
 #endif
 #if 1
 	std::vector< std::vector<float6> > rects;
-	rects.resize(cls);
+	clusterRects(net_cvg, net_rects, ow, oh, cls, cell_width, cell_height, scale_x, scale_y, mCoverageThreshold, rects);
 	
-	// extract and cluster the raw bounding boxes that meet the coverage threshold
+	//printf("done clustering rects\n");
+	
+	*numBoxes = condenseRects(rects, boundingBoxes, *numBoxes, confidence);
+#else
+	*numBoxes = 0;
+#endif
+	return true;
+}
+
+
+// SetPyramid
+bool detectNet::SetPyramid( uint32_t levels, float scaleFactor )
+{
+	if( levels < 1 || levels > mMaxBatchSize || levels > DETECTNET_MAX_PYRAMID_LEVELS )
+	{
+		printf("detectNet -- %u pyramid levels requested, but the network supports between 1 and %u (max batch size)\n", levels, std::min(mMaxBatchSize, (uint32_t)DETECTNET_MAX_PYRAMID_LEVELS));
+		return false;
+	}
+
+	if( scaleFactor <= 0.0f || scaleFactor >= 1.0f )
+	{
+		printf("detectNet -- invalid pyramid scale factor %f, must be between 0 and 1\n", scaleFactor);
+		return false;
+	}
+
+	mPyramidLevels = levels;
+	mPyramidScale  = scaleFactor;
+	mPyramidCost.clear();
+
+	printf("detectNet -- pyramid mode using %u levels, scale factor %f\n", mPyramidLevels, mPyramidScale);
+	return true;
+}
+
+
+// pyramidLevelSize
+static inline int2 pyramidLevelSize( uint32_t width, uint32_t height, float scaleFactor, uint32_t level )
+{
+	const float s = powf(scaleFactor, level);
+	return make_int2(std::max(1, (int)(width * s + 0.5f)), std::max(1, (int)(height * s + 0.5f)));
+}
+
+
+// pyramidRect
+struct pyramidRect
+{
+	float6   rect;
+	uint32_t level;
+
+	inline float area() const	{ return (rect.z - rect.x) * (rect.w - rect.y); }
+};
+
+
+// pyramidOverlap
+static float pyramidOverlap( const pyramidRect& a, const pyramidRect& b )
+{
+	const float ix = std::min(a.rect.z, b.rect.z) - std::max(a.rect.x, b.rect.x);
+	const float iy = std::min(a.rect.w, b.rect.w) - std::max(a.rect.y, b.rect.y);
+
+	if( ix <= 0.0f || iy <= 0.0f )
+		return 0.0f;
+
+	const float intersection = ix * iy;
+	const float areaA = a.area();
+	const float areaB = b.area();
+
+	// detections of the same level use IoU, while across levels the box from the coarser
+	// level is often a looser fit around the same object, so compare against the smaller box
+	if( a.level == b.level )
+		return intersection / (areaA + areaB - intersection);
+
+	return intersection / std::min(areaA, areaB);
+}
+
+
+// DetectPyramid
+bool detectNet::DetectPyramid( float* rgba, uint32_t width, uint32_t height, float* boundingBoxes, int* numBoxes, float* confidence )
+{
+	if( !rgba || width == 0 || height == 0 || !boundingBoxes || !numBoxes || *numBoxes < 1 )
+	{
+		printf("detectNet::DetectPyramid( 0x%p, %u, %u ) -> invalid parameters\n", rgba, width, height);
+		return false;
+	}
+
+	const uint32_t numLevels = mPyramidLevels;
+
+	// generate every level of the pyramid into the batch with one launch
+	int2 levels[DETECTNET_MAX_PYRAMID_LEVELS];
+
+	for( uint32_t n=0; n < numLevels; n++ )
+		levels[n] = pyramidLevelSize(mWidth, mHeight, mPyramidScale, n);
+
+	if( CUDA_FAILED(cudaPreImageNetPyramid((float4*)rgba, width, height, mInputCUDA, mWidth, mHeight, levels, numLevels,
+									make_float3(mMeanPixel, mMeanPixel, mMeanPixel))) )
+	{
+		printf("detectNet::DetectPyramid() -- cudaPreImageNetPyramid failed\n");
+		return false;
+	}
+
+	// process with GIE
+	void* inferenceBuffers[] = { mInputCUDA, mOutputs[OUTPUT_CVG].CUDA, mOutputs[OUTPUT_BBOX].CUDA };
+	
+	if( !execute(numLevels, inferenceBuffers) )
+	{
+		printf(LOG_GIE "detectNet::DetectPyramid() -- failed to execute tensorRT context\n");
+		*numBoxes = 0;
+		return false;
+	}
+	
+	PROFILER_REPORT();
+	TRACE_ZONE("postprocess");
+
+	// cluster the detection bboxes of each level
+	const int ow  = DIMS_W(mOutputs[OUTPUT_BBOX].dims);
+	const int oh  = DIMS_H(mOutputs[OUTPUT_BBOX].dims);
+	const int owh = ow * oh;
+	const int cls = GetNumClasses();
+	
+	const float cell_width  = DIMS_W(mInputDims) / ow;
+	const float cell_height = DIMS_H(mInputDims) / oh;
+
+	std::vector< std::vector<pyramidRect> > candidates(cls);
+	std::vector< std::vector<float6> > rects;
+
+	for( uint32_t n=0; n < numLevels; n++ )
+	{
+		const float* net_cvg   = mOutputs[OUTPUT_CVG].CPU + n * cls * owh;
+		const float* net_rects = mOutputs[OUTPUT_BBOX].CPU + n * DIMS_C(mOutputs[OUTPUT_BBOX].dims) * owh;
+
+		// the image only occupies the top-left of the slot at this level
+		const float scale_x = float(width) / float(levels[n].x);
+		const float scale_y = float(height) / float(levels[n].y);
+
+		rects.clear();
+		clusterRects(net_cvg, net_rects, ow, oh, cls, cell_width, cell_height, scale_x, scale_y, mCoverageThreshold, rects);
+
+		for( uint32_t z=0; z < cls; z++ )
+		{
+			const uint32_t numBox = rects[z].size();
+
+			for( uint32_t b=0; b < numBox; b++ )
+			{
+				pyramidRect r;
+
+				r.rect   = rects[z][b];
+				r.rect.x = std::max(r.rect.x, 0.0f);
+				r.rect.y = std::max(r.rect.y, 0.0f);
+				r.rect.z = std::min(r.rect.z, float(width));
+				r.rect.w = std::min(r.rect.w, float(height));
+				r.level  = n;
+
+				if( r.rect.z > r.rect.x && r.rect.w > r.rect.y )
+					candidates[z].push_back(r);
+			}
+		}
+	}
+
+	// merge the levels with non-maximum suppression, highest coverage first
+	rects.clear();
+	rects.resize(cls);
+
 	for( uint32_t z=0; z < cls; z++ )
 	{
-		rects[z].reserve(owh);
-		
-		for( uint32_t y=0; y < oh; y++ )
+		std::vector<pyramidRect>& c = candidates[z];
+		std::sort(c.begin(), c.end(), [](const pyramidRect& a, const pyramidRect& b) { return a.rect.v > b.rect.v; });
+
+		std::vector<pyramidRect> kept;
+		const uint32_t numCandidates = c.size();
+
+		for( uint32_t i=0; i < numCandidates; i++ )
 		{
-			for( uint32_t x=0; x < ow; x++)
+			bool suppressed = false;
+
+			for( uint32_t k=0; k < kept.size(); k++ )
 			{
-				const float coverage = net_cvg[z * owh + y * ow + x];
-				
-				if( coverage > mCoverageThreshold )
+				if( pyramidOverlap(kept[k], c[i]) > mPyramidOverlap )
 				{
-					const float mx = x * cell_width;
-					const float my = y * cell_height;
-					
-					const float x1 = (net_rects[0 * owh + y * ow + x] + mx) * scale_x;	// left
-					const float y1 = (net_rects[1 * owh + y * ow + x] + my) * scale_y;	// top
-					const float x2 = (net_rects[2 * owh + y * ow + x] + mx) * scale_x;	// right
-					const float y2 = (net_rects[3 * owh + y * ow + x] + my) * scale_y;	// bottom 
-					
-				#ifdef DEBUG_CLUSTERING
-					printf("rect x=%u y=%u  cvg=%f  %f %f   %f %f \n", x, y, coverage, x1, x2, y1, y2);
-				#endif					
-					mergeRect( rects[z], make_float6(x1, y1, x2, y2, coverage, z) );
+					suppressed = true;
+					break;
 				}
 			}
+
+			if( !suppressed )
+			{
+				kept.push_back(c[i]);
+				rects[z].push_back(c[i].rect);
+			}
 		}
 	}
+
+	*numBoxes = condenseRects(rects, boundingBoxes, *numBoxes, confidence);
+	return true;
+}
+
+
+// ProfilePyramid
+bool detectNet::ProfilePyramid( uint32_t iterations )
+{
+	if( iterations == 0 )
+		return false;
+
+	void* inferenceBuffers[] = { mInputCUDA, mOutputs[OUTPUT_CVG].CUDA, mOutputs[OUTPUT_BBOX].CUDA };
 	
-	//printf("done clustering rects\n");
-	
-	// condense the multiple class lists down to 1 list of detections
-	const uint32_t numMax = *numBoxes;
-	int n = 0;
-	
-	for( uint32_t z = 0; z < cls; z++ )
+	std::vector<float> batchTime(mPyramidLevels);
+	mPyramidCost.resize(mPyramidLevels);
+
+	for( uint32_t n=0; n < mPyramidLevels; n++ )
 	{
-		const uint32_t numBox = rects[z].size();
-		
-		for( uint32_t b = 0; b < numBox && n < numMax; b++ )
+		const uint32_t batchSize = n + 1;
+
+		// warm up once so the first timing doesn't include lazy initialization
+		bool result = mContext->execute(batchSize, inferenceBuffers);
+
+		timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for( uint32_t i=0; i < iterations && result; i++ )
+			result = mContext->execute(batchSize, inferenceBuffers);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		// a failed level would be timed as if it ran, so none of the costs can be trusted
+		if( !result )
 		{
-			const float6 r = rects[z][b];
-			
-			boundingBoxes[n * 4 + 0] = r.x;
-			boundingBoxes[n * 4 + 1] = r.y;
-			boundingBoxes[n * 4 + 2] = r.z;
-			boundingBoxes[n * 4 + 3] = r.w;
-			
-			if( confidence != NULL )
-			{
-				confidence[n * 2 + 0] = r.v;	// coverage
-				confidence[n * 2 + 1] = r.u;	// class ID
-			}
-			
-			n++;
+			printf(LOG_GIE "detectNet::ProfilePyramid() -- failed to execute tensorRT context with batch size %u (level %u)\n", batchSize, n);
+			mPyramidCost.clear();
+			return false;
 		}
+
+		batchTime[n]    = ((end.tv_sec - start.tv_sec) * 1000.0f + (end.tv_nsec - start.tv_nsec) * 0.000001f) / iterations;
+		mPyramidCost[n] = (n == 0) ? batchTime[n] : batchTime[n] - batchTime[n-1];
 	}
-	
-	*numBoxes = n;
-#else
-	*numBoxes = 0;
-#endif
+
+	printf("detectNet -- pyramid profile (%u iterations)\n", iterations);
+
+	for( uint32_t n=0; n < mPyramidLevels; n++ )
+	{
+		const int2 size = pyramidLevelSize(mWidth, mHeight, mPyramidScale, n);
+		printf("          -- level %u  %4ix%-4i  total %8.3f ms  level cost %8.3f ms\n", n, size.x, size.y, batchTime[n], mPyramidCost[n]);
+	}
+
 	return true;
 }
 
@@ -45,6 +45,12 @@
  */
 #define DETECTNET_DEFAULT_BBOX  "bboxes"
 
+/**
+ * Maximum number of levels supported by detectNet pyramid mode.
+ * @ingroup deepVision
+ */
+#define DETECTNET_MAX_PYRAMID_LEVELS  16
+
 
 /**
  * Object recognition and localization networks with TensorRT support.
@@ -131,6 +137,55 @@ public:
 	 * @returns True if the image was processed without error, false if an error was encountered.
 	 */
 	bool Detect( float* rgba, uint32_t width, uint32_t height, float* boundingBoxes, int* numBoxes, float* confidence=NULL );
+
+	/**
+	 * Detect object locations over an image pyramid of the RGBA image.
+	 * All of the pyramid levels are generated with a single preprocessing launch and packed
+	 * into the batch, so the network is executed once per frame.  The results from each level
+	 * are mapped back to image coordinates and merged with scale-aware non-maximum suppression.
+	 * The parameters are the same as Detect(), which forwards here when SetPyramid() was used.
+	 * @see SetPyramid()
+	 */
+	bool DetectPyramid( float* rgba, uint32_t width, uint32_t height, float* boundingBoxes, int* numBoxes, float* confidence=NULL );
+
+	/**
+	 * Enable pyramid mode with the specified number of levels.
+	 * Level 0 is the full frame resized to the network input, and each following level
+	 * is downscaled by scaleFactor again and placed in the top-left corner of its batch slot.
+	 * @param levels number of pyramid levels, between 1 (disabled) and the maximum batch size.
+	 * @param scaleFactor downscaling factor applied between successive levels, in the range (0,1).
+	 * @returns false if the parameters were out of range.
+	 */
+	bool SetPyramid( uint32_t levels, float scaleFactor=0.7071f );
+
+	/**
+	 * Retrieve the number of pyramid levels (1 if pyramid mode is disabled).
+	 */
+	inline uint32_t GetPyramidLevels() const		{ return mPyramidLevels; }
+
+	/**
+	 * Retrieve the downscaling factor between successive pyramid levels.
+	 */
+	inline float GetPyramidScale() const			{ return mPyramidScale; }
+
+	/**
+	 * Set the overlap threshold used to merge detections across pyramid levels.
+	 */
+	inline void SetPyramidOverlap( float overlap )	{ mPyramidOverlap = overlap; }
+
+	/**
+	 * Measure the execution time of the network for batch sizes 1 through GetPyramidLevels().
+	 * The results are printed and retained, so the cost of each extra level can be queried
+	 * with GetPyramidCost() in order to trade off the number of levels against latency.
+	 * @param iterations number of timed executions to average over per batch size.
+	 */
+	bool ProfilePyramid( uint32_t iterations=10 );
+
+	/**
+	 * Retrieve the marginal cost in milliseconds of adding the specified level to the batch,
+	 * as measured by ProfilePyramid().  Returns 0 if the level hasn't been profiled.
+	 */
+	inline float GetPyramidCost( uint32_t level ) const	{ return (level < mPyramidCost.size()) ? mPyramidCost[level] : 0.0f; }
 	
 	/**
 	 * Draw bounding boxes in the RGBA image.
@@ -176,6 +231,12 @@ protected:
 	float  mCoverageThreshold;
 	float* mClassColors[2];
 	float  mMeanPixel;
+
+	uint32_t mPyramidLevels;
+	float    mPyramidScale;
+	float    mPyramidOverlap;
+
+	std::vector<float> mPyramidCost;
 };
 
 
@@ -20,23 +20,29 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include "gstCamera.h"
-
-#include "glDisplay.h"
-#include "glTexture.h"
+#include "camera.h"
+#include "pipeline.h"
+#include "trace.h"
 
 #include <stdio.h>
 #include <signal.h>
 #include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
 
 #include "cudaMappedMemory.h"
 #include "cudaNormalize.h"
 #include "cudaFont.h"
 
+#include "commandLine.h"
+#include "imageWriter.h"
+#include "displaySink.h"
+
 #include "detectNet.h"
 
 
-#define DEFAULT_CAMERA -1	// -1 for onboard camera, or change to index of /dev/video V4L2 camera (>=0)	
+#define DEFAULT_CAMERA "gst://onboard"	// onboard camera, or override with --camera=<uri> (e.g. gst://0 or v4l2:///dev/video0)
 		
 
 bool signal_recieved = false;
@@ -51,6 +57,76 @@ void sig_handler(int signo)
 }
 
 
+// state of the detect stage, which only runs on the stage's thread
+struct detectStage
+{
+	detectNet*   net;
+	float*       bbCPU;
+	float*       bbCUDA;
+	float*       confCPU;
+	uint32_t     maxBoxes;
+	imageWriter* snapshots;
+	const char*  snapshotDir;
+	const char*  snapshotExt;
+	bool         overlay;		// draw the boxes, if anything will see them
+};
+
+
+// detect objects and draw their bounding boxes
+static bool detect( pipelineFrame* frame, void* user_data )
+{
+	detectStage* stage = (detectStage*)user_data;
+	detectNet*   net   = stage->net;
+
+	int numBoundingBoxes = stage->maxBoxes;
+
+	if( !net->Detect((float*)frame->rgba, frame->width, frame->height, stage->bbCPU, &numBoundingBoxes, stage->confCPU) )
+		return false;
+
+	printf("%i bounding boxes detected\n", numBoundingBoxes);
+
+	int lastClass = 0;
+	int lastStart = 0;
+	
+	for( int n=0; n < numBoundingBoxes; n++ )
+	{
+		const int nc = stage->confCPU[n*2+1];
+		float* bb = stage->bbCPU + (n * 4);
+		
+		printf("bounding box %i   (%f, %f)  (%f, %f)  w=%f  h=%f\n", n, bb[0], bb[1], bb[2], bb[3], bb[2] - bb[0], bb[3] - bb[1]); 
+		
+		if( stage->overlay && (nc != lastClass || n == (numBoundingBoxes - 1)) )
+		{
+			if( !net->DrawBoxes((float*)frame->rgba, (float*)frame->rgba, frame->width, frame->height, 
+				                        stage->bbCUDA + (lastStart * 4), (n - lastStart) + 1, lastClass) )
+				printf("detectnet-camera:  failed to draw boxes\n");
+				
+			lastClass = nc;
+			lastStart = n;
+		}
+	}
+
+	// frames are dropped by the writer rather than stalling the pipeline
+	if( stage->snapshots != NULL && numBoundingBoxes > 0 )
+	{
+		char filename[512];
+		sprintf(filename, "%s/frame-%08llu.%s", stage->snapshotDir, (unsigned long long)frame->sequence, stage->snapshotExt);
+		stage->snapshots->Write(filename, frame->rgba, frame->width, frame->height);
+	}
+
+	return true;
+}
+
+
+// rescale the pixel intensities for display
+static bool normalize( pipelineFrame* frame, void* user_data )
+{
+	return !CUDA_FAILED(cudaNormalizeRGBA(frame->rgba, make_float2(0.0f, 255.0f), 
+								   frame->rgba, make_float2(0.0f, 1.0f), 
+		 						   frame->width, frame->height));
+}
+
+
 int main( int argc, char** argv )
 {
 	printf("detectnet-camera\n  args (%i):  ", argc);
@@ -60,30 +136,17 @@ int main( int argc, char** argv )
 		
 	printf("\n\n");
 	
-
-	/*
-	 * parse network type from CLI arguments
-	 */
-	/*detectNet::NetworkType networkType = detectNet::PEDNET_MULTI;
-
-	if( argc > 1 )
-	{
-		if( strcmp(argv[1], "multiped") == 0 || strcmp(argv[1], "pednet") == 0 || strcmp(argv[1], "multiped-500") == 0 )
-			networkType = detectNet::PEDNET_MULTI;
-		else if( strcmp(argv[1], "ped-100") == 0 )
-			networkType = detectNet::PEDNET;
-		else if( strcmp(argv[1], "facenet") == 0 || strcmp(argv[1], "facenet-120") == 0 || strcmp(argv[1], "face-120") == 0 )
-			networkType = detectNet::FACENET;
-	}*/
-	
 	if( signal(SIGINT, sig_handler) == SIG_ERR )
 		printf("\ncan't catch SIGINT\n");
 
+	// record where the time of each frame goes (--trace=<file>)
+	trace::Init(argc, argv);
+
 
 	/*
 	 * create the camera device
 	 */
-	gstCamera* camera = gstCamera::Create(DEFAULT_CAMERA);
+	camera* camera = camera::Create(argc, argv, DEFAULT_CAMERA);
 	
 	if( !camera )
 	{
@@ -112,16 +175,17 @@ int main( int argc, char** argv )
 	/*
 	 * allocate memory for output bounding boxes and class confidence
 	 */
-	const uint32_t maxBoxes = net->GetMaxBoundingBoxes();		printf("maximum bounding boxes:  %u\n", maxBoxes);
-	const uint32_t classes  = net->GetNumClasses();
+	detectStage stage;
+
+	stage.net      = net;
+	stage.maxBoxes = net->GetMaxBoundingBoxes();		printf("maximum bounding boxes:  %u\n", stage.maxBoxes);
+
+	const uint32_t classes = net->GetNumClasses();
 	
-	float* bbCPU    = NULL;
-	float* bbCUDA   = NULL;
-	float* confCPU  = NULL;
 	float* confCUDA = NULL;
 	
-	if( !cudaAllocMapped((void**)&bbCPU, (void**)&bbCUDA, maxBoxes * sizeof(float4)) ||
-	    !cudaAllocMapped((void**)&confCPU, (void**)&confCUDA, maxBoxes * classes * sizeof(float)) )
+	if( !cudaAllocMapped((void**)&stage.bbCPU, (void**)&stage.bbCUDA, stage.maxBoxes * sizeof(float4)) ||
+	    !cudaAllocMapped((void**)&stage.confCPU, (void**)&confCUDA, stage.maxBoxes * classes * sizeof(float)) )
 	{
 		printf("detectnet-console:  failed to alloc output memory\n");
 		return 0;
@@ -129,28 +193,68 @@ int main( int argc, char** argv )
 	
 
 	/*
-	 * create openGL window
+	 * create the sinks (--sink=display://,shm://<name>,null:// or --output=<uri>), which
+	 * is an openGL window by default if there's an X server, or else nothing
 	 */
-	glDisplay* display = glDisplay::Create();
-	glTexture* texture = NULL;
-	
-	if( !display ) {
-		printf("\ndetectnet-camera:  failed to create openGL display\n");
+	displaySink* sink = displaySink::Create(argc, argv, camera->GetWidth(), camera->GetHeight());
+
+	if( !sink )
+	{
+		printf("\ndetectnet-camera:  failed to create display sinks\n");
+		return 0;
 	}
-	else
+
+
+	/*
+	 * save the frames with detections in the background (--snapshots=<dir>, --snapshot_format=jpg|png|raw)
+	 */
+	commandLine cmdLine(argc, argv);
+
+	stage.snapshotDir = cmdLine.GetString("snapshots");
+	stage.snapshots   = NULL;
+
+	if( stage.snapshotDir != NULL )
 	{
-		texture = glTexture::Create(camera->GetWidth(), camera->GetHeight(), GL_RGBA32F_ARB/*GL_RGBA8*/);
+		struct stat info;
 
-		if( !texture )
-			printf("detectnet-camera:  failed to create openGL texture\n");
+		if( mkdir(stage.snapshotDir, 0755) != 0 && (errno != EEXIST || stat(stage.snapshotDir, &info) != 0 || !S_ISDIR(info.st_mode)) )
+		{
+			printf("\ndetectnet-camera:  failed to create snapshot directory '%s' (%s)\n", stage.snapshotDir, strerror(errno));
+			return 0;
+		}
+
+		stage.snapshots = imageWriter::Create(2, 8, imageWriter::ParseFormat(cmdLine.GetString("snapshot_format")));
 	}
-	
-	
+
+	stage.snapshotExt = "jpg";
+
+	if( stage.snapshots != NULL && stage.snapshots->GetFormat() == imageWriter::FORMAT_PNG )
+		stage.snapshotExt = "png";
+	else if( stage.snapshots != NULL && stage.snapshots->GetFormat() == imageWriter::FORMAT_RAW )
+		stage.snapshotExt = "rgba";
+
+	// the snapshots are saved with their boxes
+	stage.overlay = sink->Needs(displaySink::FORMAT_RGBA) || stage.snapshots != NULL;
+
+	const bool  normalized = sink->Needs(displaySink::FORMAT_NORMALIZED);
+	const float maxPixel   = normalized ? 1.0f : 255.0f;
+
+
 	/*
-	 * create font
+	 * create the processing pipeline:  capture -> convert -> detect -> normalize -> sinks, with each
+	 * stage on its own thread and detection always taking the newest frame (the normalization is
+	 * left out when no sink needs it)
 	 */
-	cudaFont* font = cudaFont::Create();
-	
+	pipeline* pipe = pipeline::Create(camera->GetWidth(), camera->GetHeight());
+
+	if( !pipe || !pipe->AddCamera(camera) ||
+	    !pipe->AddStage("detect", detect, &stage, 1, pipeline::DROP_OLDEST) ||
+	    (normalized && !pipe->AddStage("normalize", normalize, NULL, 2, pipeline::BACKPRESSURE)) )
+	{
+		printf("detectnet-camera:  failed to create the processing pipeline\n");
+		return 0;
+	}
+
 
 	/*
 	 * start streaming
@@ -163,108 +267,54 @@ int main( int argc, char** argv )
 	
 	printf("\ndetectnet-camera:  camera open for streaming\n");
 	
+	if( !pipe->Start() )
+	{
+		printf("detectnet-camera:  failed to start the processing pipeline\n");
+		return 0;
+	}
+
 	
 	/*
-	 * processing loop
+	 * render loop
 	 */
-	float confidence = 0.0f;
-	
 	while( !signal_recieved )
 	{
-		void* imgCPU  = NULL;
-		void* imgCUDA = NULL;
-		
-		// get the latest frame
-		if( !camera->Capture(&imgCPU, &imgCUDA, 1000) )
-			printf("\ndetectnet-camera:  failed to capture frame\n");
+		pipelineFrame* frame = NULL;
 
-		// convert from YUV to RGBA
-		void* imgRGBA = NULL;
-		
-		if( !camera->ConvertRGBA(imgCUDA, &imgRGBA) )
-			printf("detectnet-camera:  failed to convert from NV12 to RGBA\n");
-
-		// classify image with detectNet
-		int numBoundingBoxes = maxBoxes;
-	
-		if( net->Detect((float*)imgRGBA, camera->GetWidth(), camera->GetHeight(), bbCPU, &numBoundingBoxes, confCPU))
+		// get the latest processed frame
+		if( !pipe->Next(&frame, 1000) )
 		{
-			printf("%i bounding boxes detected\n", numBoundingBoxes);
-		
-			int lastClass = 0;
-			int lastStart = 0;
-			
-			for( int n=0; n < numBoundingBoxes; n++ )
-			{
-				const int nc = confCPU[n*2+1];
-				float* bb = bbCPU + (n * 4);
-				
-				printf("bounding box %i   (%f, %f)  (%f, %f)  w=%f  h=%f\n", n, bb[0], bb[1], bb[2], bb[3], bb[2] - bb[0], bb[3] - bb[1]); 
-				
-				if( nc != lastClass || n == (numBoundingBoxes - 1) )
-				{
-					if( !net->DrawBoxes((float*)imgRGBA, (float*)imgRGBA, camera->GetWidth(), camera->GetHeight(), 
-						                        bbCUDA + (lastStart * 4), (n - lastStart) + 1, lastClass) )
-						printf("detectnet-console:  failed to draw boxes\n");
-						
-					lastClass = nc;
-					lastStart = n;
-
-					CUDA(cudaDeviceSynchronize());
-				}
-			}
-		
-			/*if( font != NULL )
-			{
-				char str[256];
-				sprintf(str, "%05.2f%% %s", confidence * 100.0f, net->GetClassDesc(img_class));
-				
-				font->RenderOverlay((float4*)imgRGBA, (float4*)imgRGBA, camera->GetWidth(), camera->GetHeight(),
-								    str, 10, 10, make_float4(255.0f, 255.0f, 255.0f, 255.0f));
-			}*/
-			
-			if( display != NULL )
-			{
-				char str[256];
-				sprintf(str, "TensorRT build %x | %s | %04.1f FPS", NV_GIE_VERSION, net->HasFP16() ? "FP16" : "FP32", display->GetFPS());
-				//sprintf(str, "GIE build %x | %s | %04.1f FPS | %05.2f%% %s", NV_GIE_VERSION, net->GetNetworkName(), display->GetFPS(), confidence * 100.0f, net->GetClassDesc(img_class));
-				display->SetTitle(str);	
-			}	
-		}	
-
-
-		// update display
-		if( display != NULL )
+			if( pipe->IsEOS() )
+				break;
+
+			continue;
+		}
+
+		TRACE_FRAME(frame->traceFrame);
+
+		// update the window, encoder, etc.
 		{
-			display->UserEvents();
-			display->BeginRender();
-
-			if( texture != NULL )
-			{
-				// rescale image pixel intensities for display
-				CUDA(cudaNormalizeRGBA((float4*)imgRGBA, make_float2(0.0f, 255.0f), 
-								   (float4*)imgRGBA, make_float2(0.0f, 1.0f), 
-		 						   camera->GetWidth(), camera->GetHeight()));
-
-				// map from CUDA to openGL using GL interop
-				void* tex_map = texture->MapCUDA();
-
-				if( tex_map != NULL )
-				{
-					cudaMemcpy(tex_map, imgRGBA, texture->GetSize(), cudaMemcpyDeviceToDevice);
-					texture->Unmap();
-				}
-
-				// draw the texture
-				texture->Render(100,100);		
-			}
-
-			display->EndRender();
+			TRACE_ZONE("display");
+
+			char str[256];
+			sprintf(str, "TensorRT build %x | %s", NV_GIE_VERSION, net->HasFP16() ? "FP16" : "FP32");
+			sink->SetStatus(str);
+
+			sink->Render(frame->rgba, frame->width, frame->height, maxPixel);
 		}
+
+		pipe->Release(frame);
 	}
 	
 	printf("\ndetectnet-camera:  un-initializing video device\n");
 	
+
+	/*
+	 * stop the pipeline, which hands the camera its frames back
+	 */
+	delete pipe;
+	trace::Shutdown();
+
 	
 	/*
 	 * shutdown the camera device
@@ -275,10 +325,16 @@ int main( int argc, char** argv )
 		camera = NULL;
 	}
 
-	if( display != NULL )
+	if( sink != NULL )
+	{
+		delete sink;
+		sink = NULL;
+	}
+
+	if( stage.snapshots != NULL )
 	{
-		delete display;
-		display = NULL;
+		delete stage.snapshots;
+		stage.snapshots = NULL;
 	}
 	
 	printf("detectnet-camera:  video device has been un-initialized.\n");
@@ -22,11 +22,13 @@
 
 #include "detectNet.h"
 #include "loadImage.h"
+#include "batchProcessor.h"
 
 #include "cudaMappedMemory.h"
 
 
 #include <sys/time.h>
+#include <vector>
 
 
 uint64_t current_timestamp() {
@@ -36,6 +38,85 @@ uint64_t current_timestamp() {
 }
 
 
+// draw the bounding boxes, in runs of the same class
+static void drawBoxes( detectNet* net, float* imgCUDA, int imgWidth, int imgHeight, float* bbCPU, float* bbCUDA, float* confCPU, int numBoundingBoxes, bool verbose )
+{
+	int lastClass = 0;
+	int lastStart = 0;
+	
+	for( int n=0; n < numBoundingBoxes; n++ )
+	{
+		const int nc = confCPU[n*2+1];
+		float* bb = bbCPU + (n * 4);
+		
+		if( verbose )
+			printf("bounding box %i   (%f, %f)  (%f, %f)  w=%f  h=%f\n", n, bb[0], bb[1], bb[2], bb[3], bb[2] - bb[0], bb[3] - bb[1]); 
+		
+		if( nc != lastClass || n == (numBoundingBoxes - 1) )
+		{
+			if( !net->DrawBoxes(imgCUDA, imgCUDA, imgWidth, imgHeight, bbCUDA + (lastStart * 4), (n - lastStart) + 1, lastClass) )
+				printf("detectnet-console:  failed to draw boxes\n");
+				
+			lastClass = nc;
+			lastStart = n;
+		}
+	}
+}
+
+
+// detect objects in a directory or list of images (--images=<dir|list>)
+static int processBatch( detectNet* net, int argc, char** argv, float* bbCPU, float* bbCUDA, float* confCPU )
+{
+	batchProcessor* batch = batchProcessor::Create(argc, argv);
+
+	if( !batch )
+	{
+		printf("detectnet-console:  failed to create batch processor\n");
+		return 0;
+	}
+
+	const uint32_t maxBoxes = net->GetMaxBoundingBoxes();
+	std::vector<batchResult> results(maxBoxes);
+
+	batchImage* image = NULL;
+
+	// detectNet has no batched entry point, so inference runs one image at a time
+	// while the decoding and writing overlap with it in the other threads
+	while( batch->Next(&image) )
+	{
+		int numBoundingBoxes = maxBoxes;
+
+		if( !net->Detect(image->cuda, image->width, image->height, bbCPU, &numBoundingBoxes, confCPU) )
+		{
+			printf("detectnet-console:  failed to process '%s'\n", image->filename);
+			batch->Complete(image, NULL, 0);
+			continue;
+		}
+
+		for( int n=0; n < numBoundingBoxes; n++ )
+		{
+			batchResult& r = results[n];
+
+			r.classID    = confCPU[n*2+1];
+			r.desc       = NULL;
+			r.confidence = confCPU[n*2];
+			r.left       = bbCPU[n*4+0];
+			r.top        = bbCPU[n*4+1];
+			r.right      = bbCPU[n*4+2];
+			r.bottom     = bbCPU[n*4+3];
+		}
+
+		if( batch->HasOutput() )
+			drawBoxes(net, image->cuda, image->width, image->height, bbCPU, bbCUDA, confCPU, numBoundingBoxes, false);
+
+		batch->Complete(image, results.data(), numBoundingBoxes);
+	}
+
+	delete batch;
+	return 0;
+}
+
+
 // main entry point
 int main( int argc, char** argv )
 {
@@ -66,7 +147,9 @@ int main( int argc, char** argv )
 		return 0;
 	}
 
-	net->EnableProfiler();
+	// report the cost of each pyramid level (--pyramid=N)
+	if( net->GetPyramidLevels() > 1 )
+		net->ProfilePyramid();
 	
 	// alloc memory for bounding box & confidence value output arrays
 	const uint32_t maxBoxes = net->GetMaxBoundingBoxes();		printf("maximum bounding boxes:  %u\n", maxBoxes);
@@ -83,6 +166,16 @@ int main( int argc, char** argv )
 		printf("detectnet-console:  failed to alloc output memory\n");
 		return 0;
 	}
+
+	// process a directory or list of images (--images=<dir|list>)
+	if( batchProcessor::IsRequested(argc, argv) )
+	{
+		const int result = processBatch(net, argc, argv, bbCPU, bbCUDA, confCPU);
+		delete net;
+		return result;
+	}
+
+	net->EnableProfiler();
 	
 	// load image from file on disk
 	float* imgCPU    = NULL;
@@ -111,25 +204,7 @@ int main( int argc, char** argv )
 	{
 		printf("%i bounding boxes detected\n", numBoundingBoxes);
 		
-		int lastClass = 0;
-		int lastStart = 0;
-		
-		for( int n=0; n < numBoundingBoxes; n++ )
-		{
-			const int nc = confCPU[n*2+1];
-			float* bb = bbCPU + (n * 4);
-			
-			printf("bounding box %i   (%f, %f)  (%f, %f)  w=%f  h=%f\n", n, bb[0], bb[1], bb[2], bb[3], bb[2] - bb[0], bb[3] - bb[1]); 
-			
-			if( nc != lastClass || n == (numBoundingBoxes - 1) )
-			{
-				if( !net->DrawBoxes(imgCUDA, imgCUDA, imgWidth, imgHeight, bbCUDA + (lastStart * 4), (n - lastStart) + 1, lastClass) )
-					printf("detectnet-console:  failed to draw boxes\n");
-					
-				lastClass = nc;
-				lastStart = n;
-			}
-		}
+		drawBoxes(net, imgCUDA, imgWidth, imgHeight, bbCPU, bbCUDA, confCPU, numBoundingBoxes, true);
 		
 		CUDA(cudaThreadSynchronize());
 		
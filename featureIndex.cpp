@@ -0,0 +1,749 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "featureIndex.h"
+#include "cudaMappedMemory.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+// declaration from featureIndex.cu
+cudaError_t cudaFeatureDot( const float* vectors, size_t count, size_t dims, const float* query, float* scores );
+
+
+#define FEATURE_INDEX_MAGIC     "FEATIDX1"
+#define FEATURE_INDEX_VERSION   1
+#define FEATURE_INDEX_ALIGN     64
+#define FEATURE_INDEX_TRAIN     64	// training vectors per IVF list
+
+enum featureSection
+{
+	SECTION_VECTORS = 0,
+	SECTION_CENTROIDS,
+	SECTION_LISTS,
+	SECTION_IDS,
+	SECTION_SCALES,
+	SECTION_CODES,
+	SECTION_COUNT
+};
+
+// on-disk header, followed by the 64-byte aligned sections (an offset of 0 means absent)
+struct featureIndexHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t dims;
+	uint32_t stride;
+	uint32_t count;
+	uint32_t numLists;
+	uint32_t reserved;
+	uint64_t offset[SECTION_COUNT];
+	uint64_t size[SECTION_COUNT];
+};
+
+
+// dotFloat
+static inline float dotFloat( const float* a, const float* b, uint32_t n )
+{
+	uint32_t i   = 0;
+	float    sum = 0.0f;
+
+#if defined(__SSE2__)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+
+	for( ; i + 8 <= n; i += 8 )
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+	for( ; i + 8 <= n; i += 8 )
+	{
+		acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+	}
+
+	const float32x4_t acc = vaddq_f32(acc0, acc1);
+	sum = (vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1)) + (vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3));
+#endif
+
+	for( ; i < n; i++ )
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+
+// dotInt8 (n must be a multiple of 16)
+static inline int dotInt8( const int8_t* a, const int8_t* b, uint32_t n )
+{
+#if defined(__SSE2__)
+	__m128i acc = _mm_setzero_si128();
+
+	for( uint32_t i=0; i < n; i += 16 )
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+
+		// sign-extend to 16-bit, then multiply-add pairs into 32-bit
+		const __m128i sa = _mm_cmpgt_epi8(_mm_setzero_si128(), va);
+		const __m128i sb = _mm_cmpgt_epi8(_mm_setzero_si128(), vb);
+
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(va, sa), _mm_unpacklo_epi8(vb, sb)));
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(va, sa), _mm_unpackhi_epi8(vb, sb)));
+	}
+
+	int lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	int32x4_t acc = vdupq_n_s32(0);
+
+	for( uint32_t i=0; i < n; i += 16 )
+	{
+		const int8x16_t va = vld1q_s8(a + i);
+		const int8x16_t vb = vld1q_s8(b + i);
+
+		acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+		acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+	}
+
+	return vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+#else
+	int sum = 0;
+
+	for( uint32_t i=0; i < n; i++ )
+		sum += a[i] * b[i];
+
+	return sum;
+#endif
+}
+
+
+// quantize a vector to int8 codes, returning the dequantization scale
+static float quantize( const float* vec, uint32_t dims, uint32_t stride, int8_t* codes )
+{
+	float maxAbs = 0.0f;
+
+	for( uint32_t i=0; i < dims; i++ )
+		maxAbs = fmaxf(maxAbs, fabsf(vec[i]));
+
+	const float scale = maxAbs / 127.0f;
+	const float inv   = (maxAbs > 0.0f) ? 127.0f / maxAbs : 0.0f;
+
+	for( uint32_t i=0; i < dims; i++ )
+		codes[i] = (int8_t)lrintf(vec[i] * inv);
+
+	memset(codes + dims, 0, stride - dims);
+	return scale;
+}
+
+
+// nearest centroid of a vector
+static uint32_t nearestList( const float* centroids, uint32_t numLists, const float* vec, uint32_t dims )
+{
+	uint32_t best      = 0;
+	float    bestScore = -2.0f;
+
+	for( uint32_t n=0; n < numLists; n++ )
+	{
+		const float score = dotFloat(centroids + n * dims, vec, dims);
+
+		if( score > bestScore )
+		{
+			best      = n;
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
+
+// sorted list of the k best scores seen
+struct topK
+{
+	uint32_t k;
+	uint32_t count;
+	int      ids[FEATURE_INDEX_MAX_K];
+	float    scores[FEATURE_INDEX_MAX_K];
+
+	topK( uint32_t k_ ) : k(k_), count(0)	{ }
+
+	inline void insert( int id, float score )
+	{
+		if( count == k && score <= scores[count-1] )
+			return;
+
+		uint32_t n = (count < k) ? count++ : count - 1;
+
+		while( n > 0 && scores[n-1] < score )
+		{
+			ids[n]    = ids[n-1];
+			scores[n] = scores[n-1];
+			n--;
+		}
+
+		ids[n]    = id;
+		scores[n] = score;
+	}
+
+	inline int output( int* ids_out, float* scores_out ) const
+	{
+		memcpy(ids_out, ids, count * sizeof(int));
+
+		if( scores_out != NULL )
+			memcpy(scores_out, scores, count * sizeof(float));
+
+		return count;
+	}
+};
+
+
+// constructor
+featureIndex::featureIndex()
+{
+	mDims     = 0;
+	mStride   = 0;
+	mCount    = 0;
+	mNumLists = 0;
+	mBuilt    = false;
+
+	mVectors     = NULL;
+	mCentroids   = NULL;
+	mListOffsets = NULL;
+	mIDs         = NULL;
+	mScales      = NULL;
+	mCodes       = NULL;
+
+	mMap     = NULL;
+	mMapSize = 0;
+
+	mVectorsGPU      = NULL;
+	mVectorsGPUCount = 0;
+	mScores[0]       = NULL;
+	mScores[1]       = NULL;
+	mScoresCount     = 0;
+}
+
+
+// destructor
+featureIndex::~featureIndex()
+{
+	if( mMap != NULL )
+		munmap(mMap, mMapSize);
+
+	if( mVectorsGPU != NULL )
+		CUDA(cudaFree(mVectorsGPU));
+
+	if( mScores[0] != NULL )
+		CUDA(cudaFreeHost(mScores[0]));
+}
+
+
+// Create
+featureIndex* featureIndex::Create( uint32_t dims, uint32_t numLists )
+{
+	if( dims == 0 )
+	{
+		printf("featureIndex -- invalid number of dimensions (%u)\n", dims);
+		return NULL;
+	}
+
+	featureIndex* idx = new featureIndex();
+
+	idx->mDims     = dims;
+	idx->mStride   = (dims + 15) & ~15;
+	idx->mNumLists = numLists;
+	idx->mBuilt    = (numLists == 0);
+
+	return idx;
+}
+
+
+// Add
+int featureIndex::Add( const float* vectors, uint32_t count )
+{
+	if( !vectors || count == 0 )
+		return -1;
+
+	if( mMap != NULL )
+	{
+		printf("featureIndex -- can't add vectors to an index loaded from disk\n");
+		return -1;
+	}
+
+	const int first = mCount;
+
+	mData.insert(mData.end(), vectors, vectors + count * mDims);
+	mVectors = mData.data();
+	mCount  += count;
+
+	if( mNumLists > 0 )
+		mBuilt = false;
+
+	return first;
+}
+
+
+// Build
+bool featureIndex::Build( uint32_t iterations )
+{
+	if( mNumLists == 0 || mBuilt )
+		return true;
+
+	if( mCount < mNumLists )
+	{
+		printf("featureIndex -- need at least %u vectors to build %u lists (has %u)\n", mNumLists, mNumLists, mCount);
+		return false;
+	}
+
+	/*
+	 * train the centroids with spherical k-means on a subsample
+	 */
+	const uint32_t numTrain = std::min(mCount, mNumLists * FEATURE_INDEX_TRAIN);
+
+	std::vector<const float*> train(numTrain);
+
+	for( uint32_t n=0; n < numTrain; n++ )
+		train[n] = mVectors + (uint64_t(n) * mCount / numTrain) * mDims;
+
+	mCentroidData.resize(mNumLists * mDims);
+
+	for( uint32_t c=0; c < mNumLists; c++ )
+		memcpy(&mCentroidData[c * mDims], train[uint64_t(c) * numTrain / mNumLists], mDims * sizeof(float));
+
+	std::vector<float>    sums(mNumLists * mDims);
+	std::vector<uint32_t> sizes(mNumLists);
+
+	for( uint32_t iter=0; iter < iterations; iter++ )
+	{
+		std::fill(sums.begin(), sums.end(), 0.0f);
+		std::fill(sizes.begin(), sizes.end(), 0);
+
+		for( uint32_t n=0; n < numTrain; n++ )
+		{
+			const uint32_t c = nearestList(mCentroidData.data(), mNumLists, train[n], mDims);
+			float* sum = &sums[c * mDims];
+
+			for( uint32_t i=0; i < mDims; i++ )
+				sum[i] += train[n][i];
+
+			sizes[c]++;
+		}
+
+		for( uint32_t c=0; c < mNumLists; c++ )
+		{
+			float* centroid = &mCentroidData[c * mDims];
+
+			// re-seed empty lists from the training set
+			if( sizes[c] == 0 )
+			{
+				memcpy(centroid, train[(uint64_t(c) * 7919 + iter * 104729) % numTrain], mDims * sizeof(float));
+				continue;
+			}
+
+			const float* sum  = &sums[c * mDims];
+			const float  norm = sqrtf(dotFloat(sum, sum, mDims));
+
+			if( norm <= 0.0f )
+				continue;
+
+			for( uint32_t i=0; i < mDims; i++ )
+				centroid[i] = sum[i] / norm;
+		}
+	}
+
+	/*
+	 * assign every vector to its list and quantize it
+	 */
+	std::vector<uint32_t> assignment(mCount);
+
+	mListData.assign(mNumLists + 1, 0);
+
+	for( uint32_t n=0; n < mCount; n++ )
+	{
+		assignment[n] = nearestList(mCentroidData.data(), mNumLists, mVectors + n * mDims, mDims);
+		mListData[assignment[n] + 1]++;
+	}
+
+	for( uint32_t c=0; c < mNumLists; c++ )
+		mListData[c + 1] += mListData[c];
+
+	std::vector<uint32_t> next(mListData.begin(), mListData.end() - 1);
+
+	mIDData.resize(mCount);
+	mScaleData.resize(mCount);
+	mCodeData.resize(mCount * mStride);
+
+	for( uint32_t n=0; n < mCount; n++ )
+	{
+		const uint32_t slot = next[assignment[n]]++;
+
+		mIDData[slot]    = n;
+		mScaleData[slot] = quantize(mVectors + n * mDims, mDims, mStride, &mCodeData[slot * mStride]);
+	}
+
+	mCentroids   = mCentroidData.data();
+	mListOffsets = mListData.data();
+	mIDs         = mIDData.data();
+	mScales      = mScaleData.data();
+	mCodes       = mCodeData.data();
+	mBuilt       = true;
+
+	printf("featureIndex -- built %u lists from %u vectors (%u training vectors, %u iterations)\n", mNumLists, mCount, numTrain, iterations);
+	return true;
+}
+
+
+// Search
+int featureIndex::Search( const float* query, uint32_t k, int* ids, float* scores, uint32_t nprobe )
+{
+	if( !query || !ids || k == 0 || k > FEATURE_INDEX_MAX_K )
+		return -1;
+
+	if( !mBuilt )
+	{
+		printf("featureIndex -- Build() must be called before searching\n");
+		return -1;
+	}
+
+	topK best(k);
+
+	if( mNumLists == 0 )
+	{
+		for( uint32_t n=0; n < mCount; n++ )
+			best.insert(n, dotFloat(mVectors + n * mDims, query, mDims));
+
+		return best.output(ids, scores);
+	}
+
+	// select the closest lists
+	nprobe = std::max(1u, std::min(nprobe, mNumLists));
+
+	std::vector< std::pair<float, uint32_t> > lists(mNumLists);
+
+	for( uint32_t c=0; c < mNumLists; c++ )
+		lists[c] = std::make_pair(-dotFloat(mCentroids + c * mDims, query, mDims), c);
+
+	std::partial_sort(lists.begin(), lists.begin() + nprobe, lists.end());
+
+	// score their vectors against the quantized query
+	std::vector<int8_t> codes(mStride);
+	const float queryScale = quantize(query, mDims, mStride, codes.data());
+
+	for( uint32_t p=0; p < nprobe; p++ )
+	{
+		const uint32_t list = lists[p].second;
+
+		for( uint32_t n=mListOffsets[list]; n < mListOffsets[list+1]; n++ )
+			best.insert(mIDs[n], dotInt8(codes.data(), mCodes + uint64_t(n) * mStride, mStride) * queryScale * mScales[n]);
+	}
+
+	return best.output(ids, scores);
+}
+
+
+// uploadGPU
+bool featureIndex::uploadGPU()
+{
+	if( mVectorsGPUCount == mCount )
+		return true;
+
+	if( mVectorsGPU != NULL )
+	{
+		CUDA(cudaFree(mVectorsGPU));
+		mVectorsGPU      = NULL;
+		mVectorsGPUCount = 0;
+	}
+
+	const size_t size = size_t(mCount) * mDims * sizeof(float);
+
+	if( CUDA_FAILED(cudaMalloc((void**)&mVectorsGPU, size)) )
+		return false;
+
+	if( CUDA_FAILED(cudaMemcpy(mVectorsGPU, mVectors, size, cudaMemcpyHostToDevice)) )
+		return false;
+
+	mVectorsGPUCount = mCount;
+
+	// the scores are read back by the CPU for the top-k selection
+	if( mScoresCount < mCount )
+	{
+		if( mScores[0] != NULL )
+			CUDA(cudaFreeHost(mScores[0]));
+
+		mScores[0]   = NULL;
+		mScores[1]   = NULL;
+		mScoresCount = 0;
+
+		if( !cudaAllocMapped((void**)&mScores[0], (void**)&mScores[1], mCount * sizeof(float)) )
+			return false;
+
+		mScoresCount = mCount;
+	}
+
+	return true;
+}
+
+
+// SearchGPU
+int featureIndex::SearchGPU( const float* query, uint32_t k, int* ids, float* scores )
+{
+	if( !query || !ids || k == 0 || k > FEATURE_INDEX_MAX_K )
+		return -1;
+
+	if( mNumLists > 0 )
+	{
+		printf("featureIndex -- SearchGPU() only supports flat indices\n");
+		return -1;
+	}
+
+	if( mCount == 0 )
+		return 0;
+
+	if( !uploadGPU() )
+		return -1;
+
+	if( CUDA_FAILED(cudaFeatureDot(mVectorsGPU, mCount, mDims, query, mScores[1])) )
+		return -1;
+
+	if( CUDA_FAILED(cudaDeviceSynchronize()) )
+		return -1;
+
+	topK best(k);
+
+	for( uint32_t n=0; n < mCount; n++ )
+		best.insert(n, mScores[0][n]);
+
+	return best.output(ids, scores);
+}
+
+
+// write a section padded to the alignment
+static bool writeSection( FILE* file, featureIndexHeader* header, int section, const void* data, uint64_t size )
+{
+	const long pos = ftell(file);
+	const long pad = (FEATURE_INDEX_ALIGN - (pos % FEATURE_INDEX_ALIGN)) % FEATURE_INDEX_ALIGN;
+
+	for( long n=0; n < pad; n++ )
+		fputc(0, file);
+
+	header->offset[section] = pos + pad;
+	header->size[section]   = size;
+
+	return fwrite(data, 1, size, file) == size;
+}
+
+
+// Save
+bool featureIndex::Save( const char* path ) const
+{
+	if( !path )
+		return false;
+
+	if( !mBuilt )
+	{
+		printf("featureIndex -- Build() must be called before saving\n");
+		return false;
+	}
+
+	FILE* file = fopen(path, "wb");
+
+	if( !file )
+	{
+		printf("featureIndex -- failed to open '%s' for writing\n", path);
+		return false;
+	}
+
+	featureIndexHeader header;
+	memset(&header, 0, sizeof(header));
+
+	memcpy(header.magic, FEATURE_INDEX_MAGIC, sizeof(header.magic));
+
+	header.version  = FEATURE_INDEX_VERSION;
+	header.dims     = mDims;
+	header.stride   = mStride;
+	header.count    = mCount;
+	header.numLists = mNumLists;
+
+	// the header is written again once the section offsets are known
+	bool result = (fwrite(&header, 1, sizeof(header), file) == sizeof(header));
+
+	if( mNumLists == 0 )
+	{
+		result = result && writeSection(file, &header, SECTION_VECTORS, mVectors, uint64_t(mCount) * mDims * sizeof(float));
+	}
+	else
+	{
+		result = result && writeSection(file, &header, SECTION_CENTROIDS, mCentroids, uint64_t(mNumLists) * mDims * sizeof(float));
+		result = result && writeSection(file, &header, SECTION_LISTS, mListOffsets, (mNumLists + 1) * sizeof(uint32_t));
+		result = result && writeSection(file, &header, SECTION_IDS, mIDs, uint64_t(mCount) * sizeof(uint32_t));
+		result = result && writeSection(file, &header, SECTION_SCALES, mScales, uint64_t(mCount) * sizeof(float));
+		result = result && writeSection(file, &header, SECTION_CODES, mCodes, uint64_t(mCount) * mStride);
+	}
+
+	result = result && (fseek(file, 0, SEEK_SET) == 0);
+	result = result && (fwrite(&header, 1, sizeof(header), file) == sizeof(header));
+
+	if( fclose(file) != 0 )
+		result = false;
+
+	if( !result )
+		printf("featureIndex -- failed to write '%s'\n", path);
+	else
+		printf("featureIndex -- wrote %u vectors to '%s'\n", mCount, path);
+
+	return result;
+}
+
+
+// Load
+featureIndex* featureIndex::Load( const char* path )
+{
+	if( !path )
+		return NULL;
+
+	const int fd = open(path, O_RDONLY);
+
+	if( fd < 0 )
+	{
+		printf("featureIndex -- failed to open '%s'\n", path);
+		return NULL;
+	}
+
+	struct stat st;
+
+	if( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(featureIndexHeader) )
+	{
+		printf("featureIndex -- '%s' is too small to be an index\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if( map == MAP_FAILED )
+	{
+		printf("featureIndex -- failed to mmap '%s'\n", path);
+		return NULL;
+	}
+
+	const uint8_t* base = (const uint8_t*)map;
+	const featureIndexHeader* header = (const featureIndexHeader*)map;
+
+	// validate the header and that every section it lists is within the file
+	bool valid = (memcmp(header->magic, FEATURE_INDEX_MAGIC, sizeof(header->magic)) == 0) &&
+			   header->version == FEATURE_INDEX_VERSION && header->dims > 0 && 
+			   header->stride == ((header->dims + 15) & ~15);
+
+	const uint64_t expected[] = { uint64_t(header->count) * header->dims * sizeof(float),
+							uint64_t(header->numLists) * header->dims * sizeof(float),
+							(uint64_t(header->numLists) + 1) * sizeof(uint32_t),
+							uint64_t(header->count) * sizeof(uint32_t),
+							uint64_t(header->count) * sizeof(float),
+							uint64_t(header->count) * header->stride };
+
+	for( int n=0; valid && n < SECTION_COUNT; n++ )
+	{
+		const bool required = (header->numLists == 0) ? (n == SECTION_VECTORS) : (n != SECTION_VECTORS);
+
+		if( !required )
+			continue;
+
+		valid = header->size[n] == expected[n] && (header->offset[n] % FEATURE_INDEX_ALIGN) == 0 &&
+			   header->offset[n] >= sizeof(featureIndexHeader) && header->offset[n] + header->size[n] <= (uint64_t)st.st_size;
+	}
+
+	if( !valid )
+	{
+		printf("featureIndex -- '%s' is not a valid index file\n", path);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	featureIndex* idx = new featureIndex();
+
+	idx->mMap      = map;
+	idx->mMapSize  = st.st_size;
+	idx->mDims     = header->dims;
+	idx->mStride   = header->stride;
+	idx->mCount    = header->count;
+	idx->mNumLists = header->numLists;
+	idx->mBuilt    = true;
+
+	if( header->numLists == 0 )
+	{
+		idx->mVectors = (const float*)(base + header->offset[SECTION_VECTORS]);
+	}
+	else
+	{
+		idx->mCentroids   = (const float*)(base + header->offset[SECTION_CENTROIDS]);
+		idx->mListOffsets = (const uint32_t*)(base + header->offset[SECTION_LISTS]);
+		idx->mIDs         = (const uint32_t*)(base + header->offset[SECTION_IDS]);
+		idx->mScales      = (const float*)(base + header->offset[SECTION_SCALES]);
+		idx->mCodes       = (const int8_t*)(base + header->offset[SECTION_CODES]);
+
+		// the lists are searched straight from the file, so their offsets and IDs must stay within the entries
+		bool consistent = (idx->mListOffsets[0] == 0 && idx->mListOffsets[idx->mNumLists] == idx->mCount);
+
+		for( uint32_t n=0; consistent && n < idx->mNumLists; n++ )
+			consistent = (idx->mListOffsets[n] <= idx->mListOffsets[n+1]);
+
+		for( uint32_t n=0; consistent && n < idx->mCount; n++ )
+			consistent = (idx->mIDs[n] < idx->mCount);
+
+		if( !consistent )
+		{
+			printf("featureIndex -- '%s' has inconsistent list offsets or IDs\n", path);
+			delete idx;
+			return NULL;
+		}
+	}
+
+	printf("featureIndex -- loaded '%s' (%u vectors, %u dims, %u lists)\n", path, idx->mCount, idx->mDims, idx->mNumLists);
+	return idx;
+}
+
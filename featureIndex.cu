@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "cudaUtility.h"
+
+
+
+// gpuFeatureDot
+__global__ void gpuFeatureDot( const float* vectors, int count, int dims, const float* query, float* scores )
+{
+	extern __shared__ float s_query[];
+
+	for( int i=threadIdx.x; i < dims; i += blockDim.x )
+		s_query[i] = query[i];
+
+	__syncthreads();
+
+	// one warp per vector, so that its loads are coalesced
+	const int lane = threadIdx.x % warpSize;
+	const int n    = blockIdx.x * (blockDim.x / warpSize) + threadIdx.x / warpSize;
+
+	if( n >= count )
+		return;
+
+	const float* vec = vectors + (size_t)n * dims;
+	float sum = 0.0f;
+
+	for( int i=lane; i < dims; i += warpSize )
+		sum += vec[i] * s_query[i];
+
+	for( int offset=16; offset > 0; offset >>= 1 )
+		sum += WARP_SHFL_DOWN(sum, offset);
+
+	if( lane == 0 )
+		scores[n] = sum;
+}
+
+
+// cudaFeatureDot
+cudaError_t cudaFeatureDot( const float* vectors, size_t count, size_t dims, const float* query, float* scores )
+{
+	if( !vectors || !query || !scores )
+		return cudaErrorInvalidDevicePointer;
+
+	if( count == 0 || dims == 0 || dims * sizeof(float) > 48 * 1024 )
+		return cudaErrorInvalidValue;
+
+	// launch kernel, with 8 warps per block
+	const dim3 blockDim(256);
+	const dim3 gridDim(iDivUp(count, blockDim.x / 32));
+
+	gpuFeatureDot<<<gridDim, blockDim, dims * sizeof(float)>>>(vectors, count, dims, query, scores);
+
+	return CUDA(cudaGetLastError());
+}
+
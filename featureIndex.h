@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __FEATURE_INDEX_H__
+#define __FEATURE_INDEX_H__
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+/**
+ * Maximum number of nearest neighbours returned by featureIndex::Search()
+ * @ingroup deepVision
+ */
+#define FEATURE_INDEX_MAX_K 64
+
+
+/**
+ * Nearest-neighbour index of L2-normalized feature vectors (i.e. the embeddings
+ * extracted by imageNet::GetEmbedding()), searched by cosine similarity.
+ *
+ * Two layouts are supported:
+ *
+ *   - INDEX_FLAT stores the vectors as floats and compares every one of them
+ *     against the query, either on the CPU with SSE2/NEON or on the GPU.
+ *     This is exact and suits galleries of up to a few thousand vectors.
+ *
+ *   - INDEX_IVF clusters the gallery into lists with spherical k-means, and
+ *     stores each vector as int8 codes with a per-vector scale.  A query is only
+ *     compared against the vectors of the nprobe closest lists, which keeps the
+ *     lookups of large galleries (100k vectors) well under a millisecond.
+ *
+ * Indices are saved to a single file whose sections are 64-byte aligned, so
+ * that Load() can mmap() it and search it in-place without copying.
+ *
+ * @ingroup deepVision
+ */
+class featureIndex
+{
+public:
+	/**
+	 * Index layouts.
+	 */
+	enum IndexType
+	{
+		INDEX_FLAT = 0,	/**< brute-force float vectors */
+		INDEX_IVF		/**< inverted lists of int8 quantized vectors */
+	};
+
+	/**
+	 * Create an empty index.
+	 * @param dims number of dimensions of each vector.
+	 * @param numLists number of IVF lists, or 0 to create a flat index.
+	 */
+	static featureIndex* Create( uint32_t dims, uint32_t numLists=0 );
+
+	/**
+	 * Load an index previously written by Save().
+	 * The file is memory-mapped read-only, so the index can't be extended with Add().
+	 */
+	static featureIndex* Load( const char* path );
+
+	/**
+	 * Destroy
+	 */
+	~featureIndex();
+
+	/**
+	 * Add L2-normalized vectors to the index.  Their IDs are assigned sequentially,
+	 * starting from GetCount().  IVF indices need to be built again afterwards.
+	 * @param vectors array of count * GetDims() floats in CPU memory.
+	 * @returns the ID of the first vector that was added, or -1 on error.
+	 */
+	int Add( const float* vectors, uint32_t count=1 );
+
+	/**
+	 * Train the IVF centroids on the vectors added so far and quantize the lists.
+	 * Flat indices don't need to be built, and return true.
+	 * @param iterations number of k-means iterations.
+	 */
+	bool Build( uint32_t iterations=10 );
+
+	/**
+	 * Write the index to disk.
+	 */
+	bool Save( const char* path ) const;
+
+	/**
+	 * Find the k nearest neighbours of an L2-normalized query vector on the CPU.
+	 * @param query array of GetDims() floats in CPU memory.
+	 * @param k the number of neighbours to return (at most FEATURE_INDEX_MAX_K)
+	 * @param ids output array of k IDs, ordered from the most to the least similar.
+	 * @param scores optional output array of k cosine similarities.
+	 * @param nprobe the number of IVF lists to search (ignored by flat indices).
+	 * @returns the number of neighbours found, or -1 on error.
+	 */
+	int Search( const float* query, uint32_t k, int* ids, float* scores=NULL, uint32_t nprobe=8 );
+
+	/**
+	 * Find the k nearest neighbours of a query vector with the GPU.
+	 * Only flat indices are supported, whose vectors get copied to the GPU on first use.
+	 * @param query array of GetDims() floats in CUDA device memory (i.e. imageNet::GetEmbeddingCUDA())
+	 * @see Search()
+	 */
+	int SearchGPU( const float* query, uint32_t k, int* ids, float* scores=NULL );
+
+	/**
+	 * Retrieve the layout of the index.
+	 */
+	inline IndexType GetType() const			{ return mNumLists > 0 ? INDEX_IVF : INDEX_FLAT; }
+
+	/**
+	 * Retrieve the number of dimensions of each vector.
+	 */
+	inline uint32_t GetDims() const			{ return mDims; }
+
+	/**
+	 * Retrieve the number of vectors in the index.
+	 */
+	inline uint32_t GetCount() const			{ return mCount; }
+
+	/**
+	 * Retrieve the number of IVF lists (0 for flat indices)
+	 */
+	inline uint32_t GetNumLists() const		{ return mNumLists; }
+
+	/**
+	 * Query if the IVF lists are up-to-date with the vectors that were added.
+	 */
+	inline bool IsBuilt() const				{ return mBuilt; }
+
+protected:
+	featureIndex();
+
+	bool searchFlat( const float* query, uint32_t k, int* ids, float* scores );
+	bool searchIVF( const float* query, uint32_t k, int* ids, float* scores, uint32_t nprobe );
+	bool uploadGPU();
+
+	uint32_t mDims;
+	uint32_t mStride;		/**< dims of the int8 codes, padded to a multiple of 16 */
+	uint32_t mCount;
+	uint32_t mNumLists;
+	bool     mBuilt;
+
+	// sections, pointing either into the owned storage or the mapped file
+	const float*    mVectors;		/**< flat:  count * dims floats */
+	const float*    mCentroids;		/**< IVF:   numLists * dims floats */
+	const uint32_t* mListOffsets;	/**< IVF:   numLists + 1 offsets into the lists */
+	const uint32_t* mIDs;			/**< IVF:   count IDs, ordered by list */
+	const float*    mScales;		/**< IVF:   count dequantization scales */
+	const int8_t*   mCodes;		/**< IVF:   count * stride codes */
+
+	std::vector<float>    mData;	/**< vectors added with Add() */
+	std::vector<float>    mCentroidData;
+	std::vector<uint32_t> mListData;
+	std::vector<uint32_t> mIDData;
+	std::vector<float>    mScaleData;
+	std::vector<int8_t>   mCodeData;
+
+	void*  mMap;
+	size_t mMapSize;
+
+	float*   mVectorsGPU;
+	uint32_t mVectorsGPUCount;
+	float*   mScores[2];
+	uint32_t mScoresCount;
+};
+
+
+#endif
@@ -24,6 +24,7 @@
 #include "cudaMappedMemory.h"
 #include "cudaResize.h"
 #include "commandLine.h"
+#include "trace.h"
 
 
 // constructor
@@ -31,6 +32,16 @@ imageNet::imageNet() : tensorNet()
 {
 	mCustomClasses = 0;
 	mOutputClasses = 0;
+
+	mTopClasses[0] = NULL;
+	mTopClasses[1] = NULL;
+
+	mTopConfidence[0] = NULL;
+	mTopConfidence[1] = NULL;
+
+	mEmbeddingSize = 0;
+	mEmbedding[0]  = NULL;
+	mEmbedding[1]  = NULL;
 }
 
 
@@ -42,14 +53,14 @@ imageNet::~imageNet()
 
 
 // Create
-imageNet* imageNet::Create( imageNet::NetworkType networkType, uint32_t maxBatchSize )
+imageNet* imageNet::Create( imageNet::NetworkType networkType, uint32_t maxBatchSize, const char* embedding )
 {
 	imageNet* net = new imageNet();
 	
 	if( !net )
 		return NULL;
 	
-	if( !net->init(networkType, maxBatchSize) )
+	if( !net->init(networkType, maxBatchSize, embedding) )
 	{
 		printf("imageNet -- failed to initialize.\n");
 		return NULL;
@@ -61,14 +72,14 @@ imageNet* imageNet::Create( imageNet::NetworkType networkType, uint32_t maxBatch
 
 // Create
 imageNet* imageNet::Create( const char* prototxt_path, const char* model_path, const char* mean_binary,
-							const char* class_path, const char* input, const char* output, uint32_t maxBatchSize )
+							const char* class_path, const char* input, const char* output, uint32_t maxBatchSize, const char* embedding )
 {
 	imageNet* net = new imageNet();
 	
 	if( !net )
 		return NULL;
 	
-	if( !net->init(prototxt_path, model_path, mean_binary, class_path, input, output, maxBatchSize) )
+	if( !net->init(prototxt_path, model_path, mean_binary, class_path, input, output, maxBatchSize, embedding) )
 	{
 		printf("imageNet -- failed to initialize.\n");
 		return NULL;
@@ -79,7 +90,7 @@ imageNet* imageNet::Create( const char* prototxt_path, const char* model_path, c
 
 
 // init
-bool imageNet::init( imageNet::NetworkType networkType, uint32_t maxBatchSize )
+bool imageNet::init( imageNet::NetworkType networkType, uint32_t maxBatchSize, const char* embedding )
 {
 	/*const char* proto_file[] = { "networks/alexnet.prototxt", "networks/googlenet.prototxt" };
 	const char* model_file[] = { "networks/bvlc_alexnet.caffemodel", "networks/bvlc_googlenet.caffemodel" };
@@ -106,16 +117,16 @@ bool imageNet::init( imageNet::NetworkType networkType, uint32_t maxBatchSize )
 	return true;*/
 
 	if( networkType == imageNet::ALEXNET )
-		return init( "networks/alexnet.prototxt", "networks/bvlc_alexnet.caffemodel", NULL, "networks/ilsvrc12_synset_words.txt", IMAGENET_DEFAULT_INPUT, IMAGENET_DEFAULT_OUTPUT, maxBatchSize );
+		return init( "networks/alexnet.prototxt", "networks/bvlc_alexnet.caffemodel", NULL, "networks/ilsvrc12_synset_words.txt", IMAGENET_DEFAULT_INPUT, IMAGENET_DEFAULT_OUTPUT, maxBatchSize, embedding );
 	else if( networkType == imageNet::GOOGLENET )
-		return init( "networks/googlenet.prototxt", "networks/bvlc_googlenet.caffemodel", NULL, "networks/ilsvrc12_synset_words.txt", IMAGENET_DEFAULT_INPUT, IMAGENET_DEFAULT_OUTPUT, maxBatchSize );
+		return init( "networks/googlenet.prototxt", "networks/bvlc_googlenet.caffemodel", NULL, "networks/ilsvrc12_synset_words.txt", IMAGENET_DEFAULT_INPUT, IMAGENET_DEFAULT_OUTPUT, maxBatchSize, embedding );
 	else if( networkType == imageNet::GOOGLENET_12 )
-		return init( "networks/GoogleNet-ILSVRC12-subset/deploy.prototxt", "networks/GoogleNet-ILSVRC12-subset/snapshot_iter_184080.caffemodel", NULL, "networks/GoogleNet-ILSVRC12-subset/labels.txt", IMAGENET_DEFAULT_INPUT, "softmax", maxBatchSize );
+		return init( "networks/GoogleNet-ILSVRC12-subset/deploy.prototxt", "networks/GoogleNet-ILSVRC12-subset/snapshot_iter_184080.caffemodel", NULL, "networks/GoogleNet-ILSVRC12-subset/labels.txt", IMAGENET_DEFAULT_INPUT, "softmax", maxBatchSize, embedding );
 }
 
 
 // init
-bool imageNet::init(const char* prototxt_path, const char* model_path, const char* mean_binary, const char* class_path, const char* input, const char* output, uint32_t maxBatchSize )
+bool imageNet::init(const char* prototxt_path, const char* model_path, const char* mean_binary, const char* class_path, const char* input, const char* output, uint32_t maxBatchSize, const char* embedding )
 {
 	if( !prototxt_path || !model_path || !class_path || !input || !output )
 		return false;
@@ -127,12 +138,22 @@ bool imageNet::init(const char* prototxt_path, const char* model_path, const cha
 	printf("         -- class_labels %s\n", class_path);
 	printf("         -- input_blob   '%s'\n", input);
 	printf("         -- output_blob  '%s'\n", output);
+
+	if( embedding != NULL )
+		printf("         -- embedding    '%s'\n", embedding);
+
 	printf("         -- batch_size   %u\n\n", maxBatchSize);
 
 	/*
 	 * load and parse googlenet network definition and model file
 	 */
-	if( !tensorNet::LoadNetwork( prototxt_path, model_path, mean_binary, input, output, maxBatchSize ) )
+	std::vector<std::string> output_blobs;
+	output_blobs.push_back(output);
+
+	if( embedding != NULL )
+		output_blobs.push_back(embedding);
+
+	if( !tensorNet::LoadNetwork( prototxt_path, model_path, mean_binary, input, output_blobs, maxBatchSize ) )
 	{
 		printf("failed to load %s\n", model_path);
 		return false;
@@ -150,6 +171,26 @@ bool imageNet::init(const char* prototxt_path, const char* model_path, const cha
 		printf("imageNet -- failed to load synset class descriptions  (%zu / %zu of %u)\n", mClassSynset.size(), mClassDesc.size(), mOutputClasses);
 		return false;
 	}
+
+	/*
+	 * allocate top-K results
+	 */
+	if( !cudaAllocMapped((void**)&mTopClasses[0], (void**)&mTopClasses[1], mMaxBatchSize * IMAGENET_MAX_TOPK * sizeof(int)) ||
+	    !cudaAllocMapped((void**)&mTopConfidence[0], (void**)&mTopConfidence[1], mMaxBatchSize * IMAGENET_MAX_TOPK * sizeof(float)) )
+		return false;
+
+	/*
+	 * allocate normalized embeddings
+	 */
+	if( embedding != NULL )
+	{
+		mEmbeddingSize = DIMS_C(mOutputs[1].dims) * DIMS_H(mOutputs[1].dims) * DIMS_W(mOutputs[1].dims);
+
+		if( !cudaAllocMapped((void**)&mEmbedding[0], (void**)&mEmbedding[1], mMaxBatchSize * mEmbeddingSize * sizeof(float)) )
+			return false;
+
+		printf("imageNet -- embedding '%s' has %u dimensions\n", embedding, mEmbeddingSize);
+	}
 	
 	printf("%s initialized.\n", model_path);
 	return true;
@@ -166,9 +207,10 @@ imageNet* imageNet::Create( int argc, char** argv )
 
 	if( !modelName )
 	{
-		if( argc == 2 )
+		// positional model name, unless the arguments are all options (i.e. --images=<dir>)
+		if( argc == 2 && argv[1][0] != '-' )
 			modelName = argv[1];
-		else if( argc == 4 )
+		else if( argc == 4 && argv[3][0] != '-' )
 			modelName = argv[3];
 		else
 			modelName = "googlenet";
@@ -177,6 +219,14 @@ imageNet* imageNet::Create( int argc, char** argv )
 	//if( argc > 3 )
 	//	modelName = argv[3];	
 
+	// optional layer to extract as an embedding (i.e. --embedding=pool5/7x7_s1)
+	const char* embedding = cmdLine.GetString("embedding");
+
+	int maxBatchSize = cmdLine.GetInt("batch_size");
+	
+	if( maxBatchSize < 1 )
+		maxBatchSize = 2;
+
 	imageNet::NetworkType type = imageNet::GOOGLENET;
 
 	if( strcasecmp(modelName, "alexnet") == 0 )
@@ -201,17 +251,12 @@ imageNet* imageNet::Create( int argc, char** argv )
 		
 		if( !input ) 	input    = IMAGENET_DEFAULT_INPUT;
 		if( !output )  output   = IMAGENET_DEFAULT_OUTPUT;
-		
-		int maxBatchSize = cmdLine.GetInt("batch_size");
-		
-		if( maxBatchSize < 1 )
-			maxBatchSize = 2;
 
-		return imageNet::Create(prototxt, modelName, NULL, labels, input, output, maxBatchSize);
+		return imageNet::Create(prototxt, modelName, NULL, labels, input, output, maxBatchSize, embedding);
 	}
 
 	// create from pretrained model
-	return imageNet::Create(type);
+	return imageNet::Create(type, maxBatchSize, embedding);
 }
 				 
 
@@ -279,58 +324,94 @@ bool imageNet::loadClassInfo( const char* filename )
 
 // from imageNet.cu
 cudaError_t cudaPreImageNetMean( float4* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight, const float3& mean_value );
+cudaError_t cudaTopK( float* prob, size_t numImages, size_t numClasses, size_t k, int* classes, float* confidence );
+cudaError_t cudaL2Normalize( float* input, float* output, size_t numVectors, size_t dims );
 					
 					
 // Classify
 int imageNet::Classify( float* rgba, uint32_t width, uint32_t height, float* confidence )
 {
-	if( !rgba || width == 0 || height == 0 )
-	{
-		printf("imageNet::Classify( 0x%p, %u, %u ) -> invalid parameters\n", rgba, width, height);
+	int classIndex = -1;
+
+	if( !ClassifyTopK(rgba, width, height, 1, &classIndex, confidence) )
 		return -1;
+
+	return classIndex;
+}
+
+
+// ClassifyTopK
+bool imageNet::ClassifyTopK( float* rgba, uint32_t width, uint32_t height, uint32_t k, int* classes, float* confidence )
+{
+	return ClassifyTopK(&rgba, 1, width, height, k, classes, confidence);
+}
+
+
+// ClassifyTopK
+bool imageNet::ClassifyTopK( float** images, uint32_t numImages, uint32_t width, uint32_t height, uint32_t k, int* classes, float* confidence )
+{
+	if( !images || numImages == 0 || numImages > mMaxBatchSize || width == 0 || height == 0 || 
+	    k == 0 || k > IMAGENET_MAX_TOPK || k > mOutputClasses || !classes )
+	{
+		printf("imageNet::ClassifyTopK( 0x%p, %u, %u, %u, %u ) -> invalid parameters\n", images, numImages, width, height, k);
+		return false;
 	}
 
 	
 	// downsample and convert to band-sequential BGR
-	if( CUDA_FAILED(cudaPreImageNetMean((float4*)rgba, width, height, mInputCUDA, mWidth, mHeight,
-								 make_float3(104.0069879317889f, 116.66876761696767f, 122.6789143406786f))) )
+	const size_t inputStride = DIMS_C(mInputDims) * mWidth * mHeight;
+
+	for( uint32_t n=0; n < numImages; n++ )
 	{
-		printf("imageNet::Classify() -- cudaPreImageNetMean failed\n");
-		return -1;
+		if( !images[n] )
+			return false;
+
+		if( CUDA_FAILED(cudaPreImageNetMean((float4*)images[n], width, height, mInputCUDA + n * inputStride, mWidth, mHeight,
+									 make_float3(104.0069879317889f, 116.66876761696767f, 122.6789143406786f))) )
+		{
+			printf("imageNet::ClassifyTopK() -- cudaPreImageNetMean failed\n");
+			return false;
+		}
 	}
 	
 	
 	// process with GIE
-	void* inferenceBuffers[] = { mInputCUDA, mOutputs[0].CUDA };
+	void* inferenceBuffers[] = { mInputCUDA, mOutputs[0].CUDA, HasEmbedding() ? mOutputs[1].CUDA : NULL };
 	
-	mContext->execute(1, inferenceBuffers);
+	if( !execute(numImages, inferenceBuffers) )
+	{
+		printf(LOG_GIE "imageNet::ClassifyTopK() -- failed to execute tensorRT context\n");
+		return false;
+	}
 	
-	//CUDA(cudaDeviceSynchronize());
 	PROFILER_REPORT();
-	
-	
-	// determine the maximum class
-	int classIndex = -1;
-	float classMax = -1.0f;
-	
-	for( size_t n=0; n < mOutputClasses; n++ )
+	TRACE_ZONE("postprocess");
+
+	// normalize the embeddings
+	if( HasEmbedding() )
 	{
-		const float value = mOutputs[0].CPU[n];
-		
-		if( value >= 0.01f )
-			printf("class %04zu - %f  (%s)\n", n, value, mClassDesc[n].c_str());
-	
-		if( value > classMax )
+		if( CUDA_FAILED(cudaL2Normalize(mOutputs[1].CUDA, mEmbedding[1], numImages, mEmbeddingSize)) )
 		{
-			classIndex = n;
-			classMax   = value;
+			printf("imageNet::ClassifyTopK() -- cudaL2Normalize failed\n");
+			return false;
 		}
 	}
 	
-	if( confidence != NULL )
-		*confidence = classMax;
 	
-	//printf("\nmaximum class:  #%i  (%f) (%s)\n", classIndex, classMax, mClassDesc[classIndex].c_str());
-	return classIndex;
-}
+	// determine the maximum classes
+	if( CUDA_FAILED(cudaTopK(mOutputs[0].CUDA, numImages, mOutputClasses, k, mTopClasses[1], mTopConfidence[1])) )
+	{
+		printf("imageNet::ClassifyTopK() -- cudaTopK failed\n");
+		return false;
+	}
+
+	if( CUDA_FAILED(cudaStreamSynchronize(0)) )
+		return false;
+
+	memcpy(classes, mTopClasses[0], numImages * k * sizeof(int));
 
+	if( confidence != NULL )
+		memcpy(confidence, mTopConfidence[0], numImages * k * sizeof(float));
+
+	return true;
+}
@@ -21,6 +21,7 @@
  */
  
 #include "cudaUtility.h"
+#include "imageNet.h"
 
 
 
@@ -116,3 +117,238 @@ cudaError_t cudaPreImageNetMean( float4* input, size_t inputWidth, size_t inputH
 }
 
 
+
+
+#define PRE_IMAGENET_MAX_LEVELS 16
+
+struct preImageNetLevels
+{
+	int2 size[PRE_IMAGENET_MAX_LEVELS];
+};
+
+
+// gpuPreImageNetPyramid
+__global__ void gpuPreImageNetPyramid( preImageNetLevels levels, float4* input, int iWidth, int iHeight, float* output, int oWidth, int oHeight, float3 mean_value )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+	const int z = blockIdx.z;
+	const int n = oWidth * oHeight;
+	
+	if( x >= oWidth || y >= oHeight )
+		return;
+
+	// each level is stored in its own batch slot, with the image in the top-left corner
+	float* slot = output + z * n * 3;
+	const int2 size = levels.size[z];
+	
+	if( x >= size.x || y >= size.y )
+	{
+		slot[n * 0 + y * oWidth + x] = 0.0f;
+		slot[n * 1 + y * oWidth + x] = 0.0f;
+		slot[n * 2 + y * oWidth + x] = 0.0f;
+		return;
+	}
+
+	const int dx = ((float)x * (float(iWidth) / float(size.x)));
+	const int dy = ((float)y * (float(iHeight) / float(size.y)));
+
+	const float4 px  = input[ dy * iWidth + dx ];
+	const float3 bgr = make_float3(px.z - mean_value.x, px.y - mean_value.y, px.x - mean_value.z);
+	
+	slot[n * 0 + y * oWidth + x] = bgr.x;
+	slot[n * 1 + y * oWidth + x] = bgr.y;
+	slot[n * 2 + y * oWidth + x] = bgr.z;
+}
+
+
+// cudaPreImageNetPyramid
+cudaError_t cudaPreImageNetPyramid( float4* input, size_t inputWidth, size_t inputHeight,
+				                float* output, size_t outputWidth, size_t outputHeight,
+				                const int2* levelSize, uint32_t numLevels, const float3& mean_value )
+{
+	if( !input || !output )
+		return cudaErrorInvalidDevicePointer;
+
+	if( inputWidth == 0 || outputWidth == 0 || inputHeight == 0 || outputHeight == 0 )
+		return cudaErrorInvalidValue;
+
+	if( !levelSize || numLevels == 0 || numLevels > PRE_IMAGENET_MAX_LEVELS )
+		return cudaErrorInvalidValue;
+
+	preImageNetLevels levels;
+
+	for( uint32_t n=0; n < numLevels; n++ )
+	{
+		if( levelSize[n].x <= 0 || levelSize[n].y <= 0 || (size_t)levelSize[n].x > outputWidth || (size_t)levelSize[n].y > outputHeight )
+			return cudaErrorInvalidValue;
+
+		levels.size[n] = levelSize[n];
+	}
+
+	// launch kernel, with one grid layer per pyramid level
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(outputWidth,blockDim.x), iDivUp(outputHeight,blockDim.y), numLevels);
+
+	gpuPreImageNetPyramid<<<gridDim, blockDim>>>(levels, input, inputWidth, inputHeight, output, outputWidth, outputHeight, mean_value);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuTopK
+__global__ void gpuTopK( float* prob, int numClasses, int k, int* classes, float* confidence )
+{
+	const int lane  = threadIdx.x;
+	const int image = blockIdx.x;
+
+	prob += image * numClasses;
+
+	// each lane keeps a sorted list of the top-k classes from its strided subset
+	float v[IMAGENET_MAX_TOPK];
+	int   c[IMAGENET_MAX_TOPK];
+
+	for( int n=0; n < k; n++ )
+	{
+		v[n] = -1e30f;
+		c[n] = -1;
+	}
+
+	for( int i=lane; i < numClasses; i += warpSize )
+	{
+		const float p = prob[i];
+
+		if( p <= v[k-1] )
+			continue;
+
+		int n = k - 1;
+
+		for( ; n > 0 && p > v[n-1]; n-- )
+		{
+			v[n] = v[n-1];
+			c[n] = c[n-1];
+		}
+
+		v[n] = p;
+		c[n] = i;
+	}
+
+	// merge the lists, taking the head of the winning lane each round
+	int head = 0;
+
+	for( int r=0; r < k; r++ )
+	{
+		float best_v = (head < k) ? v[head] : -1e30f;
+		int   best_c = (head < k) ? c[head] : -1;
+		int   best_l = lane;
+
+		for( int offset=16; offset > 0; offset >>= 1 )
+		{
+			const float other_v = WARP_SHFL_DOWN(best_v, offset);
+			const int   other_c = WARP_SHFL_DOWN(best_c, offset);
+			const int   other_l = WARP_SHFL_DOWN(best_l, offset);
+
+			if( other_v > best_v || (other_v == best_v && other_c >= 0 && (best_c < 0 || other_c < best_c)) )
+			{
+				best_v = other_v;
+				best_c = other_c;
+				best_l = other_l;
+			}
+		}
+
+		best_l = WARP_SHFL(best_l, 0);
+
+		if( lane == best_l )
+			head++;
+
+		if( lane == 0 )
+		{
+			classes[image * k + r]    = best_c;
+			confidence[image * k + r] = best_v;
+		}
+	}
+}
+
+
+// cudaTopK
+cudaError_t cudaTopK( float* prob, size_t numImages, size_t numClasses, size_t k, int* classes, float* confidence )
+{
+	if( !prob || !classes || !confidence )
+		return cudaErrorInvalidDevicePointer;
+
+	if( numImages == 0 || numClasses == 0 || k == 0 || k > IMAGENET_MAX_TOPK )
+		return cudaErrorInvalidValue;
+
+	// launch kernel, with one warp per image
+	const dim3 blockDim(32);
+	const dim3 gridDim(numImages);
+
+	gpuTopK<<<gridDim, blockDim>>>(prob, numClasses, k, classes, confidence);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuL2Normalize
+__global__ void gpuL2Normalize( float* input, float* output, int dims )
+{
+	__shared__ float s_sum[32];
+
+	input  += blockIdx.x * dims;
+	output += blockIdx.x * dims;
+
+	// sum of squares, reduced within each warp and then across warps
+	float sum = 0.0f;
+
+	for( int i=threadIdx.x; i < dims; i += blockDim.x )
+		sum += input[i] * input[i];
+
+	for( int offset=16; offset > 0; offset >>= 1 )
+		sum += WARP_SHFL_DOWN(sum, offset);
+
+	const int warp = threadIdx.x / warpSize;
+	const int lane = threadIdx.x % warpSize;
+
+	if( lane == 0 )
+		s_sum[warp] = sum;
+
+	__syncthreads();
+
+	if( warp == 0 )
+	{
+		sum = (lane < blockDim.x / warpSize) ? s_sum[lane] : 0.0f;
+
+		for( int offset=16; offset > 0; offset >>= 1 )
+			sum += WARP_SHFL_DOWN(sum, offset);
+
+		if( lane == 0 )
+			s_sum[0] = (sum > 0.0f) ? rsqrtf(sum) : 0.0f;
+	}
+
+	__syncthreads();
+
+	const float scale = s_sum[0];
+
+	for( int i=threadIdx.x; i < dims; i += blockDim.x )
+		output[i] = input[i] * scale;
+}
+
+
+// cudaL2Normalize
+cudaError_t cudaL2Normalize( float* input, float* output, size_t numVectors, size_t dims )
+{
+	if( !input || !output )
+		return cudaErrorInvalidDevicePointer;
+
+	if( numVectors == 0 || dims == 0 )
+		return cudaErrorInvalidValue;
+
+	// launch kernel, with one block per vector
+	const dim3 blockDim(256);
+	const dim3 gridDim(numVectors);
+
+	gpuL2Normalize<<<gridDim, blockDim>>>(input, output, dims);
+
+	return CUDA(cudaGetLastError());
+}
+
@@ -39,6 +39,12 @@
  */
 #define IMAGENET_DEFAULT_OUTPUT  "prob"
 
+/**
+ * Maximum number of results per image returned by imageNet::ClassifyTopK()
+ * @ingroup deepVision
+ */
+#define IMAGENET_MAX_TOPK  8
+
 
 /**
  * Image recognition with GoogleNet/Alexnet or custom models, using TensorRT.
@@ -59,8 +65,11 @@ public:
 
 	/**
 	 * Load a new network instance
+	 * @param networkType type of pre-supported network to load
+	 * @param maxBatchSize The maximum batch size that the network will support and be optimized for.
+	 * @param embedding Optional name of an extra layer blob to extract as an embedding (i.e. "pool5/7x7_s1").
 	 */
-	static imageNet* Create( NetworkType networkType=GOOGLENET, uint32_t maxBatchSize=2 );
+	static imageNet* Create( NetworkType networkType=GOOGLENET, uint32_t maxBatchSize=2, const char* embedding=NULL );
 	
 	/**
 	 * Load a new network instance
@@ -70,12 +79,13 @@ public:
 	 * @param class_info File path to list of class name labels
 	 * @param input Name of the input layer blob.
 	 * @param maxBatchSize The maximum batch size that the network will support and be optimized for.
+	 * @param embedding Optional name of an extra layer blob to extract as an embedding (i.e. "pool5/7x7_s1").
 	 */
 	static imageNet* Create( const char* prototxt_path, const char* model_path, 
 						const char* mean_binary, const char* class_labels, 
 						const char* input=IMAGENET_DEFAULT_INPUT, 
 						const char* output=IMAGENET_DEFAULT_OUTPUT, 
-						uint32_t maxBatchSize=2 );
+						uint32_t maxBatchSize=2, const char* embedding=NULL );
 	
 	/**
 	 * Load a new network instance by parsing the command line.
@@ -97,6 +107,50 @@ public:
 	 */
 	int Classify( float* rgba, uint32_t width, uint32_t height, float* confidence=NULL );
 
+	/**
+	 * Determine the K most likely classes of a batch of images.
+	 * The images are packed into one batch, and the top-K reduction runs on the GPU,
+	 * so only the K results per image are transferred back.
+	 * @param images array of float4 input images in CUDA device memory, each the same size.
+	 * @param numImages number of images in the batch, up to the maximum batch size of the network.
+	 * @param width width of the input images in pixels.
+	 * @param height height of the input images in pixels.
+	 * @param k number of results per image, up to IMAGENET_MAX_TOPK.
+	 * @param classes output array of numImages * k class indices, sorted by descending confidence.
+	 * @param confidence optional output array of numImages * k confidence values.
+	 * @returns true on success, false on error.
+	 */
+	bool ClassifyTopK( float** images, uint32_t numImages, uint32_t width, uint32_t height, uint32_t k, int* classes, float* confidence=NULL );
+
+	/**
+	 * Determine the K most likely classes of a single image.
+	 * @see ClassifyTopK() above for a description of the parameters.
+	 */
+	bool ClassifyTopK( float* rgba, uint32_t width, uint32_t height, uint32_t k, int* classes, float* confidence=NULL );
+
+	/**
+	 * Query if the network was created with an embedding layer.
+	 */
+	inline bool HasEmbedding() const							{ return mEmbeddingSize > 0; }
+
+	/**
+	 * Retrieve the number of dimensions of the embedding (i.e. 1024 for GoogleNet pool5).
+	 */
+	inline uint32_t GetEmbeddingSize() const					{ return mEmbeddingSize; }
+
+	/**
+	 * Retrieve the L2-normalized embedding of an image from the last call to Classify() or ClassifyTopK().
+	 * @param image index of the image within the batch.
+	 * @returns pointer to GetEmbeddingSize() floats in CPU memory, or NULL without an embedding layer.
+	 */
+	inline float* GetEmbedding( uint32_t image=0 ) const			{ return HasEmbedding() ? mEmbedding[0] + image * mEmbeddingSize : NULL; }
+
+	/**
+	 * Retrieve the L2-normalized embedding of an image, in CUDA device memory.
+	 * @see GetEmbedding()
+	 */
+	inline float* GetEmbeddingCUDA( uint32_t image=0 ) const		{ return HasEmbedding() ? mEmbedding[1] + image * mEmbeddingSize : NULL; }
+
 	/**
 	 * Retrieve the number of image recognition classes (typically 1000)
 	 */
@@ -125,12 +179,18 @@ public:
 protected:
 	imageNet();
 	
-	bool init( NetworkType networkType, uint32_t maxBatchSize );
-	bool init(const char* prototxt_path, const char* model_path, const char* mean_binary, const char* class_path, const char* input, const char* output, uint32_t maxBatchSize );
+	bool init( NetworkType networkType, uint32_t maxBatchSize, const char* embedding );
+	bool init(const char* prototxt_path, const char* model_path, const char* mean_binary, const char* class_path, const char* input, const char* output, uint32_t maxBatchSize, const char* embedding );
 	bool loadClassInfo( const char* filename );
 	
 	uint32_t mCustomClasses;
 	uint32_t mOutputClasses;
+
+	int*     mTopClasses[2];		/**< results of the top-K reduction in shared CPU/GPU memory */
+	float*   mTopConfidence[2];
+
+	uint32_t mEmbeddingSize;
+	float*   mEmbedding[2];		/**< normalized embeddings of the batch in shared CPU/GPU memory */
 	
 	std::vector<std::string> mClassSynset;	// 1000 class ID's (ie n01580077, n04325704)
 	std::vector<std::string> mClassDesc;
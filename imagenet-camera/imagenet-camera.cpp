@@ -21,12 +21,8 @@
  */
 
 #include "camera.h"
-#include "CameraNode.h"
-#include "gstCamera.h"
-#include "pylonCamera.h"
-
-#include "glDisplay.h"
-#include "glTexture.h"
+#include "pipeline.h"
+#include "trace.h"
 
 #include <stdio.h>
 #include <signal.h>
@@ -35,9 +31,14 @@
 #include "cudaNormalize.h"
 #include "cudaFont.h"
 #include "imageNet.h"
+#include "displaySink.h"
 
 
-#define DEFAULT_CAMERA -1	// -1 for onboard camera, or change to index of /dev/video V4L2 camera (>=0)
+#ifdef HAS_PYLON
+#define DEFAULT_CAMERA "pylon://22279978"	// Basler camera, or override with --camera=<uri> (e.g. gst://onboard)
+#else
+#define DEFAULT_CAMERA "gst://onboard"		// onboard camera, or override with --camera=<uri> (e.g. gst://0 or v4l2:///dev/video0)
+#endif
 
 
 
@@ -53,6 +54,66 @@ void sig_handler(int signo)
 }
 
 
+// classification of a frame, stored in the frame's results
+struct classifyResult
+{
+	int   classID;
+	float confidence;
+};
+
+
+// state of the classify and overlay stages
+struct classifyStage
+{
+	imageNet* net;
+	cudaFont* font;
+};
+
+
+// classify the frame
+static bool classify( pipelineFrame* frame, void* user_data )
+{
+	classifyStage*  stage  = (classifyStage*)user_data;
+	classifyResult* result = (classifyResult*)frame->resultsCPU;
+
+	result->confidence = 0.0f;
+	result->classID    = stage->net->Classify((float*)frame->rgba, frame->width, frame->height, &result->confidence);
+
+	if( result->classID >= 0 )
+		printf("imagenet-camera:  %2.5f%% class #%i (%s)\n", result->confidence * 100.0f, result->classID, stage->net->GetClassDesc(result->classID));
+
+	return true;
+}
+
+
+// render the classification
+static bool overlay( pipelineFrame* frame, void* user_data )
+{
+	classifyStage*  stage  = (classifyStage*)user_data;
+	classifyResult* result = (classifyResult*)frame->resultsCPU;
+
+	if( result->classID >= 0 && stage->font != NULL )
+	{
+		char str[256];
+		sprintf(str, "%05.2f%% %s", result->confidence * 100.0f, stage->net->GetClassDesc(result->classID));
+
+		stage->font->RenderOverlay(frame->rgba, frame->rgba, frame->width, frame->height,
+							  str, 0, 0, make_float4(255.0f, 255.0f, 255.0f, 255.0f));
+	}
+
+	return true;
+}
+
+
+// rescale the pixel intensities for display
+static bool normalize( pipelineFrame* frame, void* user_data )
+{
+	return !CUDA_FAILED(cudaNormalizeRGBA(frame->rgba, make_float2(0.0f, 255.0f),
+								   frame->rgba, make_float2(0.0f, 1.0f),
+		 						   frame->width, frame->height));
+}
+
+
 int main( int argc, char** argv )
 {
 	printf("imagenet-camera\n  args (%i):  ", argc);
@@ -69,15 +130,14 @@ int main( int argc, char** argv )
 	if( signal(SIGINT, sig_handler) == SIG_ERR )
 		printf("\ncan't catch SIGINT\n");
 
+	// record where the time of each frame goes (--trace=<file>)
+	trace::Init(argc, argv);
+
 
 	/*
 	 * create the camera device
 	 */
-	// camera* camera = gstCamera::Create(DEFAULT_CAMERA);
-	CameraNode cam1("22279978");
-	std::vector<CameraNode*> cameras = { &cam1 };
-	pylonCamera pcam(cameras, 1280, 960);
-	camera* camera = &pcam;
+	camera* camera = camera::Create(argc, argv, DEFAULT_CAMERA);
 
 	if( !camera )
 	{
@@ -104,27 +164,46 @@ int main( int argc, char** argv )
 
 
 	/*
-	 * create openGL window
+	 * create the sinks (--sink=display://,shm://<name>,null:// or --output=<uri>), which
+	 * is an openGL window by default if there's an X server, or else nothing
 	 */
-	glDisplay* display = glDisplay::Create();
-	glTexture* texture = NULL;
+	displaySink* sink = displaySink::Create(argc, argv, camera->GetWidth(), camera->GetHeight());
 
-	if( !display ) {
-		printf("\nimagenet-camera:  failed to create openGL display\n");
-	}
-	else
+	if( !sink )
 	{
-		texture = glTexture::Create(camera->GetWidth(), camera->GetHeight(), GL_RGBA32F_ARB/*GL_RGBA8*/);
-
-		if( !texture )
-			printf("imagenet-camera:  failed to create openGL texture\n");
+		printf("\nimagenet-camera:  failed to create display sinks\n");
+		return 0;
 	}
 
+	const bool  overlaid   = sink->Needs(displaySink::FORMAT_RGBA);
+	const bool  normalized = sink->Needs(displaySink::FORMAT_NORMALIZED);
+	const float maxPixel   = normalized ? 1.0f : 255.0f;
+
+
+	/*
+	 * create font, if the classification will be seen
+	 */
+	classifyStage stage;
+
+	stage.net  = net;
+	stage.font = overlaid ? cudaFont::Create() : NULL;
+
 
 	/*
-	 * create font
+	 * create the processing pipeline:  capture -> convert -> classify -> overlay -> normalize -> sinks,
+	 * with each stage on its own thread and classification always taking the newest frame (the
+	 * overlay and normalization are left out when no sink needs them)
 	 */
-	cudaFont* font = cudaFont::Create();
+	pipeline* pipe = pipeline::Create(camera->GetWidth(), camera->GetHeight(), sizeof(classifyResult));
+
+	if( !pipe || !pipe->AddCamera(camera) ||
+	    !pipe->AddStage("classify", classify, &stage, 1, pipeline::DROP_OLDEST) ||
+	    (overlaid && !pipe->AddStage("overlay", overlay, &stage, 2, pipeline::BACKPRESSURE)) ||
+	    (normalized && !pipe->AddStage("normalize", normalize, NULL, 2, pipeline::BACKPRESSURE)) )
+	{
+		printf("imagenet-camera:  failed to create the processing pipeline\n");
+		return 0;
+	}
 
 
 	/*
@@ -138,88 +217,55 @@ int main( int argc, char** argv )
 
 	printf("\nimagenet-camera:  camera open for streaming\n");
 
+	if( !pipe->Start() )
+	{
+		printf("imagenet-camera:  failed to start the processing pipeline\n");
+		return 0;
+	}
+
 
 	/*
-	 * processing loop
+	 * render loop
 	 */
-	float confidence = 0.0f;
-
 	while( !signal_recieved )
 	{
-		void* imgCPU  = NULL;
-		void* imgCUDA = NULL;
+		pipelineFrame* frame = NULL;
 
-		// get the latest frame
-		if( !camera->Capture(&imgCPU, &imgCUDA, 1000) )
-			printf("\nimagenet-camera:  failed to capture frame\n");
-		//else
-		//	printf("imagenet-camera:  recieved new frame  CPU=0x%p  GPU=0x%p\n", imgCPU, imgCUDA);
-
-		// convert from YUV to RGBA
-		void* imgRGBA = NULL;
+		// get the latest processed frame
+		if( !pipe->Next(&frame, 1000) )
+		{
+			if( pipe->IsEOS() )
+				break;
 
-		if( !camera->ConvertRGBtoRGBA(imgCUDA, &imgRGBA) )
-			printf("imagenet-camera:  failed to convert from NV12 to RGBA\n");
+			continue;
+		}
 
-		// classify image
-		const int img_class = net->Classify((float*)imgRGBA, camera->GetWidth(), camera->GetHeight(), &confidence);
+		TRACE_FRAME(frame->traceFrame);
 
-		if( img_class >= 0 )
+		// update the window, encoder, etc.
 		{
-			printf("imagenet-camera:  %2.5f%% class #%i (%s)\n", confidence * 100.0f, img_class, net->GetClassDesc(img_class));
-
-			if( font != NULL )
-			{
-				char str[256];
-				sprintf(str, "%05.2f%% %s", confidence * 100.0f, net->GetClassDesc(img_class));
-
-				font->RenderOverlay((float4*)imgRGBA, (float4*)imgRGBA, camera->GetWidth(), camera->GetHeight(),
-								    str, 0, 0, make_float4(255.0f, 255.0f, 255.0f, 255.0f));
-			}
-
-			if( display != NULL )
-			{
-				char str[256];
-				sprintf(str, "TensorRT build %x | %s | %s | %04.1f FPS", NV_GIE_VERSION, net->GetNetworkName(), net->HasFP16() ? "FP16" : "FP32", display->GetFPS());
-				//sprintf(str, "TensorRT build %x | %s | %04.1f FPS | %05.2f%% %s", NV_GIE_VERSION, net->GetNetworkName(), display->GetFPS(), confidence * 100.0f, net->GetClassDesc(img_class));
-				display->SetTitle(str);
-			}
-		}
+			TRACE_ZONE("display");
 
+			char str[256];
+			sprintf(str, "TensorRT build %x | %s | %s", NV_GIE_VERSION, net->GetNetworkName(), net->HasFP16() ? "FP16" : "FP32");
+			sink->SetStatus(str);
 
-		// update display
-		if( display != NULL )
-		{
-			display->UserEvents();
-			display->BeginRender();
-
-			if( texture != NULL )
-			{
-				// rescale image pixel intensities for display
-				CUDA(cudaNormalizeRGBA((float4*)imgRGBA, make_float2(0.0f, 255.0f),
-								   (float4*)imgRGBA, make_float2(0.0f, 1.0f),
-		 						   camera->GetWidth(), camera->GetHeight()));
-
-				// map from CUDA to openGL using GL interop
-				void* tex_map = texture->MapCUDA();
-
-				if( tex_map != NULL )
-				{
-					cudaMemcpy(tex_map, imgRGBA, texture->GetSize(), cudaMemcpyDeviceToDevice);
-					texture->Unmap();
-				}
-
-				// draw the texture
-				texture->Render(100,100);
-			}
-
-			display->EndRender();
+			sink->Render(frame->rgba, frame->width, frame->height, maxPixel);
 		}
+
+		pipe->Release(frame);
 	}
 
 	printf("\nimagenet-camera:  un-initializing video device\n");
 
 
+	/*
+	 * stop the pipeline, which hands the camera its frames back
+	 */
+	delete pipe;
+	trace::Shutdown();
+
+
 	/*
 	 * shutdown the camera device
 	 */
@@ -229,10 +275,10 @@ int main( int argc, char** argv )
 		camera = NULL;
 	}
 
-	if( display != NULL )
+	if( sink != NULL )
 	{
-		delete display;
-		display = NULL;
+		delete sink;
+		sink = NULL;
 	}
 
 	printf("imagenet-camera:  video device has been un-initialized.\n");
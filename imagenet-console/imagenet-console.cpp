@@ -23,8 +23,109 @@
 #include "imageNet.h"
 
 #include "loadImage.h"
+#include "commandLine.h"
+#include "batchProcessor.h"
 #include "cudaFont.h"
 
+#include <vector>
+
+
+// overlay the classification on the image
+static void overlayClass( cudaFont* font, imageNet* net, float* imgCPU, float* imgCUDA, int imgWidth, int imgHeight, int img_class, float confidence )
+{
+	char str[512];
+	sprintf(str, "%2.3f%% %s", confidence * 100.0f, net->GetClassDesc(img_class));
+
+	const int overlay_x = 10;
+	const int overlay_y = 10;
+	const int px_offset = overlay_y * imgWidth * 4 + overlay_x * 4;
+
+	// if the image has a white background, use black text (otherwise, white)
+	const float white_cutoff = 225.0f;
+	bool white_background = false;
+
+	if( imgCPU[px_offset] > white_cutoff && imgCPU[px_offset + 1] > white_cutoff && imgCPU[px_offset + 2] > white_cutoff )
+		white_background = true;
+
+	// overlay the text on the image
+	font->RenderOverlay((float4*)imgCUDA, (float4*)imgCUDA, imgWidth, imgHeight, (const char*)str, overlay_x, overlay_y,
+					white_background ? make_float4(0.0f, 0.0f, 0.0f, 255.0f) : make_float4(255.0f, 255.0f, 255.0f, 255.0f));
+}
+
+
+// classify a directory or list of images (--images=<dir|list>) in batches
+static int processBatch( imageNet* net, int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	// number of classes to report per image (--topk=N)
+	int topK = cmdLine.GetInt("topk");
+
+	if( topK < 1 )
+		topK = 1;
+	else if( topK > IMAGENET_MAX_TOPK )
+		topK = IMAGENET_MAX_TOPK;
+
+	batchProcessor* batch = batchProcessor::Create(argc, argv);
+
+	if( !batch )
+	{
+		printf("imagenet-console:  failed to create batch processor\n");
+		return 0;
+	}
+
+	cudaFont* font = batch->HasOutput() ? cudaFont::Create() : NULL;
+
+	const uint32_t maxBatchSize = net->GetMaxBatchSize();
+
+	std::vector<batchImage*>  images(maxBatchSize);
+	std::vector<float*>       rgba(maxBatchSize);
+	std::vector<int>          classes(maxBatchSize * topK);
+	std::vector<float>        confidence(maxBatchSize * topK);
+	std::vector<batchResult>  results(topK);
+
+	uint32_t numImages = 0;
+
+	while( (numImages = batch->NextBatch(images.data(), maxBatchSize)) > 0 )
+	{
+		for( uint32_t n=0; n < numImages; n++ )
+			rgba[n] = images[n]->cuda;
+
+		if( !net->ClassifyTopK(rgba.data(), numImages, images[0]->width, images[0]->height, topK, classes.data(), confidence.data()) )
+		{
+			printf("imagenet-console:  failed to classify batch of %u images starting with '%s'\n", numImages, images[0]->filename);
+
+			for( uint32_t n=0; n < numImages; n++ )
+				batch->Complete(images[n], NULL, 0);
+
+			continue;
+		}
+
+		for( uint32_t n=0; n < numImages; n++ )
+		{
+			for( int k=0; k < topK; k++ )
+			{
+				batchResult& r = results[k];
+
+				r.classID    = classes[n * topK + k];
+				r.desc       = (r.classID >= 0) ? net->GetClassDesc(r.classID) : NULL;
+				r.confidence = confidence[n * topK + k];
+				r.left       = 0.0f;
+				r.top        = 0.0f;
+				r.right      = 0.0f;
+				r.bottom     = 0.0f;
+			}
+
+			if( font != NULL && results[0].classID >= 0 )
+				overlayClass(font, net, images[n]->cpu, images[n]->cuda, images[n]->width, images[n]->height, results[0].classID, results[0].confidence);
+
+			batch->Complete(images[n], results.data(), topK);
+		}
+	}
+
+	delete batch;
+	return 0;
+}
 
 
 // main entry point
@@ -56,6 +157,14 @@ int main( int argc, char** argv )
 		printf("imagenet-console:   failed to initialize imageNet\n");
 		return 0;
 	}
+
+	// process a directory or list of images (--images=<dir|list>)
+	if( batchProcessor::IsRequested(argc, argv) )
+	{
+		const int result = processBatch(net, argc, argv);
+		delete net;
+		return result;
+	}
 	
 	net->EnableProfiler();
 	
@@ -88,25 +197,7 @@ int main( int argc, char** argv )
 			cudaFont* font = cudaFont::Create();
 			
 			if( font != NULL )
-			{
-				char str[512];
-				sprintf(str, "%2.3f%% %s", confidence * 100.0f, net->GetClassDesc(img_class));
-
-				const int overlay_x = 10;
-				const int overlay_y = 10;
-				const int px_offset = overlay_y * imgWidth * 4 + overlay_x * 4;
-
-				// if the image has a white background, use black text (otherwise, white)
-				const float white_cutoff = 225.0f;
-				bool white_background = false;
-
-				if( imgCPU[px_offset] > white_cutoff && imgCPU[px_offset + 1] > white_cutoff && imgCPU[px_offset + 2] > white_cutoff )
-					white_background = true;
-
-				// overlay the text on the image
-				font->RenderOverlay((float4*)imgCUDA, (float4*)imgCUDA, imgWidth, imgHeight, (const char*)str, 10, 10,
-								white_background ? make_float4(0.0f, 0.0f, 0.0f, 255.0f) : make_float4(255.0f, 255.0f, 255.0f, 255.0f));
-			}
+				overlayClass(font, net, imgCPU, imgCUDA, imgWidth, imgHeight, img_class, confidence);
 			
 			printf("imagenet-console:  attempting to save output image to '%s'\n", outputFilename);
 			
@@ -27,7 +27,34 @@
 #include "cudaResize.h"
 
 #include "commandLine.h"
+#include "trace.h"
 
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+// downsampling and search radius of the motion estimation, relative to the class map
+#define SEGNET_MOTION_SCALE   2
+#define SEGNET_MOTION_RADIUS  2
+
+
+// statistics of each connected component (same layout as SEG_CC_* in segNet.cu)
+struct componentStats
+{
+	uint32_t area;
+	uint32_t sumX;
+	uint32_t sumY;
+	uint32_t left;
+	uint32_t top;
+	uint32_t right;
+	uint32_t bottom;
+};
 
 
 // constructor
@@ -38,13 +65,45 @@ segNet::segNet() : tensorNet()
 
 	mClassMap[0] = NULL;
 	mClassMap[1] = NULL;
+
+	mClassConfidence[0] = NULL;
+	mClassConfidence[1] = NULL;
+
+	mClassStats[0] = NULL;
+	mClassStats[1] = NULL;
+
+	mLabels[0] = NULL;
+	mLabels[1] = NULL;
+
+	mLabelStats[0] = NULL;
+	mLabelStats[1] = NULL;
+
+	mLabelRoots[0] = NULL;
+	mLabelRoots[1] = NULL;
+
+	mEnableConfidence = false;
+
+	mTemporalMode    = TEMPORAL_DISABLED;
+	mTemporalFactor  = 0.0f;
+	mMotionThreshold = 0.0f;
+	mMotion          = 0.0f;
+	mTemporalScores  = NULL;
+	mReferenceMap    = NULL;
+	mTemporalFrames  = 0;
+	mSkippedFrames   = 0;
+
+	mMotionFrames[0] = NULL;
+	mMotionFrames[1] = NULL;
+
+	mMotionSAD[0] = NULL;
+	mMotionSAD[1] = NULL;
 }
 
 
 // destructor
 segNet::~segNet()
 {
-	
+	freeTemporal();
 }
 
 
@@ -78,12 +137,13 @@ segNet* segNet::Create( int argc, char** argv )
 	commandLine cmdLine(argc, argv);
 
 	const char* modelName = cmdLine.GetString("model");
+	segNet* net = NULL;
 
 	if( !modelName )
 	{
 		modelName = "fcn-alexnet-cityscapes-hd";
 
-		if( argc > 3 )
+		if( argc > 3 && argv[3][0] != '-' )
 			modelName = argv[3];	
 
 		segNet::NetworkType type = segNet::SEGNET_CUSTOM;
@@ -108,7 +168,7 @@ segNet* segNet::Create( int argc, char** argv )
 			type = segNet::FCN_ALEXNET_AERIAL_FPV_720p_21ch;*/
 
 		// create segnet from pretrained model
-		return segNet::Create(type);
+		net = segNet::Create(type);
 	}
 	else
 	{
@@ -126,8 +186,38 @@ segNet* segNet::Create( int argc, char** argv )
 		if( maxBatchSize < 1 )
 			maxBatchSize = 2;
 		
-		return segNet::Create(prototxt, modelName, labels, colors, input, output, maxBatchSize);
+		net = segNet::Create(prototxt, modelName, labels, colors, input, output, maxBatchSize);
 	}
+
+	if( !net )
+		return NULL;
+
+	// temporal filtering (--temporal=average|hysteresis --temporal_factor=F --motion_threshold=T)
+	const char* temporal = cmdLine.GetString("temporal");
+	const float motionThreshold = cmdLine.GetFloat("motion_threshold");
+	float temporalFactor = cmdLine.GetFloat("temporal_factor");
+
+	segNet::TemporalMode temporalMode = segNet::TEMPORAL_DISABLED;
+
+	if( temporal != NULL && strcasecmp(temporal, "average") == 0 )
+	{
+		temporalMode = segNet::TEMPORAL_AVERAGE;
+
+		if( temporalFactor == 0.0f )
+			temporalFactor = 0.5f;
+	}
+	else if( temporal != NULL && strcasecmp(temporal, "hysteresis") == 0 )
+	{
+		temporalMode = segNet::TEMPORAL_HYSTERESIS;
+
+		if( temporalFactor == 0.0f )
+			temporalFactor = 1.0f;
+	}
+
+	if( temporalMode != segNet::TEMPORAL_DISABLED || motionThreshold > 0.0f )
+		net->SetTemporal(temporalMode, temporalFactor, motionThreshold);
+
+	return net;
 }
 
 
@@ -188,6 +278,18 @@ segNet* segNet::Create( const char* prototxt, const char* model, const char* lab
 	if( !cudaAllocMapped((void**)&net->mClassMap[0], (void**)&net->mClassMap[1], s_w * s_h * sizeof(uint8_t)) )
 		return NULL;
 
+	if( !cudaAllocMapped((void**)&net->mClassConfidence[0], (void**)&net->mClassConfidence[1], s_w * s_h * sizeof(float)) )
+		return NULL;
+
+	if( !cudaAllocMapped((void**)&net->mClassStats[0], (void**)&net->mClassStats[1], s_c * sizeof(ClassStats)) )
+		return NULL;
+
+	// connected component working buffers
+	if( !cudaAllocMapped((void**)&net->mLabels[0], (void**)&net->mLabels[1], s_w * s_h * sizeof(int)) ||
+	    !cudaAllocMapped((void**)&net->mLabelStats[0], (void**)&net->mLabelStats[1], s_w * s_h * sizeof(componentStats)) ||
+	    !cudaAllocMapped((void**)&net->mLabelRoots[0], (void**)&net->mLabelRoots[1], (s_w * s_h + 1) * sizeof(int)) )
+		return NULL;
+
 	// load class info
 	net->loadClassColors(colors_path);
 	net->loadClassLabels(labels_path);
@@ -336,22 +438,180 @@ int segNet::FindClassID( const char* label_name )
 // declaration from imageNet.cu
 cudaError_t cudaPreImageNet( float4* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight );
 
+// declaration from segNet.cu
+cudaError_t cudaSegArgmax( float* scores, size_t width, size_t height, size_t numClasses, int ignoreID, uint8_t* classMap, float* confidence, bool hysteresis, float margin );
+cudaError_t cudaSegAverage( float* scores, float* average, size_t size, float alpha );
+cudaError_t cudaSegDownsample( float4* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight );
+cudaError_t cudaSegMotion( float* frame, float* reference, size_t width, size_t height, int radius, float* sad );
+cudaError_t cudaSegShift( uint8_t* input, uint8_t* output, size_t width, size_t height, const int2& shift );
+cudaError_t cudaSegOverlay( float4* input, float4* output, size_t width, size_t height, uint8_t* classMap, size_t s_w, size_t s_h, float4* colors );
+cudaError_t cudaSegMask( float4* output, size_t width, size_t height, uint8_t* classMap, size_t s_w, size_t s_h, float4* colors );
+cudaError_t cudaSegMaskClass( uint8_t* output, size_t width, size_t height, uint8_t* classMap, size_t s_w, size_t s_h );
+cudaError_t cudaSegHistogram( size_t width, size_t height, uint8_t* classMap, size_t s_w, size_t s_h, size_t numClasses, uint32_t* stats );
+cudaError_t cudaSegComponents( uint8_t* classMap, size_t width, size_t height, int* labels, uint32_t* stats, int* roots, int* numRoots );
+
+
+// argmaxConfidence
+static inline float argmaxConfidence( const float* scores, uint32_t n, uint32_t numClasses, float p_max, float p_sel )
+{
+	float sum = 0.0f;
 
+	for( uint32_t c=0; c < numClasses; c++ )
+		sum += expf(scores[c * n] - p_max);
 
+	return expf(p_sel - p_max) / sum;
+}
 
-// Overlay
-bool segNet::Overlay( float* rgba, float* output, uint32_t width, uint32_t height, const char* ignore_class )
+
+// ArgmaxReference
+void segNet::ArgmaxReference( const float* scores, uint32_t width, uint32_t height, uint32_t numClasses,
+						int ignoreID, uint8_t* classMap, float* confidence )
 {
-	if( !rgba || width == 0 || height == 0 || !output )
+	if( !scores || !classMap || numClasses == 0 )
+		return;
+
+	const uint32_t n = width * height;
+	uint32_t i = 0;
+
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+	// process 4 cells at a time, keeping the top-2 scores and classes of each lane
+	for( ; i + 4 <= n; i += 4 )
 	{
-		printf("segNet::Overlay( 0x%p, %u, %u ) -> invalid parameters\n", rgba, width, height);
+		float p_max[2][4];
+		float c_max[2][4];
+
+	#if defined(__SSE2__)
+		__m128 p0 = _mm_loadu_ps(scores + i);
+		__m128 p1 = _mm_set1_ps(-1e30f);
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_set1_ps(-1.0f);
+
+		for( uint32_t c=1; c < numClasses; c++ )
+		{
+			const __m128 p  = _mm_loadu_ps(scores + c * n + i);
+			const __m128 cc = _mm_set1_ps(float(c));
+
+			const __m128 gt0 = _mm_cmpgt_ps(p, p0);
+			const __m128 gt1 = _mm_andnot_ps(gt0, _mm_cmpgt_ps(p, p1));
+
+			// the old winner shifts down to runner-up wherever it was beaten
+			p1 = _mm_or_ps(_mm_and_ps(gt0, p0), _mm_andnot_ps(gt0, _mm_or_ps(_mm_and_ps(gt1, p), _mm_andnot_ps(gt1, p1))));
+			c1 = _mm_or_ps(_mm_and_ps(gt0, c0), _mm_andnot_ps(gt0, _mm_or_ps(_mm_and_ps(gt1, cc), _mm_andnot_ps(gt1, c1))));
+			p0 = _mm_or_ps(_mm_and_ps(gt0, p), _mm_andnot_ps(gt0, p0));
+			c0 = _mm_or_ps(_mm_and_ps(gt0, cc), _mm_andnot_ps(gt0, c0));
+		}
+
+		_mm_storeu_ps(p_max[0], p0);
+		_mm_storeu_ps(p_max[1], p1);
+		_mm_storeu_ps(c_max[0], c0);
+		_mm_storeu_ps(c_max[1], c1);
+	#else
+		float32x4_t p0 = vld1q_f32(scores + i);
+		float32x4_t p1 = vdupq_n_f32(-1e30f);
+		float32x4_t c0 = vdupq_n_f32(0.0f);
+		float32x4_t c1 = vdupq_n_f32(-1.0f);
+
+		for( uint32_t c=1; c < numClasses; c++ )
+		{
+			const float32x4_t p  = vld1q_f32(scores + c * n + i);
+			const float32x4_t cc = vdupq_n_f32(float(c));
+
+			const uint32x4_t gt0 = vcgtq_f32(p, p0);
+			const uint32x4_t gt1 = vbicq_u32(vcgtq_f32(p, p1), gt0);
+
+			// the old winner shifts down to runner-up wherever it was beaten
+			p1 = vbslq_f32(gt0, p0, vbslq_f32(gt1, p, p1));
+			c1 = vbslq_f32(gt0, c0, vbslq_f32(gt1, cc, c1));
+			p0 = vbslq_f32(gt0, p, p0);
+			c0 = vbslq_f32(gt0, cc, c0);
+		}
+
+		vst1q_f32(p_max[0], p0);
+		vst1q_f32(p_max[1], p1);
+		vst1q_f32(c_max[0], c0);
+		vst1q_f32(c_max[1], c1);
+	#endif
+
+		for( uint32_t k=0; k < 4; k++ )
+		{
+			const int argmax = ((int)c_max[0][k] == ignoreID && c_max[1][k] >= 0.0f) ? 1 : 0;
+
+			classMap[i + k] = (int)c_max[argmax][k];
+
+			if( confidence != NULL )
+				confidence[i + k] = argmaxConfidence(scores + i + k, n, numClasses, p_max[0][k], p_max[argmax][k]);
+		}
+	}
+#endif
+
+	// remaining cells (or all of them, without SIMD)
+	for( ; i < n; i++ )
+	{
+		float p_max[2] = { scores[i], -1e30f };
+		int   c_max[2] = { 0, -1 };
+
+		for( uint32_t c=1; c < numClasses; c++ )
+		{
+			const float p = scores[c * n + i];
+
+			if( p > p_max[0] )
+			{
+				p_max[1] = p_max[0];
+				c_max[1] = c_max[0];
+				p_max[0] = p;
+				c_max[0] = c;
+			}
+			else if( c_max[1] < 0 || p > p_max[1] )
+			{
+				p_max[1] = p;
+				c_max[1] = c;
+			}
+		}
+
+		const int argmax = (c_max[0] == ignoreID && c_max[1] >= 0) ? 1 : 0;
+
+		classMap[i] = c_max[argmax];
+
+		if( confidence != NULL )
+			confidence[i] = argmaxConfidence(scores + i, n, numClasses, p_max[0], p_max[argmax]);
+	}
+}
+
+
+
+
+// Process
+bool segNet::Process( float* rgba, uint32_t width, uint32_t height, const char* ignore_class )
+{
+	if( !rgba || width == 0 || height == 0 )
+	{
+		printf("segNet::Process( 0x%p, %u, %u ) -> invalid parameters\n", rgba, width, height);
 		return false;
 	}
 
+	// with low enough motion, follow the previous result instead of running the network
+	if( mMotionThreshold > 0.0f )
+	{
+		if( CUDA_FAILED(cudaSegDownsample((float4*)rgba, width, height, mMotionFrames[0], 
+									GetGridWidth() * SEGNET_MOTION_SCALE, GetGridHeight() * SEGNET_MOTION_SCALE)) )
+		{
+			printf("segNet::Process() -- cudaSegDownsample failed\n");
+			return false;
+		}
+
+		bool skipped = false;
+
+		if( mTemporalFrames > 0 && !processMotion(&skipped) )
+			return false;
+
+		if( skipped )
+			return true;
+	}
+
 	// downsample and convert to band-sequential BGR
 	if( CUDA_FAILED(cudaPreImageNet((float4*)rgba, width, height, mInputCUDA, mWidth, mHeight)) )
 	{
-		printf("segNet::Overlay() -- cudaPreImageNet failed\n");
+		printf("segNet::Process() -- cudaPreImageNet failed\n");
 		return false;
 	}
 
@@ -359,160 +619,490 @@ bool segNet::Overlay( float* rgba, float* output, uint32_t width, uint32_t heigh
 	// process with GIE
 	void* inferenceBuffers[] = { mInputCUDA, mOutputs[0].CUDA };
 	
-	if( !mContext->execute(1, inferenceBuffers) )
+	if( !execute(1, inferenceBuffers) )
 	{
-		printf(LOG_GIE "segNet::Overlay() -- failed to execute tensorRT context\n");
+		printf(LOG_GIE "segNet::Process() -- failed to execute tensorRT context\n");
 		return false;
 	}
 
 	PROFILER_REPORT();	// report total time, when profiling enabled
+	TRACE_ZONE("postprocess");
 
 	
 	// retrieve scores
-	float* scores = mOutputs[0].CPU;
-
 	const int s_w = DIMS_W(mOutputs[0].dims);
 	const int s_h = DIMS_H(mOutputs[0].dims);
 	const int s_c = DIMS_C(mOutputs[0].dims);
-		
-	//const float s_x = float(width) / float(s_w);		// TODO bug: this should use mWidth/mHeight dimensions, in case user dimensions are different
-	//const float s_y = float(height) / float(s_h);
-	const float s_x = float(s_w) / float(mWidth);
-	const float s_y = float(s_h) / float(mHeight);
 
 	// if desired, find the ID of the class to ignore (typically void)
 	const int ignoreID = FindClassID(ignore_class);
 	
-	printf(LOG_GIE "segNet::Overlay -- s_w %i  s_h %i  s_c %i  s_x %f  s_y %f\n", s_w, s_h, s_c, s_x, s_y);
-	printf(LOG_GIE "segNet::Overlay -- ignoring class '%s' id=%i\n", ignore_class, ignoreID);
+	printf(LOG_GIE "segNet::Process -- s_w %i  s_h %i  s_c %i\n", s_w, s_h, s_c);
+	printf(LOG_GIE "segNet::Process -- ignoring class '%s' id=%i\n", ignore_class, ignoreID);
 
 
-	// find the argmax-classified class of each tile
-	uint8_t* classMap = mClassMap[0];
+	// temporal filtering of the scores
+	float* scores = mOutputs[0].CUDA;
 
-	for( uint32_t y=0; y < s_h; y++ )
+	if( mTemporalMode == TEMPORAL_AVERAGE )
 	{
-		for( uint32_t x=0; x < s_w; x++ )
+		const size_t size = s_w * s_h * s_c;
+
+		if( mTemporalFrames == 0 )
 		{
-			float p_max[3] = {-100000.0f, -100000.0f, -100000.0f };
-			int   c_max[3] = { -1, -1, -1 };
+			if( CUDA_FAILED(cudaMemcpy(mTemporalScores, scores, size * sizeof(float), cudaMemcpyDeviceToDevice)) )
+				return false;
+		}
+		else if( CUDA_FAILED(cudaSegAverage(scores, mTemporalScores, size, mTemporalFactor)) )
+		{
+			printf("segNet::Process() -- cudaSegAverage failed\n");
+			return false;
+		}
 
-			for( uint32_t c=0; c < s_c; c++ )	// classes
-			{
-				const float p = scores[c * s_w * s_h + y * s_w + x];
-
-				if( c_max[0] < 0 || p > p_max[0] )
-				{
-					p_max[0] = p;
-					c_max[0] = c;
-				}
-				else if( c_max[1] < 0 || p > p_max[1] )
-				{
-					p_max[1] = p;
-					c_max[1] = c;
-				}
-				else if( c_max[2] < 0 || p > p_max[2] )
-				{
-					p_max[2] = p;
-					c_max[2] = c;
-				}
-			}
+		scores = mTemporalScores;
+	}
+
+	const bool hysteresis = (mTemporalMode == TEMPORAL_HYSTERESIS && mTemporalFrames > 0);
+
+	// find the argmax-classified class of each tile on the GPU
+	if( CUDA_FAILED(cudaSegArgmax(scores, s_w, s_h, s_c, ignoreID, mClassMap[1], 
+							mEnableConfidence ? mClassConfidence[1] : NULL,
+							hysteresis, mTemporalFactor)) )
+	{
+		printf("segNet::Process() -- cudaSegArgmax failed\n");
+		return false;
+	}
+
+	// this frame becomes the reference for skipping the following ones
+	if( mMotionThreshold > 0.0f )
+	{
+		if( CUDA_FAILED(cudaMemcpy(mReferenceMap, mClassMap[1], s_w * s_h, cudaMemcpyDeviceToDevice)) )
+			return false;
+
+		std::swap(mMotionFrames[0], mMotionFrames[1]);
+	}
+
+	if( mTemporalMode != TEMPORAL_DISABLED || mMotionThreshold > 0.0f )
+		mTemporalFrames++;
+
+	return true;
+}
+
+
+// processMotion
+bool segNet::processMotion( bool* skipped )
+{
+	*skipped = false;
+
+	const int s_w = GetGridWidth();
+	const int s_h = GetGridHeight();
+
+	const int numShifts = (2 * SEGNET_MOTION_RADIUS + 1) * (2 * SEGNET_MOTION_RADIUS + 1);
+
+	// measure the difference from the reference frame at each candidate shift
+	if( CUDA_FAILED(cudaSegMotion(mMotionFrames[0], mMotionFrames[1], s_w * SEGNET_MOTION_SCALE, s_h * SEGNET_MOTION_SCALE,
+							SEGNET_MOTION_RADIUS, mMotionSAD[1])) )
+	{
+		printf("segNet::Process() -- cudaSegMotion failed\n");
+		return false;
+	}
+
+	// the CPU reads the differences straight away, so a failed kernel mustn't go unnoticed
+	if( CUDA_FAILED(cudaStreamSynchronize(0)) )
+	{
+		printf("segNet::Process() -- failed to measure the motion from the reference frame\n");
+		return false;
+	}
+
+	int best = (numShifts - 1) / 2;	// zero shift
+
+	for( int n=0; n < numShifts; n++ )
+	{
+		if( mMotionSAD[0][n] < mMotionSAD[0][best] )
+			best = n;
+	}
+
+	mMotion = mMotionSAD[0][best];
+
+	if( mMotion >= mMotionThreshold )
+		return true;	// too much motion, so run the network
+
+	// shift the class map of the reference frame, rounded to the nearest cell
+	const int dx = (best % (2 * SEGNET_MOTION_RADIUS + 1)) - SEGNET_MOTION_RADIUS;
+	const int dy = (best / (2 * SEGNET_MOTION_RADIUS + 1)) - SEGNET_MOTION_RADIUS;
+
+	const int2 shift = make_int2(roundf(float(dx) / SEGNET_MOTION_SCALE), roundf(float(dy) / SEGNET_MOTION_SCALE));
+
+	if( CUDA_FAILED(cudaSegShift(mReferenceMap, mClassMap[1], s_w, s_h, shift)) )
+	{
+		printf("segNet::Process() -- cudaSegShift failed\n");
+		return false;
+	}
+
+	mSkippedFrames++;
+	*skipped = true;
+	return true;
+}
+
+
+// SetTemporal
+bool segNet::SetTemporal( TemporalMode mode, float factor, float motionThreshold )
+{
+	if( mode == TEMPORAL_AVERAGE && (factor <= 0.0f || factor > 1.0f) )
+	{
+		printf("segNet -- invalid temporal averaging factor %f, must be between 0 and 1\n", factor);
+		return false;
+	}
+
+	if( mode == TEMPORAL_HYSTERESIS && factor < 0.0f )
+	{
+		printf("segNet -- invalid temporal hysteresis margin %f\n", factor);
+		return false;
+	}
 
-			/*printf("%02u %u  class %i  %f  %s  class %i  %f  %s  class %i  %f  %s\n", x, y, 
-				   c_max[0], p_max[0], (c_max[0] >= 0 && c_max[0] < GetNumClasses()) ? GetClassLabel(c_max[0]) : " ", 
-				   c_max[1], p_max[1], (c_max[1] >= 0 && c_max[1] < GetNumClasses()) ? GetClassLabel(c_max[1]) : " ",
-				   c_max[2], p_max[2], (c_max[2] >= 0 && c_max[2] < GetNumClasses()) ? GetClassLabel(c_max[2]) : " ");
-			*/
+	freeTemporal();
 
-			const int argmax = (c_max[0] == ignoreID) ? c_max[1] : c_max[0];
+	const size_t s_w = GetGridWidth();
+	const size_t s_h = GetGridHeight();
+	const size_t s_c = GetNumClasses();
 
-			classMap[y * s_w + x] = argmax;
+	if( mode == TEMPORAL_AVERAGE )
+	{
+		if( CUDA_FAILED(cudaMalloc((void**)&mTemporalScores, s_w * s_h * s_c * sizeof(float))) )
+			return false;
+	}
+
+	if( motionThreshold > 0.0f )
+	{
+		const size_t motionSize = s_w * s_h * SEGNET_MOTION_SCALE * SEGNET_MOTION_SCALE * sizeof(float);
+		const size_t numShifts  = (2 * SEGNET_MOTION_RADIUS + 1) * (2 * SEGNET_MOTION_RADIUS + 1);
+
+		if( CUDA_FAILED(cudaMalloc((void**)&mReferenceMap, s_w * s_h)) ||
+		    CUDA_FAILED(cudaMalloc((void**)&mMotionFrames[0], motionSize)) ||
+		    CUDA_FAILED(cudaMalloc((void**)&mMotionFrames[1], motionSize)) )
+		{
+			freeTemporal();
+			return false;
 		}
+
+		if( !cudaAllocMapped((void**)&mMotionSAD[0], (void**)&mMotionSAD[1], numShifts * sizeof(float)) )
+		{
+			freeTemporal();
+			return false;
+		}
+	}
+
+	mTemporalMode    = mode;
+	mTemporalFactor  = factor;
+	mMotionThreshold = motionThreshold;
+	mTemporalFrames  = 0;
+	mSkippedFrames   = 0;
+
+	printf("segNet -- temporal mode %i, factor %f, motion threshold %f\n", (int)mode, factor, motionThreshold);
+	return true;
+}
+
+
+// freeTemporal
+void segNet::freeTemporal()
+{
+	if( mTemporalScores != NULL )
+	{
+		CUDA(cudaFree(mTemporalScores));
+		mTemporalScores = NULL;
 	}
-	   
-	// overlay pixels onto original
-	for( uint32_t y=0; y < height; y++ )
+
+	if( mReferenceMap != NULL )
 	{
-		for( uint32_t x=0; x < width; x++ )
+		CUDA(cudaFree(mReferenceMap));
+		mReferenceMap = NULL;
+	}
+
+	for( uint32_t n=0; n < 2; n++ )
+	{
+		if( mMotionFrames[n] != NULL )
 		{
-			const float cx = float(x) * s_x;
-			const float cy = float(y) * s_y;
+			CUDA(cudaFree(mMotionFrames[n]));
+			mMotionFrames[n] = NULL;
+		}
+	}
 
-			const int x1 = int(cx);
-			const int y1 = int(cy);
-			
-			const int x2 = x1 + 1;
-			const int y2 = y1 + 1;
+	if( mMotionSAD[0] != NULL )
+	{
+		CUDA(cudaFreeHost(mMotionSAD[0]));
+		mMotionSAD[0] = NULL;
+		mMotionSAD[1] = NULL;
+	}
 
-			#define CHK_BOUNDS(x, y)		( (y < 0 ? 0 : (y >= (s_h - 1) ? (s_h - 1) : y)) * s_w + (x < 0 ? 0 : (x >= (s_w - 1) ? (s_w - 1) : x)) )
+	mTemporalMode    = TEMPORAL_DISABLED;
+	mMotionThreshold = 0.0f;
+}
 
-			/*const uint8_t classIdx[] = { classMap[y1 * s_w + x1],
-								    classMap[y1 * s_w + x2],
-								    classMap[y2 * s_w + x2],
-								    classMap[y2 * s_w + x1] };*/
 
-			const uint8_t classIdx[] = { classMap[CHK_BOUNDS(x1, y1)],
-								    classMap[CHK_BOUNDS(x2, y1)],
-								    classMap[CHK_BOUNDS(x2, y2)],
-								    classMap[CHK_BOUNDS(x1, y2)] };
 
+// Overlay
+bool segNet::Overlay( float* rgba, float* output, uint32_t width, uint32_t height, const char* ignore_class )
+{
+	if( !rgba || width == 0 || height == 0 || !output )
+	{
+		printf("segNet::Overlay( 0x%p, %u, %u ) -> invalid parameters\n", rgba, width, height);
+		return false;
+	}
 
-			float* cc[] = { GetClassColor(classIdx[0]),
-						 GetClassColor(classIdx[1]),
-						 GetClassColor(classIdx[2]),
-						 GetClassColor(classIdx[3]) };
+	if( !Process(rgba, width, height, ignore_class) )
+		return false;
 
-			
+	// blend the interpolated class colors over the original
+	if( CUDA_FAILED(cudaSegOverlay((float4*)rgba, (float4*)output, width, height, mClassMap[1], 
+							 GetGridWidth(), GetGridHeight(), (float4*)mClassColors[1])) )
+	{
+		printf("segNet::Overlay() -- cudaSegOverlay failed\n");
+		return false;
+	}
 
-			const float x1d = cx - float(x1);
-			const float y1d = cy - float(y1);
-		
-			const float x2d = 1.0f - x1d;
-			const float y2d = 1.0f - y1d;
+	return true;
+}
+
+
+// Mask
+bool segNet::Mask( float* output, uint32_t width, uint32_t height )
+{
+	if( !output || width == 0 || height == 0 )
+	{
+		printf("segNet::Mask( 0x%p, %u, %u ) -> invalid parameters\n", output, width, height);
+		return false;
+	}
+
+	if( CUDA_FAILED(cudaSegMask((float4*)output, width, height, mClassMap[1], 
+						   GetGridWidth(), GetGridHeight(), (float4*)mClassColors[1])) )
+	{
+		printf("segNet::Mask() -- cudaSegMask failed\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+// Mask
+bool segNet::Mask( uint8_t* output, uint32_t width, uint32_t height )
+{
+	if( !output || width == 0 || height == 0 )
+	{
+		printf("segNet::Mask( 0x%p, %u, %u ) -> invalid parameters\n", output, width, height);
+		return false;
+	}
+
+	if( CUDA_FAILED(cudaSegMaskClass(output, width, height, mClassMap[1], GetGridWidth(), GetGridHeight())) )
+	{
+		printf("segNet::Mask() -- cudaSegMaskClass failed\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+// ClassHistogram
+bool segNet::ClassHistogram( uint32_t width, uint32_t height, ClassStats* stats )
+{
+	if( !stats || width == 0 || height == 0 )
+	{
+		printf("segNet::ClassHistogram( 0x%p, %u, %u ) -> invalid parameters\n", stats, width, height);
+		return false;
+	}
+
+	const uint32_t numClasses = GetNumClasses();
+
+	// the previous reduction has completed, so the results can be reset from the CPU
+	for( uint32_t n=0; n < numClasses; n++ )
+	{
+		uint32_t* c = mClassStats[0] + n * 5;
+
+		c[0] = 0;
+		c[1] = 0xFFFFFFFF;
+		c[2] = 0xFFFFFFFF;
+		c[3] = 0;
+		c[4] = 0;
+	}
+
+	if( CUDA_FAILED(cudaSegHistogram(width, height, mClassMap[1], GetGridWidth(), GetGridHeight(), numClasses, mClassStats[1])) )
+	{
+		printf("segNet::ClassHistogram() -- cudaSegHistogram failed\n");
+		return false;
+	}
+
+	if( CUDA_FAILED(cudaStreamSynchronize(0)) )
+		return false;
 
-			const float x1f = 1.0f - x1d;
-			const float y1f = 1.0f - y1d;
+	for( uint32_t n=0; n < numClasses; n++ )
+	{
+		const uint32_t* c = mClassStats[0] + n * 5;
+
+		if( c[0] == 0 )
+		{
+			memset(&stats[n], 0, sizeof(ClassStats));
+			continue;
+		}
 
-			const float x2f = 1.0f - x1f;
-			const float y2f = 1.0f - y1f;
+		stats[n].count  = c[0];
+		stats[n].left   = c[1];
+		stats[n].top    = c[2];
+		stats[n].right  = c[3];
+		stats[n].bottom = c[4];
+	}
 
-			int c_index = 0;
+	return true;
+}
 
-			/*if( y2d > y1d )
+
+// findRoot
+static inline int findRoot( int* labels, int i )
+{
+	// path halving
+	while( labels[i] != i )
+	{
+		labels[i] = labels[labels[i]];
+		i = labels[i];
+	}
+
+	return i;
+}
+
+
+// unionRoots
+static inline void unionRoots( int* labels, int a, int b )
+{
+	a = findRoot(labels, a);
+	b = findRoot(labels, b);
+
+	if( a < b )
+		labels[b] = a;
+	else if( b < a )
+		labels[a] = b;
+}
+
+
+// labelComponents (CPU)
+static void labelComponents( const uint8_t* classMap, int width, int height, int* labels, componentStats* stats, int* roots, int* numRoots )
+{
+	const int n = width * height;
+
+	for( int i=0; i < n; i++ )
+		labels[i] = i;
+
+	// first pass merges equivalent labels with the left and top neighbors
+	for( int y=0; y < height; y++ )
+	{
+		for( int x=0; x < width; x++ )
+		{
+			const int i = y * width + x;
+			const uint8_t c = classMap[i];
+
+			if( x > 0 && classMap[i - 1] == c )
+				unionRoots(labels, i, i - 1);
+
+			if( y > 0 && classMap[i - width] == c )
+				unionRoots(labels, i, i - width);
+		}
+	}
+
+	// second pass accumulates the statistics of each root
+	int count = 0;
+
+	for( int y=0; y < height; y++ )
+	{
+		for( int x=0; x < width; x++ )
+		{
+			const int i = y * width + x;
+			const int r = findRoot(labels, i);
+
+			componentStats& s = stats[r];
+
+			if( r == i )
 			{
-				if( x2d > y2d )			c_index = 2;
-				else 					c_index = 3;
+				s.area   = 0;
+				s.sumX   = 0;
+				s.sumY   = 0;
+				s.left   = x;
+				s.top    = y;
+				s.right  = x;
+				s.bottom = y;
+
+				roots[count++] = i;
 			}
-			else
-			{
-				if( x2d > y2d )			c_index = 1;
-				else						c_index = 0;
-			}*/
-			
-			//float* c_color = GetClassColor(classIdx[c_index]);
-			//printf("x %u y %u cx %f cy %f  x1d %f y1d %f  x2d %f y2d %f  c %i\n", x, y, cx, cy, x1d, y1d, x2d, y2d, c_index);
-
-			float c_color[] = { cc[0][0] * x1f * y1f + cc[1][0] * x2f * y1f + cc[2][0] * x2f * y2f + cc[3][0] * x1f * y2f,
-						     cc[0][1] * x1f * y1f + cc[1][1] * x2f * y1f + cc[2][1] * x2f * y2f + cc[3][1] * x1f * y2f,
-						     cc[0][2] * x1f * y1f + cc[1][2] * x2f * y1f + cc[2][2] * x2f * y2f + cc[3][2] * x1f * y2f,
-						     cc[0][3] * x1f * y1f + cc[1][3] * x2f * y1f + cc[2][3] * x2f * y2f + cc[3][3] * x1f * y2f };
-
-			float* px_in  = rgba +   (((y * width * 4) + x * 4));
-			float* px_out = output + (((y * width * 4) + x * 4));
-
-			const float alph = c_color[3] / 255.0f;
-			const float inva = 1.0f - alph;
-
-			px_out[0] = alph * c_color[0] + inva * px_in[0];
-			px_out[1] = alph * c_color[1] + inva * px_in[1];
-			px_out[2] = alph * c_color[2] + inva * px_in[2];
-			px_out[3] = 255.0f;
+
+			s.area++;
+			s.sumX += x;
+			s.sumY += y;
+
+			if( x < s.left )	s.left   = x;
+			if( x > s.right )	s.right  = x;
+			if( y > s.bottom )	s.bottom = y;
 		}
 	}
 
-	return true;
+	*numRoots = count;
 }
 
 
-	
-	
+// ConnectedComponents
+bool segNet::ConnectedComponents( Component* components, int* numComponents, bool gpu )
+{
+	if( !components || !numComponents || *numComponents < 1 )
+	{
+		printf("segNet::ConnectedComponents( 0x%p, 0x%p ) -> invalid parameters\n", components, numComponents);
+		return false;
+	}
+
+	const int s_w = GetGridWidth();
+	const int s_h = GetGridHeight();
+
+	int* numRoots = mLabelRoots[0];
+	int* roots    = mLabelRoots[0] + 1;
+
+	if( gpu )
+	{
+		if( CUDA_FAILED(cudaSegComponents(mClassMap[1], s_w, s_h, mLabels[1], mLabelStats[1], mLabelRoots[1] + 1, mLabelRoots[1])) )
+		{
+			printf("segNet::ConnectedComponents() -- cudaSegComponents failed\n");
+			return false;
+		}
+
+		if( CUDA_FAILED(cudaStreamSynchronize(0)) )
+			return false;
+
+		// roots are compacted in arbitrary order on the GPU
+		std::sort(roots, roots + *numRoots);
+	}
+	else
+	{
+		// wait for the class map from Process()
+		if( CUDA_FAILED(cudaStreamSynchronize(0)) )
+			return false;
+
+		labelComponents(mClassMap[0], s_w, s_h, mLabels[0], (componentStats*)mLabelStats[0], roots, numRoots);
+	}
+
+	const componentStats* stats = (componentStats*)mLabelStats[0];
+	const int count = std::min(*numRoots, *numComponents);
+
+	for( int n=0; n < count; n++ )
+	{
+		const int r = roots[n];
+		const componentStats& s = stats[r];
+
+		components[n].classID = mClassMap[0][r];
+		components[n].area    = s.area;
+		components[n].x       = float(s.sumX) / float(s.area);
+		components[n].y       = float(s.sumY) / float(s.area);
+		components[n].left    = s.left;
+		components[n].top     = s.top;
+		components[n].right   = s.right;
+		components[n].bottom  = s.bottom;
+	}
+
+	*numComponents = count;
+	return true;
+}
+
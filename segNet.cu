@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "cudaUtility.h"
+
+
+
+// gpuSegArgmax
+__global__ void gpuSegArgmax( float* scores, int width, int height, int numClasses, int ignoreID, uint8_t* classMap, float* confidence, bool hysteresis, float margin )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+	const int n = width * height;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int i = y * width + x;
+
+	// track the top-2 classes, so the runner-up can be used if the winner is ignored
+	float p_max[2] = { scores[i], -1e30f };
+	int   c_max[2] = { 0, -1 };
+
+	for( int c=1; c < numClasses; c++ )
+	{
+		const float p = scores[c * n + i];
+
+		if( p > p_max[0] )
+		{
+			p_max[1] = p_max[0];
+			c_max[1] = c_max[0];
+			p_max[0] = p;
+			c_max[0] = c;
+		}
+		else if( c_max[1] < 0 || p > p_max[1] )
+		{
+			p_max[1] = p;
+			c_max[1] = c;
+		}
+	}
+
+	const int argmax = (c_max[0] == ignoreID && c_max[1] >= 0) ? 1 : 0;
+
+	int   c_sel = c_max[argmax];
+	float p_sel = p_max[argmax];
+
+	// with hysteresis, the previous class is kept unless it's beaten by the margin
+	if( hysteresis )
+	{
+		const int c_prev = classMap[i];
+
+		if( c_prev != c_sel && c_prev < numClasses && c_prev != ignoreID )
+		{
+			const float p_prev = scores[c_prev * n + i];
+
+			if( p_sel - p_prev < margin )
+			{
+				c_sel = c_prev;
+				p_sel = p_prev;
+			}
+		}
+	}
+
+	classMap[i] = c_sel;
+
+	// softmax probability of the selected class
+	if( confidence != NULL )
+	{
+		float sum = 0.0f;
+
+		for( int c=0; c < numClasses; c++ )
+			sum += __expf(scores[c * n + i] - p_max[0]);
+
+		confidence[i] = __expf(p_sel - p_max[0]) / sum;
+	}
+}
+
+
+// cudaSegArgmax
+cudaError_t cudaSegArgmax( float* scores, size_t width, size_t height, size_t numClasses, int ignoreID, uint8_t* classMap, float* confidence, bool hysteresis, float margin )
+{
+	if( !scores || !classMap )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 || numClasses == 0 || numClasses > 256 )
+		return cudaErrorInvalidValue;
+
+	// launch kernel
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuSegArgmax<<<gridDim, blockDim>>>(scores, width, height, numClasses, ignoreID, classMap, confidence, hysteresis, margin);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegOverlay
+__global__ void gpuSegOverlay( float2 scale, float4* input, float4* output, int width, int height,
+						 uint8_t* classMap, int s_w, int s_h, float4* colors )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const float cx = float(x) * scale.x;
+	const float cy = float(y) * scale.y;
+
+	const int x1 = int(cx);
+	const int y1 = int(cy);
+
+	const int x2 = min(x1 + 1, s_w - 1);
+	const int y2 = min(y1 + 1, s_h - 1);
+
+	// bilinear interpolation of the class colors of the 4 neighboring cells
+	const float4 c1 = colors[classMap[y1 * s_w + x1]];
+	const float4 c2 = colors[classMap[y1 * s_w + x2]];
+	const float4 c3 = colors[classMap[y2 * s_w + x2]];
+	const float4 c4 = colors[classMap[y2 * s_w + x1]];
+
+	const float x2f = cx - float(x1);
+	const float y2f = cy - float(y1);
+
+	const float x1f = 1.0f - x2f;
+	const float y1f = 1.0f - y2f;
+
+	const float w1 = x1f * y1f;
+	const float w2 = x2f * y1f;
+	const float w3 = x2f * y2f;
+	const float w4 = x1f * y2f;
+
+	const float4 color = make_float4(c1.x * w1 + c2.x * w2 + c3.x * w3 + c4.x * w4,
+							   c1.y * w1 + c2.y * w2 + c3.y * w3 + c4.y * w4,
+							   c1.z * w1 + c2.z * w2 + c3.z * w3 + c4.z * w4,
+							   c1.w * w1 + c2.w * w2 + c3.w * w3 + c4.w * w4);
+
+	// alpha blend with the original
+	const float4 px = input[y * width + x];
+
+	const float alph = color.w / 255.0f;
+	const float inva = 1.0f - alph;
+
+	output[y * width + x] = make_float4(alph * color.x + inva * px.x,
+								 alph * color.y + inva * px.y,
+								 alph * color.z + inva * px.z,
+								 255.0f);
+}
+
+
+// cudaSegOverlay
+cudaError_t cudaSegOverlay( float4* input, float4* output, size_t width, size_t height,
+				        uint8_t* classMap, size_t s_w, size_t s_h, float4* colors )
+{
+	if( !input || !output || !classMap || !colors )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 || s_w == 0 || s_h == 0 )
+		return cudaErrorInvalidValue;
+
+	const float2 scale = make_float2( float(s_w) / float(width),
+							    float(s_h) / float(height) );
+
+	// launch kernel
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuSegOverlay<<<gridDim, blockDim>>>(scale, input, output, width, height, classMap, s_w, s_h, colors);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegMask
+__global__ void gpuSegMask( float2 scale, float4* output, int width, int height,
+					   uint8_t* classMap, int s_w, float4* colors )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	// point sample the nearest cell
+	const int cx = float(x) * scale.x;
+	const int cy = float(y) * scale.y;
+
+	const float4 color = colors[classMap[cy * s_w + cx]];
+
+	output[y * width + x] = make_float4(color.x, color.y, color.z, 255.0f);
+}
+
+
+// cudaSegMask
+cudaError_t cudaSegMask( float4* output, size_t width, size_t height,
+				     uint8_t* classMap, size_t s_w, size_t s_h, float4* colors )
+{
+	if( !output || !classMap || !colors )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 || s_w == 0 || s_h == 0 )
+		return cudaErrorInvalidValue;
+
+	const float2 scale = make_float2( float(s_w) / float(width),
+							    float(s_h) / float(height) );
+
+	// launch kernel
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuSegMask<<<gridDim, blockDim>>>(scale, output, width, height, classMap, s_w, colors);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegMaskClass
+__global__ void gpuSegMaskClass( float2 scale, uint8_t* output, int width, int height, uint8_t* classMap, int s_w )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	// point sample the nearest cell
+	const int cx = float(x) * scale.x;
+	const int cy = float(y) * scale.y;
+
+	output[y * width + x] = classMap[cy * s_w + cx];
+}
+
+
+// cudaSegMaskClass
+cudaError_t cudaSegMaskClass( uint8_t* output, size_t width, size_t height,
+					     uint8_t* classMap, size_t s_w, size_t s_h )
+{
+	if( !output || !classMap )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 || s_w == 0 || s_h == 0 )
+		return cudaErrorInvalidValue;
+
+	const float2 scale = make_float2( float(s_w) / float(width),
+							    float(s_h) / float(height) );
+
+	// launch kernel
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuSegMaskClass<<<gridDim, blockDim>>>(scale, output, width, height, classMap, s_w);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegHistogram
+__global__ void gpuSegHistogram( float2 scale, int width, int height, uint8_t* classMap, int s_w, int numClasses, uint32_t* stats )
+{
+	extern __shared__ uint32_t s_stats[];	// count, left, top, right, bottom per class
+
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	const int tid = threadIdx.y * blockDim.x + threadIdx.x;
+	const int numThreads = blockDim.x * blockDim.y;
+
+	// reset this block's partial histogram
+	for( int i=tid; i < numClasses; i += numThreads )
+	{
+		s_stats[i * 5 + 0] = 0;
+		s_stats[i * 5 + 1] = 0xFFFFFFFF;
+		s_stats[i * 5 + 2] = 0xFFFFFFFF;
+		s_stats[i * 5 + 3] = 0;
+		s_stats[i * 5 + 4] = 0;
+	}
+
+	__syncthreads();
+
+	if( x < width && y < height )
+	{
+		const int cx = float(x) * scale.x;
+		const int cy = float(y) * scale.y;
+
+		uint32_t* c = s_stats + classMap[cy * s_w + cx] * 5;
+
+		atomicAdd(c + 0, 1u);
+		atomicMin(c + 1, (uint32_t)x);
+		atomicMin(c + 2, (uint32_t)y);
+		atomicMax(c + 3, (uint32_t)x);
+		atomicMax(c + 4, (uint32_t)y);
+	}
+
+	__syncthreads();
+
+	// merge the classes present in this block into the global results
+	for( int i=tid; i < numClasses; i += numThreads )
+	{
+		const uint32_t count = s_stats[i * 5 + 0];
+
+		if( count == 0 )
+			continue;
+
+		atomicAdd(stats + i * 5 + 0, count);
+		atomicMin(stats + i * 5 + 1, s_stats[i * 5 + 1]);
+		atomicMin(stats + i * 5 + 2, s_stats[i * 5 + 2]);
+		atomicMax(stats + i * 5 + 3, s_stats[i * 5 + 3]);
+		atomicMax(stats + i * 5 + 4, s_stats[i * 5 + 4]);
+	}
+}
+
+
+// cudaSegHistogram
+cudaError_t cudaSegHistogram( size_t width, size_t height, uint8_t* classMap, size_t s_w, size_t s_h, size_t numClasses, uint32_t* stats )
+{
+	if( !classMap || !stats )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 || s_w == 0 || s_h == 0 || numClasses == 0 || numClasses > 256 )
+		return cudaErrorInvalidValue;
+
+	const float2 scale = make_float2( float(s_w) / float(width),
+							    float(s_h) / float(height) );
+
+	// launch kernel
+	const dim3 blockDim(16, 16);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuSegHistogram<<<gridDim, blockDim, numClasses * 5 * sizeof(uint32_t)>>>(scale, width, height, classMap, s_w, numClasses, stats);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// connected component statistics, indexed by the root cell of each component
+#define SEG_CC_AREA   0
+#define SEG_CC_SUMX   1
+#define SEG_CC_SUMY   2
+#define SEG_CC_LEFT   3
+#define SEG_CC_TOP    4
+#define SEG_CC_RIGHT  5
+#define SEG_CC_BOTTOM 6
+#define SEG_CC_STATS  7
+
+
+// findRoot
+__device__ inline int findRoot( int* labels, int i )
+{
+	while( labels[i] != i )
+		i = labels[i];
+
+	return i;
+}
+
+
+// unionRoots
+__device__ inline void unionRoots( int* labels, int a, int b )
+{
+	bool done = false;
+
+	// link the larger root to the smaller one, retrying if another thread got there first
+	do
+	{
+		a = findRoot(labels, a);
+		b = findRoot(labels, b);
+
+		if( a < b )
+		{
+			const int old = atomicMin(&labels[b], a);
+			done = (old == b);
+			b = old;
+		}
+		else if( b < a )
+		{
+			const int old = atomicMin(&labels[a], b);
+			done = (old == a);
+			a = old;
+		}
+		else
+		{
+			done = true;
+		}
+	} while( !done );
+}
+
+
+// gpuComponentsInit
+__global__ void gpuComponentsInit( int width, int height, int* labels, uint32_t* stats, int* numRoots )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int i = y * width + x;
+	uint32_t* s = stats + i * SEG_CC_STATS;
+
+	labels[i] = i;
+
+	s[SEG_CC_AREA]   = 0;
+	s[SEG_CC_SUMX]   = 0;
+	s[SEG_CC_SUMY]   = 0;
+	s[SEG_CC_LEFT]   = 0xFFFFFFFF;
+	s[SEG_CC_TOP]    = 0xFFFFFFFF;
+	s[SEG_CC_RIGHT]  = 0;
+	s[SEG_CC_BOTTOM] = 0;
+
+	if( i == 0 )
+		*numRoots = 0;
+}
+
+
+// gpuComponentsMerge
+__global__ void gpuComponentsMerge( uint8_t* classMap, int width, int height, int* labels )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int i = y * width + x;
+	const uint8_t c = classMap[i];
+
+	// 4-connectivity with the left and top neighbors
+	if( x > 0 && classMap[i - 1] == c )
+		unionRoots(labels, i, i - 1);
+
+	if( y > 0 && classMap[i - width] == c )
+		unionRoots(labels, i, i - width);
+}
+
+
+// gpuComponentsStats
+__global__ void gpuComponentsStats( int width, int height, int* labels, uint32_t* stats, int* roots, int* numRoots )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const int i = y * width + x;
+	const int r = findRoot(labels, i);
+
+	uint32_t* s = stats + r * SEG_CC_STATS;
+
+	atomicAdd(s + SEG_CC_AREA, 1u);
+	atomicAdd(s + SEG_CC_SUMX, (uint32_t)x);
+	atomicAdd(s + SEG_CC_SUMY, (uint32_t)y);
+	atomicMin(s + SEG_CC_LEFT, (uint32_t)x);
+	atomicMin(s + SEG_CC_TOP, (uint32_t)y);
+	atomicMax(s + SEG_CC_RIGHT, (uint32_t)x);
+	atomicMax(s + SEG_CC_BOTTOM, (uint32_t)y);
+
+	// compact the list of roots
+	if( r == i )
+		roots[atomicAdd(numRoots, 1)] = i;
+}
+
+
+// cudaSegComponents
+cudaError_t cudaSegComponents( uint8_t* classMap, size_t width, size_t height, int* labels, uint32_t* stats, int* roots, int* numRoots )
+{
+	if( !classMap || !labels || !stats || !roots || !numRoots )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
+
+	// launch kernels
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuComponentsInit<<<gridDim, blockDim>>>(width, height, labels, stats, numRoots);
+	gpuComponentsMerge<<<gridDim, blockDim>>>(classMap, width, height, labels);
+	gpuComponentsStats<<<gridDim, blockDim>>>(width, height, labels, stats, roots, numRoots);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegAverage
+__global__ void gpuSegAverage( float* scores, float* average, int size, float alpha )
+{
+	const int i = blockIdx.x * blockDim.x + threadIdx.x;
+
+	if( i >= size )
+		return;
+
+	average[i] = alpha * scores[i] + (1.0f - alpha) * average[i];
+}
+
+
+// cudaSegAverage
+cudaError_t cudaSegAverage( float* scores, float* average, size_t size, float alpha )
+{
+	if( !scores || !average )
+		return cudaErrorInvalidDevicePointer;
+
+	if( size == 0 )
+		return cudaErrorInvalidValue;
+
+	// launch kernel
+	const dim3 blockDim(64);
+	const dim3 gridDim(iDivUp(size,blockDim.x));
+
+	gpuSegAverage<<<gridDim, blockDim>>>(scores, average, size, alpha);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegDownsample
+__global__ void gpuSegDownsample( float2 scale, float4* input, int iWidth, float* output, int oWidth, int oHeight )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= oWidth || y >= oHeight )
+		return;
+
+	// point sample the center of each cell, converted to grayscale
+	const int dx = ((float)x + 0.5f) * scale.x;
+	const int dy = ((float)y + 0.5f) * scale.y;
+
+	const float4 px = input[dy * iWidth + dx];
+
+	output[y * oWidth + x] = (px.x + px.y + px.z) * (1.0f / 3.0f);
+}
+
+
+// cudaSegDownsample
+cudaError_t cudaSegDownsample( float4* input, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight )
+{
+	if( !input || !output )
+		return cudaErrorInvalidDevicePointer;
+
+	if( inputWidth == 0 || outputWidth == 0 || inputHeight == 0 || outputHeight == 0 )
+		return cudaErrorInvalidValue;
+
+	const float2 scale = make_float2( float(inputWidth) / float(outputWidth),
+							    float(inputHeight) / float(outputHeight) );
+
+	// launch kernel
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(outputWidth,blockDim.x), iDivUp(outputHeight,blockDim.y));
+
+	gpuSegDownsample<<<gridDim, blockDim>>>(scale, input, inputWidth, output, outputWidth, outputHeight);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegMotion
+__global__ void gpuSegMotion( float* frame, float* reference, int width, int height, int radius, float* sad )
+{
+	__shared__ float s_sum[64];
+
+	// each block evaluates one candidate shift (dx, dy) of the frame relative to the reference
+	const int dx = int(blockIdx.x % (2 * radius + 1)) - radius;
+	const int dy = int(blockIdx.x / (2 * radius + 1)) - radius;
+
+	// only compare the region where both images overlap
+	const int x0 = max(dx, 0);
+	const int y0 = max(dy, 0);
+	const int x1 = min(width, width + dx);
+	const int y1 = min(height, height + dy);
+
+	const int w = x1 - x0;
+	const int n = w * (y1 - y0);
+
+	float sum = 0.0f;
+
+	for( int i=threadIdx.x; i < n; i += blockDim.x )
+	{
+		const int x = x0 + i % w;
+		const int y = y0 + i / w;
+
+		sum += fabsf(frame[y * width + x] - reference[(y - dy) * width + (x - dx)]);
+	}
+
+	s_sum[threadIdx.x] = sum;
+	__syncthreads();
+
+	for( int stride=blockDim.x/2; stride > 0; stride >>= 1 )
+	{
+		if( threadIdx.x < stride )
+			s_sum[threadIdx.x] += s_sum[threadIdx.x + stride];
+
+		__syncthreads();
+	}
+
+	if( threadIdx.x == 0 )
+		sad[blockIdx.x] = s_sum[0] / float(n);
+}
+
+
+// cudaSegMotion
+cudaError_t cudaSegMotion( float* frame, float* reference, size_t width, size_t height, int radius, float* sad )
+{
+	if( !frame || !reference || !sad )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 || radius < 0 || radius >= width || radius >= height )
+		return cudaErrorInvalidValue;
+
+	// launch kernel, with one block per candidate shift
+	const dim3 blockDim(64);
+	const dim3 gridDim((2 * radius + 1) * (2 * radius + 1));
+
+	gpuSegMotion<<<gridDim, blockDim>>>(frame, reference, width, height, radius, sad);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// gpuSegShift
+__global__ void gpuSegShift( uint8_t* input, uint8_t* output, int width, int height, int2 shift )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	// cells uncovered by the shift repeat the edge of the map
+	const int sx = min(max(x - shift.x, 0), width - 1);
+	const int sy = min(max(y - shift.y, 0), height - 1);
+
+	output[y * width + x] = input[sy * width + sx];
+}
+
+
+// cudaSegShift
+cudaError_t cudaSegShift( uint8_t* input, uint8_t* output, size_t width, size_t height, const int2& shift )
+{
+	if( !input || !output )
+		return cudaErrorInvalidDevicePointer;
+
+	if( width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
+
+	// launch kernel
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	gpuSegShift<<<gridDim, blockDim>>>(input, output, width, height, shift);
+
+	return CUDA(cudaGetLastError());
+}
+
@@ -64,6 +64,17 @@ public:
 		SEGNET_CUSTOM
 	};
 
+	/**
+	 * Temporal filtering modes applied by Process() to stabilize results across frames.
+	 * @see SetTemporal()
+	 */
+	enum TemporalMode
+	{
+		TEMPORAL_DISABLED = 0,	/**< every frame is classified independently (default) */
+		TEMPORAL_AVERAGE,		/**< exponential moving average of the class scores */
+		TEMPORAL_HYSTERESIS		/**< the class of a cell only changes when beaten by a margin */
+	};
+
 	/**
 	 * Load a new network instance
 	 */
@@ -96,8 +107,125 @@ public:
 	 */
 	virtual ~segNet();
 	
+	/**
+	 * Perform the initial inferencing processing portion of the segmentation.
+	 * The class map is generated on the GPU, and the results can then be visualized with Mask(),
+	 * or read directly from GetClassMap() without touching the RGBA images.
+	 * @param input float4 input image in CUDA device memory, RGBA colorspace with values 0-255.
+	 * @param width width of the input image in pixels.
+	 * @param height height of the input image in pixels.
+	 * @param ignore_class label name of class to ignore in the classification (or NULL to process all).
+	 * @returns true on success, false on error.
+	 */
+	bool Process( float* input, uint32_t width, uint32_t height, const char* ignore_class="void" );
+
+	/**
+	 * Produce a colorized segmentation mask of the results from the last call to Process().
+	 * Each pixel is point-sampled from the class map, and the input image is never read.
+	 * @param output float4 output image in CUDA device memory, RGBA colorspace with values 0-255.
+	 * @param width width of the output image in pixels.
+	 * @param height height of the output image in pixels.
+	 * @returns true on success, false on error.
+	 */
+	bool Mask( float* output, uint32_t width, uint32_t height );
+
+	/**
+	 * Produce a class mask of the results from the last call to Process().
+	 * Each pixel of the output is set to the class index of the nearest cell of the class map,
+	 * so the mask can be generated at any resolution (for example, that of the original image).
+	 * @param output uint8 output image in CUDA device memory, width * height bytes.
+	 * @param width width of the output image in pixels.
+	 * @param height height of the output image in pixels.
+	 * @returns true on success, false on error.
+	 */
+	bool Mask( uint8_t* output, uint32_t width, uint32_t height );
+
+	/**
+	 * Per-class statistics computed by ClassHistogram().
+	 * The extents are inclusive pixel coordinates, and are all zero when the count is zero.
+	 */
+	struct ClassStats
+	{
+		uint32_t count;		/**< number of pixels classified as the class */
+		uint32_t left;		/**< left-most pixel of the class */
+		uint32_t top;		/**< top-most pixel of the class */
+		uint32_t right;	/**< right-most pixel of the class */
+		uint32_t bottom;	/**< bottom-most pixel of the class */
+	};
+
+	/**
+	 * Compute the pixel count and bounding extents of every class from the last call to Process(),
+	 * as if the class mask was generated at the specified resolution with Mask().
+	 * The reduction runs on the GPU, and the overlay path is never used.
+	 * @param width width of the mask in pixels.
+	 * @param height height of the mask in pixels.
+	 * @param stats array of GetNumClasses() entries in CPU memory to receive the results.
+	 * @returns true on success, false on error.
+	 */
+	bool ClassHistogram( uint32_t width, uint32_t height, ClassStats* stats );
+
+	/**
+	 * Connected component extracted by ConnectedComponents().
+	 * Coordinates are in cells of the class map (GetGridWidth() x GetGridHeight()),
+	 * and the bounding box is inclusive.
+	 */
+	struct Component
+	{
+		uint32_t classID;	/**< class index shared by all cells of the component */
+		uint32_t area;		/**< number of cells in the component */
+		float    x;		/**< centroid X coordinate */
+		float    y;		/**< centroid Y coordinate */
+		uint32_t left;		/**< left-most cell of the component */
+		uint32_t top;		/**< top-most cell of the component */
+		uint32_t right;	/**< right-most cell of the component */
+		uint32_t bottom;	/**< bottom-most cell of the component */
+	};
+
+	/**
+	 * Label the 4-connected regions of equal class in the class map from the last call to Process().
+	 * The working buffers are allocated when the network is created, so this doesn't allocate memory.
+	 * Components are returned in raster order of their first cell.
+	 * @param components array of components in CPU memory to receive the results.
+	 * @param numComponents pointer to a single integer containing the maximum number of components
+	 *                      available in the array.  Upon successful return, it's set to the number
+	 *                      of components that were written.
+	 * @param gpu if true, label on the GPU with union-find, otherwise use the CPU implementation.
+	 * @returns true on success, false on error.
+	 */
+	bool ConnectedComponents( Component* components, int* numComponents, bool gpu=true );
+
+	/**
+	 * Enable temporal filtering of the results, and optionally skipping inference on still frames.
+	 * With a motion threshold, each frame is downsampled and compared against the last frame that
+	 * was processed by the network, at a few small global shifts.  If the best mean absolute difference
+	 * is below the threshold, inference is skipped and the previous class map is shifted to follow it.
+	 * @param mode the temporal filtering mode, or TEMPORAL_DISABLED.
+	 * @param factor for TEMPORAL_AVERAGE, the weight of the newest frame (0-1].
+	 *               for TEMPORAL_HYSTERESIS, the score margin needed to change the class of a cell.
+	 * @param motionThreshold mean absolute difference (in 0-255 pixel units) below which inference
+	 *                        is skipped, or 0 to run the network on every frame.
+	 * @returns true on success, false on error.
+	 */
+	bool SetTemporal( TemporalMode mode, float factor, float motionThreshold=0.0f );
+
+	/**
+	 * Retrieve the temporal filtering mode.
+	 */
+	inline TemporalMode GetTemporalMode() const				{ return mTemporalMode; }
+
+	/**
+	 * Retrieve the motion measured against the last processed frame by the most recent Process().
+	 */
+	inline float GetMotion() const							{ return mMotion; }
+
+	/**
+	 * Retrieve the number of frames where inference was skipped because of low motion.
+	 */
+	inline uint32_t GetSkippedFrames() const					{ return mSkippedFrames; }
+
 	/**
 	 * Produce the segmentation overlay alpha blended on top of the original image.
+	 * This runs Process() followed by compositing the interpolated class colors on the GPU.
 	 * @param input float4 input image in CUDA device memory, RGBA colorspace with values 0-255.
 	 * @param output float4 output image in CUDA device memory, RGBA colorspace with values 0-255.
 	 * @param width width of the input image in pixels.
@@ -108,6 +236,47 @@ public:
 	 */
 	bool Overlay( float* input, float* output, uint32_t width, uint32_t height, const char* ignore_class="void" );
 	
+	/**
+	 * Enable generation of the per-cell confidence map.
+	 * When enabled, the softmax probability of the class selected for each cell of
+	 * the class map is written to GetConfidenceMap() during Overlay().
+	 */
+	inline void EnableConfidenceMap( bool enable=true )		{ mEnableConfidence = enable; }
+
+	/**
+	 * Retrieve the argmax-classified class index of each cell, in shared CPU/GPU memory.
+	 * The map has the dimensions of the network output (GetGridWidth() x GetGridHeight()).
+	 * @note Process() runs asynchronously, so synchronize the device before reading it from the CPU.
+	 */
+	inline uint8_t* GetClassMap() const						{ return mClassMap[0]; }
+
+	/**
+	 * Retrieve the per-cell confidence map, in shared CPU/GPU memory.
+	 * @see EnableConfidenceMap()
+	 */
+	inline float* GetConfidenceMap() const					{ return mClassConfidence[0]; }
+
+	/**
+	 * Retrieve the width of the network output grid (number of cells in the X dimension).
+	 */
+	inline uint32_t GetGridWidth() const						{ return DIMS_W(mOutputs[0].dims); }
+
+	/**
+	 * Retrieve the height of the network output grid (number of cells in the Y dimension).
+	 */
+	inline uint32_t GetGridHeight() const						{ return DIMS_H(mOutputs[0].dims); }
+
+	/**
+	 * CPU reference implementation of the argmax that generates the class map on the GPU,
+	 * vectorized with SSE2 or NEON when available.  Used for validating the CUDA kernel.
+	 * @param scores per-class score planes, width * height * numClasses floats.
+	 * @param ignoreID class to skip in favor of the runner-up (or -1 to process all).
+	 * @param classMap output class index of each cell, width * height bytes.
+	 * @param confidence optional output softmax probability of the selected class of each cell.
+	 */
+	static void ArgmaxReference( const float* scores, uint32_t width, uint32_t height, uint32_t numClasses,
+						    int ignoreID, uint8_t* classMap, float* confidence=NULL );
+
 	/**
 	 * Find the ID of a particular class (by label name).
 	 */
@@ -154,10 +323,30 @@ protected:
 	
 	bool loadClassColors( const char* filename );
 	bool loadClassLabels( const char* filename );
+
+	bool processMotion( bool* skipped );	// returns false on CUDA errors, sets skipped if the previous result was reused
+	void freeTemporal();
 	
 	std::vector<std::string> mClassLabels;
 	float*   mClassColors[2];	/**< array of overlay colors in shared CPU/GPU memory */
 	uint8_t* mClassMap[2];		/**< runtime buffer for the argmax-classified class index of each tile */
+	float*   mClassConfidence[2];	/**< runtime buffer for the probability of the classified class of each tile */
+	uint32_t* mClassStats[2];	/**< runtime buffer for the per-class reductions of ClassHistogram() */
+	int*      mLabels[2];		/**< runtime buffer for the connected component label of each tile */
+	uint32_t* mLabelStats[2];	/**< runtime buffer for the statistics of each connected component */
+	int*      mLabelRoots[2];	/**< runtime buffer for the list of connected component roots, preceded by the count */
+
+	TemporalMode mTemporalMode;
+	float    mTemporalFactor;
+	float    mMotionThreshold;
+	float    mMotion;
+	float*   mTemporalScores;	/**< moving average of the scores (TEMPORAL_AVERAGE) */
+	uint8_t* mReferenceMap;		/**< class map of the last frame processed by the network */
+	float*   mMotionFrames[2];	/**< downsampled grayscale of the current and reference frames */
+	float*   mMotionSAD[2];		/**< mean absolute difference of each candidate shift */
+	uint32_t mTemporalFrames;
+	uint32_t mSkippedFrames;
+	bool     mEnableConfidence;
 
 	NetworkType mNetworkType;
 };
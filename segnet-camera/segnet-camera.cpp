@@ -20,10 +20,9 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include "gstCamera.h"
-
-#include "glDisplay.h"
-#include "glTexture.h"
+#include "camera.h"
+#include "pipeline.h"
+#include "trace.h"
 
 #include <stdio.h>
 #include <signal.h>
@@ -33,10 +32,12 @@
 #include "cudaNormalize.h"
 #include "cudaFont.h"
 
+#include "displaySink.h"
+
 #include "segNet.h"
 
 
-#define DEFAULT_CAMERA -1	// -1 for onboard camera, or change to index of /dev/video V4L2 camera (>=0)	
+#define DEFAULT_CAMERA "gst://onboard"	// onboard camera, or override with --camera=<uri> (e.g. gst://0 or v4l2:///dev/video0)
 		
 
 bool signal_recieved = false;
@@ -51,6 +52,41 @@ void sig_handler(int signo)
 }
 
 
+// state of the segment stage
+struct segmentStage
+{
+	segNet* net;
+	bool    overlay;	// render the overlay to the frame's results, if anything will see it
+};
+
+
+// segment the frame, with the overlay going to the frame's results
+static bool segment( pipelineFrame* frame, void* user_data )
+{
+	segmentStage* stage = (segmentStage*)user_data;
+
+	if( !stage->overlay )
+		return stage->net->Process((float*)frame->rgba, frame->width, frame->height);
+
+	if( !stage->net->Overlay((float*)frame->rgba, (float*)frame->resultsCUDA, frame->width, frame->height) )
+	{
+		printf("segnet-camera:  failed to process segmentation overlay.\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+// rescale the overlay's pixel intensities for display
+static bool normalize( pipelineFrame* frame, void* user_data )
+{
+	return !CUDA_FAILED(cudaNormalizeRGBA((float4*)frame->resultsCUDA, make_float2(0.0f, 255.0f), 
+								   (float4*)frame->resultsCUDA, make_float2(0.0f, 1.0f), 
+		 						   frame->width, frame->height));
+}
+
+
 int main( int argc, char** argv )
 {
 	printf("segnet-camera\n  args (%i):  ", argc);
@@ -64,11 +100,14 @@ int main( int argc, char** argv )
 	if( signal(SIGINT, sig_handler) == SIG_ERR )
 		printf("\ncan't catch SIGINT\n");
 
+	// record where the time of each frame goes (--trace=<file>)
+	trace::Init(argc, argv);
+
 
 	/*
 	 * create the camera device
 	 */
-	gstCamera* camera = gstCamera::Create(DEFAULT_CAMERA);
+	camera* camera = camera::Create(argc, argv, DEFAULT_CAMERA);
 	
 	if( !camera )
 	{
@@ -96,34 +135,44 @@ int main( int argc, char** argv )
 	// set alpha blending value for classes that don't explicitly already have an alpha	
 	net->SetGlobalAlpha(120);
 
-	// allocate segmentation overlay output buffer
-	float* outCPU  = NULL;
-	float* outCUDA = NULL;
+	
+	/*
+	 * create the sinks (--sink=display://,shm://<name>,null:// or --output=<uri>), which
+	 * is an openGL window by default if there's an X server, or else nothing
+	 */
+	displaySink* sink = displaySink::Create(argc, argv, camera->GetWidth(), camera->GetHeight());
 
-	if( !cudaAllocMapped((void**)&outCPU, (void**)&outCUDA, camera->GetWidth() * camera->GetHeight() * sizeof(float) * 4) )
+	if( !sink )
 	{
-		printf("segnet-camera:  failed to allocate CUDA memory for output image (%ux%u)\n", camera->GetWidth(), camera->GetHeight());
+		printf("\nsegnet-camera:  failed to create display sinks\n");
 		return 0;
 	}
 
-	
+	segmentStage stage;
+
+	stage.net     = net;
+	stage.overlay = sink->Needs(displaySink::FORMAT_RGBA);
+
+	const bool  normalized = sink->Needs(displaySink::FORMAT_NORMALIZED);
+	const float maxPixel   = normalized ? 1.0f : 255.0f;
+
 	/*
-	 * create openGL window
+	 * create the processing pipeline:  capture -> convert -> segment -> normalize -> sinks,
+	 * with each frame carrying its own segmentation overlay as its results (the overlay
+	 * and normalization are left out when no sink needs them)
 	 */
-	glDisplay* display = glDisplay::Create();
-	glTexture* texture = NULL;
-	
-	if( !display ) {
-		printf("\nsegnet-camera:  failed to create openGL display\n");
-	}
-	else
-	{
-		texture = glTexture::Create(camera->GetWidth(), camera->GetHeight(), GL_RGBA32F_ARB/*GL_RGBA8*/);
+	const size_t overlaySize = stage.overlay ? camera->GetWidth() * camera->GetHeight() * sizeof(float) * 4 : 0;
+
+	pipeline* pipe = pipeline::Create(camera->GetWidth(), camera->GetHeight(), overlaySize);
 
-		if( !texture )
-			printf("segnet-camera:  failed to create openGL texture\n");
+	if( !pipe || !pipe->AddCamera(camera) ||
+	    !pipe->AddStage("segment", segment, &stage, 1, pipeline::DROP_OLDEST) ||
+	    (normalized && !pipe->AddStage("normalize", normalize, NULL, 2, pipeline::BACKPRESSURE)) )
+	{
+		printf("segnet-camera:  failed to create the processing pipeline\n");
+		return 0;
 	}
-	
+
 
 	/*
 	 * start streaming
@@ -136,72 +185,55 @@ int main( int argc, char** argv )
 	
 	printf("\nsegnet-camera:  camera open for streaming\n");
 	
+	if( !pipe->Start() )
+	{
+		printf("segnet-camera:  failed to start the processing pipeline\n");
+		return 0;
+	}
+
 	
 	/*
-	 * processing loop
+	 * render loop
 	 */
-	float confidence = 0.0f;
-	
 	while( !signal_recieved )
 	{
-		void* imgCPU  = NULL;
-		void* imgCUDA = NULL;
-		
-		// get the latest frame
-		if( !camera->Capture(&imgCPU, &imgCUDA, 1000) )
-			printf("\nsegnet-camera:  failed to capture frame\n");
-
-		// convert from YUV to RGBA
-		void* imgRGBA = NULL;
-		
-		if( !camera->ConvertRGBA(imgCUDA, &imgRGBA, true) )
-			printf("segnet-camera:  failed to convert from NV12 to RGBA\n");
+		pipelineFrame* frame = NULL;
 
-		// process image overlay
-		if( !net->Overlay((float*)imgRGBA, (float*)outCUDA, camera->GetWidth(), camera->GetHeight()) )
+		// get the latest processed frame
+		if( !pipe->Next(&frame, 1000) )
 		{
-			printf("segnet-console:  failed to process segmentation overlay.\n");
+			if( pipe->IsEOS() )
+				break;
+
 			continue;
 		}
 		
-		// update display
-		if( display != NULL )
+		TRACE_FRAME(frame->traceFrame);
+
+		// update the window, encoder, etc.
+		if( stage.overlay )
 		{
+			TRACE_ZONE("display");
+
 			char str[256];
-			sprintf(str, "TensorRT build %x | %s | %04.1f FPS", NV_GIE_VERSION, net->HasFP16() ? "FP16" : "FP32", display->GetFPS());
-			//sprintf(str, "GIE build %x | %s | %04.1f FPS | %05.2f%% %s", NV_GIE_VERSION, net->GetNetworkName(), display->GetFPS(), confidence * 100.0f, net->GetClassDesc(img_class));
-			display->SetTitle(str);	
-	
-			// next frame in the window
-			display->UserEvents();
-			display->BeginRender();
-
-			if( texture != NULL )
-			{
-				// rescale image pixel intensities for display
-				CUDA(cudaNormalizeRGBA((float4*)outCUDA, make_float2(0.0f, 255.0f), 
-								   (float4*)outCUDA, make_float2(0.0f, 1.0f), 
-		 						   camera->GetWidth(), camera->GetHeight()));
-
-				// map from CUDA to openGL using GL interop
-				void* tex_map = texture->MapCUDA();
-
-				if( tex_map != NULL )
-				{
-					cudaMemcpy(tex_map, outCUDA, texture->GetSize(), cudaMemcpyDeviceToDevice);
-					texture->Unmap();
-				}
-
-				// draw the texture
-				texture->Render(10, 10);		
-			}
-
-			display->EndRender();
+			sprintf(str, "TensorRT build %x | %s", NV_GIE_VERSION, net->HasFP16() ? "FP16" : "FP32");
+			sink->SetStatus(str);
+
+			sink->Render((float4*)frame->resultsCUDA, frame->width, frame->height, maxPixel);
 		}
+
+		pipe->Release(frame);
 	}
 	
 	printf("\nsegnet-camera:  un-initializing video device\n");
 	
+
+	/*
+	 * stop the pipeline, which hands the camera its frames back
+	 */
+	delete pipe;
+	trace::Shutdown();
+
 	
 	/*
 	 * shutdown the camera device
@@ -212,10 +244,10 @@ int main( int argc, char** argv )
 		camera = NULL;
 	}
 
-	if( display != NULL )
+	if( sink != NULL )
 	{
-		delete display;
-		display = NULL;
+		delete sink;
+		sink = NULL;
 	}
 	
 	printf("segnet-camera:  video device has been un-initialized.\n");
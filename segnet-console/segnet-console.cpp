@@ -24,9 +24,11 @@
 
 #include "loadImage.h"
 #include "commandLine.h"
+#include "batchProcessor.h"
 #include "cudaMappedMemory.h"
 
 #include <sys/time.h>
+#include <vector>
 
 
 uint64_t current_timestamp() {
@@ -36,6 +38,69 @@ uint64_t current_timestamp() {
 }
 
 
+// segment a directory or list of images (--images=<dir|list>)
+static int processBatch( segNet* net, int argc, char** argv )
+{
+	batchProcessor* batch = batchProcessor::Create(argc, argv);
+
+	if( !batch )
+	{
+		printf("segnet-console:  failed to create batch processor\n");
+		return 0;
+	}
+
+	const uint32_t numClasses = net->GetNumClasses();
+
+	std::vector<segNet::ClassStats> stats(numClasses);
+	std::vector<batchResult> results(numClasses);
+
+	net->SetGlobalAlpha(120);
+
+	batchImage* image = NULL;
+
+	// segNet has no batched entry point, so inference runs one image at a time
+	// while the decoding and writing overlap with it in the other threads
+	while( batch->Next(&image) )
+	{
+		// the overlay is blended in-place, and only when the images are being saved
+		const bool result = batch->HasOutput() ? net->Overlay(image->cuda, image->cuda, image->width, image->height)
+									  : net->Process(image->cuda, image->width, image->height);
+
+		if( !result || !net->ClassHistogram(image->width, image->height, stats.data()) )
+		{
+			printf("segnet-console:  failed to process '%s'\n", image->filename);
+			batch->Complete(image, NULL, 0);
+			continue;
+		}
+
+		// report the fraction and extents of each class present
+		const float pixels = float(image->width * image->height);
+		uint32_t numResults = 0;
+
+		for( uint32_t n=0; n < numClasses; n++ )
+		{
+			if( stats[n].count == 0 )
+				continue;
+
+			batchResult& r = results[numResults++];
+
+			r.classID    = n;
+			r.desc       = net->GetClassLabel(n);
+			r.confidence = stats[n].count / pixels;
+			r.left       = stats[n].left;
+			r.top        = stats[n].top;
+			r.right      = stats[n].right;
+			r.bottom     = stats[n].bottom;
+		}
+
+		batch->Complete(image, results.data(), numResults);
+	}
+
+	delete batch;
+	return 0;
+}
+
+
 // main entry point
 int main( int argc, char** argv )
 {
@@ -47,6 +112,9 @@ int main( int argc, char** argv )
 	printf("\n\n");
 	
 	
+	// process a directory or list of images instead (--images=<dir|list>)
+	const bool batchMode = batchProcessor::IsRequested(argc, argv);
+
 	// retrieve filename arguments
 	if( argc < 2 )
 	{
@@ -54,7 +122,7 @@ int main( int argc, char** argv )
 		return 0;
 	}
 
-	if( argc < 3 )
+	if( argc < 3 && !batchMode )
 	{
 		printf("segnet-console:   output image filename required\n");
 		return 0;
@@ -72,6 +140,13 @@ int main( int argc, char** argv )
 		printf("segnet-console:   failed to initialize segnet\n");
 		return 0;
 	}
+
+	if( batchMode )
+	{
+		const int result = processBatch(net, argc, argv);
+		delete net;
+		return result;
+	}
 	
 	// enable layer timings for the console application
 	net->EnableProfiler();
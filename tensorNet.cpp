@@ -23,10 +23,14 @@
 #include "tensorNet.h"
 #include "cudaMappedMemory.h"
 #include "cudaResize.h"
+#include "trace.h"
 
 #include <iostream>
 #include <fstream>
 
+#include <strings.h>
+#include <time.h>
+
 
 #if NV_TENSORRT_MAJOR > 1
 	#define CREATE_INFER_BUILDER nvinfer1::createInferBuilder
@@ -37,6 +41,36 @@
 #endif
 
 
+precisionType tensorNet::sDefaultPrecision = TYPE_FASTEST;
+
+
+// precisionTypeToStr
+const char* precisionTypeToStr( precisionType type )
+{
+	switch(type)
+	{
+		case TYPE_FP32:	return "fp32";
+		case TYPE_FP16:	return "fp16";
+		default:			return "fastest";
+	}
+}
+
+
+// precisionTypeFromStr
+precisionType precisionTypeFromStr( const char* str )
+{
+	if( !str )
+		return TYPE_FASTEST;
+
+	if( strcasecmp(str, "fp32") == 0 || strcasecmp(str, "float") == 0 )
+		return TYPE_FP32;
+	else if( strcasecmp(str, "fp16") == 0 || strcasecmp(str, "half") == 0 )
+		return TYPE_FP16;
+
+	return TYPE_FASTEST;
+}
+
+
 // constructor
 tensorNet::tensorNet()
 {
@@ -54,6 +88,10 @@ tensorNet::tensorNet()
 	mEnableProfiler = false;
 	mEnableFP16     = false;
 	mOverride16     = false;
+	mPrecision      = sDefaultPrecision;
+	mEnableTiming   = false;
+	mExecuteBegin   = 0;
+	mExecuteEnd     = 0;
 
 #if NV_TENSORRT_MAJOR < 2
 	memset(&mInputDims, 0, sizeof(Dims3));
@@ -102,6 +140,58 @@ void tensorNet::DisableFP16()
 }
 
 
+// EnableTiming
+void tensorNet::EnableTiming( bool enable )
+{
+	mEnableTiming = enable;
+}
+
+
+// timestamp
+static inline uint64_t timestamp()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+
+// execute
+bool tensorNet::execute( uint32_t batchSize, void** buffers )
+{
+	TRACE_ZONE("execute");
+
+	if( mEnableTiming )
+	{
+		if( CUDA_FAILED(cudaStreamSynchronize(0)) )
+			return false;
+
+		mExecuteBegin = timestamp();
+	}
+
+	const bool result = mContext->execute(batchSize, buffers);
+
+	if( mEnableTiming )
+		mExecuteEnd = timestamp();
+
+	return result;
+}
+
+
+// SetDefaultPrecision
+void tensorNet::SetDefaultPrecision( precisionType type )
+{
+	sDefaultPrecision = type;
+}
+
+
+// GetDefaultPrecision
+precisionType tensorNet::GetDefaultPrecision()
+{
+	return sDefaultPrecision;
+}
+
+
 // Create an optimized GIE network from caffe prototxt and model file
 bool tensorNet::ProfileModel(const std::string& deployFile,			   // name for caffe prototxt
 					         const std::string& modelFile,			   // name for model 
@@ -120,8 +210,8 @@ bool tensorNet::ProfileModel(const std::string& deployFile,			   // name for caf
 	// parse the caffe model to populate the network, then set the outputs
 	nvcaffeparser1::ICaffeParser* parser = nvcaffeparser1::createCaffeParser();
 
-	mEnableFP16 = (mOverride16 == true) ? false : builder->platformHasFastFp16();
-	printf(LOG_GIE "platform %s FP16 support.\n", mEnableFP16 ? "has" : "does not have");
+	mEnableFP16 = (mOverride16 == true || mPrecision == TYPE_FP32) ? false : builder->platformHasFastFp16();
+	printf(LOG_GIE "platform %s FP16 support.\n", builder->platformHasFastFp16() ? "has" : "does not have");
 	printf(LOG_GIE "loading %s %s\n", deployFile.c_str(), modelFile.c_str());
 	
 	nvinfer1::DataType modelDataType = mEnableFP16 ? nvinfer1::DataType::kHALF : nvinfer1::DataType::kFLOAT; // create a 16-bit model if it's natively supported
@@ -225,11 +315,27 @@ bool tensorNet::LoadNetwork( const char* prototxt_path, const char* model_path,
 	std::stringstream gieModelStream;
 	gieModelStream.seekg(0, gieModelStream.beg);
 
+	// the engine is built for a set of outputs (i.e. with or without an embedding layer),
+	// so a hash of their names keeps the engines of different sets side by side (FNV-1a)
+	uint32_t outputs_hash = 2166136261u;
+
+	for( size_t n=0; n < output_blobs.size(); n++ )
+	{
+		for( size_t c=0; c <= output_blobs[n].size(); c++ )
+			outputs_hash = (outputs_hash ^ (uint8_t)output_blobs[n].c_str()[c]) * 16777619u;
+	}
+
 	char cache_path[512];
-	sprintf(cache_path, "%s.%u.tensorcache", model_path, maxBatchSize);
+
+	if( mPrecision == TYPE_FASTEST )
+		sprintf(cache_path, "%s.%u.%08x.tensorcache", model_path, maxBatchSize, outputs_hash);
+	else
+		sprintf(cache_path, "%s.%u.%s.%08x.tensorcache", model_path, maxBatchSize, precisionTypeToStr(mPrecision), outputs_hash);
+
 	printf(LOG_GIE "attempting to open cache file %s\n", cache_path);
 	
 	std::ifstream cache( cache_path );
+	const bool cache_loaded = (bool)cache;
 
 	if( !cache )
 	{
@@ -260,8 +366,8 @@ bool tensorNet::LoadNetwork( const char* prototxt_path, const char* model_path,
 		
 		if( builder != NULL )
 		{
-			mEnableFP16 = !mOverride16 && builder->platformHasFastFp16();
-			printf(LOG_GIE "platform %s FP16 support.\n", mEnableFP16 ? "has" : "does not have");
+			mEnableFP16 = !mOverride16 && mPrecision != TYPE_FP32 && builder->platformHasFastFp16();
+			printf(LOG_GIE "platform %s FP16 support.\n", builder->platformHasFastFp16() ? "has" : "does not have");
 			builder->destroy();	
 		}
 	}
@@ -309,6 +415,39 @@ bool tensorNet::LoadNetwork( const char* prototxt_path, const char* model_path,
 		printf(LOG_GIE "failed to create CUDA engine\n");
 		return 0;
 	}
+
+	// the outputs are in the cache's name, but check anyway in case the file was replaced or is from an older build
+	if( cache_loaded )
+	{
+		bool stale = (engine->getNbBindings() != (int)(1 + output_blobs.size()));
+
+		if( stale )
+			printf(LOG_GIE "cached engine has %i bindings, expected %zu, deleting %s and profiling again\n", engine->getNbBindings(), 1 + output_blobs.size(), cache_path);
+
+		for( size_t n=0; n < output_blobs.size() && !stale; n++ )
+		{
+			if( engine->getBindingIndex(output_blobs[n].c_str()) >= 0 )
+				continue;
+
+			printf(LOG_GIE "cached engine is missing output '%s', deleting %s and profiling again\n", output_blobs[n].c_str(), cache_path);
+			stale = true;
+		}
+
+		if( stale )
+		{
+			engine->destroy();
+			infer->destroy();
+
+			if( remove(cache_path) != 0 )
+			{
+				printf(LOG_GIE "failed to delete stale cache file %s\n", cache_path);
+				return 0;
+			}
+
+			// with the cache gone, this profiles the network and recurses no further
+			return LoadNetwork(prototxt_path, model_path, mean_path, input_blob, output_blobs, maxBatchSize);
+		}
+	}
 	
 	nvinfer1::IExecutionContext* context = engine->createExecutionContext();
 	
@@ -51,6 +51,30 @@ typedef nvinfer1::Dims3 Dims3;
 #endif
 
 
+/**
+ * Precision of a network's engine.
+ * @ingroup deepVision
+ */
+enum precisionType
+{
+	TYPE_FASTEST = 0,	/**< FP16 when the platform has fast FP16 support, otherwise FP32 */
+	TYPE_FP32,		/**< 32-bit floating point */
+	TYPE_FP16		/**< 16-bit floating point, falling back to FP32 on platforms without fast FP16 */
+};
+
+/**
+ * Convert a precision to a string ("fastest", "fp32" or "fp16")
+ * @ingroup deepVision
+ */
+const char* precisionTypeToStr( precisionType type );
+
+/**
+ * Parse a precision from a string, returning TYPE_FASTEST if it wasn't recognized.
+ * @ingroup deepVision
+ */
+precisionType precisionTypeFromStr( const char* str );
+
+
 /**
  * Abstract class for loading a tensor network with TensorRT.
  * For example implementations, @see imageNet and @see detectNet
@@ -110,6 +134,38 @@ public:
 	 */
 	inline bool HasFP16() const		{ return mEnableFP16; }
 
+	/**
+	 * Set the precision of the networks loaded from now on (TYPE_FASTEST by default).
+	 * Engines of each precision are cached separately.
+	 */
+	static void SetDefaultPrecision( precisionType type );
+
+	/**
+	 * Retrieve the precision the networks are loaded with.
+	 */
+	static precisionType GetDefaultPrecision();
+
+	/**
+	 * Retrieve the maximum batch size the network was optimized for.
+	 */
+	inline uint32_t GetMaxBatchSize() const	{ return mMaxBatchSize; }
+
+	/**
+	 * Time where each call spends its time.  The stream is synchronized before the engine
+	 * runs, so that the preprocessing kernels aren't counted as inference.
+	 */
+	void EnableTiming( bool enable=true );
+
+	/**
+	 * When timing is enabled, the time the last call's engine started (CLOCK_MONOTONIC nanoseconds).
+	 */
+	inline uint64_t GetExecuteBegin() const	{ return mExecuteBegin; }
+
+	/**
+	 * When timing is enabled, the time the last call's engine finished (CLOCK_MONOTONIC nanoseconds).
+	 */
+	inline uint64_t GetExecuteEnd() const	{ return mExecuteEnd; }
+
 	
 protected:
 
@@ -132,6 +188,11 @@ protected:
 				    const std::vector<std::string>& outputs,
 				    uint32_t maxBatchSize, std::ostream& modelStream);
 				
+	/**
+	 * Run the engine on a batch, timing it if EnableTiming() was called.
+	 */
+	bool execute( uint32_t batchSize, void** buffers );
+
 	/**
 	 * Prefix used for tagging printed log output
 	 */
@@ -194,6 +255,13 @@ protected:
 	bool     mEnableDebug;
 	bool	 mEnableFP16;
 	bool     mOverride16;
+
+	precisionType mPrecision;
+
+	bool     mEnableTiming;
+	uint64_t mExecuteBegin;
+	uint64_t mExecuteEnd;
+	static precisionType sDefaultPrecision;
 	
 	Dims3 mInputDims;
 	
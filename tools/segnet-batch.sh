@@ -2,12 +2,8 @@
 
 SEQ_IN=$1
 
-FILES="$SEQ_IN/*.png"
-
-for f in $FILES
-do
-	echo "Processing $f"
-	./segnet-console $f $f $2
-done
-
-
+# segment every image in the directory with a single instance of the network,
+# overwriting each image with its overlay (the pretrained network can be given as the 2nd
+# argument, i.e. fcn-alexnet-cityscapes-hd, which segnet-console takes positionally)
+echo "Processing $SEQ_IN"
+./segnet-console --images=$SEQ_IN --output_dir=$SEQ_IN $2
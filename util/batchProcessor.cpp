@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "batchProcessor.h"
+#include "commandLine.h"
+#include "loadImage.h"
+#include "cudaMappedMemory.h"
+
+#include <QMutex>
+#include <QThread>
+
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+
+// queued to the writer thread by Complete()
+struct batchProcessor::writeJob
+{
+	batchImage* image;
+	bool        failed;
+	std::vector<batchResult> results;
+};
+
+
+// decoding thread
+class batchDecoder : public QThread
+{
+public:
+	batchDecoder( batchProcessor* processor ) : mProcessor(processor)	{ }
+
+protected:
+	virtual void run()		{ mProcessor->decode(); }
+
+	batchProcessor* mProcessor;
+};
+
+
+// writing thread
+class batchWriter : public QThread
+{
+public:
+	batchWriter( batchProcessor* processor ) : mProcessor(processor)	{ }
+
+protected:
+	virtual void run()		{ mProcessor->write(); }
+
+	batchProcessor* mProcessor;
+};
+
+
+// timestamp in nanoseconds
+static inline uint64_t batchTime()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+
+// write a string with CSV quoting
+static void writeCSV( FILE* file, const char* str )
+{
+	fputc('"', file);
+
+	for( const char* c=str; *c != '\0'; c++ )
+	{
+		if( *c == '"' )
+			fputc('"', file);
+
+		fputc(*c, file);
+	}
+
+	fputc('"', file);
+}
+
+
+// write a string with JSON escaping
+static void writeJSON( FILE* file, const char* str )
+{
+	fputc('"', file);
+
+	for( const char* c=str; *c != '\0'; c++ )
+	{
+		if( *c == '"' || *c == '\\' )
+			fputc('\\', file);
+
+		if( (unsigned char)*c < 0x20 )
+			fprintf(file, "\\u%04x", *c);
+		else
+			fputc(*c, file);
+	}
+
+	fputc('"', file);
+}
+
+
+// constructor
+batchProcessor::batchProcessor()
+{
+	mList           = NULL;
+	mResults        = NULL;
+	mResultsJSON    = false;
+	mResultsWritten = 0;
+	mWriter         = NULL;
+	mDecoded        = NULL;
+	mWrites         = NULL;
+	mPending        = NULL;
+	mMutex          = new QMutex();
+	mNextIndex      = 0;
+	mActiveDecoders = 0;
+	mDecodeFailures = 0;
+	mProcessed      = 0;
+	mFailed         = 0;
+	mStartTime      = 0;
+	mMaxBuffers     = 0;
+}
+
+
+// destructor
+batchProcessor::~batchProcessor()
+{
+	// stop decoding, in case the caller didn't retrieve every image
+	if( mDecoded != NULL )
+		mDecoded->Close();
+
+	for( size_t n=0; n < mDecoders.size(); n++ )
+	{
+		mDecoders[n]->wait();
+		delete mDecoders[n];
+	}
+
+	if( mPending != NULL )
+		freeImage(mPending);
+
+	batchImage* image = NULL;
+
+	while( mDecoded != NULL && mDecoded->TryPop(&image) )
+		freeImage(image);
+
+	// flush the pending writes
+	if( mWrites != NULL )
+		mWrites->Close();
+
+	if( mWriter != NULL )
+	{
+		mWriter->wait();
+		delete mWriter;
+	}
+
+	if( mResults != NULL )
+	{
+		if( mResultsJSON )
+			fprintf(mResults, "\n]\n");
+
+		fclose(mResults);
+		printf("batchProcessor -- wrote results to '%s'\n", mResultsPath.c_str());
+	}
+
+	if( mStartTime != 0 )
+	{
+		const double seconds = double(batchTime() - mStartTime) * 1.0e-9;
+
+		printf("batchProcessor -- processed %u images in %.2f seconds (%.2f images/sec)\n", mProcessed, seconds, seconds > 0.0 ? mProcessed / seconds : 0.0);
+
+		if( mDecodeFailures > 0 || mFailed > 0 )
+			printf("batchProcessor -- %u images failed to load, %u failed to process\n", mDecodeFailures, mFailed);
+	}
+
+	for( size_t n=0; n < mBuffers.size(); n++ )
+		CUDA(cudaFreeHost(mBuffers[n].cpu));
+
+	delete mDecoded;
+	delete mWrites;
+	delete mMutex;
+	delete mList;
+}
+
+
+// IsRequested
+bool batchProcessor::IsRequested( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+	return cmdLine.GetString("images") != NULL;
+}
+
+
+// Create
+batchProcessor* batchProcessor::Create( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	const char* images = cmdLine.GetString("images");
+
+	if( !images )
+		return NULL;
+
+	int threads    = cmdLine.GetInt("threads");
+	int queueDepth = cmdLine.GetInt("queue_depth");
+
+	if( threads < 1 )
+		threads = 4;
+
+	if( queueDepth < 1 )
+		queueDepth = 16;
+
+	return Create(images, cmdLine.GetString("output_dir"), cmdLine.GetString("results"), threads, queueDepth);
+}
+
+
+// Create
+batchProcessor* batchProcessor::Create( const char* images, const char* outputDir, const char* results, uint32_t threads, uint32_t queueDepth )
+{
+	imageList* list = imageList::Create(images);
+
+	if( !list )
+		return NULL;
+
+	batchProcessor* batch = new batchProcessor();
+
+	batch->mList = list;
+
+	if( outputDir != NULL )
+	{
+		if( mkdir(outputDir, 0755) != 0 && errno != EEXIST )
+		{
+			printf("batchProcessor -- failed to create output directory '%s'\n", outputDir);
+			delete batch;
+			return NULL;
+		}
+
+		batch->mOutputDir = outputDir;
+	}
+
+	if( results != NULL )
+	{
+		batch->mResults = fopen(results, "w");
+
+		if( !batch->mResults )
+		{
+			printf("batchProcessor -- failed to open '%s' for writing\n", results);
+			delete batch;
+			return NULL;
+		}
+
+		const char* ext = strrchr(results, '.');
+
+		batch->mResultsPath = results;
+		batch->mResultsJSON = (ext != NULL && strcasecmp(ext, ".json") == 0);
+
+		if( batch->mResultsJSON )
+			fprintf(batch->mResults, "[");
+		else
+			fprintf(batch->mResults, "image,class,description,confidence,left,top,right,bottom\n");
+	}
+
+	if( threads == 0 )
+		threads = 1;
+
+	batch->mDecoded        = new threadQueue<batchImage*>(queueDepth);
+	batch->mWrites         = new threadQueue<writeJob*>(queueDepth);
+	batch->mActiveDecoders = threads;
+	batch->mMaxBuffers     = queueDepth * 2 + threads;
+	batch->mStartTime      = batchTime();
+
+	printf("batchProcessor -- processing %u images with %u decoding threads\n", list->GetCount(), threads);
+
+	for( uint32_t n=0; n < threads; n++ )
+	{
+		batch->mDecoders.push_back(new batchDecoder(batch));
+		batch->mDecoders[n]->start();
+	}
+
+	batch->mWriter = new batchWriter(batch);
+	batch->mWriter->start();
+
+	return batch;
+}
+
+
+// decode
+void batchProcessor::decode()
+{
+	const uint32_t count = mList->GetCount();
+
+	while( true )
+	{
+		mMutex->lock();
+		const uint32_t index = mNextIndex++;
+		mMutex->unlock();
+
+		if( index >= count )
+			break;
+
+		batchImage* image = new batchImage();
+
+		image->index    = index;
+		image->filename = mList->GetPath(index);
+		image->cpu      = NULL;
+		image->cuda     = NULL;
+		image->width    = 0;
+		image->height   = 0;
+		image->size     = 0;
+
+		// decode into a recycled buffer, sized from the image header
+		int width  = 0;
+		int height = 0;
+
+		if( !loadImageSize(image->filename, &width, &height) || !allocImage(image, width * height * sizeof(float4)) ||
+		    !loadImageRGBA(image->filename, (float4*)image->cpu, image->size, &image->width, &image->height) )
+		{
+			printf("batchProcessor -- failed to load image '%s'\n", image->filename);
+
+			mMutex->lock();
+			mDecodeFailures++;
+			mMutex->unlock();
+
+			freeImage(image);
+			continue;
+		}
+
+		// blocks while the queue is full, and fails once it's closed
+		if( !mDecoded->Push(image) )
+		{
+			freeImage(image);
+			break;
+		}
+	}
+
+	// the last decoder to finish lets the consumer know there are no more images
+	mMutex->lock();
+	const bool last = (--mActiveDecoders == 0);
+	mMutex->unlock();
+
+	if( last )
+		mDecoded->Close();
+}
+
+
+// NextBatch
+uint32_t batchProcessor::NextBatch( batchImage** images, uint32_t maxImages )
+{
+	if( !images || maxImages == 0 )
+		return 0;
+
+	uint32_t count = 0;
+
+	if( mPending != NULL )
+	{
+		images[count++] = mPending;
+		mPending = NULL;
+	}
+	else if( mDecoded->Pop(&images[0]) )
+	{
+		count++;
+	}
+	else
+	{
+		return 0;
+	}
+
+	// batches need to be the same resolution, so images of a different size are kept for next time
+	batchImage* image = NULL;
+
+	while( count < maxImages && mDecoded->TryPop(&image) )
+	{
+		if( image->width != images[0]->width || image->height != images[0]->height )
+		{
+			mPending = image;
+			break;
+		}
+
+		images[count++] = image;
+	}
+
+	return count;
+}
+
+
+// Next
+bool batchProcessor::Next( batchImage** image )
+{
+	return NextBatch(image, 1) == 1;
+}
+
+
+// Complete
+void batchProcessor::Complete( batchImage* image, const batchResult* results, uint32_t numResults )
+{
+	if( !image )
+		return;
+
+	writeJob* job = new writeJob();
+
+	job->image  = image;
+	job->failed = (results == NULL);
+
+	if( results != NULL )
+		job->results.assign(results, results + numResults);
+
+	if( job->failed )
+		mFailed++;
+	else
+		mProcessed++;
+
+	// make sure the annotations have finished drawing before the writer reads the image
+	if( HasOutput() && !job->failed )
+		CUDA(cudaDeviceSynchronize());
+
+	if( !mWrites->Push(job) )
+	{
+		freeImage(image);
+		delete job;
+	}
+}
+
+
+// write
+void batchProcessor::write()
+{
+	writeJob* job = NULL;
+
+	while( mWrites->Pop(&job) )
+	{
+		if( !job->failed )
+		{
+			if( HasOutput() )
+			{
+				const char* name = strrchr(job->image->filename, '/');
+				const std::string path = mOutputDir + "/" + (name ? name + 1 : job->image->filename);
+
+				if( !saveImageRGBA(path.c_str(), (float4*)job->image->cpu, job->image->width, job->image->height) )
+					printf("batchProcessor -- failed to save '%s'\n", path.c_str());
+			}
+
+			if( mResults != NULL )
+				writeResults(job);
+		}
+
+		freeImage(job->image);
+		delete job;
+	}
+}
+
+
+// writeResults
+void batchProcessor::writeResults( const writeJob* job )
+{
+	const char* filename = job->image->filename;
+	const uint32_t numResults = job->results.size();
+
+	if( mResultsJSON )
+	{
+		fprintf(mResults, "%s\n  { \"image\": ", mResultsWritten > 0 ? "," : "");
+		writeJSON(mResults, filename);
+		fprintf(mResults, ", \"results\": [");
+
+		for( uint32_t n=0; n < numResults; n++ )
+		{
+			const batchResult& r = job->results[n];
+
+			fprintf(mResults, "%s\n    { \"class\": %i, \"description\": ", n > 0 ? "," : "", r.classID);
+			writeJSON(mResults, r.desc != NULL ? r.desc : "");
+			fprintf(mResults, ", \"confidence\": %f, \"box\": [%.1f, %.1f, %.1f, %.1f] }", r.confidence, r.left, r.top, r.right, r.bottom);
+		}
+
+		fprintf(mResults, numResults > 0 ? "\n  ] }" : "] }");
+	}
+	else
+	{
+		for( uint32_t n=0; n < numResults; n++ )
+		{
+			const batchResult& r = job->results[n];
+
+			writeCSV(mResults, filename);
+			fprintf(mResults, ",%i,", r.classID);
+			writeCSV(mResults, r.desc != NULL ? r.desc : "");
+			fprintf(mResults, ",%f,%.1f,%.1f,%.1f,%.1f\n", r.confidence, r.left, r.top, r.right, r.bottom);
+		}
+	}
+
+	mResultsWritten++;
+}
+
+
+// allocImage
+bool batchProcessor::allocImage( batchImage* image, size_t size )
+{
+	if( size == 0 )
+		return false;
+
+	// take the smallest free buffer that fits
+	mMutex->lock();
+
+	int best = -1;
+
+	for( size_t n=0; n < mBuffers.size(); n++ )
+	{
+		if( mBuffers[n].size >= size && (best < 0 || mBuffers[n].size < mBuffers[best].size) )
+			best = n;
+	}
+
+	if( best >= 0 )
+	{
+		image->cpu  = mBuffers[best].cpu;
+		image->cuda = mBuffers[best].cuda;
+		image->size = mBuffers[best].size;
+
+		mBuffers.erase(mBuffers.begin() + best);
+	}
+
+	mMutex->unlock();
+
+	if( best >= 0 )
+		return true;
+
+	if( !cudaAllocMapped((void**)&image->cpu, (void**)&image->cuda, size) )
+		return false;
+
+	image->size = size;
+	return true;
+}
+
+
+// freeImage
+void batchProcessor::freeImage( batchImage* image )
+{
+	if( !image )
+		return;
+
+	// return the buffer to the pool, unless it's already holding enough
+	if( image->cpu != NULL )
+	{
+		mMutex->lock();
+
+		const bool recycle = (mBuffers.size() < mMaxBuffers);
+
+		if( recycle )
+		{
+			mappedBuffer buffer;
+
+			buffer.cpu  = image->cpu;
+			buffer.cuda = image->cuda;
+			buffer.size = image->size;
+
+			mBuffers.push_back(buffer);
+		}
+
+		mMutex->unlock();
+
+		if( !recycle )
+			CUDA(cudaFreeHost(image->cpu));
+	}
+
+	delete image;
+}
+
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __BATCH_PROCESSOR_H_
+#define __BATCH_PROCESSOR_H_
+
+
+#include "imageList.h"
+#include "threadQueue.h"
+
+#include <stdio.h>
+
+
+class QThread;
+class QMutex;
+
+
+/**
+ * Image decoded by batchProcessor, in shared CPU/GPU memory.
+ * @ingroup util
+ */
+struct batchImage
+{
+	uint32_t    index;		/**< position of the image in the imageList */
+	const char* filename;	/**< path of the image on disk */
+	float*      cpu;		/**< RGBA image in CPU memory */
+	float*      cuda;		/**< RGBA image in CUDA memory */
+	int         width;		/**< width of the image in pixels */
+	int         height;	/**< height of the image in pixels */
+	size_t      size;		/**< capacity of the buffer in bytes */
+};
+
+
+/**
+ * Result of processing an image, written by batchProcessor to the results file.
+ * Classification results leave the bounding box as zero.
+ * @ingroup util
+ */
+struct batchResult
+{
+	int         classID;	/**< index of the class */
+	const char* desc;		/**< description of the class (may be NULL) */
+	float       confidence;	/**< confidence of the class (or fraction of the image, for segmentation) */
+	float       left;		/**< left of the bounding box, in pixels */
+	float       top;		/**< top of the bounding box, in pixels */
+	float       right;		/**< right of the bounding box, in pixels */
+	float       bottom;		/**< bottom of the bounding box, in pixels */
+};
+
+
+/**
+ * Runs the console tools over a directory or list of images without reloading the network.
+ *
+ * A pool of threads decodes the images into a bounded queue, which the main thread
+ * drains into batches for inference with Next() or NextBatch().  The processed
+ * images are handed back with Complete(), which queues them to a writer thread
+ * that saves the annotated image and appends the results as CSV or JSON,
+ * before freeing it.  The throughput in images/second is printed when the
+ * batchProcessor is deleted.  The image buffers are pinned memory recycled between
+ * images, so there is no allocation per image once the pool has warmed up.
+ *
+ * The command line options are:
+ *
+ *   --images=<dir|list>     directory, list file or image to process
+ *   --output_dir=<dir>      directory to write the annotated images to (optional)
+ *   --results=<file>        results file, in JSON if it ends in .json or CSV otherwise (optional)
+ *   --threads=<N>           number of decoding threads (default 4)
+ *   --queue_depth=<N>       number of decoded images to buffer (default 16)
+ *
+ * @ingroup util
+ */
+class batchProcessor
+{
+public:
+	/**
+	 * Create from the command line options listed above.
+	 * @returns NULL if --images wasn't specified, or on error.
+	 */
+	static batchProcessor* Create( int argc, char** argv );
+
+	/**
+	 * Create from a directory, list file or single image.
+	 */
+	static batchProcessor* Create( const char* images, const char* outputDir=NULL, const char* results=NULL, 
+							 uint32_t threads=4, uint32_t queueDepth=16 );
+
+	/**
+	 * Query if batch mode was requested on the command line (--images)
+	 */
+	static bool IsRequested( int argc, char** argv );
+
+	/**
+	 * Wait for the pending writes to finish, print the statistics and release the threads.
+	 */
+	~batchProcessor();
+
+	/**
+	 * Retrieve the next decoded image, waiting for it if needed.
+	 * @returns false once every image has been retrieved.
+	 */
+	bool Next( batchImage** image );
+
+	/**
+	 * Retrieve up to maxImages decoded images of the same resolution, for batched inference.
+	 * Waits for the first image, but only takes the others if they've already been decoded.
+	 * @returns the number of images retrieved, or 0 once every image has been retrieved.
+	 */
+	uint32_t NextBatch( batchImage** images, uint32_t maxImages );
+
+	/**
+	 * Hand back an image after processing it, with its results.  The image and results are
+	 * written asynchronously, after which the image is freed.  The device is synchronized
+	 * first, so any annotations drawn on the image with CUDA are included.
+	 * @param results array of numResults results (copied), or NULL if the image failed.
+	 */
+	void Complete( batchImage* image, const batchResult* results, uint32_t numResults );
+
+	/**
+	 * Query if the annotated images are being saved (--output_dir), so drawing them can be skipped otherwise.
+	 */
+	inline bool HasOutput() const				{ return mOutputDir.size() > 0; }
+
+	/**
+	 * Retrieve the number of images in the list.
+	 */
+	inline uint32_t GetCount() const			{ return mList->GetCount(); }
+
+	/**
+	 * Retrieve the list of images.
+	 */
+	inline const imageList* GetList() const		{ return mList; }
+
+protected:
+	batchProcessor();
+
+	struct writeJob;
+
+	friend class batchDecoder;
+	friend class batchWriter;
+
+	void decode();
+	void write();
+	void writeResults( const writeJob* job );
+	bool allocImage( batchImage* image, size_t size );
+	void freeImage( batchImage* image );
+
+	struct mappedBuffer
+	{
+		float* cpu;
+		float* cuda;
+		size_t size;
+	};
+
+	std::vector<mappedBuffer> mBuffers;	/**< free buffers available for recycling */
+	uint32_t                  mMaxBuffers;
+
+	imageList*   mList;
+	std::string  mOutputDir;
+	std::string  mResultsPath;
+	FILE*        mResults;
+	bool         mResultsJSON;
+	uint32_t     mResultsWritten;
+
+	std::vector<QThread*> mDecoders;
+	QThread*              mWriter;
+
+	threadQueue<batchImage*>* mDecoded;
+	threadQueue<writeJob*>*   mWrites;
+	batchImage*               mPending;
+
+	QMutex*  mMutex;
+	uint32_t mNextIndex;
+	uint32_t mActiveDecoders;
+	uint32_t mDecodeFailures;
+	uint32_t mProcessed;
+	uint32_t mFailed;
+	uint64_t mStartTime;
+};
+
+
+#endif
@@ -1,127 +1,458 @@
 #include "camera.h"
+#include "gstCamera.h"
+#include "v4l2Camera.h"
+#include "replayCamera.h"
+#include "cameraRecorder.h"
+
+#ifdef HAS_PYLON
+#include "pylonCamera.h"
+#endif
+
+#include "commandLine.h"
 #include "cudaMappedMemory.h"
 #include "cudaRGB.h"
+#include "cudaBayer.h"
 #include "cudaYUV.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
 
-bool camera::ConvertBAYER_GR8toRGBA( void* input, void** output )
+
+// constructor
+camera::camera(int height, int width)
 {
-	if( !input || !output )
+	mWidth  = width;
+	mHeight = height;
+	mDepth  = 0;
+	mSize   = 0;
+	mFormat = PIXEL_FORMAT_UNKNOWN;
+	mFrames = 0;
+	mRecorder = 0;
+
+	mLatestRGBA   = 0;
+	mRGBAZeroCopy = false;
+
+	for( uint32_t n=0; n < NUM_RGBA_BUFFERS; n++ )
+		mRGBA[n] = 0;
+}
+
+
+// destructor
+camera::~camera()
+{
+	SetRecorder(NULL);
+
+	for( uint32_t n=0; n < NUM_RGBA_BUFFERS; n++ )
+	{
+		if( !mRGBA[n] )
+			continue;
+
+		if( mRGBAZeroCopy )
+			CUDA(cudaFreeHost(mRGBA[n]));
+		else
+			CUDA(cudaFree(mRGBA[n]));
+	}
+}
+
+
+// parse the device number from "N" or "/dev/videoN"
+static bool parseDevice( const char* str, int* device )
+{
+	if( strncmp(str, "/dev/video", 10) == 0 )
+		str += 10;
+
+	char* end = NULL;
+	const long value = strtol(str, &end, 10);
+
+	if( end == str || *end != '\0' || value < 0 )
 		return false;
 
-	if( !mRGBA )
+	*device = value;
+	return true;
+}
+
+
+// Create
+camera* camera::Create( const char* uri, uint32_t width, uint32_t height )
+{
+	if( !uri || strlen(uri) == 0 )
+		uri = DEFAULT_CAMERA_URI;
+
+	std::string str = uri;
+	std::string scheme;
+	std::string options;
+
+	const size_t schemeEnd = str.find("://");
+
+	if( schemeEnd != std::string::npos )
+	{
+		scheme = str.substr(0, schemeEnd);
+		str    = str.substr(schemeEnd + 3);
+	}
+
+	const size_t optionsBegin = str.find('?');
+
+	if( optionsBegin != std::string::npos )
 	{
-		if( CUDA_FAILED(cudaMalloc(&mRGBA, mWidth * mHeight * sizeof(float4))) )
+		options = str.substr(optionsBegin + 1);
+		str     = str.substr(0, optionsBegin);
+	}
+
+	// shorthands without a scheme
+	int device = -1;
+
+	if( scheme.empty() )
+	{
+		if( strncmp(str.c_str(), "/dev/video", 10) == 0 )
+			scheme = "v4l2";
+		else if( str == "onboard" || parseDevice(str.c_str(), &device) )
+			scheme = "gst";
+	}
+
+	camera* cam = NULL;
+
+	if( scheme == "gst" )
+	{
+		if( !str.empty() && str != "onboard" && !parseDevice(str.c_str(), &device) )
 		{
-			printf(LOG_CUDA "gvCamera -- failed to allocate memory for %ux%u RGBA texture\n", mWidth, mHeight);
-			return false;
+			printf("camera -- invalid gstreamer camera '%s' (expected gst://onboard or gst://N)\n", uri);
+			return NULL;
 		}
+
+		const bool zeroCopy = (options == "zerocopy");
+
+		cam = gstCamera::Create(width > 0 ? width : gstCamera::DefaultWidth,
+							height > 0 ? height : gstCamera::DefaultHeight,
+							device, zeroCopy);
+	}
+	else if( scheme == "v4l2" )
+	{
+		cam = v4l2Camera::Create(str.c_str(), width, height);
 	}
+	else if( scheme == "file" )
+	{
+		cam = replayCamera::Create(str.c_str(), options.c_str(), width, height);
+	}
+	else if( scheme == "test" )
+	{
+		cam = replayCamera::Create("pattern", options.c_str(), width, height);
+	}
+	else if( scheme == "pylon" )
+	{
+	#ifdef HAS_PYLON
+		CameraNode node(str);
+		std::vector<CameraNode*> nodes = { &node };
 
-	// USB webcam is RGB
-	if( CUDA_FAILED(cudaBAYER_GR8toRGBA((uint8_t*)input, (float4*)mRGBA, mWidth, mHeight)) )
+		cam = new pylonCamera(nodes, height > 0 ? height : 960, width > 0 ? width : 1280);
+	#else
+		printf("camera -- '%s' requires pylon, which this build doesn't have\n", uri);
+		return NULL;
+	#endif
+	}
+	else
 	{
-		printf(LOG_CUDA "gvCamera -- conversion cudaRGBToRGBAf failed\n");
-		return false;
+		printf("camera -- unsupported camera URI '%s'\n", uri);
+		return NULL;
 	}
 
-	*output = mRGBA;
-	return true;
+	if( !cam )
+	{
+		printf("camera -- failed to create '%s'\n", uri);
+		return NULL;
+	}
+
+	printf("camera -- created '%s'  (%ux%u, %s)\n", uri, cam->GetWidth(), cam->GetHeight(), pixelFormatToStr(cam->GetPixelFormat()));
+	return cam;
 }
 
-bool camera::ConvertYUVtoRGBf( void* input, void** output )
+
+// bayer conversion shared by every camera
+bayerQuality camera::sBayerQuality = BAYER_MALVAR;
+float3       camera::sBayerBalance = make_float3(1.0f, 1.0f, 1.0f);
+
+
+// Create
+camera* camera::Create( int argc, char** argv, const char* defaultURI )
 {
-	if( !input || !output )
-		return false;
+	commandLine cmdLine(argc, argv);
+
+	const char* uri = cmdLine.GetString("camera");
+
+	camera* cam = Create(uri != NULL ? uri : defaultURI, cmdLine.GetInt("width"), cmdLine.GetInt("height"));
 
-	if( !mRGBA )
+	if( !cam )
+		return NULL;
+
+	// bayer demosaic options
+	const char* bayerStr   = cmdLine.GetString("bayer");
+	const char* balanceStr = cmdLine.GetString("white_balance");
+
+	bayerQuality quality = sBayerQuality;
+	float3       balance = sBayerBalance;
+
+	if( bayerStr != NULL )
 	{
-		if( CUDA_FAILED(cudaMalloc(&mRGBA, mWidth * mHeight * sizeof(float4))) )
-		{
-			printf(LOG_CUDA "cudaMalloc -- failed to allocate memory for %ux%u RGBA texture\n", mWidth, mHeight);
-			return false;
-		}
+		if( strcasecmp(bayerStr, "bilinear") == 0 )
+			quality = BAYER_BILINEAR;
+		else if( strcasecmp(bayerStr, "malvar") == 0 )
+			quality = BAYER_MALVAR;
+		else
+			printf("camera -- unknown --bayer=%s, expected bilinear or malvar\n", bayerStr);
 	}
 
-	// nvcamera is YUV
-	if( CUDA_FAILED(cudaYUVToRGBAf((uint8_t*)input, (float4*)mRGBA, mWidth, mHeight)) )
+	if( balanceStr != NULL && sscanf(balanceStr, "%f,%f,%f", &balance.x, &balance.y, &balance.z) != 3 )
+	{
+		printf("camera -- invalid --white_balance=%s, expected r,g,b gains\n", balanceStr);
+		balance = sBayerBalance;
+	}
+
+	SetBayerConversion(quality, balance);
+
+	// YUV colorspace (--colorspace=bt601|bt709, --color_range=limited|full)
+	const char* matrixStr = cmdLine.GetString("colorspace");
+	const char* rangeStr  = cmdLine.GetString("color_range");
+
+	if( matrixStr != NULL || rangeStr != NULL )
+	{
+		yuvColorspace colorspace = cudaYUVGetColorspace();
+
+		if( matrixStr != NULL && strcasecmp(matrixStr, "bt601") == 0 )
+			colorspace.matrix = YUV_BT601;
+		else if( matrixStr != NULL && strcasecmp(matrixStr, "bt709") == 0 )
+			colorspace.matrix = YUV_BT709;
+		else if( matrixStr != NULL )
+			printf("camera -- unknown --colorspace=%s, expected bt601 or bt709\n", matrixStr);
+
+		if( rangeStr != NULL && strcasecmp(rangeStr, "limited") == 0 )
+			colorspace.range = YUV_RANGE_LIMITED;
+		else if( rangeStr != NULL && strcasecmp(rangeStr, "full") == 0 )
+			colorspace.range = YUV_RANGE_FULL;
+		else if( rangeStr != NULL )
+			printf("camera -- unknown --color_range=%s, expected limited or full\n", rangeStr);
+
+		if( CUDA_FAILED(cudaYUVSetColorspace(colorspace)) )
+			printf(LOG_CUDA "camera -- failed to set the YUV colorspace\n");
+	}
+
+	const char* recordPath = cmdLine.GetString("record");
+
+	if( recordPath != NULL )
+	{
+		cameraRecorder* recorder = cameraRecorder::Create(recordPath);
+
+		if( !recorder )
 		{
-			printf(LOG_CUDA "cudaYUVToRGBAf -- failed convert %ux%u RGBA texture\n", mWidth, mHeight);
-			return false;
+			delete cam;
+			return NULL;
 		}
 
-	*output = mRGBA;
+		cam->SetRecorder(recorder);
+	}
 
-	return true;
+	return cam;
 }
 
-// ConvertRGBA
-bool camera::ConvertNV12toRGBA( void* input, void** output )
+
+// SetRecorder
+void camera::SetRecorder( cameraRecorder* recorder )
 {
-	if( !input || !output )
-		return false;
+	if( mRecorder == recorder )
+		return;
+
+	if( mRecorder != NULL )
+		delete mRecorder;
+
+	mRecorder = recorder;
+}
 
-	if( !mRGBA )
+
+// record
+void camera::record( const cameraFrameInfo& frame )
+{
+	if( mRecorder != NULL )
+		mRecorder->Write(frame);
+}
+
+
+// nextRGBA
+void* camera::nextRGBA( bool zeroCopy )
+{
+	if( !mRGBA[0] )
 	{
-		if( CUDA_FAILED(cudaMalloc(&mRGBA, mWidth * mHeight * sizeof(float4))) )
+		const size_t size = mWidth * mHeight * sizeof(float4);
+
+		for( uint32_t n=0; n < NUM_RGBA_BUFFERS; n++ )
 		{
-			printf(LOG_CUDA "gstCamera -- failed to allocate memory for %ux%u RGBA texture\n", mWidth, mHeight);
-			return false;
+			if( zeroCopy )
+			{
+				void* cpuPtr = NULL;
+				void* gpuPtr = NULL;
+
+				if( !cudaAllocMapped(&cpuPtr, &gpuPtr, size) )
+				{
+					printf(LOG_CUDA "camera -- failed to allocate zeroCopy memory for %ux%u RGBA texture\n", mWidth, mHeight);
+					return NULL;
+				}
+
+				if( cpuPtr != gpuPtr )
+				{
+					printf(LOG_CUDA "camera -- zeroCopy memory has different pointers, please use a UVA-compatible GPU\n");
+					return NULL;
+				}
+
+				mRGBA[n] = gpuPtr;
+			}
+			else
+			{
+				if( CUDA_FAILED(cudaMalloc(&mRGBA[n], size)) )
+				{
+					printf(LOG_CUDA "camera -- failed to allocate memory for %ux%u RGBA texture\n", mWidth, mHeight);
+					return NULL;
+				}
+			}
 		}
+
+		mRGBAZeroCopy = zeroCopy;
+		printf(LOG_CUDA "camera -- allocated %u RGBA ringbuffers\n", NUM_RGBA_BUFFERS);
 	}
 
-	// nvcamera is NV12
-	if( CUDA_FAILED(cudaNV12ToRGBAf((uint8_t*)input, (float4*)mRGBA, mWidth, mHeight)) )
+	void* rgba  = mRGBA[mLatestRGBA];
+	mLatestRGBA = (mLatestRGBA + 1) % NUM_RGBA_BUFFERS;
+	return rgba;
+}
+
+
+// convertRGBA
+bool camera::convertRGBA( pixelFormat format, void* input, void** output, bool zeroCopy )
+{
+	if( !input || !output )
 		return false;
 
-	*output = mRGBA;
+	void* rgba = nextRGBA(zeroCopy);
+
+	if( !rgba || !convertFrame(format, input, pixelFormatPitch(format, mWidth), rgba, mWidth, mHeight) )
+		return false;
+
+	*output = rgba;
 	return true;
 }
 
-bool camera::ConvertYUVtoRGBA( void* input, void** output )
+
+// convertFrame
+bool camera::convertFrame( pixelFormat format, void* input, uint32_t pitch, void* rgba, uint32_t width, uint32_t height )
 {
-	if( !input || !output )
-		return false;
+	cudaError_t result = cudaErrorInvalidValue;
+
+	// the input rows can be padded (i.e. by v4l2 or gstreamer), the output is tightly packed
+	const size_t rgbaPitch = width * sizeof(float4);
 
-	if( !mRGBA )
+	if( pitch == 0 )
+		pitch = pixelFormatPitch(format, width);
+
+	switch(format)
 	{
-		if( CUDA_FAILED(cudaMalloc(&mRGBA, mWidth * mHeight * sizeof(float4))) )
+		case PIXEL_FORMAT_NV12:			result = cudaNV12ToRGBAf((uint8_t*)input, pitch, (float4*)rgba, rgbaPitch, width, height); break;
+		case PIXEL_FORMAT_I420:			result = cudaI420ToRGBAf((uint8_t*)input, pitch, (float4*)rgba, rgbaPitch, width, height); break;
+		case PIXEL_FORMAT_YUYV:			result = cudaYUYVToRGBAf((uint8_t*)input, pitch, (float4*)rgba, rgbaPitch, width, height); break;
+		case PIXEL_FORMAT_UYVY:			result = cudaUYVYToRGBAf((uint8_t*)input, pitch, (float4*)rgba, rgbaPitch, width, height); break;
+		case PIXEL_FORMAT_RGB8:			result = cudaRGBToRGBAf((uchar3*)input, pitch, (float4*)rgba, rgbaPitch, width, height); break;
+		case PIXEL_FORMAT_BGR8:			result = cudaBGRToRGBAf((uchar3*)input, pitch, (float4*)rgba, rgbaPitch, width, height); break;
+		case PIXEL_FORMAT_RGBA8:		result = cudaRGBA8ToRGBAf((uchar4*)input, pitch, (float4*)rgba, rgbaPitch, width, height); break;
+		case PIXEL_FORMAT_RGBA32F:		result = cudaMemcpy2DAsync(rgba, rgbaPitch, input, pitch, rgbaPitch, height, cudaMemcpyDeviceToDevice); break;
+		case PIXEL_FORMAT_BAYER_GRBG8:
+		case PIXEL_FORMAT_BAYER_RGGB8:
+		case PIXEL_FORMAT_BAYER_BGGR8:
+		case PIXEL_FORMAT_BAYER_GBRG8:
+		{
+			// in the order of the pixelFormat enum
+			static const bayerPattern patterns[] = { BAYER_GRBG, BAYER_RGGB, BAYER_BGGR, BAYER_GBRG };
+
+			result = cudaBayerToRGBA((uint8_t*)input, pitch, (float4*)rgba, rgbaPitch, width, height,
+								patterns[format - PIXEL_FORMAT_BAYER_GRBG8], sBayerQuality, sBayerBalance);
+			break;
+		}
+		default:
 		{
-			printf(LOG_CUDA "gstCamera -- failed to allocate memory for %ux%u RGBA texture\n", mWidth, mHeight);
+			printf(LOG_CUDA "camera -- no conversion from %s to RGBA\n", pixelFormatToStr(format));
 			return false;
 		}
 	}
 
-	// nvcamera is YUV
-	if( CUDA_FAILED(cudaYUVToRGBAf((uint8_t*)input, (float4*)mRGBA, mWidth, mHeight)) )
+	if( CUDA_FAILED(result) )
+	{
+		printf(LOG_CUDA "camera -- failed to convert %ux%u %s image to RGBA\n", width, height, pixelFormatToStr(format));
 		return false;
+	}
 
-	*output = mRGBA;
 	return true;
 }
 
-bool camera::ConvertRGBtoRGBA( void* input, void** output )
+
+// ConvertRGBA
+bool camera::ConvertRGBA( void* input, void** output, bool zeroCopy )
+{
+	return convertRGBA(mFormat, input, output, zeroCopy);
+}
+
+
+// ConvertRGBA
+bool camera::ConvertRGBA( const cameraFrameInfo& frame, void* output )
+{
+	if( !frame.cuda || !output )
+		return false;
+
+	return convertFrame(frame.format, frame.cuda, frame.pitch, output, frame.width, frame.height);
+}
+
+
+// SetBayerConversion
+void camera::SetBayerConversion( bayerQuality quality, const float3& whiteBalance )
+{
+	sBayerQuality = quality;
+	sBayerBalance = whiteBalance;
+}
+
+
+bool camera::ConvertBAYER_GR8toRGBA( void* input, void** output )
+{
+	return convertRGBA(PIXEL_FORMAT_BAYER_GRBG8, input, output, false);
+}
+
+bool camera::ConvertYUVtoRGBf( void* input, void** output )
+{
+	return ConvertYUVtoRGBA(input, output);
+}
+
+// ConvertRGBA
+bool camera::ConvertNV12toRGBA( void* input, void** output )
+{
+	return convertRGBA(PIXEL_FORMAT_NV12, input, output, false);
+}
+
+bool camera::ConvertYUVtoRGBA( void* input, void** output )
 {
 	if( !input || !output )
 		return false;
 
-	if( !mRGBA )
-	{
-		if( CUDA_FAILED(cudaMalloc(&mRGBA, mWidth * mHeight * sizeof(float4))) )
-		{
-			printf(LOG_CUDA "camera -- failed to allocate memory for %ux%u RGBA texture\n", mWidth, mHeight);
-			return false;
-		}
-	}
+	void* rgba = nextRGBA(false);
+
+	if( !rgba )
+		return false;
 
-	// USB webcam is RGB
-	if( CUDA_FAILED(cudaRGBToRGBAf((uchar3*)input, (float4*)mRGBA, mWidth, mHeight)) )
+	// nvcamera is YUV
+	if( CUDA_FAILED(cudaYUVToRGBAf((uint8_t*)input, (float4*)rgba, mWidth, mHeight)) )
 	{
-		printf(LOG_CUDA "camera -- conversion cudaRGBToRGBAf failed (%dx%d)\n", mWidth, mHeight);
+		printf(LOG_CUDA "cudaYUVToRGBAf -- failed convert %ux%u RGBA texture\n", mWidth, mHeight);
 		return false;
 	}
 
-	*output = mRGBA;
+	*output = rgba;
 	return true;
 }
 
+bool camera::ConvertRGBtoRGBA( void* input, void** output )
+{
+	return convertRGBA(PIXEL_FORMAT_RGB8, input, output, false);
+}
@@ -7,11 +7,40 @@
 #include <climits>
 #include <stdint.h>
 
+#include "cameraFrame.h"
+#include "cudaBayer.h"
+
+
+// Camera used by the apps when --camera isn't specified (the onboard CSI camera)
+#define DEFAULT_CAMERA_URI "gst://onboard"
+
+
+class cameraRecorder;
+
 class camera
 {
 public:
-	camera(int height, int width) { mWidth = width; mHeight = height; mRGBA = 0; };
-	~camera() {};
+	// Create a camera from a URI:
+	//   gst://onboard                onboard CSI camera through gstreamer (nvcamerasrc)
+	//   gst://N  or gst:///dev/videoN  V4L2 camera through gstreamer (v4l2src)
+	//   v4l2:///dev/videoN           V4L2 camera, streamed directly from the driver
+	//   pylon://serial               Basler camera with the given serial number (if built with pylon)
+	//   file://path                  replays a directory or list of images, or a raw dump (e.g. frames.nv12)
+	//   test://                      replays a generated test pattern
+	//   /dev/videoN  or  N           shorthand for v4l2:///dev/videoN and gst://N
+	// gst:// URIs accept a ?zerocopy suffix to capture the frames in-place.
+	// file:// and test:// take options like ?fps=30&jitter=2&format=nv12 (see replayCamera.h).
+	// The width and height are requests that not every camera honors (0 for the default).
+	static camera* Create( const char* uri, uint32_t width=0, uint32_t height=0 );
+
+	// Create the camera from the command line (--camera=<uri> --width=N --height=N),
+	// recording the frames it delivers if --record=<file> is specified.
+	// Bayer cameras also take --bayer=bilinear|malvar and --white_balance=r,g,b (see SetBayerConversion),
+	// and YUV cameras --colorspace=bt601|bt709 and --color_range=limited|full (see cudaYUVSetColorspace)
+	static camera* Create( int argc, char** argv, const char* defaultURI=DEFAULT_CAMERA_URI );
+
+	camera(int height, int width);
+	virtual ~camera();
 
 	virtual bool Open() = 0;
 
@@ -19,26 +48,78 @@ public:
 	
 	// Capture frame
 	virtual bool Capture( void** cpu, void** cuda, unsigned long timeout=ULONG_MAX ) = 0;
+
+	// Capture a lease on the next frame, that holds its buffer until cameraFrame::Release() is called.
+	// Returns NULL on timeout, or if every buffer is leased and the camera can't capture another frame.
+	virtual cameraFrame* CaptureFrame( unsigned long timeout=ULONG_MAX ) = 0;
+
+	// Record the frames delivered by Capture() and CaptureFrame() to a log (see cameraRecorder.h),
+	// or NULL to stop recording.  The camera takes ownership of the recorder.  Set it before Open().
+	void SetRecorder( cameraRecorder* recorder );
+	inline cameraRecorder* GetRecorder() const { return mRecorder; }
+
+	// Query if the stream ended (i.e. a replayed log that doesn't loop), after which CaptureFrame() keeps returning NULL
+	virtual bool IsEOS() const	{ return false; }
+
+	// Lease counters
+	inline uint32_t GetLeasedFrames() const  { return mFrames != 0 ? mFrames->GetLeased() : 0; }
+	inline uint64_t GetStarvedFrames() const { return mFrames != 0 ? mFrames->GetStarved() : 0; }
 	
 	inline uint32_t GetWidth() const	  { return mWidth; }
 	inline uint32_t GetHeight() const	  { return mHeight; }
 	inline uint32_t GetPixelDepth() const { return mDepth; }
 	inline uint32_t GetSize() const		  { return mSize; }
-	
-	// Takes in captured YUV-NV12 CUDA image, converts to float4 RGBA (with pixel intensity 0-255)
+
+	// Native format of the captured frames, for picking the conversion
+	inline pixelFormat GetPixelFormat() const { return mFormat; }
+
+	// Takes in a captured CUDA image in the camera's native format, converts to float4 RGBA (with pixel intensity 0-255)
+	// Set zeroCopy to true if you need to access the output from CPU, otherwise it will be CUDA only.
+	// The output comes from a ringbuffer, and is overwritten after NUM_RGBA_BUFFERS more conversions.
+	virtual bool ConvertRGBA( void* input, void** output, bool zeroCopy=false );
+
+	// Converts a captured frame to float4 RGBA (0-255) in the caller's buffer of frame.width x frame.height,
+	// instead of the ringbuffer, so frames can be converted from any thread.  Every pixelFormat is supported,
+	// and the rows of the frame may be padded to frame.pitch.
+	static bool ConvertRGBA( const cameraFrameInfo& frame, void* output );
+
+	// Interpolation and white balance gains used to convert the bayer formats (default malvar, 1,1,1).
+	// These apply to every camera in the process, so set them before streaming.
+	static void SetBayerConversion( bayerQuality quality, const float3& whiteBalance=make_float3(1.0f, 1.0f, 1.0f) );
+
+	// Converts from a specific format to float4 RGBA (with pixel intensity 0-255)
 	bool ConvertBAYER_GR8toRGBA( void* input, void** output );
 	bool ConvertNV12toRGBA( void* input, void** output );
 	bool ConvertYUVtoRGBA ( void* input, void** output );
 	bool ConvertRGBtoRGBA ( void* input, void** output );
 	bool ConvertYUVtoRGBf ( void* input, void** output );
+
+	static const uint32_t NUM_RGBA_BUFFERS = 16;
 	
 protected:
+	bool convertRGBA( pixelFormat format, void* input, void** output, bool zeroCopy );
+	static bool convertFrame( pixelFormat format, void* input, uint32_t pitch, void* rgba, uint32_t width, uint32_t height );
+	void* nextRGBA( bool zeroCopy );
+
+	// Called by the subclasses with each frame they deliver
+	void record( const cameraFrameInfo& frame );
+
 	uint32_t mWidth;
 	uint32_t mHeight;
 	uint32_t mDepth;
 	uint32_t mSize;
+
+	pixelFormat mFormat;
 	
-	void* mRGBA;
+	void*    mRGBA[NUM_RGBA_BUFFERS];
+	uint32_t mLatestRGBA;
+	bool     mRGBAZeroCopy;
+
+	cameraFramePool* mFrames;	// leases on the camera's buffers, owned by the subclass
+	cameraRecorder*  mRecorder;
+
+	static bayerQuality sBayerQuality;
+	static float3       sBayerBalance;
 };
 
 #endif
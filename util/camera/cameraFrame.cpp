@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "cameraFrame.h"
+
+#include <stdio.h>
+#include <strings.h>
+#include <time.h>
+
+
+// pixelFormatToStr
+const char* pixelFormatToStr( pixelFormat format )
+{
+	switch(format)
+	{
+		case PIXEL_FORMAT_RGB8:		 return "rgb8";
+		case PIXEL_FORMAT_BGR8:		 return "bgr8";
+		case PIXEL_FORMAT_RGBA8:	 return "rgba8";
+		case PIXEL_FORMAT_RGBA32F:	 return "rgba32f";
+		case PIXEL_FORMAT_NV12:		 return "nv12";
+		case PIXEL_FORMAT_I420:		 return "i420";
+		case PIXEL_FORMAT_YUYV:		 return "yuyv";
+		case PIXEL_FORMAT_UYVY:		 return "uyvy";
+		case PIXEL_FORMAT_BAYER_GRBG8: return "bayer-grbg8";
+		case PIXEL_FORMAT_BAYER_RGGB8: return "bayer-rggb8";
+		case PIXEL_FORMAT_BAYER_BGGR8: return "bayer-bggr8";
+		case PIXEL_FORMAT_BAYER_GBRG8: return "bayer-gbrg8";
+		default:					 return "unknown";
+	}
+}
+
+
+// pixelFormatFromStr
+pixelFormat pixelFormatFromStr( const char* str )
+{
+	if( !str )
+		return PIXEL_FORMAT_UNKNOWN;
+
+	static const struct { const char* name; pixelFormat format; } aliases[] = {
+		{ "rgb",  PIXEL_FORMAT_RGB8 },
+		{ "bgr",  PIXEL_FORMAT_BGR8 },
+		{ "rgba", PIXEL_FORMAT_RGBA8 },
+		{ "grbg", PIXEL_FORMAT_BAYER_GRBG8 },
+		{ "rggb", PIXEL_FORMAT_BAYER_RGGB8 },
+		{ "bggr", PIXEL_FORMAT_BAYER_BGGR8 },
+		{ "gbrg", PIXEL_FORMAT_BAYER_GBRG8 }
+	};
+
+	for( uint32_t n=0; n < sizeof(aliases) / sizeof(aliases[0]); n++ )
+	{
+		if( strcasecmp(str, aliases[n].name) == 0 )
+			return aliases[n].format;
+	}
+
+	for( uint32_t n=PIXEL_FORMAT_RGB8; n <= PIXEL_FORMAT_BAYER_GBRG8; n++ )
+	{
+		if( strcasecmp(str, pixelFormatToStr((pixelFormat)n)) == 0 )
+			return (pixelFormat)n;
+	}
+
+	return PIXEL_FORMAT_UNKNOWN;
+}
+
+
+// pixelFormatDepth
+uint32_t pixelFormatDepth( pixelFormat format )
+{
+	switch(format)
+	{
+		case PIXEL_FORMAT_RGB8:
+		case PIXEL_FORMAT_BGR8:		 return 24;
+		case PIXEL_FORMAT_RGBA8:	 return 32;
+		case PIXEL_FORMAT_RGBA32F:	 return 128;
+		case PIXEL_FORMAT_NV12:
+		case PIXEL_FORMAT_I420:		 return 12;
+		case PIXEL_FORMAT_YUYV:
+		case PIXEL_FORMAT_UYVY:		 return 16;
+		case PIXEL_FORMAT_BAYER_GRBG8:
+		case PIXEL_FORMAT_BAYER_RGGB8:
+		case PIXEL_FORMAT_BAYER_BGGR8:
+		case PIXEL_FORMAT_BAYER_GBRG8: return 8;
+		default:					 return 0;
+	}
+}
+
+
+// pixelFormatPitch
+uint32_t pixelFormatPitch( pixelFormat format, uint32_t width )
+{
+	// the planar formats start with an 8-bit luma plane
+	if( format == PIXEL_FORMAT_NV12 || format == PIXEL_FORMAT_I420 )
+		return width;
+
+	return (width * pixelFormatDepth(format)) / 8;
+}
+
+
+// cameraTimestamp
+uint64_t cameraTimestamp()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return uint64_t(t.tv_sec) * 1000000000ULL + uint64_t(t.tv_nsec);
+}
+
+
+// constructor
+cameraFrame::cameraFrame()
+{
+	cpu       = NULL;
+	cuda      = NULL;
+	width     = 0;
+	height    = 0;
+	pitch     = 0;
+	size      = 0;
+	format    = PIXEL_FORMAT_UNKNOWN;
+	timestamp = 0;
+	sequence  = 0;
+
+	mPool = NULL;
+	mSlot = 0;
+	mRefs.store(0);
+}
+
+
+// AddRef
+void cameraFrame::AddRef()
+{
+	mRefs.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+// Release
+void cameraFrame::Release()
+{
+	int32_t refs = mRefs.load(std::memory_order_relaxed);
+
+	// drop the extra references without locking, the last one goes through the pool
+	while( refs > 1 )
+	{
+		if( mRefs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel) )
+			return;
+	}
+
+	if( refs <= 0 )
+	{
+		printf("cameraFrame -- Release() called on frame %llu that isn't leased\n", (unsigned long long)sequence);
+		return;
+	}
+
+	mPool->release(this);
+}
+
+
+// constructor
+cameraFramePool::cameraFramePool( uint32_t numSlots, ReleaseCallback callback, void* user_data )
+	: mNumSlots(numSlots)
+{
+	mFrames   = new cameraFrame[numSlots];
+	mCallback = callback;
+	mUserData = user_data;
+
+	mLeased.store(0);
+	mLeases.store(0);
+	mStarved.store(0);
+
+	for( uint32_t n=0; n < numSlots; n++ )
+	{
+		mFrames[n].mPool = this;
+		mFrames[n].mSlot = n;
+	}
+}
+
+
+// destructor
+cameraFramePool::~cameraFramePool()
+{
+	const uint32_t leased = GetLeased();
+
+	if( leased > 0 )
+		printf("cameraFramePool -- destroyed with %u frames still leased\n", leased);
+
+	delete[] mFrames;
+}
+
+
+// Lease
+cameraFrame* cameraFramePool::Lease( uint32_t slot, const cameraFrameInfo& info )
+{
+	if( slot >= mNumSlots )
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	cameraFrame* frame = mFrames + slot;
+
+	if( frame->mRefs.load(std::memory_order_acquire) > 0 )
+	{
+		frame->mRefs.fetch_add(1, std::memory_order_relaxed);
+		return frame;
+	}
+
+	*(cameraFrameInfo*)frame = info;
+	frame->mRefs.store(1, std::memory_order_release);
+
+	mLeased.fetch_add(1, std::memory_order_release);
+	mLeases.fetch_add(1, std::memory_order_relaxed);
+	return frame;
+}
+
+
+// release
+void cameraFramePool::release( cameraFrame* frame )
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// another consumer may have leased it again while we were waiting on the lock
+	if( frame->mRefs.fetch_sub(1, std::memory_order_acq_rel) != 1 )
+		return;
+
+	// give the buffer back to the camera, before it can be leased again
+	if( mCallback != NULL )
+		mCallback(frame->mSlot, mUserData);
+
+	mLeased.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __CAMERA_FRAME_H__
+#define __CAMERA_FRAME_H__
+
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+
+/**
+ * Native pixel formats delivered by the cameras.
+ * @ingroup util
+ */
+enum pixelFormat
+{
+	PIXEL_FORMAT_UNKNOWN = 0,
+	PIXEL_FORMAT_RGB8,		/**< packed 24-bit RGB */
+	PIXEL_FORMAT_BGR8,		/**< packed 24-bit BGR */
+	PIXEL_FORMAT_RGBA8,		/**< packed 32-bit RGBA */
+	PIXEL_FORMAT_RGBA32F,	/**< float4 RGBA */
+	PIXEL_FORMAT_NV12,		/**< 8-bit Y plane followed by interleaved UV at half resolution */
+	PIXEL_FORMAT_I420,		/**< 8-bit Y, U and V planes, with U and V at half resolution */
+	PIXEL_FORMAT_YUYV,		/**< packed 4:2:2 YUYV */
+	PIXEL_FORMAT_UYVY,		/**< packed 4:2:2 UYVY */
+	PIXEL_FORMAT_BAYER_GRBG8,	/**< 8-bit bayer, GR/BG ordering */
+	PIXEL_FORMAT_BAYER_RGGB8,	/**< 8-bit bayer, RG/GB ordering */
+	PIXEL_FORMAT_BAYER_BGGR8,	/**< 8-bit bayer, BG/GR ordering */
+	PIXEL_FORMAT_BAYER_GBRG8	/**< 8-bit bayer, GB/RG ordering */
+};
+
+/**
+ * Retrieve the name of a pixel format, for logging.
+ * @ingroup util
+ */
+const char* pixelFormatToStr( pixelFormat format );
+
+/**
+ * Parse a pixel format from its name (i.e. "nv12" or "bayer-rggb8"), ignoring case.
+ * The short names "rgb", "bgr", "rgba", "grbg", "rggb", "bggr" and "gbrg" are accepted too.
+ * @returns PIXEL_FORMAT_UNKNOWN if the name isn't recognized.
+ * @ingroup util
+ */
+pixelFormat pixelFormatFromStr( const char* str );
+
+/**
+ * Retrieve the average number of bits per pixel of a format (12 for NV12, 16 for YUYV, ect.)
+ * @ingroup util
+ */
+uint32_t pixelFormatDepth( pixelFormat format );
+
+/**
+ * Retrieve the size in bytes of one line of the first plane, for an unpadded image of the given width.
+ * @ingroup util
+ */
+uint32_t pixelFormatPitch( pixelFormat format, uint32_t width );
+
+
+/**
+ * Description of a captured frame.
+ * @ingroup util
+ */
+struct cameraFrameInfo
+{
+	void*       cpu;		/**< CPU pointer to the frame */
+	void*       cuda;		/**< CUDA pointer to the frame (NULL if it isn't accessible from the GPU) */
+	uint32_t    width;		/**< width in pixels */
+	uint32_t    height;		/**< height in pixels */
+	uint32_t    pitch;		/**< size in bytes of one line of the first plane */
+	uint32_t    size;		/**< size in bytes of the whole frame */
+	pixelFormat format;		/**< native pixel format */
+	uint64_t    timestamp;	/**< capture time in nanoseconds, from CLOCK_MONOTONIC */
+	uint64_t    sequence;	/**< frame number, starting from 1 */
+};
+
+
+class cameraFramePool;
+
+
+/**
+ * Lease on a captured frame.  The camera doesn't recycle the buffer
+ * until every reference to the frame has been released.
+ * @ingroup util
+ */
+class cameraFrame : public cameraFrameInfo
+{
+public:
+	/**
+	 * Add a reference, for handing the frame to another consumer.
+	 */
+	void AddRef();
+
+	/**
+	 * Release a reference.  When the last one is released, the buffer is returned
+	 * to the camera and the frame must no longer be accessed.
+	 */
+	void Release();
+
+	/**
+	 * Retrieve the number of references held.
+	 */
+	inline int32_t GetRefCount() const		{ return mRefs.load(std::memory_order_acquire); }
+
+	/**
+	 * Retrieve the camera's buffer index the frame is stored in.
+	 */
+	inline uint32_t GetSlot() const			{ return mSlot; }
+
+protected:
+	friend class cameraFramePool;
+
+	cameraFrame();
+
+	cameraFramePool* mPool;
+	uint32_t mSlot;
+
+	std::atomic<int32_t> mRefs;
+};
+
+
+/**
+ * Set of frame leases, one for each of a camera's buffers.  The camera leases a buffer
+ * to the consumer once it has been filled, and gets it back through the release callback
+ * when the last reference is released.  Until then the camera mustn't write to the buffer.
+ * @ingroup util
+ */
+class cameraFramePool
+{
+public:
+	/**
+	 * Function called when the last reference to a leased buffer is released.
+	 */
+	typedef void (*ReleaseCallback)( uint32_t slot, void* user_data );
+
+	/**
+	 * Create a pool for the specified number of buffers.
+	 */
+	cameraFramePool( uint32_t numSlots, ReleaseCallback callback, void* user_data );
+
+	/**
+	 * Destructor
+	 */
+	~cameraFramePool();
+
+	/**
+	 * Lease the buffer to a consumer, with one reference.  If the buffer is already leased,
+	 * the existing lease gets another reference instead, and info is ignored.
+	 * @returns the lease, or NULL if the slot is invalid.
+	 */
+	cameraFrame* Lease( uint32_t slot, const cameraFrameInfo& info );
+
+	/**
+	 * Query if a buffer is leased, in which case the camera mustn't reuse it.
+	 */
+	inline bool IsLeased( uint32_t slot ) const	{ return slot < mNumSlots && mFrames[slot].GetRefCount() > 0; }
+
+	/**
+	 * Record a frame the camera had to drop or couldn't deliver, because all its buffers were leased.
+	 */
+	inline void Starved()				{ mStarved.fetch_add(1, std::memory_order_relaxed); }
+
+	/**
+	 * Retrieve the number of buffers currently leased.
+	 */
+	inline uint32_t GetLeased() const		{ return mLeased.load(std::memory_order_acquire); }
+
+	/**
+	 * Retrieve the total number of leases handed out.
+	 */
+	inline uint64_t GetLeases() const		{ return mLeases.load(std::memory_order_relaxed); }
+
+	/**
+	 * Retrieve the number of frames lost because all the buffers were leased.
+	 */
+	inline uint64_t GetStarved() const		{ return mStarved.load(std::memory_order_relaxed); }
+
+	/**
+	 * Retrieve the number of buffers.
+	 */
+	inline uint32_t GetNumSlots() const		{ return mNumSlots; }
+
+protected:
+	friend class cameraFrame;
+
+	void release( cameraFrame* frame );
+
+	const uint32_t mNumSlots;
+
+	cameraFrame*    mFrames;
+	ReleaseCallback mCallback;
+	void*           mUserData;
+	std::mutex      mMutex;		/**< serializes leasing a buffer with releasing its last reference */
+
+	std::atomic<uint32_t> mLeased;
+	std::atomic<uint64_t> mLeases;
+	std::atomic<uint64_t> mStarved;
+};
+
+
+/**
+ * Retrieve the current CLOCK_MONOTONIC time in nanoseconds, for frame timestamps.
+ * @ingroup util
+ */
+uint64_t cameraTimestamp();
+
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "cameraRecorder.h"
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+// round up to the alignment of the log
+static inline uint64_t alignLog( uint64_t size )
+{
+	return ((size + cameraRecorder::Alignment - 1) / cameraRecorder::Alignment) * cameraRecorder::Alignment;
+}
+
+
+// allocate a buffer that direct I/O can write from
+static uint8_t* allocAligned( size_t size )
+{
+	void* ptr = NULL;
+
+	if( posix_memalign(&ptr, cameraRecorder::Alignment, size) != 0 )
+		return NULL;
+
+	memset(ptr, 0, size);
+	return (uint8_t*)ptr;
+}
+
+
+// write the whole buffer at the offset, resuming after partial writes
+static bool writeAt( int fd, const uint8_t* buffer, size_t size, uint64_t offset )
+{
+	while( size > 0 )
+	{
+		const ssize_t result = pwrite(fd, buffer, size, offset);
+
+		if( result < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+
+			printf("cameraRecorder -- failed to write %zu bytes at offset %llu (errno=%i) (%s)\n", size, (unsigned long long)offset, errno, strerror(errno));
+			return false;
+		}
+
+		buffer += result;
+		size   -= result;
+		offset += result;
+	}
+
+	return true;
+}
+
+
+// writer thread
+class cameraRecorderThread : public QThread
+{
+public:
+	cameraRecorderThread( cameraRecorder* recorder ) : mRecorder(recorder)	{ }
+
+protected:
+	virtual void run()		{ mRecorder->process(); }
+
+	cameraRecorder* mRecorder;
+};
+
+
+// constructor
+cameraRecorder::cameraRecorder()
+{
+	mFD            = -1;
+	mDirect        = false;
+	mHeaderWritten = false;
+	mQueueDepth    = 0;
+	mThread        = NULL;
+	mQueue         = NULL;
+	mMutex         = new QMutex();
+	mIdle          = new QWaitCondition();
+	mPending       = 0;
+	mChunk         = 0;
+	mChunkUsed     = 0;
+	mPreallocated  = 0;
+	mIndex         = NULL;
+	mIndexBuffer   = NULL;
+	mWritten       = 0;
+	mDropped       = 0;
+	mFailed        = 0;
+
+	memset(&mHeader, 0, sizeof(mHeader));
+}
+
+
+// destructor
+cameraRecorder::~cameraRecorder()
+{
+	if( mQueue != NULL )
+		mQueue->Close();
+
+	if( mThread != NULL )
+	{
+		mThread->wait();
+		delete mThread;
+	}
+
+	// the index is written with each frame, but once more in case the last write failed
+	if( mChunkUsed > 0 && !writeIndex() )
+		printf("cameraRecorder -- failed to write the index of the last chunk, its frames are lost\n");
+
+	if( mFD >= 0 )
+	{
+		fdatasync(mFD);
+		close(mFD);
+	}
+
+	for( size_t n=0; n < mAllocated.size(); n++ )
+		free(mAllocated[n]);
+
+	free(mIndexBuffer);
+
+	printf("cameraRecorder -- recorded %llu frames to '%s' (%llu dropped, %llu failed)\n", (unsigned long long)mWritten,
+		  mPath.c_str(), (unsigned long long)mDropped, (unsigned long long)mFailed);
+
+	delete mQueue;
+	delete mIdle;
+	delete mMutex;
+}
+
+
+// Create
+cameraRecorder* cameraRecorder::Create( const char* path, uint32_t queueDepth, uint32_t chunkFrames, bool direct )
+{
+	if( !path )
+		return NULL;
+
+	if( queueDepth == 0 )
+		queueDepth = 1;
+
+	if( chunkFrames == 0 )
+		chunkFrames = 1;
+
+	cameraRecorder* recorder = new cameraRecorder();
+
+	recorder->mPath       = path;
+	recorder->mQueueDepth = queueDepth;
+	recorder->mHeader.chunkFrames = chunkFrames;
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+	if( direct )
+		recorder->mFD = open(path, flags | O_DIRECT, 0644);
+
+	// not every file system supports direct I/O (i.e. tmpfs)
+	if( recorder->mFD < 0 )
+		recorder->mFD = open(path, flags, 0644);
+	else
+		recorder->mDirect = true;
+
+	if( recorder->mFD < 0 )
+	{
+		printf("cameraRecorder -- failed to create '%s' (errno=%i) (%s)\n", path, errno, strerror(errno));
+		delete recorder;
+		return NULL;
+	}
+
+	recorder->mQueue  = new threadQueue<recordJob*>(queueDepth);
+	recorder->mThread = new cameraRecorderThread(recorder);
+	recorder->mThread->start();
+
+	printf("cameraRecorder -- recording to '%s'%s\n", path, recorder->mDirect ? " (direct I/O)" : "");
+	return recorder;
+}
+
+
+// init
+bool cameraRecorder::init( const cameraFrameInfo& frame )
+{
+	if( frame.size == 0 || frame.width == 0 || frame.height == 0 )
+		return false;
+
+	const uint32_t chunkFrames = mHeader.chunkFrames;
+
+	memcpy(mHeader.magic, CAMERA_LOG_MAGIC, sizeof(mHeader.magic));
+
+	mHeader.version     = CAMERA_LOG_VERSION;
+	mHeader.format      = frame.format;
+	mHeader.width       = frame.width;
+	mHeader.height      = frame.height;
+	mHeader.pitch       = frame.pitch;
+	mHeader.frameSize   = frame.size;
+	mHeader.frameStride = alignLog(frame.size);
+	mHeader.indexSize   = alignLog(sizeof(cameraLogChunk) + chunkFrames * sizeof(cameraLogEntry));
+	mHeader.chunkSize   = mHeader.indexSize + chunkFrames * mHeader.frameStride;
+	mHeader.alignment   = Alignment;
+
+	// one staging buffer for each queued frame, and one being written
+	for( uint32_t n=0; n <= mQueueDepth; n++ )
+	{
+		uint8_t* buffer = allocAligned(mHeader.frameStride);
+
+		if( !buffer )
+		{
+			printf("cameraRecorder -- failed to allocate %llu byte staging buffers\n", (unsigned long long)mHeader.frameStride);
+			return false;
+		}
+
+		mAllocated.push_back(buffer);
+		mBuffers.push_back(buffer);
+	}
+
+	mIndexBuffer = allocAligned(mHeader.indexSize);
+
+	if( !mIndexBuffer )
+		return false;
+
+	mIndex = (cameraLogEntry*)(mIndexBuffer + sizeof(cameraLogChunk));
+
+	uint8_t* header = allocAligned(Alignment);
+
+	if( !header )
+		return false;
+
+	memcpy(header, &mHeader, sizeof(mHeader));
+
+	const bool result = writeAt(mFD, header, Alignment, 0);
+	free(header);
+
+	if( !result )
+		return false;
+
+	preallocate(0);
+	preallocate(1);
+
+	printf("cameraRecorder -- recording %ux%u %s frames to '%s'\n", frame.width, frame.height, pixelFormatToStr(frame.format), mPath.c_str());
+	return true;
+}
+
+
+// preallocate
+void cameraRecorder::preallocate( uint32_t chunk )
+{
+	if( chunk < mPreallocated )
+		return;
+
+	// reserve the extents without changing the size of the file, so it ends after the last frame
+	if( fallocate(mFD, FALLOC_FL_KEEP_SIZE, Alignment + uint64_t(chunk) * mHeader.chunkSize, mHeader.chunkSize) != 0 && mPreallocated == 0 )
+		printf("cameraRecorder -- the file system doesn't support preallocation (errno=%i) (%s)\n", errno, strerror(errno));
+
+	mPreallocated = chunk + 1;
+}
+
+
+// Write
+bool cameraRecorder::Write( const cameraFrameInfo& frame )
+{
+	if( !frame.cpu )
+		return false;
+
+	mMutex->lock();
+
+	if( !mHeaderWritten )
+	{
+		if( !init(frame) )
+		{
+			printf("cameraRecorder -- failed to start the log '%s'\n", mPath.c_str());
+			mHeader.frameSize = 0;	// fails every frame
+		}
+
+		mHeaderWritten = true;
+	}
+
+	if( frame.format != (pixelFormat)mHeader.format || frame.width != mHeader.width ||
+	    frame.height != mHeader.height || frame.size != mHeader.frameSize )
+	{
+		mFailed++;
+		mMutex->unlock();
+		return false;
+	}
+
+	// drop the frame instead of waiting for the disk
+	if( mBuffers.empty() )
+	{
+		mDropped++;
+		mMutex->unlock();
+		return false;
+	}
+
+	recordJob* job = new recordJob();
+
+	job->buffer    = mBuffers.back();
+	job->sequence  = frame.sequence;
+	job->timestamp = frame.timestamp;
+
+	mBuffers.pop_back();
+	mPending++;
+	mMutex->unlock();
+
+	memcpy(job->buffer, frame.cpu, frame.size);
+
+	// there's a staging buffer for every place in the queue, so this only fails once closed
+	if( !mQueue->TryPush(job) )
+	{
+		mMutex->lock();
+		mBuffers.push_back(job->buffer);
+		mPending--;
+		mDropped++;
+		mIdle->wakeAll();
+		mMutex->unlock();
+
+		delete job;
+		return false;
+	}
+
+	return true;
+}
+
+
+// Flush
+void cameraRecorder::Flush()
+{
+	mMutex->lock();
+
+	while( mPending > 0 )
+		mIdle->wait(mMutex);
+
+	mMutex->unlock();
+}
+
+
+// process
+void cameraRecorder::process()
+{
+	recordJob* job = NULL;
+
+	while( mQueue->Pop(&job) )
+	{
+		const bool result = writeFrame(job);
+
+		mMutex->lock();
+
+		if( result )
+			mWritten++;
+		else
+			mFailed++;
+
+		mBuffers.push_back(job->buffer);
+		mPending--;
+		mIdle->wakeAll();
+		mMutex->unlock();
+
+		delete job;
+	}
+}
+
+
+// writeFrame
+bool cameraRecorder::writeFrame( const recordJob* job )
+{
+	// the index of the full chunk was written with its last frame
+	if( mChunkUsed == mHeader.chunkFrames )
+	{
+		memset(mIndexBuffer, 0, mHeader.indexSize);
+
+		mChunk++;
+		mChunkUsed = 0;
+
+		// keep a chunk ahead of the frames being written
+		preallocate(mChunk + 1);
+	}
+
+	const uint64_t offset = Alignment + uint64_t(mChunk) * mHeader.chunkSize + mHeader.indexSize + uint64_t(mChunkUsed) * mHeader.frameStride;
+
+	if( !writeAt(mFD, job->buffer, mHeader.frameStride, offset) )
+		return false;
+
+	mIndex[mChunkUsed].sequence  = job->sequence;
+	mIndex[mChunkUsed].timestamp = job->timestamp;
+
+	mChunkUsed++;
+
+	// rewrite the index after every frame, so a crash only loses the frames still queued
+	// (the index is one aligned block, which is small next to a frame)
+	if( !writeIndex() )
+	{
+		printf("cameraRecorder -- failed to write the index of chunk %u\n", mChunk);
+		return false;
+	}
+
+	return true;
+}
+
+
+// writeIndex
+bool cameraRecorder::writeIndex()
+{
+	cameraLogChunk* chunk = (cameraLogChunk*)mIndexBuffer;
+
+	memcpy(chunk->magic, CAMERA_CHUNK_MAGIC, sizeof(chunk->magic));
+
+	chunk->chunk  = mChunk;
+	chunk->frames = mChunkUsed;
+
+	return writeAt(mFD, mIndexBuffer, mHeader.indexSize, Alignment + uint64_t(mChunk) * mHeader.chunkSize);
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __CAMERA_RECORDER_H__
+#define __CAMERA_RECORDER_H__
+
+
+#include "cameraFrame.h"
+#include "threadQueue.h"
+
+#include <string>
+#include <vector>
+
+
+class QThread;
+class QMutex;
+class QWaitCondition;
+
+
+/**
+ * Magic numbers of the camera log file and its chunks.
+ * @ingroup util
+ */
+#define CAMERA_LOG_MAGIC	"JICAMLOG"
+#define CAMERA_CHUNK_MAGIC	"JICHUNK"
+
+/**
+ * Version of the camera log format.
+ * @ingroup util
+ */
+#define CAMERA_LOG_VERSION	1
+
+
+/**
+ * Header at the start of a camera log, padded to cameraRecorder::Alignment bytes.
+ *
+ * The header is followed by chunks of chunkSize bytes each.  A chunk starts with
+ * its index (a cameraLogChunk followed by chunkFrames cameraLogEntry's, padded to
+ * indexSize bytes) and is followed by chunkFrames frames, frameStride bytes apart.
+ * Frame i of chunk c is at offset:
+ *
+ *   Alignment + c * chunkSize + indexSize + i * frameStride
+ *
+ * @ingroup util
+ */
+struct cameraLogHeader
+{
+	char     magic[8];		/**< CAMERA_LOG_MAGIC */
+	uint32_t version;		/**< CAMERA_LOG_VERSION */
+	uint32_t format;		/**< pixelFormat of the frames */
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint32_t frameSize;		/**< size of a frame in bytes */
+	uint64_t frameStride;	/**< frameSize padded to the alignment */
+	uint64_t indexSize;		/**< size of a chunk's index, padded to the alignment */
+	uint64_t chunkSize;		/**< size of a whole chunk, including its index */
+	uint32_t chunkFrames;	/**< maximum number of frames in a chunk */
+	uint32_t alignment;		/**< alignment of the chunks and frames */
+};
+
+/**
+ * Index at the start of each chunk of a camera log, followed by one entry per frame.
+ * It's rewritten after each frame stored in the chunk, with the number of frames so far.
+ * @ingroup util
+ */
+struct cameraLogChunk
+{
+	char     magic[8];		/**< CAMERA_CHUNK_MAGIC */
+	uint32_t chunk;		/**< index of the chunk in the log */
+	uint32_t frames;		/**< number of frames stored in the chunk */
+};
+
+/**
+ * Capture time and sequence number of a frame in a camera log.
+ * @ingroup util
+ */
+struct cameraLogEntry
+{
+	uint64_t sequence;		/**< camera's sequence number of the frame */
+	uint64_t timestamp;		/**< camera's capture time of the frame (CLOCK_MONOTONIC nanoseconds) */
+};
+
+
+/**
+ * Records the frames delivered by a camera, in their native format, to a log that
+ * replayCamera can play back (i.e. with --camera=file://capture.camlog).
+ *
+ * Write() copies the frame into an aligned staging buffer and queues it to a thread
+ * that writes it to disk, so the cost to the caller is one copy of the frame.  The file
+ * space is preallocated a chunk ahead, and with direct I/O (the default) the frames
+ * bypass the page cache.  When the disk falls behind and every staging buffer is queued,
+ * frames are dropped and counted instead of blocking the camera.
+ *
+ * The index of the current chunk is rewritten after each frame, so if the process dies,
+ * the log is still readable up to the last frame that reached the disk.  The frames still
+ * in the queue (up to queueDepth) are lost.
+ *
+ * All the frames of a log have the format and dimensions of the first one.
+ *
+ * @ingroup util
+ */
+class cameraRecorder
+{
+public:
+	/**
+	 * Create the log and start the writer thread.
+	 * @param path the file to write, which is overwritten if it exists.
+	 * @param queueDepth number of frames that can be waiting to be written.
+	 * @param chunkFrames number of frames in each chunk of the log.
+	 * @param direct use direct I/O (O_DIRECT), if the file system supports it.
+	 */
+	static cameraRecorder* Create( const char* path, uint32_t queueDepth=8, uint32_t chunkFrames=64, bool direct=true );
+
+	/**
+	 * Write the queued frames, finish the log and stop the thread.
+	 */
+	~cameraRecorder();
+
+	/**
+	 * Queue a frame to be recorded.  Returns once the frame has been copied.
+	 * @returns true if the frame was queued, or false if it was dropped.
+	 */
+	bool Write( const cameraFrameInfo& frame );
+
+	/**
+	 * Wait for the queued frames to be written.
+	 */
+	void Flush();
+
+	/**
+	 * Retrieve the path of the log.
+	 */
+	inline const char* GetPath() const			{ return mPath.c_str(); }
+
+	/**
+	 * Retrieve the number of frames written.
+	 */
+	inline uint64_t GetWritten() const			{ return mWritten; }
+
+	/**
+	 * Retrieve the number of frames dropped because the disk fell behind.
+	 */
+	inline uint64_t GetDropped() const			{ return mDropped; }
+
+	/**
+	 * Retrieve the number of frames that failed to be written, or didn't match the log's format.
+	 */
+	inline uint64_t GetFailed() const			{ return mFailed; }
+
+	/**
+	 * Alignment of the chunks and frames in the file, suitable for direct I/O.
+	 */
+	static const uint32_t Alignment = 4096;
+
+protected:
+	cameraRecorder();
+
+	struct recordJob
+	{
+		uint8_t* buffer;
+		uint64_t sequence;
+		uint64_t timestamp;
+	};
+
+	friend class cameraRecorderThread;
+
+	bool init( const cameraFrameInfo& frame );
+	void process();
+	bool writeFrame( const recordJob* job );
+	bool writeIndex();
+	void preallocate( uint32_t chunk );
+
+	std::string mPath;
+	int         mFD;
+	bool        mDirect;
+
+	cameraLogHeader mHeader;
+	bool            mHeaderWritten;
+	uint32_t        mQueueDepth;
+
+	QThread*                mThread;
+	threadQueue<recordJob*>* mQueue;
+	std::vector<uint8_t*>   mBuffers;	/**< free staging buffers */
+	std::vector<uint8_t*>   mAllocated;
+
+	QMutex*         mMutex;
+	QWaitCondition* mIdle;
+	uint32_t        mPending;
+
+	// the state of the writer thread
+	uint32_t        mChunk;
+	uint32_t        mChunkUsed;
+	uint32_t        mPreallocated;	/**< number of chunks preallocated */
+	cameraLogEntry* mIndex;		/**< entries of the current chunk, following its cameraLogChunk */
+	uint8_t*        mIndexBuffer;
+
+	volatile uint64_t mWritten;
+	volatile uint64_t mDropped;
+	volatile uint64_t mFailed;
+};
+
+
+#endif
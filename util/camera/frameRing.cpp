@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "frameRing.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+
+// futex wrappers
+static inline int futexWait( std::atomic<uint32_t>* addr, uint32_t expected, const timespec* timeout )
+{
+	return syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+}
+
+static inline void futexWake( std::atomic<uint32_t>* addr )
+{
+	syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
+// constructor
+frameRing::frameRing( uint32_t numSlots ) : mNumSlots(numSlots > 1 ? numSlots : 2)
+{
+	Reset();
+}
+
+
+// Reset
+void frameRing::Reset()
+{
+	mLatest.store(0);
+	mRetrieved.store(0);
+	mDropped.store(0);
+	mFutex.store(0);
+}
+
+
+// EndWrite
+uint64_t frameRing::EndWrite()
+{
+	const uint64_t previous = mLatest.load(std::memory_order_relaxed);
+	const uint64_t sequence = previous + 1;
+
+	// the previous frame is superseded, so if nobody retrieved it, it was dropped
+	if( previous > 0 && mRetrieved.load(std::memory_order_relaxed) < previous )
+		mDropped.fetch_add(1, std::memory_order_relaxed);
+
+	mLatest.store(sequence, std::memory_order_release);
+	mFutex.fetch_add(1, std::memory_order_release);
+	futexWake(&mFutex);
+
+	return sequence;
+}
+
+
+// Wait
+bool frameRing::Wait( uint64_t lastSequence, unsigned long timeout, uint32_t* slot, uint64_t* sequence )
+{
+	timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	if( timeout != ULONG_MAX )
+	{
+		deadline.tv_sec  += timeout / 1000;
+		deadline.tv_nsec += (timeout % 1000) * 1000000;
+
+		if( deadline.tv_nsec >= 1000000000 )
+		{
+			deadline.tv_sec  += 1;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	while( true )
+	{
+		// read the futex word before checking, so a publish in between makes the wait return
+		const uint32_t futex  = mFutex.load(std::memory_order_acquire);
+		const uint64_t latest = mLatest.load(std::memory_order_acquire);
+
+		if( latest > lastSequence )
+		{
+			// record the newest frame retrieved, for the drop counter
+			uint64_t retrieved = mRetrieved.load(std::memory_order_relaxed);
+
+			while( retrieved < latest && !mRetrieved.compare_exchange_weak(retrieved, latest, std::memory_order_relaxed) );
+
+			if( slot != NULL )
+				*slot = latest % mNumSlots;
+
+			if( sequence != NULL )
+				*sequence = latest;
+
+			return true;
+		}
+
+		if( timeout == ULONG_MAX )
+		{
+			futexWait(&mFutex, futex, NULL);
+			continue;
+		}
+
+		// FUTEX_WAIT takes a relative timeout
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		timespec remaining;
+		remaining.tv_sec  = deadline.tv_sec - now.tv_sec;
+		remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+
+		if( remaining.tv_nsec < 0 )
+		{
+			remaining.tv_sec  -= 1;
+			remaining.tv_nsec += 1000000000;
+		}
+
+		if( remaining.tv_sec < 0 )
+			return false;
+
+		futexWait(&mFutex, futex, &remaining);
+	}
+}
+
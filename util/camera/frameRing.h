@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __FRAME_RING_H__
+#define __FRAME_RING_H__
+
+
+#include <stdint.h>
+#include <atomic>
+
+
+/**
+ * Lock-free ring of frame slots, shared between one producer (the capture thread)
+ * and any number of consumers.
+ *
+ * Frames are numbered with a 64-bit sequence starting from 1, and frame N is
+ * stored in slot N % numSlots.  The producer fills the slot returned by
+ * BeginWrite() and publishes it with EndWrite().  A consumer passes the sequence
+ * of the last frame it saw to Wait(), which returns the latest frame straight away
+ * if it's newer, and otherwise sleeps on a futex until the next one is published.
+ *
+ * Frames that were overwritten by a newer one before any consumer retrieved them
+ * are counted as dropped.
+ *
+ * @ingroup util
+ */
+class frameRing
+{
+public:
+	/**
+	 * Create a ring with the specified number of slots.
+	 */
+	frameRing( uint32_t numSlots );
+
+	/**
+	 * Retrieve the slot the producer should fill with the next frame.
+	 */
+	inline uint32_t BeginWrite() const		{ return (mLatest.load(std::memory_order_relaxed) + 1) % mNumSlots; }
+
+	/**
+	 * Publish the frame written to the slot from BeginWrite(), and wake the waiting consumers.
+	 * @returns the sequence number of the frame.
+	 */
+	uint64_t EndWrite();
+
+	/**
+	 * Wait for a frame newer than lastSequence.
+	 * @param lastSequence the sequence of the last frame the caller retrieved (0 for none).
+	 * @param timeout the maximum time to wait in milliseconds, or ULONG_MAX to wait forever.
+	 * @param slot receives the slot of the latest frame.
+	 * @param sequence receives the sequence of the latest frame.
+	 * @returns true if a newer frame was retrieved, or false on timeout.
+	 */
+	bool Wait( uint64_t lastSequence, unsigned long timeout, uint32_t* slot, uint64_t* sequence );
+
+	/**
+	 * Query if the frame with the specified sequence hasn't been overwritten yet.
+	 * The producer may begin overwriting a frame once numSlots-1 newer frames are published.
+	 */
+	inline bool IsValid( uint64_t sequence ) const	{ return sequence > 0 && mLatest.load(std::memory_order_acquire) < sequence + mNumSlots - 1; }
+
+	/**
+	 * Retrieve the sequence of the latest frame published (0 if there are none yet)
+	 */
+	inline uint64_t GetLatest() const			{ return mLatest.load(std::memory_order_acquire); }
+
+	/**
+	 * Retrieve the number of frames that were never retrieved by a consumer.
+	 */
+	inline uint64_t GetDropped() const			{ return mDropped.load(std::memory_order_relaxed); }
+
+	/**
+	 * Retrieve the number of slots.
+	 */
+	inline uint32_t GetNumSlots() const			{ return mNumSlots; }
+
+	/**
+	 * Reset the sequence and counters (only while the producer is stopped)
+	 */
+	void Reset();
+
+protected:
+	const uint32_t mNumSlots;
+
+	std::atomic<uint64_t> mLatest;		/**< sequence of the latest frame published */
+	std::atomic<uint64_t> mRetrieved;	/**< sequence of the latest frame retrieved by a consumer */
+	std::atomic<uint64_t> mDropped;
+	std::atomic<uint32_t> mFutex;		/**< bumped on every publish, for the consumers to sleep on */
+};
+
+
+#endif
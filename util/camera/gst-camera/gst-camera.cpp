@@ -20,7 +20,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include "gstCamera.h"
+#include "camera.h"
 
 #include "glDisplay.h"
 #include "glTexture.h"
@@ -60,7 +60,7 @@ int main( int argc, char** argv )
 	/*
 	 * create the camera device
 	 */
-	gstCamera* camera = gstCamera::Create();
+	camera* camera = camera::Create(argc, argv);
 	
 	if( !camera )
 	{
@@ -30,43 +30,42 @@
 #include <unistd.h>
 #include <string.h>
 
-#include <QMutex>
-#include <QWaitCondition>
-
 #include "cudaMappedMemory.h"
-#include "cudaYUV.h"
-#include "cudaRGB.h"
+#include "trace.h"
 
 #include "tensorNet.h"
 
 
 // constructor
 gstCamera::gstCamera()
-	: camera(0, 0)
+	: camera(0, 0), mRing(NUM_RINGBUFFERS)
 {
 	mAppSink    = NULL;
 	mBus        = NULL;
 	mPipeline   = NULL;
 	mV4L2Device = -1;
 
-	mWidth  = 0;
-	mHeight = 0;
-	mDepth  = 0;
-	mSize   = 0;
-
-	mWaitEvent  = new QWaitCondition();
-	mWaitMutex  = new QMutex();
-	mRingMutex  = new QMutex();
+	mLastCaptured = 0;
+	mLastLeased   = 0;
+	mZeroCopy     = false;
 
-	mLatestRGBA       = 0;
-	mLatestRingbuffer = 0;
-	mLatestRetrieved  = false;
+	// the frames stay in the ringbuffer while leased, so there's nothing to do on release
+	mFrames = new cameraFramePool(NUM_RINGBUFFERS, NULL, NULL);
 
 	for( uint32_t n=0; n < NUM_RINGBUFFERS; n++ )
 	{
 		mRingbufferCPU[n] = NULL;
 		mRingbufferGPU[n] = NULL;
-		mRGBA[n]          = NULL;
+		mTimestamps[n]    = 0;
+
+		mSlots[n].sample     = NULL;
+		mSlots[n].buffer     = NULL;
+		mSlots[n].cpu        = NULL;
+		mSlots[n].gpu        = NULL;
+		mSlots[n].registered = false;
+		mSlots[n].sequence   = 0;
+		mSlots[n].held       = 0;
+		mSlots[n].refs       = 0;
 	}
 }
 
@@ -74,70 +73,7 @@ gstCamera::gstCamera()
 // destructor
 gstCamera::~gstCamera()
 {
-
-}
-
-
-// ConvertRGBA
-bool gstCamera::ConvertRGBA( void* input, void** output, bool zeroCopy )
-{
-	if( !input || !output )
-		return false;
-
-	if( !mRGBA[0] )
-	{
-		const size_t size = mWidth * mHeight * sizeof(float4);
-
-		for( uint32_t n=0; n < NUM_RINGBUFFERS; n++ )
-		{
-			if( zeroCopy )
-			{
-				void* cpuPtr = NULL;
-				void* gpuPtr = NULL;
-
-				if( !cudaAllocMapped(&cpuPtr, &gpuPtr, size) )
-				{
-					printf(LOG_CUDA "gstCamera -- failed to allocate zeroCopy memory for %ux%xu RGBA texture\n", mWidth, mHeight);
-					return false;
-				}
-
-				if( cpuPtr != gpuPtr )
-				{
-					printf(LOG_CUDA "gstCamera -- zeroCopy memory has different pointers, please use a UVA-compatible GPU\n");
-					return false;
-				}
-
-				mRGBA[n] = gpuPtr;
-			}
-			else
-			{
-				if( CUDA_FAILED(cudaMalloc(&mRGBA[n], size)) )
-				{
-					printf(LOG_CUDA "gstCamera -- failed to allocate memory for %ux%u RGBA texture\n", mWidth, mHeight);
-					return false;
-				}
-			}
-		}
-
-		printf(LOG_CUDA "gstreamer camera -- allocated %u RGBA ringbuffers\n", NUM_RINGBUFFERS);
-	}
-
-	if( onboardCamera() )
-	{
-		// onboard camera is NV12
-		if( CUDA_FAILED(cudaNV12ToRGBAf((uint8_t*)input, (float4*)mRGBA[mLatestRGBA], mWidth, mHeight)) )
-			return false;
-	}
-	else
-	{
-		// USB webcam is RGB
-		if( CUDA_FAILED(cudaRGBToRGBAf((uchar3*)input, (float4*)mRGBA[mLatestRGBA], mWidth, mHeight)) )
-			return false;
-	}
-
-	*output     = mRGBA[mLatestRGBA];
-	mLatestRGBA = (mLatestRGBA + 1) % NUM_RINGBUFFERS;
-	return true;
+	delete mFrames;
 }
 
 
@@ -175,28 +111,275 @@ GstFlowReturn gstCamera::onBuffer(_GstAppSink* sink, void* user_data)
 // Capture
 bool gstCamera::Capture( void** cpu, void** cuda, unsigned long timeout )
 {
-	mWaitMutex->lock();
-    const bool wait_result = mWaitEvent->wait(mWaitMutex, timeout);
-    mWaitMutex->unlock();
+	return Capture(cpu, cuda, &mLastCaptured, timeout);
+}
 
-	if( !wait_result )
-		return false;
 
-	mRingMutex->lock();
-	const uint32_t latest = mLatestRingbuffer;
-	const bool retrieved = mLatestRetrieved;
-	mLatestRetrieved = true;
-	mRingMutex->unlock();
+// Capture
+bool gstCamera::Capture( void** cpu, void** cuda, uint64_t* sequence, unsigned long timeout )
+{
+	TRACE_ZONE("capture");
+
+	const uint64_t previous = (sequence != NULL) ? *sequence : 0;
 
-	// skip if it was already retrieved
-	if( retrieved )
-		return false;
+	uint32_t latest = 0;
+	uint64_t latestSequence = 0;
+
+	bool referenced = false;
+
+	while( true )
+	{
+		// returns straight away if there's a newer frame than the caller's last one
+		if( !mRing.Wait(previous, timeout, &latest, &latestSequence) )
+			return false;
+
+		if( !mZeroCopy )
+			break;
+
+		// take a reference on the sample, unless the capture thread retired it in the meantime
+		mSlots[latest].refs.fetch_add(1);
+
+		if( mSlots[latest].sequence.load() == latestSequence )
+		{
+			referenced = true;
+			break;
+		}
+
+		mSlots[latest].refs.fetch_sub(1);
+	}
+
+	TRACE_FRAME(latestSequence);
+
+	// the consumer has moved on from its previous frame
+	// (a no-op if it already released it, as that reset its sequence)
+	if( sequence != NULL )
+	{
+		ReleaseFrame(sequence);
+		*sequence = latestSequence;
+	}
 
 	if( cpu != NULL )
-		*cpu = mRingbufferCPU[latest];
+		*cpu = referenced ? mSlots[latest].cpu : mRingbufferCPU[latest];
 
 	if( cuda != NULL )
-		*cuda = mRingbufferGPU[latest];
+		*cuda = referenced ? mSlots[latest].gpu : mRingbufferGPU[latest];
+
+	if( mRecorder != NULL )
+	{
+		cameraFrameInfo info;
+		frameInfo(latest, latestSequence, &info);
+		record(info);
+	}
+
+	return true;
+}
+
+
+// frameInfo
+void gstCamera::frameInfo( uint32_t slot, uint64_t sequence, cameraFrameInfo* info ) const
+{
+	info->cpu       = mZeroCopy ? mSlots[slot].cpu : mRingbufferCPU[slot];
+	info->cuda      = mZeroCopy ? mSlots[slot].gpu : mRingbufferGPU[slot];
+	info->width     = mWidth;
+	info->height    = mHeight;
+	info->pitch     = onboardCamera() ? mWidth : mWidth * 3;
+	info->size      = mSize;
+	info->format    = mFormat;
+	info->timestamp = mTimestamps[slot];
+	info->sequence  = sequence;
+}
+
+
+// CaptureFrame
+cameraFrame* gstCamera::CaptureFrame( unsigned long timeout )
+{
+	TRACE_ZONE("capture");
+
+	uint32_t latest = 0;
+	uint64_t latestSequence = 0;
+
+	cameraFrame* frame = NULL;
+
+	while( frame == NULL )
+	{
+		if( !mRing.Wait(mLastLeased.load(), timeout, &latest, &latestSequence) )
+			return NULL;
+
+		if( mZeroCopy )
+		{
+			// hold the sample with a reference until it's leased, unless it was retired in the meantime
+			mSlots[latest].refs.fetch_add(1);
+
+			if( mSlots[latest].sequence.load() == latestSequence )
+			{
+				cameraFrameInfo info;
+				frameInfo(latest, latestSequence, &info);
+				frame = mFrames->Lease(latest, info);
+			}
+
+			mSlots[latest].refs.fetch_sub(1);
+		}
+		else
+		{
+			cameraFrameInfo info;
+			frameInfo(latest, latestSequence, &info);
+			frame = mFrames->Lease(latest, info);
+
+			// the capture thread checks for the lease before overwriting a frame,
+			// so if the frame is still intact now, it stays intact until released
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if( !mRing.IsValid(latestSequence) )
+			{
+				frame->Release();
+				frame = NULL;
+			}
+		}
+	}
+
+	TRACE_FRAME(latestSequence);
+
+	// only ever move forward, in case another consumer leased a newer frame meanwhile
+	uint64_t lastLeased = mLastLeased.load();
+
+	while( lastLeased < latestSequence && !mLastLeased.compare_exchange_weak(lastLeased, latestSequence) );
+
+	record(*frame);
+	return frame;
+}
+
+
+// ReleaseFrame
+void gstCamera::ReleaseFrame( uint64_t* sequence )
+{
+	if( !sequence || *sequence == 0 )
+		return;
+
+	const uint64_t released = *sequence;
+	*sequence = 0;
+
+	// referenced slots are never reused, so the frame is still in its slot
+	// (the sample itself is freed later by the capture thread).  Only drop a
+	// reference that belongs to this frame, so a stale sequence can't take
+	// away another consumer's reference on whatever the slot holds now.
+	frameSlot& slot = mSlots[released % NUM_RINGBUFFERS];
+
+	int32_t refs = slot.refs.load();
+
+	while( refs > 0 && slot.held.load() == released )
+	{
+		if( slot.refs.compare_exchange_weak(refs, refs - 1) )
+			break;
+	}
+}
+
+
+// IsFrameValid
+bool gstCamera::IsFrameValid( uint64_t sequence ) const
+{
+	if( mZeroCopy )
+		return sequence > 0 && mSlots[sequence % NUM_RINGBUFFERS].sample != NULL &&
+			  (mSlots[sequence % NUM_RINGBUFFERS].sequence.load() == sequence || mSlots[sequence % NUM_RINGBUFFERS].refs.load() > 0);
+
+	return mRing.IsValid(sequence);
+}
+
+
+// retireSlot
+void gstCamera::retireSlot( uint32_t slot )
+{
+	// stop new consumers from taking it, then free it if no consumer has it
+	mSlots[slot].sequence.store(0);
+
+	if( mSlots[slot].refs.load() == 0 && !mFrames->IsLeased(slot) )
+		freeSlot(slot);
+}
+
+
+// freeSlot
+void gstCamera::freeSlot( uint32_t slot )
+{
+	frameSlot& s = mSlots[slot];
+
+	if( !s.sample )
+		return;
+
+	if( s.registered )
+		CUDA(cudaHostUnregister(s.cpu));
+
+	gst_buffer_unmap(s.buffer, &s.map);
+	gst_sample_unref(s.sample);
+
+	s.sample     = NULL;
+	s.buffer     = NULL;
+	s.cpu        = NULL;
+	s.gpu        = NULL;
+	s.registered = false;
+}
+
+
+// freeSlots
+void gstCamera::freeSlots( bool all )
+{
+	for( uint32_t n=0; n < NUM_RINGBUFFERS; n++ )
+	{
+		if( mSlots[n].sample != NULL && (all || (mSlots[n].sequence.load() == 0 && mSlots[n].refs.load() == 0 && !mFrames->IsLeased(n))) )
+			freeSlot(n);
+	}
+}
+
+
+// holdSample
+bool gstCamera::holdSample( GstSample* gstSample, GstBuffer* gstBuffer, GstMapInfo* map )
+{
+	// free the retired frames that the consumers have moved on from
+	freeSlots(false);
+
+	const uint32_t next = mRing.BeginWrite();
+	frameSlot& slot = mSlots[next];
+
+	if( slot.sample != NULL )
+	{
+		retireSlot(next);
+
+		// a consumer is still using the frame from a full lap ago, so drop this one
+		if( slot.sample != NULL )
+		{
+			mFrames->Starved();
+			gst_buffer_unmap(gstBuffer, map);
+			gst_sample_unref(gstSample);
+			return true;
+		}
+	}
+
+	// make the gstreamer memory accessible to CUDA
+	void* gpu = NULL;
+
+	if( CUDA_FAILED(cudaHostRegister(map->data, map->size, cudaHostRegisterMapped)) ||
+	    CUDA_FAILED(cudaHostGetDevicePointer(&gpu, map->data, 0)) )
+	{
+		printf(LOG_CUDA "gstreamer camera -- failed to register buffer with CUDA, disabling zeroCopy\n");
+		mZeroCopy = false;
+		return false;
+	}
+
+	slot.sample     = gstSample;
+	slot.buffer     = gstBuffer;
+	slot.map        = *map;
+	slot.cpu        = map->data;
+	slot.gpu        = gpu;
+	slot.registered = true;
+
+	mTimestamps[next] = cameraTimestamp();
+	slot.held.store(mRing.GetLatest() + 1);
+	slot.sequence.store(mRing.GetLatest() + 1);
+	const uint64_t sequence = mRing.EndWrite();
+
+	// the previous frame can't be captured anymore, so free it unless a consumer has it
+	const uint32_t previous = (sequence - 1) % NUM_RINGBUFFERS;
+
+	if( sequence > 1 && mSlots[previous].sequence.load() == sequence - 1 )
+		retireSlot(previous);
 
 	return true;
 }
@@ -220,6 +403,10 @@ void gstCamera::checkBuffer()
 		return;
 	}
 
+	// the copy into the ring, tagged with the sequence the frame will be published as
+	TRACE_ZONE("checkBuffer");
+	TRACE_FRAME(mRing.GetLatest() + 1);
+
 	GstBuffer* gstBuffer = gst_sample_get_buffer(gstSample);
 
 	if( !gstBuffer )
@@ -286,6 +473,10 @@ void gstCamera::checkBuffer()
 
 	//printf(LOG_GSTREAMER "gstreamer camera recieved %ix%i frame (%u bytes, %u bpp)\n", width, height, gstSize, mDepth);
 
+	// hold onto the sample in the ring instead of copying it
+	if( mZeroCopy && holdSample(gstSample, gstBuffer, &map) )
+		return;
+
 	// make sure ringbuffer is allocated
 	if( !mRingbufferCPU[0] )
 	{
@@ -299,7 +490,17 @@ void gstCamera::checkBuffer()
 	}
 
 	// copy to next ringbuffer
-	const uint32_t nextRingbuffer = (mLatestRingbuffer + 1) % NUM_RINGBUFFERS;
+	const uint32_t nextRingbuffer = mRing.BeginWrite();
+
+	// never overwrite a leased frame, drop the new one instead
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if( mFrames->IsLeased(nextRingbuffer) )
+	{
+		mFrames->Starved();
+		gst_buffer_unmap(gstBuffer, &map);
+		release_return;
+	}
 
 	//printf(LOG_GSTREAMER "gstreamer camera -- using ringbuffer #%u for next frame\n", nextRingbuffer);
 	memcpy(mRingbufferCPU[nextRingbuffer], gstData, gstSize);
@@ -307,13 +508,10 @@ void gstCamera::checkBuffer()
 	//gst_buffer_unref(gstBuffer);
 	gst_sample_unref(gstSample);
 
+	mTimestamps[nextRingbuffer] = cameraTimestamp();
 
-	// update and signal sleeping threads
-	mRingMutex->lock();
-	mLatestRingbuffer = nextRingbuffer;
-	mLatestRetrieved  = false;
-	mRingMutex->unlock();
-	mWaitEvent->wakeAll();
+	// publish and wake the sleeping threads
+	mRing.EndWrite();
 }
 
 
@@ -356,7 +554,7 @@ bool gstCamera::buildLaunchStr()
 
 
 // Create
-gstCamera* gstCamera::Create( uint32_t width, uint32_t height, int v4l2_device )
+gstCamera* gstCamera::Create( uint32_t width, uint32_t height, int v4l2_device, bool zeroCopy )
 {
 	if( !gstreamerInit() )
 	{
@@ -370,9 +568,11 @@ gstCamera* gstCamera::Create( uint32_t width, uint32_t height, int v4l2_device )
 		return NULL;
 
 	cam->mV4L2Device = v4l2_device;
+	cam->mZeroCopy   = zeroCopy;
 	cam->mWidth      = width;
 	cam->mHeight     = height;
-	cam->mDepth      = cam->onboardCamera() ? 12 : 24;	// NV12 or RGB
+	cam->mFormat     = cam->onboardCamera() ? PIXEL_FORMAT_NV12 : PIXEL_FORMAT_RGB8;
+	cam->mDepth      = pixelFormatDepth(cam->mFormat);
 	cam->mSize       = (width * height * cam->mDepth) / 8;
 
 	if( !cam->init() )
@@ -386,9 +586,9 @@ gstCamera* gstCamera::Create( uint32_t width, uint32_t height, int v4l2_device )
 
 
 // Create
-gstCamera* gstCamera::Create( int v4l2_device )
+gstCamera* gstCamera::Create( int v4l2_device, bool zeroCopy )
 {
-	return Create( DefaultWidth, DefaultHeight, v4l2_device );
+	return Create( DefaultWidth, DefaultHeight, v4l2_device, zeroCopy );
 }
 
 
@@ -510,6 +710,15 @@ void gstCamera::Close()
 		printf(LOG_GSTREAMER "gstreamer failed to set pipeline state to PLAYING (error %u)\n", result);
 
 	usleep(250*1000);
+
+	// the consumers are expected to be finished with the frames by now
+	freeSlots(true);
+
+	printf(LOG_GSTREAMER "gstreamer camera -- captured %llu frames, %llu dropped\n", 
+		  (unsigned long long)mRing.GetLatest(), (unsigned long long)mRing.GetDropped());
+
+	printf(LOG_GSTREAMER "gstreamer camera -- leased %llu frames, %llu starved (%u still leased)\n", 
+		  (unsigned long long)mFrames->GetLeases(), (unsigned long long)mFrames->GetStarved(), mFrames->GetLeased());
 }
 
 
@@ -26,11 +26,10 @@
 #include <gst/gst.h>
 #include <string>
 #include "camera.h"
+#include "frameRing.h"
 
 
 struct _GstAppSink;
-class QWaitCondition;
-class QMutex;
 
 
 /**
@@ -41,8 +40,10 @@ class gstCamera : public camera
 {
 public:
 	// Create camera
-	static gstCamera* Create( int v4l2_device=-1 );	// use onboard camera by default (>=0 for V4L2)
-	static gstCamera* Create( uint32_t width, uint32_t height, int v4l2_device=-1 );
+	// With zeroCopy, the frames are captured in-place from the gstreamer buffers instead of being copied,
+	// and each frame stays valid until the consumer captures its next one (or calls ReleaseFrame)
+	static gstCamera* Create( int v4l2_device=-1, bool zeroCopy=false );	// use onboard camera by default (>=0 for V4L2)
+	static gstCamera* Create( uint32_t width, uint32_t height, int v4l2_device=-1, bool zeroCopy=false );
 
 	// Destroy
 	~gstCamera();
@@ -52,17 +53,30 @@ public:
 	void Close();
 
 	// Capture YUV (NV12)
+	// Returns immediately if there's a frame newer than the last one captured, otherwise waits for one.
 	bool Capture( void** cpu, void** cuda, unsigned long timeout=ULONG_MAX );
 
-	// Takes in captured YUV-NV12 CUDA image, converts to float4 RGBA (with pixel intensity 0-255)
-	// Set zeroCopy to true if you need to access ConvertRGBA from CPU, otherwise it will be CUDA only.
-	bool ConvertRGBA( void* input, void** output, bool zeroCopy=false );
+	// Capture with the caller tracking the sequence of its last frame, for multiple consumers.
+	// sequence is the last frame's sequence on input (0 for none), and receives the new one.
+	bool Capture( void** cpu, void** cuda, uint64_t* sequence, unsigned long timeout=ULONG_MAX );
 
-	// Image dimensions
-	inline uint32_t GetWidth() const	  { return mWidth; }
-	inline uint32_t GetHeight() const	  { return mHeight; }
-	inline uint32_t GetPixelDepth() const { return mDepth; }
-	inline uint32_t GetSize() const		  { return mSize; }
+	// Capture a lease on the next frame, newer than the last one leased.
+	// The ringbuffer skips over a leased frame instead of overwriting it, until it's released.
+	cameraFrame* CaptureFrame( unsigned long timeout=ULONG_MAX );
+
+	// Query if a captured frame is still intact, before the ringbuffer wraps around and overwrites it
+	bool IsFrameValid( uint64_t sequence ) const;
+
+	// Release a frame captured in zeroCopy mode, when the consumer is done with it but isn't capturing another.
+	// The caller's sequence is reset to 0, so releasing it again (or capturing with it) doesn't release twice.
+	void ReleaseFrame( uint64_t* sequence );
+
+	// Query if the frames are captured without copying
+	inline bool IsZeroCopy() const		  { return mZeroCopy; }
+
+	// Frame counters
+	inline uint64_t GetFrameCount() const	  { return mRing.GetLatest(); }
+	inline uint64_t GetDroppedFrames() const  { return mRing.GetDropped(); }
 
 	// Default resolution, unless otherwise specified during Create()
 	static const uint32_t DefaultWidth  = 1280;
@@ -79,6 +93,27 @@ private:
 	bool buildLaunchStr();
 	void checkMsgBus();
 	void checkBuffer();
+	void frameInfo( uint32_t slot, uint64_t sequence, cameraFrameInfo* info ) const;
+
+	// zeroCopy
+	struct frameSlot
+	{
+		GstSample*  sample;
+		GstBuffer*  buffer;
+		GstMapInfo  map;
+		void*       cpu;
+		void*       gpu;
+		bool        registered;
+
+		std::atomic<uint64_t> sequence;	// sequence of the frame held, or 0 once it's retired
+		std::atomic<uint64_t> held;		// sequence of the frame held, kept after it's retired
+		std::atomic<int32_t>  refs;		// number of consumers using the frame
+	};
+
+	bool holdSample( GstSample* sample, GstBuffer* buffer, GstMapInfo* map );
+	void retireSlot( uint32_t slot );
+	void freeSlot( uint32_t slot );
+	void freeSlots( bool all );
 
 	_GstBus*     mBus;
 	_GstAppSink* mAppSink;
@@ -86,27 +121,20 @@ private:
 
 	std::string  mLaunchStr;
 
-	uint32_t mWidth;
-	uint32_t mHeight;
-	uint32_t mDepth;
-	uint32_t mSize;
-
 	static const uint32_t NUM_RINGBUFFERS = 16;
 
 	void* mRingbufferCPU[NUM_RINGBUFFERS];
 	void* mRingbufferGPU[NUM_RINGBUFFERS];
 
-	QWaitCondition* mWaitEvent;
-
-	QMutex* mWaitMutex;
-	QMutex* mRingMutex;
+	frameRing mRing;
+	uint64_t  mLastCaptured;	// sequence of the last frame returned by Capture() without a sequence
+	std::atomic<uint64_t> mLastLeased;	// sequence of the newest frame returned by CaptureFrame(), shared by its callers
+	uint64_t  mTimestamps[NUM_RINGBUFFERS];
 
-	uint32_t mLatestRGBA;
-	uint32_t mLatestRingbuffer;
-	bool     mLatestRetrieved;
+	frameSlot mSlots[NUM_RINGBUFFERS];
+	std::atomic<bool> mZeroCopy;	// cleared by the capture thread if CUDA can't map the buffers
 
-	void* mRGBA[NUM_RINGBUFFERS];
-	int   mV4L2Device;	// -1 for onboard, >=0 for V4L2 device
+	int mV4L2Device;	// -1 for onboard, >=0 for V4L2 device
 
 	inline bool onboardCamera() const		{ return (mV4L2Device < 0); }
 };
@@ -2,12 +2,47 @@
 #include "pylonCamera.h"
 #include "pylonUtility.h"
 
+#include "cudaMappedMemory.h"
+
+#include <string.h>
+#include <algorithm>
+
+// bayer pixel types are passed through for the GPU demosaic, others are converted to RGB on the CPU
+static pixelFormat pylonBayerFormat(Pylon::EPixelType type)
+{
+    switch (type)
+    {
+        case Pylon::EPixelType::PixelType_BayerGR8: return PIXEL_FORMAT_BAYER_GRBG8;
+        case Pylon::EPixelType::PixelType_BayerRG8: return PIXEL_FORMAT_BAYER_RGGB8;
+        case Pylon::EPixelType::PixelType_BayerBG8: return PIXEL_FORMAT_BAYER_BGGR8;
+        case Pylon::EPixelType::PixelType_BayerGB8: return PIXEL_FORMAT_BAYER_GBRG8;
+        default:                                    return PIXEL_FORMAT_UNKNOWN;
+    }
+}
+
+
 // constructor
 pylonCamera::pylonCamera(std::vector<CameraNode*> cameras,
                          int height,
                          int width)
     : camera(height, width)
 {
+    mFormat     = PIXEL_FORMAT_RGB8;
+    mDepth      = pixelFormatDepth(mFormat);
+    mSize       = mWidth * mHeight * 3;
+    mNextBuffer = 0;
+    mSequence   = 0;
+    mLastFrame  = NULL;
+
+    for (uint32_t n = 0; n < NUM_BUFFERS; ++n)
+    {
+        mBuffersCPU[n] = NULL;
+        mBuffersGPU[n] = NULL;
+    }
+
+    // The frames stay in their buffers while leased, so there's nothing to do on release.
+    mFrames = new cameraFramePool(NUM_BUFFERS, NULL, NULL);
+
     // Initialize Pylon runtime first.
     Pylon::PylonInitialize();
 
@@ -28,6 +63,17 @@ pylonCamera::pylonCamera(std::vector<CameraNode*> cameras,
 
 pylonCamera::~pylonCamera()
 {
+    if (mLastFrame != NULL)
+        mLastFrame->Release();
+
+    delete mFrames;
+
+    for (uint32_t n = 0; n < NUM_BUFFERS; ++n)
+    {
+        if (mBuffersCPU[n] != NULL)
+            CUDA(cudaFreeHost(mBuffersCPU[n]));
+    }
+
     // Properly delete CInstanceCameraArray
     delete mCameras;
     // Terminate the Pylon runtime.
@@ -52,10 +98,17 @@ bool pylonCamera::Open()
                 GenApi::CFloatPtr((*mCameras)[i].GetNodeMap().GetNode("AcquisitionFrameRate"))->SetValue(30); // TODO: Unhardcode framerate
         }
 
-        // Initialize mNextImage as an empty image.
-        mNextImage.Reset(Pylon::EPixelType::PixelType_RGB8packed, mWidth, mHeight);
+        // Allocate the RGB buffers the frames are converted into, accessible from both CPU and GPU.
+        for (uint32_t n = 0; n < NUM_BUFFERS; ++n)
+        {
+            if (mBuffersCPU[n] == NULL && !cudaAllocMapped(&mBuffersCPU[n], &mBuffersGPU[n], mSize))
+            {
+                std::cerr << LOG_PYLON << "Failed to allocate " << mWidth << "x" << mHeight << " RGB buffer" << std::endl;
+                return false;
+            }
+        }
 
-        return true;
+        return StartGrabbing();
     }
     catch (GenICam::GenericException &e)
     {
@@ -116,73 +169,128 @@ bool pylonCamera::StartGrabbing()
     // for more information.
 
     std::cout << LOG_PYLON << "Starting Pylon driver grab engine..." << std::endl;
-    cameras_->StartGrabbing(Pylon::EGrabStrategy::GrabStrategy_LatestImageOnly);
+    mCameras->StartGrabbing(Pylon::EGrabStrategy::GrabStrategy_LatestImageOnly);
     return true;
 }
 
 
 bool pylonCamera::Capture(void** cpu, void** cuda, unsigned long timeout=ULONG_MAX)
 {
-    try
+    // The previous frame can be overwritten once the caller is on to the next one.
+    if (mLastFrame != NULL)
     {
-        // Pylon grab functions are not thread safe, so need to lock RetrieveImage since it could be called
-        // from NeedDataCB or grab thread created in StartCameraLoop.
-        mRetrieveMutex.lock();
+        mLastFrame->Release();
+        mLastFrame = NULL;
+    }
+
+    mLastFrame = CaptureFrame(timeout);
+
+    if (mLastFrame == NULL)
+        return false;
+
+    if( cpu != NULL )
+        *cpu = mLastFrame->cpu;
+    if( cuda != NULL )
+        *cuda = mLastFrame->cuda;
+
+    return true;
+}
+
 
+cameraFrame* pylonCamera::CaptureFrame(unsigned long timeout)
+{
+    // Pylon grab functions are not thread safe, so need to lock RetrieveImage since it could be called
+    // from NeedDataCB or grab thread created in StartCameraLoop.
+    std::lock_guard<std::mutex> lock(mRetrieveMutex);
+
+    try
+    {
         Pylon::CImageFormatConverter formatConverter;
+        formatConverter.OutputPixelFormat = Pylon::EPixelType::PixelType_RGB8packed;
+
         if (!mCameras->IsGrabbing())
         {
-            std::cout << LOG_PYLON << "Cameras are not grabbing. Call StartCameras() first." << std::endl;
-            return false;
+            std::cout << LOG_PYLON << "Cameras are not grabbing. Call Open() first." << std::endl;
+            return NULL;
         }
-        else
+
+        // Find a buffer that isn't leased, the leased ones are never overwritten.
+        uint32_t buffer = NUM_BUFFERS;
+
+        for (uint32_t n = 0; n < NUM_BUFFERS; ++n)
         {
-            std::cout << LOG_PYLON << "Starting to grab frames with cameras." << std::endl;
-            mCameras->StartGrabbing();
+            const uint32_t i = (mNextBuffer + n) % NUM_BUFFERS;
+
+            if (mBuffersCPU[i] != NULL && !mFrames->IsLeased(i))
+            {
+                buffer = i;
+                break;
+            }
+        }
+
+        if (buffer == NUM_BUFFERS)
+        {
+            mFrames->Starved();
+            return NULL;
         }
 
         static int cam_index = 0;
 
         Pylon::CGrabResultPtr grabResult;
         (*mCameras)[cam_index].RetrieveResult(timeout/1000, grabResult, Pylon::ETimeoutHandling::TimeoutHandling_ThrowException);
-        if (grabResult->GrabSucceeded())
-        {
-            if (!formatConverter.ImageHasDestinationFormat(grabResult))
-                formatConverter.Convert(mNextImage, grabResult);
-            else if (formatConverter.ImageHasDestinationFormat(grabResult))
-                mNextImage.CopyImage(grabResult);
 
-            intptr_t cameraContextValue = grabResult->GetCameraContext();
-            std::cout << LOG_PYLON << "Grabbed image from camera " << cameraContextValue << std::endl;
-        }
-        else
+        // Increment camera index no matter what. This way if a camera fails, all cameras are not stalled.
+        cam_index = ((cam_index+1) < mCameras->GetSize()) ? cam_index+1 : 0;
+
+        if (!grabResult->GrabSucceeded())
         {
             intptr_t cameraContextValue = grabResult->GetCameraContext();
             std::cout << LOG_PYLON << "Pylon: Grab result failed for camera " << cameraContextValue << ": "
                 << grabResult->GetErrorDescription() << std::endl;
+            return NULL;
         }
 
-        if( cpu != NULL )
-            *cpu = mNextImage.GetBuffer();
-        if( cuda != NULL )
-            *cuda = mNextImage.GetBuffer();
+        // The buffers are sized for RGB, so a raw bayer frame (1 byte per pixel) always fits.
+        const pixelFormat bayer = pylonBayerFormat(grabResult->GetPixelType());
 
-        // Increment camera index no matter what. This way if a camera fails, all cameras are not stalled.
-        cam_index = ((cam_index+1) < mCameras->GetSize()) ? cam_index+1 : 0;
+        if (bayer != PIXEL_FORMAT_UNKNOWN)
+            memcpy(mBuffersCPU[buffer], grabResult->GetBuffer(), std::min<size_t>(grabResult->GetImageSize(), mWidth * mHeight));
+        else if (!formatConverter.ImageHasDestinationFormat(grabResult))
+            formatConverter.Convert(mBuffersCPU[buffer], mSize, grabResult);
+        else
+            memcpy(mBuffersCPU[buffer], grabResult->GetBuffer(), std::min<size_t>(grabResult->GetImageSize(), mSize));
 
-        mRetrieveMutex.unlock();
-        return true;
+        // ConvertRGBA() follows the format of the latest frame
+        mFormat = (bayer != PIXEL_FORMAT_UNKNOWN) ? bayer : PIXEL_FORMAT_RGB8;
+        mDepth  = pixelFormatDepth(mFormat);
+
+        intptr_t cameraContextValue = grabResult->GetCameraContext();
+        std::cout << LOG_PYLON << "Grabbed image from camera " << cameraContextValue << std::endl;
+
+        cameraFrameInfo info;
+
+        info.cpu       = mBuffersCPU[buffer];
+        info.cuda      = mBuffersGPU[buffer];
+        info.width     = mWidth;
+        info.height    = mHeight;
+        info.pitch     = mWidth * (mDepth / 8);
+        info.size      = mWidth * mHeight * (mDepth / 8);
+        info.format    = mFormat;
+        info.timestamp = cameraTimestamp();
+        info.sequence  = ++mSequence;
+
+        mNextBuffer = (buffer + 1) % NUM_BUFFERS;
+        record(info);
+        return mFrames->Lease(buffer, info);
     }
     catch (Pylon::GenericException &e)
     {
         std::cerr << "An exception occurred in RetrieveImage(): " << std::endl << e.GetDescription() << std::endl;
-        mRetrieveMutex.unlock();
-        return false;
+        return NULL;
     }
     catch (std::exception &e)
     {
         std::cerr << "An exception occurred in RetrieveImage(): " << std::endl << e.what() << std::endl;
-        mRetrieveMutex.unlock();
-        return false;
+        return NULL;
     }
-}
\ No newline at end of file
+}
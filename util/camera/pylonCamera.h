@@ -24,15 +24,28 @@ public:
 	bool Open();
 	void Close();
 	// Capture RGB
+	// The image stays valid until the next call to Capture()
 	bool Capture(void** cpu, void** cuda, unsigned long timeout);
 
+	// Capture a lease on the next RGB frame, which isn't overwritten until it's released
+	cameraFrame* CaptureFrame(unsigned long timeout);
+
 protected:
 	bool StartGrabbing();
 
 private:
+    static const uint32_t NUM_BUFFERS = 4;
+
     Pylon::CInstantCameraArray* mCameras;
-	Pylon::CPylonImage mNextImage;
     std::mutex mRetrieveMutex;
+
+    void* mBuffersCPU[NUM_BUFFERS];
+    void* mBuffersGPU[NUM_BUFFERS];
+
+    uint32_t mNextBuffer;
+    uint64_t mSequence;
+
+    cameraFrame* mLastFrame;	// the frame returned by Capture()
 };
 
 #endif
@@ -0,0 +1,984 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "replayCamera.h"
+#include "cameraRecorder.h"
+#include "imageList.h"
+#include "loadImage.h"
+
+#include "cudaMappedMemory.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+
+
+// frames in the pool are aligned for the conversion kernels
+#define REPLAY_FRAME_ALIGN 256
+
+
+// retrieve an option from a query string like "fps=30&jitter=2"
+static bool getOption( const char* options, const char* key, std::string* value )
+{
+	if( !options )
+		return false;
+
+	const size_t keyLength = strlen(key);
+	const char* str = options;
+
+	while( *str != '\0' )
+	{
+		const char* end = strchr(str, '&');
+
+		if( !end )
+			end = str + strlen(str);
+
+		if( strncasecmp(str, key, keyLength) == 0 && str[keyLength] == '=' )
+		{
+			*value = std::string(str + keyLength + 1, end);
+			return true;
+		}
+
+		str = (*end == '&') ? end + 1 : end;
+	}
+
+	return false;
+}
+
+static float getOption( const char* options, const char* key, float defaultValue )
+{
+	std::string value;
+
+	if( !getOption(options, key, &value) || value.empty() )
+		return defaultValue;
+
+	return atof(value.c_str());
+}
+
+
+// 64-bit mix function (splitmix64), for reproducible jitter
+static inline uint64_t mix64( uint64_t x )
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x  = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x  = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+
+// BT.601 limited range
+static inline uint8_t rgbToY( int r, int g, int b )	{ return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16; }
+static inline uint8_t rgbToU( int r, int g, int b )	{ return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128; }
+static inline uint8_t rgbToV( int r, int g, int b )	{ return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128; }
+
+
+// constructor
+replayCamera::replayCamera() : camera(0, 0)
+{
+	mPoolCPU     = NULL;
+	mPoolGPU     = NULL;
+	mFrameStride = 0;
+	mNumFrames   = 0;
+	mMaxFrames   = DefaultMaxFrames;
+	mPitch       = 0;
+
+	mFrameRate = 30.0f;
+	mJitter    = 0.0f;
+	mSeed      = 1;
+	mLoop      = true;
+	mEOS       = false;
+
+	mStart     = 0;
+	mNextIndex = 0;
+	mDropped   = 0;
+	mNextLease = 0;
+	mLastFrame = NULL;
+
+	mLog          = NULL;
+	mLogSize      = 0;
+	mLogLength    = 0;
+	mLogSequences = 0;
+	mSpeed        = 1.0f;
+}
+
+
+// destructor
+replayCamera::~replayCamera()
+{
+	if( mLastFrame != NULL )
+	{
+		mLastFrame->Release();
+		mLastFrame = NULL;
+	}
+
+	if( mFrames != NULL )
+	{
+		delete mFrames;
+		mFrames = NULL;
+	}
+
+	if( mPoolCPU != NULL )
+	{
+		CUDA(cudaFreeHost(mPoolCPU));
+		mPoolCPU = NULL;
+	}
+
+	if( mLog != NULL )
+	{
+		munmap(mLog, mLogSize);
+		mLog = NULL;
+	}
+}
+
+
+// Create
+replayCamera* replayCamera::Create( const char* path, const char* options, uint32_t width, uint32_t height )
+{
+	if( !path )
+		return NULL;
+
+	replayCamera* cam = new replayCamera();
+
+	if( !cam->init(path, options, width, height) )
+	{
+		printf("replayCamera -- failed to create '%s'\n", path);
+		delete cam;
+		return NULL;
+	}
+
+	printf("replayCamera -- %s %u %ux%u %s frames from '%s'", cam->mLog != NULL ? "mapped" : "preloaded", cam->mNumFrames, cam->mWidth, cam->mHeight, pixelFormatToStr(cam->mFormat), path);
+
+	if( cam->mFrameRate > 0.0f )
+		printf(" at %g FPS\n", cam->mFrameRate);
+	else
+		printf(" (as fast as possible)\n");
+
+	return cam;
+}
+
+
+// init
+bool replayCamera::init( const char* path, const char* options, uint32_t width, uint32_t height )
+{
+	mPath      = path;
+	mWidth     = getOption(options, "width", (float)width);
+	mHeight    = getOption(options, "height", (float)height);
+	mFrameRate = getOption(options, "fps", 30.0f);
+	mJitter    = getOption(options, "jitter", 0.0f);
+	mSeed      = getOption(options, "seed", 1.0f);
+	mMaxFrames = getOption(options, "frames", (float)DefaultMaxFrames);
+	mLoop      = getOption(options, "loop", 1.0f) != 0.0f;
+	mSpeed     = getOption(options, "speed", 1.0f);
+
+	if( mFrameRate < 0.0f )
+		mFrameRate = 0.0f;
+
+	if( mMaxFrames == 0 )
+		mMaxFrames = 1;
+
+	std::string formatStr;
+	getOption(options, "format", &formatStr);
+	mFormat = pixelFormatFromStr(formatStr.c_str());
+
+	if( !formatStr.empty() && mFormat == PIXEL_FORMAT_UNKNOWN )
+	{
+		printf("replayCamera -- unknown pixel format '%s'\n", formatStr.c_str());
+		return false;
+	}
+
+	if( mPath == "pattern" )
+		return loadPattern();
+
+	struct stat info;
+
+	if( stat(path, &info) != 0 )
+	{
+		printf("replayCamera -- '%s' doesn't exist\n", path);
+		return false;
+	}
+
+	// logs are recognized by their magic number
+	if( S_ISREG(info.st_mode) )
+	{
+		char magic[sizeof(CAMERA_LOG_MAGIC) - 1];
+
+		FILE* file = fopen(path, "rb");
+
+		const bool isLog = file != NULL && fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+					    memcmp(magic, CAMERA_LOG_MAGIC, sizeof(magic)) == 0;
+
+		if( file != NULL )
+			fclose(file);
+
+		if( isLog )
+			return loadLog(path);
+	}
+
+	// raw dumps are recognized by their extension being a pixel format
+	const char* ext = strrchr(path, '.');
+
+	if( !S_ISDIR(info.st_mode) && ext != NULL && pixelFormatFromStr(ext + 1) != PIXEL_FORMAT_UNKNOWN )
+		return loadRaw(path);
+
+	return loadImages(path);
+}
+
+
+// initPool
+bool replayCamera::initPool( uint32_t numFrames )
+{
+	if( mWidth == 0 || mHeight == 0 || numFrames == 0 )
+		return false;
+
+	// the chroma of the YUV and bayer formats is subsampled in pairs of pixels
+	if( mFormat >= PIXEL_FORMAT_NV12 && ((mWidth & 1) != 0 || (mHeight & 1) != 0) )
+	{
+		printf("replayCamera -- %s needs an even width and height (%ux%u)\n", pixelFormatToStr(mFormat), mWidth, mHeight);
+		return false;
+	}
+
+	mDepth = pixelFormatDepth(mFormat);
+
+	// logs keep the pitch and size the camera reported
+	if( mPitch == 0 )
+		mPitch = pixelFormatPitch(mFormat, mWidth);
+
+	if( mSize == 0 )
+		mSize = (mWidth * mHeight * mDepth) / 8;
+
+	mFrameStride = ((mSize + REPLAY_FRAME_ALIGN - 1) / REPLAY_FRAME_ALIGN) * REPLAY_FRAME_ALIGN;
+
+	if( !cudaAllocMapped((void**)&mPoolCPU, (void**)&mPoolGPU, mFrameStride * numFrames) )
+	{
+		printf("replayCamera -- failed to allocate %u frames (%zu bytes)\n", numFrames, mFrameStride * numFrames);
+		return false;
+	}
+
+	mFrames = new cameraFramePool(NUM_LEASES, NULL, NULL);
+	return true;
+}
+
+
+// packRGB
+bool replayCamera::packRGB( const uint8_t* rgb, uint8_t* output ) const
+{
+	const uint32_t width  = mWidth;
+	const uint32_t height = mHeight;
+	const uint32_t pixels = width * height;
+
+	switch(mFormat)
+	{
+		case PIXEL_FORMAT_RGB8:
+		{
+			memcpy(output, rgb, pixels * 3);
+			return true;
+		}
+		case PIXEL_FORMAT_BGR8:
+		{
+			for( uint32_t n=0; n < pixels; n++ )
+			{
+				output[n*3+0] = rgb[n*3+2];
+				output[n*3+1] = rgb[n*3+1];
+				output[n*3+2] = rgb[n*3+0];
+			}
+			return true;
+		}
+		case PIXEL_FORMAT_RGBA8:
+		{
+			for( uint32_t n=0; n < pixels; n++ )
+			{
+				output[n*4+0] = rgb[n*3+0];
+				output[n*4+1] = rgb[n*3+1];
+				output[n*4+2] = rgb[n*3+2];
+				output[n*4+3] = 255;
+			}
+			return true;
+		}
+		case PIXEL_FORMAT_RGBA32F:
+		{
+			float* out = (float*)output;
+
+			for( uint32_t n=0; n < pixels; n++ )
+			{
+				out[n*4+0] = rgb[n*3+0];
+				out[n*4+1] = rgb[n*3+1];
+				out[n*4+2] = rgb[n*3+2];
+				out[n*4+3] = 255.0f;
+			}
+			return true;
+		}
+		case PIXEL_FORMAT_NV12:
+		case PIXEL_FORMAT_I420:
+		{
+			for( uint32_t n=0; n < pixels; n++ )
+				output[n] = rgbToY(rgb[n*3+0], rgb[n*3+1], rgb[n*3+2]);
+
+			// chroma from the average of each 2x2 block
+			uint8_t* uv = output + pixels;
+			uint8_t* v  = uv + pixels / 4;
+
+			for( uint32_t y=0; y < height; y += 2 )
+			{
+				for( uint32_t x=0; x < width; x += 2 )
+				{
+					const uint8_t* p0 = rgb + (y * width + x) * 3;
+					const uint8_t* p1 = p0 + width * 3;
+
+					const int r = (p0[0] + p0[3] + p1[0] + p1[3] + 2) / 4;
+					const int g = (p0[1] + p0[4] + p1[1] + p1[4] + 2) / 4;
+					const int b = (p0[2] + p0[5] + p1[2] + p1[5] + 2) / 4;
+
+					const uint32_t i = (y / 2) * (width / 2) + (x / 2);
+
+					if( mFormat == PIXEL_FORMAT_NV12 )
+					{
+						uv[i*2+0] = rgbToU(r, g, b);
+						uv[i*2+1] = rgbToV(r, g, b);
+					}
+					else
+					{
+						uv[i] = rgbToU(r, g, b);
+						v[i]  = rgbToV(r, g, b);
+					}
+				}
+			}
+			return true;
+		}
+		case PIXEL_FORMAT_YUYV:
+		case PIXEL_FORMAT_UYVY:
+		{
+			const bool yuyv = (mFormat == PIXEL_FORMAT_YUYV);
+
+			for( uint32_t n=0; n < pixels; n += 2 )
+			{
+				const uint8_t* p = rgb + n * 3;
+
+				const int r = (p[0] + p[3] + 1) / 2;
+				const int g = (p[1] + p[4] + 1) / 2;
+				const int b = (p[2] + p[5] + 1) / 2;
+
+				uint8_t* out = output + n * 2;
+
+				out[yuyv ? 0 : 1] = rgbToY(p[0], p[1], p[2]);
+				out[yuyv ? 2 : 3] = rgbToY(p[3], p[4], p[5]);
+				out[yuyv ? 1 : 0] = rgbToU(r, g, b);
+				out[yuyv ? 3 : 2] = rgbToV(r, g, b);
+			}
+			return true;
+		}
+		case PIXEL_FORMAT_BAYER_GRBG8:
+		case PIXEL_FORMAT_BAYER_RGGB8:
+		case PIXEL_FORMAT_BAYER_BGGR8:
+		case PIXEL_FORMAT_BAYER_GBRG8:
+		{
+			// channel sampled at each position of the 2x2 CFA:  0=R, 1=G, 2=B
+			static const uint8_t cfa[4][4] = { { 1, 0, 2, 1 },		// GRBG
+									     { 0, 1, 1, 2 },		// RGGB
+									     { 2, 1, 1, 0 },		// BGGR
+									     { 1, 2, 0, 1 } };	// GBRG
+
+			const uint8_t* pattern = cfa[mFormat - PIXEL_FORMAT_BAYER_GRBG8];
+
+			for( uint32_t y=0; y < height; y++ )
+				for( uint32_t x=0; x < width; x++ )
+					output[y * width + x] = rgb[(y * width + x) * 3 + pattern[(y & 1) * 2 + (x & 1)]];
+
+			return true;
+		}
+		default:
+		{
+			printf("replayCamera -- can't generate %s frames\n", pixelFormatToStr(mFormat));
+			return false;
+		}
+	}
+}
+
+
+// loadImages
+bool replayCamera::loadImages( const char* path )
+{
+	imageList* list = imageList::Create(path);
+
+	if( !list || list->GetCount() == 0 )
+	{
+		printf("replayCamera -- no images found in '%s'\n", path);
+		delete list;
+		return false;
+	}
+
+	if( mFormat == PIXEL_FORMAT_UNKNOWN )
+		mFormat = PIXEL_FORMAT_RGB8;
+
+	// the frames take the size of the first image, unless it was specified
+	if( mWidth == 0 || mHeight == 0 )
+	{
+		int width  = 0;
+		int height = 0;
+
+		if( !loadImageSize(list->GetPath(0), &width, &height) )
+		{
+			delete list;
+			return false;
+		}
+
+		mWidth  = width;
+		mHeight = height;
+	}
+
+	const uint32_t count = (list->GetCount() < mMaxFrames) ? list->GetCount() : mMaxFrames;
+
+	if( !initPool(count) )
+	{
+		delete list;
+		return false;
+	}
+
+	std::vector<float4>  rgba(mWidth * mHeight);
+	std::vector<uint8_t> rgb(mWidth * mHeight * 3);
+
+	for( uint32_t n=0; n < count; n++ )
+	{
+		int width  = 0;
+		int height = 0;
+
+		if( !loadImageSize(list->GetPath(n), &width, &height) || (uint32_t)width != mWidth || (uint32_t)height != mHeight )
+		{
+			printf("replayCamera -- skipping '%s', which isn't %ux%u\n", list->GetPath(n), mWidth, mHeight);
+			continue;
+		}
+
+		if( !loadImageRGBA(list->GetPath(n), rgba.data(), rgba.size() * sizeof(float4), &width, &height) )
+			continue;
+
+		for( uint32_t i=0; i < rgba.size(); i++ )
+		{
+			rgb[i*3+0] = fminf(fmaxf(rgba[i].x, 0.0f), 255.0f);
+			rgb[i*3+1] = fminf(fmaxf(rgba[i].y, 0.0f), 255.0f);
+			rgb[i*3+2] = fminf(fmaxf(rgba[i].z, 0.0f), 255.0f);
+		}
+
+		if( !packRGB(rgb.data(), mPoolCPU + mNumFrames * mFrameStride) )
+		{
+			delete list;
+			return false;
+		}
+
+		mNumFrames++;
+	}
+
+	if( list->GetCount() > count )
+		printf("replayCamera -- only the first %u of %u images were loaded (see the frames option)\n", count, list->GetCount());
+
+	delete list;
+	return mNumFrames > 0;
+}
+
+
+// loadRaw
+bool replayCamera::loadRaw( const char* path )
+{
+	const char* ext = strrchr(path, '.');
+
+	if( mFormat == PIXEL_FORMAT_UNKNOWN )
+		mFormat = pixelFormatFromStr(ext + 1);
+
+	if( mWidth == 0 || mHeight == 0 )
+	{
+		printf("replayCamera -- the width and height of raw file '%s' weren't specified\n", path);
+		return false;
+	}
+
+	const size_t frameSize = (mWidth * mHeight * pixelFormatDepth(mFormat)) / 8;
+
+	const int fd = open(path, O_RDONLY);
+
+	if( fd < 0 )
+	{
+		printf("replayCamera -- failed to open '%s'\n", path);
+		return false;
+	}
+
+	struct stat info;
+
+	if( fstat(fd, &info) != 0 || info.st_size < (off_t)frameSize )
+	{
+		printf("replayCamera -- '%s' doesn't contain a whole %ux%u %s frame\n", path, mWidth, mHeight, pixelFormatToStr(mFormat));
+		close(fd);
+		return false;
+	}
+
+	const uint32_t frames = info.st_size / frameSize;
+	const uint32_t count  = (frames < mMaxFrames) ? frames : mMaxFrames;
+
+	void* data = mmap(NULL, frameSize * count, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if( data == MAP_FAILED )
+	{
+		printf("replayCamera -- failed to mmap '%s'\n", path);
+		return false;
+	}
+
+	madvise(data, frameSize * count, MADV_SEQUENTIAL);
+
+	if( !initPool(count) )
+	{
+		munmap(data, frameSize * count);
+		return false;
+	}
+
+	for( uint32_t n=0; n < count; n++ )
+		memcpy(mPoolCPU + n * mFrameStride, (uint8_t*)data + n * frameSize, frameSize);
+
+	munmap(data, frameSize * count);
+	mNumFrames = count;
+
+	if( frames > count )
+		printf("replayCamera -- only the first %u of %u frames were loaded (see the frames option)\n", count, frames);
+
+	return true;
+}
+
+
+// loadPattern
+bool replayCamera::loadPattern()
+{
+	if( mWidth == 0 || mHeight == 0 )
+	{
+		mWidth  = 1280;
+		mHeight = 720;
+	}
+
+	if( mFormat == PIXEL_FORMAT_UNKNOWN )
+		mFormat = PIXEL_FORMAT_NV12;
+
+	if( !initPool(mMaxFrames) )
+		return false;
+
+	static const uint8_t bars[8][3] = { { 235, 235, 235 }, { 235, 235, 16 }, { 16, 235, 235 }, { 16, 235, 16 },
+								 { 235, 16, 235 }, { 235, 16, 16 }, { 16, 16, 235 }, { 16, 16, 16 } };
+
+	std::vector<uint8_t> rgb(mWidth * mHeight * 3);
+
+	const uint32_t barsHeight = (mHeight * 2) / 3;
+	const uint32_t boxSize    = mHeight / 8;
+
+	for( uint32_t n=0; n < mMaxFrames; n++ )
+	{
+		// color bars scrolling across the top, a gray ramp with a moving box at the bottom
+		const uint32_t offset = (uint64_t(n) * mWidth) / mMaxFrames;
+		const uint32_t boxX   = (uint64_t(n) * (mWidth - boxSize)) / mMaxFrames;
+
+		for( uint32_t y=0; y < mHeight; y++ )
+		{
+			for( uint32_t x=0; x < mWidth; x++ )
+			{
+				uint8_t* px = rgb.data() + (y * mWidth + x) * 3;
+
+				if( y < barsHeight )
+				{
+					const uint8_t* bar = bars[(((x + offset) % mWidth) * 8) / mWidth];
+
+					px[0] = bar[0];
+					px[1] = bar[1];
+					px[2] = bar[2];
+				}
+				else if( x >= boxX && x < boxX + boxSize && y >= mHeight - boxSize )
+				{
+					px[0] = px[1] = px[2] = 255;
+				}
+				else
+				{
+					px[0] = px[1] = px[2] = (x * 255) / (mWidth - 1);
+				}
+			}
+		}
+
+		if( !packRGB(rgb.data(), mPoolCPU + n * mFrameStride) )
+			return false;
+	}
+
+	mNumFrames = mMaxFrames;
+	return true;
+}
+
+
+// loadLog
+bool replayCamera::loadLog( const char* path )
+{
+	const int fd = open(path, O_RDONLY);
+
+	if( fd < 0 )
+	{
+		printf("replayCamera -- failed to open '%s'\n", path);
+		return false;
+	}
+
+	struct stat info;
+
+	if( fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(cameraLogHeader) )
+	{
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if( data == MAP_FAILED )
+	{
+		printf("replayCamera -- failed to mmap '%s'\n", path);
+		return false;
+	}
+
+	mLog     = (uint8_t*)data;
+	mLogSize = info.st_size;
+
+	cameraLogHeader header;
+	memcpy(&header, mLog, sizeof(header));
+
+	// the chunk index has to hold chunkFrames entries, and the chunks have to advance through the file
+	const bool validChunks = header.indexSize >= sizeof(cameraLogChunk) + uint64_t(header.chunkFrames) * sizeof(cameraLogEntry) &&
+						header.chunkSize >= header.indexSize + uint64_t(header.chunkFrames) * header.frameStride;
+
+	if( header.version != CAMERA_LOG_VERSION || header.alignment == 0 || header.frameSize == 0 || header.frameSize > header.frameStride || !validChunks )
+	{
+		printf("replayCamera -- '%s' is a corrupt or unsupported version (%u) of camera log\n", path, header.version);
+		munmap(mLog, mLogSize);
+		mLog = NULL;
+		return false;
+	}
+
+	if( mFormat != PIXEL_FORMAT_UNKNOWN && mFormat != (pixelFormat)header.format )
+		printf("replayCamera -- logs are replayed in the format they were recorded in (%s)\n", pixelFormatToStr((pixelFormat)header.format));
+
+	mFormat = (pixelFormat)header.format;
+	mWidth  = header.width;
+	mHeight = header.height;
+	mPitch  = header.pitch;
+	mSize   = header.frameSize;
+
+	// gather the frames from the index of each chunk
+	for( uint64_t chunk=0; ; chunk++ )
+	{
+		const uint64_t offset = header.alignment + chunk * header.chunkSize;
+
+		if( offset + header.indexSize > mLogSize )
+			break;
+
+		const cameraLogChunk* index = (const cameraLogChunk*)(mLog + offset);
+
+		if( memcmp(index->magic, CAMERA_CHUNK_MAGIC, sizeof(index->magic)) != 0 || index->frames > header.chunkFrames )
+		{
+			printf("replayCamera -- '%s' ends with an incomplete chunk, that was skipped\n", path);
+			break;
+		}
+
+		const cameraLogEntry* entries = (const cameraLogEntry*)(index + 1);
+
+		for( uint32_t n=0; n < index->frames; n++ )
+		{
+			logFrame frame;
+
+			frame.offset   = offset + header.indexSize + n * header.frameStride;
+			frame.sequence = entries[n].sequence;
+			frame.time     = entries[n].timestamp;
+
+			if( frame.offset + header.frameSize > mLogSize )
+				break;
+
+			mLogFrames.push_back(frame);
+		}
+	}
+
+	mNumFrames = mLogFrames.size();
+
+	if( mNumFrames == 0 )
+	{
+		printf("replayCamera -- '%s' doesn't contain any frames\n", path);
+		munmap(mLog, mLogSize);
+		mLog = NULL;
+		return false;
+	}
+
+	// frame times relative to the first one, at the playback speed
+	const uint64_t first    = mLogFrames[0].time;
+	const uint64_t duration = mLogFrames[mNumFrames-1].time - first;
+
+	if( mSpeed > 0.0f )
+	{
+		for( uint32_t n=0; n < mNumFrames; n++ )
+			mLogFrames[n].time = uint64_t((mLogFrames[n].time - first) / double(mSpeed));
+
+		// each pass lasts an average frame interval longer than the log's duration
+		const uint64_t interval = (mNumFrames > 1 && duration > 0) ? mLogFrames[mNumFrames-1].time / (mNumFrames - 1) : uint64_t(1000000000.0 / (30.0 * mSpeed));
+
+		mLogLength = mLogFrames[mNumFrames-1].time + interval;
+		mFrameRate = 1000000000.0 / interval;
+	}
+	else
+	{
+		mFrameRate = 0.0f;
+	}
+
+	mLogSequences = mLogFrames[mNumFrames-1].sequence - mLogFrames[0].sequence + 1;
+
+	madvise(mLog, mLogSize, MADV_SEQUENTIAL);
+
+	return initPool(NUM_LEASES);
+}
+
+
+// frameTime
+uint64_t replayCamera::frameTime( uint64_t index ) const
+{
+	if( mLog != NULL )
+		return mStart + (index / mNumFrames) * mLogLength + mLogFrames[index % mNumFrames].time;
+
+	const double period = 1000000000.0 / mFrameRate;
+	int64_t time = int64_t(index * period);
+
+	if( mJitter > 0.0f )
+	{
+		// uniform in [-jitter, jitter], the same for a given seed and frame
+		const double r = double(mix64(index ^ (mSeed << 32)) >> 11) / double(1ULL << 53);
+		time += int64_t((r * 2.0 - 1.0) * mJitter * 1000000.0);
+	}
+
+	return mStart + (time > 0 ? time : 0);
+}
+
+
+// dueIndex
+uint64_t replayCamera::dueIndex( uint64_t time ) const
+{
+	const uint64_t elapsed = time - mStart;
+
+	if( mLog == NULL )
+		return uint64_t(elapsed * double(mFrameRate) / 1000000000.0);
+
+	// the last frame of the log that's due in this pass through it
+	const uint64_t pass   = elapsed / mLogLength;
+	const uint64_t offset = elapsed % mLogLength;
+
+	uint32_t first = 0;
+	uint32_t last  = mNumFrames;
+
+	while( last - first > 1 )
+	{
+		const uint32_t middle = (first + last) / 2;
+
+		if( mLogFrames[middle].time <= offset )
+			first = middle;
+		else
+			last = middle;
+	}
+
+	return pass * mNumFrames + first;
+}
+
+
+// Open
+bool replayCamera::Open()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mStart     = cameraTimestamp();
+	mNextIndex = 0;
+	mDropped   = 0;
+	mEOS       = false;
+
+	return true;
+}
+
+
+// Close
+void replayCamera::Close()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	printf("replayCamera -- served %llu frames, %llu dropped while the consumer was busy, %llu refused with all frames leased\n",
+		  (unsigned long long)(mNextIndex - mDropped), (unsigned long long)mDropped, (unsigned long long)GetStarvedFrames());
+
+	mStart = 0;
+}
+
+
+// Capture
+bool replayCamera::Capture( void** cpu, void** cuda, unsigned long timeout )
+{
+	if( mLastFrame != NULL )
+	{
+		mLastFrame->Release();
+		mLastFrame = NULL;
+	}
+
+	mLastFrame = CaptureFrame(timeout);
+
+	if( !mLastFrame )
+		return false;
+
+	if( cpu != NULL )
+		*cpu = mLastFrame->cpu;
+
+	if( cuda != NULL )
+		*cuda = mLastFrame->cuda;
+
+	return true;
+}
+
+
+// CaptureFrame
+cameraFrame* replayCamera::CaptureFrame( unsigned long timeout )
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	if( mStart == 0 )
+	{
+		printf("replayCamera -- the camera needs to be opened before capturing\n");
+		return NULL;
+	}
+
+	uint64_t index = 0;
+	uint64_t now   = cameraTimestamp();
+
+	const uint64_t expires = (timeout != ULONG_MAX) ? now + uint64_t(timeout) * 1000000ULL : UINT64_MAX;
+
+	while( true )
+	{
+		if( mEOS || mStart == 0 )
+			return NULL;
+
+		index = mNextIndex;
+		now   = cameraTimestamp();
+
+		if( mFrameRate <= 0.0f )
+			break;
+
+		// skip over the frames that came due while the consumer was busy
+		const uint64_t due = dueIndex(now);
+
+		// (mNextIndex moves past them straight away, so they're only counted once)
+		if( due > index )
+		{
+			mDropped  += due - index;
+			mNextIndex = due;
+			index      = due;
+		}
+
+		const uint64_t deadline = frameTime(index);
+
+		if( deadline <= now )
+			break;
+
+		const bool timedOut = (deadline > expires);
+		const uint64_t wakeup = timedOut ? expires : deadline;
+
+		timespec ts;
+		ts.tv_sec  = wakeup / 1000000000ULL;
+		ts.tv_nsec = wakeup % 1000000000ULL;
+
+		// pace without holding the lock, so the other consumers aren't held up
+		lock.unlock();
+		while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR ) {}
+		lock.lock();
+
+		if( timedOut )
+			return NULL;
+
+		// serve the frame, unless another consumer took it while this one was waiting for it
+		if( mNextIndex == index && mStart != 0 )
+		{
+			now = deadline;
+			break;
+		}
+	}
+
+	if( !mLoop && index >= mNumFrames )
+	{
+		printf("replayCamera -- reached the end of '%s'\n", mPath.c_str());
+		mEOS = true;
+		return NULL;
+	}
+
+	// find a lease that isn't in use
+	uint32_t lease = NUM_LEASES;
+
+	for( uint32_t n=0; n < NUM_LEASES; n++ )
+	{
+		const uint32_t i = (mNextLease + n) % NUM_LEASES;
+
+		if( !mFrames->IsLeased(i) )
+		{
+			lease = i;
+			break;
+		}
+	}
+
+	if( lease == NUM_LEASES )
+	{
+		mFrames->Starved();
+		return NULL;
+	}
+
+	// log frames are copied from the mapping into the lease's buffer
+	const size_t offset = (mLog != NULL ? lease : index % mNumFrames) * mFrameStride;
+	uint64_t sequence   = index + 1;
+
+	if( mLog != NULL )
+	{
+		const logFrame& frame = mLogFrames[index % mNumFrames];
+
+		memcpy(mPoolCPU + offset, mLog + frame.offset, mSize);
+		sequence = (index / mNumFrames) * mLogSequences + frame.sequence;
+
+		const logFrame& next = mLogFrames[(index + 1) % mNumFrames];
+		madvise(mLog + next.offset, mSize, MADV_WILLNEED);
+	}
+
+	cameraFrameInfo info;
+
+	info.cpu       = mPoolCPU + offset;
+	info.cuda      = mPoolGPU + offset;
+	info.width     = mWidth;
+	info.height    = mHeight;
+	info.pitch     = mPitch;
+	info.size      = mSize;
+	info.format    = mFormat;
+	info.timestamp = now;
+	info.sequence  = sequence;
+
+	mNextIndex = index + 1;
+	mNextLease = (lease + 1) % NUM_LEASES;
+
+	record(info);
+	return mFrames->Lease(lease, info);
+}
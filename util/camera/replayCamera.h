@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __REPLAY_CAMERA_H__
+#define __REPLAY_CAMERA_H__
+
+
+#include "camera.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/**
+ * Camera that replays frames from disk or a generated test pattern, for benchmarking
+ * and testing the capture path without camera hardware.  The sources are:
+ *
+ *   - a directory of images, a text file listing images, or a single image
+ *   - a raw dump of frames in one of the native formats (i.e. .nv12, .yuyv, .rgb, .rggb),
+ *     which is mmap'd and needs the width and height options
+ *   - a test pattern of moving color bars, when the path is "pattern"
+ *   - a log written by cameraRecorder, which is mmap'd and replayed with the recorded
+ *     timestamps and sequence numbers
+ *
+ * Every frame is converted to the output format and preloaded into a pool of mapped
+ * memory when the camera is created, so serving a frame costs nothing.  Logs are too
+ * big for that, so their frames are copied from the mapping as they are captured.
+ *
+ * The options are given as a query string (i.e. "fps=60&jitter=2&format=nv12"):
+ *
+ *   - width, height  dimensions of raw dumps and the test pattern (default 1280x720)
+ *   - format         output pixel format (default: nv12 for the test pattern, rgb8 for images,
+ *                    and the file extension for raw dumps)
+ *   - fps            frame rate, or 0 to serve frames as fast as they are captured (default 30)
+ *   - jitter         random deviation of the frame times, in milliseconds (default 0)
+ *   - seed           seed of the jitter, which is deterministic for a given seed (default 1)
+ *   - frames         maximum number of frames to preload (default 64)
+ *   - loop           0 to end the stream after the last frame, instead of looping (default 1)
+ *   - speed          playback speed of logs, relative to the recording (default 1), or 0 to
+ *                    serve their frames as fast as possible
+ *
+ * At a fixed frame rate, frames that come due while the consumer is busy are dropped
+ * like a real camera would, and show up as gaps in the sequence numbers.
+ *
+ * @ingroup util
+ */
+class replayCamera : public camera
+{
+public:
+	/**
+	 * Create the camera.
+	 * @param path image directory, image list, image, raw dump, or "pattern"
+	 * @param options query string of options, or NULL for the defaults
+	 * @param width width to use when the options don't specify it (0 for the default)
+	 * @param height height to use when the options don't specify it (0 for the default)
+	 */
+	static replayCamera* Create( const char* path, const char* options=NULL, uint32_t width=0, uint32_t height=0 );
+
+	/**
+	 * Destructor
+	 */
+	~replayCamera();
+
+	/**
+	 * Start streaming, from the first frame.
+	 */
+	bool Open();
+
+	/**
+	 * Stop streaming.
+	 */
+	void Close();
+
+	/**
+	 * Capture the next frame, which stays valid until the next call to Capture().
+	 */
+	bool Capture( void** cpu, void** cuda, unsigned long timeout=ULONG_MAX );
+
+	/**
+	 * Capture a lease on the next frame.
+	 */
+	cameraFrame* CaptureFrame( unsigned long timeout=ULONG_MAX );
+
+	/**
+	 * Retrieve the number of frames preloaded.
+	 */
+	inline uint32_t GetNumFrames() const		{ return mNumFrames; }
+
+	/**
+	 * Retrieve the frame rate (0 when serving frames as fast as possible)
+	 */
+	inline float GetFrameRate() const			{ return mFrameRate; }
+
+	/**
+	 * Retrieve the number of frames that came due while the consumer was busy.
+	 */
+	inline uint64_t GetDroppedFrames() const		{ return mDropped; }
+
+	/**
+	 * Query if the stream ended, after the last frame when not looping.
+	 */
+	virtual bool IsEOS() const					{ return mEOS; }
+
+	/**
+	 * Default maximum number of frames to preload.
+	 */
+	static const uint32_t DefaultMaxFrames = 64;
+
+	/**
+	 * Maximum number of frames leased at once.
+	 */
+	static const uint32_t NUM_LEASES = 16;
+
+protected:
+	replayCamera();
+
+	bool init( const char* path, const char* options, uint32_t width, uint32_t height );
+	bool initPool( uint32_t numFrames );
+
+	bool loadImages( const char* path );
+	bool loadRaw( const char* path );
+	bool loadPattern();
+	bool loadLog( const char* path );
+
+	bool packRGB( const uint8_t* rgb, uint8_t* output ) const;
+
+	uint64_t frameTime( uint64_t index ) const;
+	uint64_t dueIndex( uint64_t time ) const;
+
+	struct logFrame
+	{
+		uint64_t offset;	// of the frame in the log
+		uint64_t sequence;
+		uint64_t time;	// since the first frame, scaled by the speed
+	};
+
+	std::string mPath;
+	std::mutex  mMutex;
+
+	uint8_t* mPoolCPU;
+	uint8_t* mPoolGPU;
+	size_t   mFrameStride;	// offset between frames in the pool
+	uint32_t mNumFrames;
+	uint32_t mMaxFrames;
+	uint32_t mPitch;
+
+	float    mFrameRate;
+	float    mJitter;
+	uint64_t mSeed;
+	bool     mLoop;
+	bool     mEOS;
+
+	uint64_t mStart;		// time of the first frame
+	uint64_t mNextIndex;	// index of the next frame, counting the loops
+	uint64_t mDropped;
+	uint32_t mNextLease;
+
+	uint8_t* mLog;		// mapping of a cameraRecorder log
+	size_t   mLogSize;
+	uint64_t mLogLength;	// duration of one pass through the log
+	uint64_t mLogSequences;	// sequence numbers spanned by one pass through the log
+	float    mSpeed;
+
+	std::vector<logFrame> mLogFrames;
+
+	cameraFrame* mLastFrame;	// the frame returned by Capture()
+};
+
+
+#endif
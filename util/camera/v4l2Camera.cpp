@@ -21,6 +21,7 @@
  */
 
 #include "v4l2Camera.h"
+#include "cudaMappedMemory.h"
 
 #include <fcntl.h> 
 #include <unistd.h>
@@ -52,7 +53,7 @@ static int xioctl(int fd, int request, void* arg)
 
 
 // constructor
-v4l2Camera::v4l2Camera( const char* device_path ) : mDevicePath(device_path)
+v4l2Camera::v4l2Camera( const char* device_path ) : camera(0, 0), mDevicePath(device_path)
 {	
 	mFD = -1;
 
@@ -63,16 +64,43 @@ v4l2Camera::v4l2Camera( const char* device_path ) : mDevicePath(device_path)
 	mRequestFormat   = 1;
 	//mRequestFormat   = -1;	// index into V4L2 format table
 	
-	mWidth      = 0;
-	mHeight     = 0;
-	mPitch      = 0;
-	mPixelDepth = 0;
+	mPitch = 0;
+
+	mLastFrame      = NULL;
+	mSequence       = 0;
+	mDroppedFrames  = 0;
+	mDriverSequence = 0;
 }
 
 
 // destructor	
 v4l2Camera::~v4l2Camera()
 {
+	if( mLastFrame != NULL )
+	{
+		mLastFrame->Release();
+		mLastFrame = NULL;
+	}
+
+	if( mFrames != NULL )
+	{
+		delete mFrames;
+		mFrames = NULL;
+	}
+
+	for( size_t n=0; n < mBufferCountMMap; n++ )
+	{
+		if( mBuffersMMap[n].staging != NULL )
+			CUDA(cudaFreeHost(mBuffersMMap[n].staging));
+		else if( mBuffersMMap[n].cuda != NULL )
+			CUDA(cudaHostUnregister(mBuffersMMap[n].ptr));
+
+		munmap(mBuffersMMap[n].ptr, mBuffersMMap[n].buf.length);
+	}
+
+	free(mBuffersMMap);
+	mBuffersMMap = NULL;
+
 	// close file
 	if( mFD >= 0 )
 	{
@@ -82,9 +110,54 @@ v4l2Camera::~v4l2Camera()
 }
 
 
-// ProcessEmit
+// Capture
 void* v4l2Camera::Capture( size_t timeout )
 {
+	// the previous image goes back to the driver once the caller is on to the next one
+	if( mLastFrame != NULL )
+	{
+		mLastFrame->Release();
+		mLastFrame = NULL;
+	}
+
+	mLastFrame = CaptureFrame(timeout);
+
+	if( !mLastFrame )
+		return NULL;
+
+	return mLastFrame->cpu;
+}
+
+
+// Capture
+bool v4l2Camera::Capture( void** cpu, void** cuda, unsigned long timeout )
+{
+	if( !Capture(timeout) )
+		return false;
+
+	if( cpu != NULL )
+		*cpu = mLastFrame->cpu;
+
+	if( cuda != NULL )
+		*cuda = mLastFrame->cuda;
+
+	return true;
+}
+
+
+// CaptureFrame
+cameraFrame* v4l2Camera::CaptureFrame( unsigned long timeout )
+{
+	if( !mFrames )
+		return NULL;
+
+	// with every buffer leased, the driver has nowhere to capture to
+	if( mFrames->GetLeased() >= mBufferCountMMap )
+	{
+		mFrames->Starved();
+		return NULL;
+	}
+
 	fd_set fds;
 	FD_ZERO(&fds);
 	FD_SET(mFD, &fds);
@@ -102,8 +175,8 @@ void* v4l2Camera::Capture( size_t timeout )
 		tv.tv_usec = (timeout - (tv.tv_sec * 1000)) * 1000;
 	}
 	
-	//
-	const int result = select(mFD + 1, &fds, NULL, NULL, &tv);
+	// ULONG_MAX waits indefinitely
+	const int result = select(mFD + 1, &fds, NULL, NULL, (timeout != ULONG_MAX) ? &tv : NULL);
 
 
 	if( result == -1 ) 
@@ -141,13 +214,56 @@ void* v4l2Camera::Capture( size_t timeout )
 	// emit ringbuffer entry
 	//printf("v4l2 -- recieved %ux%u video frame (index=%u)\n", mWidth, mHeight, (uint32_t)buf.index);
 
-	void* image_ptr = mBuffersMMap[buf.index].ptr;
+	// the driver skips frames while it's out of buffers
+	if( mSequence > 0 && buf.sequence > mDriverSequence + 1 )
+		mDroppedFrames += buf.sequence - mDriverSequence - 1;
+
+	mDriverSequence = buf.sequence;
+
+	cameraFrameInfo info;
+
+	info.cpu      = mBuffersMMap[buf.index].ptr;
+	info.cuda     = mBuffersMMap[buf.index].cuda;
+
+	// without CUDA access to the driver's buffer, a copy goes to the GPU instead
+	if( mBuffersMMap[buf.index].staging != NULL )
+	{
+		memcpy(mBuffersMMap[buf.index].staging, mBuffersMMap[buf.index].ptr, buf.bytesused);
+		info.cpu = mBuffersMMap[buf.index].staging;
+	}
+
+	info.width    = mWidth;
+	info.height   = mHeight;
+	info.pitch    = mPitch;
+	info.size     = buf.bytesused;
+	info.format   = mFormat;
+	info.sequence = ++mSequence;
+
+	if( (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC )
+		info.timestamp = uint64_t(buf.timestamp.tv_sec) * 1000000000ULL + uint64_t(buf.timestamp.tv_usec) * 1000ULL;
+	else
+		info.timestamp = cameraTimestamp();
+
+	record(info);
+
+	// the buffer is re-queued to V4L2 when the lease is released
+	return mFrames->Lease(buf.index, info);
+}
+
+
+// onRelease
+void v4l2Camera::onRelease( uint32_t slot, void* user_data )
+{
+	v4l2Camera* cam = (v4l2Camera*)user_data;
+
+	if( !cam || slot >= cam->mBufferCountMMap )
+		return;
 
 	// re-queue buffer to V4L2
-	if( xioctl(mFD, VIDIOC_QBUF, &buf) < 0 )
-		printf("v4l2 -- ioctl(VIDIOC_QBUF) failed (errno=%i) (%s)\n", errno, strerror(errno));
+	struct v4l2_buffer buf = cam->mBuffersMMap[slot].buf;
 
-	return image_ptr;
+	if( xioctl(cam->mFD, VIDIOC_QBUF, &buf) < 0 )
+		printf("v4l2 -- ioctl(VIDIOC_QBUF) failed (errno=%i) (%s)\n", errno, strerror(errno));
 }
 
 
@@ -203,6 +319,19 @@ bool v4l2Camera::initMMap()
 			return false;
 		}
 
+		// map the buffer into CUDA, or fall back to copying it if the driver's memory can't be registered
+		if( cudaHostRegister(mBuffersMMap[n].ptr, mBuffersMMap[n].buf.length, cudaHostRegisterMapped) != cudaSuccess ||
+		    cudaHostGetDevicePointer(&mBuffersMMap[n].cuda, mBuffersMMap[n].ptr, 0) != cudaSuccess )
+		{
+			cudaGetLastError();	// clear the error
+
+			if( n == 0 )
+				printf( "v4l2 -- couldn't register mmap buffers with CUDA, the frames will be copied\n");
+
+			if( !cudaAllocMapped(&mBuffersMMap[n].staging, &mBuffersMMap[n].cuda, mBuffersMMap[n].buf.length) )
+				return false;
+		}
+
 		if( xioctl(mFD, VIDIOC_QBUF, &mBuffersMMap[n].buf) < 0 )
 		{
 			printf( "v4l2 -- failed to queue mmap buffer (errno=%i) (%s)\n", errno, strerror(errno));
@@ -211,11 +340,33 @@ bool v4l2Camera::initMMap()
 	}
 
 	mBufferCountMMap = req.count;	
+	mFrames = new cameraFramePool(mBufferCountMMap, onRelease, this);
+
 	printf("v4l2 -- mapped %zu capture buffers with mmap\n", mBufferCountMMap); 	
 	return true;
 }
 
 
+inline pixelFormat v4l2_pixel_format( uint32_t fmt )
+{
+	switch(fmt)
+	{
+		case V4L2_PIX_FMT_RGB24:  return PIXEL_FORMAT_RGB8;
+		case V4L2_PIX_FMT_BGR24:  return PIXEL_FORMAT_BGR8;
+		case V4L2_PIX_FMT_NV12:   return PIXEL_FORMAT_NV12;
+		case V4L2_PIX_FMT_YUV420: return PIXEL_FORMAT_I420;
+		case V4L2_PIX_FMT_YUYV:   return PIXEL_FORMAT_YUYV;
+		case V4L2_PIX_FMT_UYVY:   return PIXEL_FORMAT_UYVY;
+		case V4L2_PIX_FMT_SGRBG8: return PIXEL_FORMAT_BAYER_GRBG8;
+		case V4L2_PIX_FMT_SRGGB8: return PIXEL_FORMAT_BAYER_RGGB8;
+		case V4L2_PIX_FMT_SBGGR8: return PIXEL_FORMAT_BAYER_BGGR8;
+		case V4L2_PIX_FMT_SGBRG8: return PIXEL_FORMAT_BAYER_GBRG8;
+	}
+
+	return PIXEL_FORMAT_UNKNOWN;
+}
+
+
 inline const char* v4l2_format_str( uint32_t fmt )
 {
 	if( fmt == V4L2_PIX_FMT_SBGGR8 )	   return "SBGGR8 (V4L2_PIX_FMT_SBGGR8)";
@@ -333,10 +484,12 @@ bool v4l2Camera::initStream()
 	v4l2_print_format(fmt, "confirmed new format");
 #endif
 
-	mWidth      = fmt.fmt.pix.width;
-	mHeight     = fmt.fmt.pix.height;
-	mPitch      = fmt.fmt.pix.bytesperline;
-	mPixelDepth = (mPitch * 8) / mWidth;
+	mWidth  = fmt.fmt.pix.width;
+	mHeight = fmt.fmt.pix.height;
+	mPitch  = fmt.fmt.pix.bytesperline;
+	mDepth  = (mPitch * 8) / mWidth;
+	mSize   = fmt.fmt.pix.sizeimage;
+	mFormat = v4l2_pixel_format(fmt.fmt.pix.pixelformat);
 
 	// initMMap
 	if( !initMMap() )		// initUserPtr()
@@ -347,10 +500,13 @@ bool v4l2Camera::initStream()
 
 
 // Create
-v4l2Camera* v4l2Camera::Create( const char* device_path )
+v4l2Camera* v4l2Camera::Create( const char* device_path, uint32_t width, uint32_t height )
 {
 	v4l2Camera* cam = new v4l2Camera(device_path);
 
+	cam->mRequestWidth  = width;
+	cam->mRequestHeight = height;
+
 	if( !cam->init() )
 	{
 		printf("v4l2 -- failed to create instance %s\n", device_path);
@@ -409,7 +565,7 @@ bool v4l2Camera::Open()
 
 
 // Close
-bool v4l2Camera::Close()
+void v4l2Camera::Close()
 {
 	// stop streaming
 	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -422,7 +578,9 @@ bool v4l2Camera::Close()
 		//return false;
 	}
 
-	return true;
+	if( mFrames != NULL )
+		printf( "v4l2 -- captured %llu frames, %llu dropped by the driver, %llu refused with all buffers leased\n",
+			   (unsigned long long)mSequence, (unsigned long long)mDroppedFrames, (unsigned long long)mFrames->GetStarved());
 }
 
 
@@ -30,12 +30,16 @@
 #include <string>
 #include <vector>
 
+#include "camera.h"
+
 
 
 struct v4l2_mmap
 {
 	struct v4l2_buffer buf;
 	void*  ptr;
+	void*  cuda;		// device pointer to the mmap'd buffer, or to its staging copy
+	void*  staging;		// mapped copy of the buffer, when it couldn't be registered with CUDA
 };
 
 
@@ -43,14 +47,16 @@ struct v4l2_mmap
  * Video4Linux2 camera capture streaming.
  * @ingroup util
  */
-class v4l2Camera
+class v4l2Camera : public camera
 {
 public:	
 	/**
 	 * Create V4L2 interface
 	 * @param path Filename of the video device (e.g. /dev/video0)
+	 * @param width Requested width, or 0 to keep the device's current format
+	 * @param height Requested height, or 0 to keep the device's current format
 	 */
-	static v4l2Camera* Create( const char* device_path );
+	static v4l2Camera* Create( const char* device_path, uint32_t width=0, uint32_t height=0 );
 
 	/**
 	 * Destructor
@@ -65,22 +71,27 @@ public:
 	/**
 	 * Stop streaming
 	 */
-	bool Close();
+	void Close();
 
 	/**
 	 * Return the next image.
+	 * The image stays valid until the next call to Capture().
 	 */
 	void* Capture( size_t timeout=0 );
 
 	/**
-	 * Get width, in pixels, of camera image.
+	 * Capture the next image, through the camera interface.
+	 * The CUDA pointer is either the registered mmap buffer, or a copy of it.
+	 * The image stays valid until the next call to Capture().
 	 */
-	inline uint32_t GetWidth() const					{ return mWidth; }
-	
+	bool Capture( void** cpu, void** cuda, unsigned long timeout=ULONG_MAX );
+
 	/**
-	 * Retrieve height, in pixels, of camera image.
+	 * Capture a lease on the next frame.  Its buffer isn't re-queued to the driver
+	 * until the lease is released with cameraFrame::Release().
+	 * @returns the frame, or NULL on timeout or if all the buffers are leased.
 	 */
-	inline uint32_t GetHeight() const					{ return mHeight; }
+	cameraFrame* CaptureFrame( unsigned long timeout=ULONG_MAX );
 
 	/**
  	 * Return the size in bytes of one line of the image.
@@ -88,9 +99,9 @@ public:
 	inline uint32_t GetPitch() const					{ return mPitch; }
 
 	/**
-	 * Return the bit depth per pixel.
+	 * Return the number of frames the driver dropped, from gaps in its sequence numbers.
 	 */
-	inline uint32_t GetPixelDepth() const				{ return mPixelDepth; }
+	inline uint64_t GetDroppedFrames() const			{ return mDroppedFrames; }
 
 private:
 
@@ -104,18 +115,23 @@ private:
 	bool initUserPtr();
 	bool initMMap();
 
+	static void onRelease( uint32_t slot, void* user_data );
+
 	int 	mFD;
 	int	    mRequestFormat;
 	uint32_t mRequestWidth;
 	uint32_t mRequestHeight;
-	uint32_t mWidth;
-	uint32_t mHeight;
 	uint32_t mPitch;
-	uint32_t mPixelDepth;
 
 	v4l2_mmap* mBuffersMMap;
 	size_t mBufferCountMMap;
 
+	cameraFrame* mLastFrame;	// the frame returned by Capture()
+
+	uint64_t mSequence;
+	uint64_t mDroppedFrames;
+	uint32_t mDriverSequence;
+
 	std::vector<v4l2_fmtdesc> mFormats;
 	std::string mDevicePath;
 };
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cudaBayer.h"
+#include "cudaRGB.h"
+
+
+// threads per block, and the border of extra samples each tile loads around them
+#define BAYER_BLOCK_X  32
+#define BAYER_BLOCK_Y  8
+#define BAYER_APRON    2	// the 5x5 Malvar-He-Cutler filters reach two pixels out
+
+#define BAYER_TILE_X   (BAYER_BLOCK_X + BAYER_APRON * 2)
+#define BAYER_TILE_Y   (BAYER_BLOCK_Y + BAYER_APRON * 2)
+
+
+// mirror a coordinate back into the image without repeating the edge (-1 -> 1),
+// which keeps the color of every site the same as the pattern outside the image
+static inline __device__ int bayerMirror( int i, int size )
+{
+	if( i >= 0 && i < size )
+		return i;
+
+	if( size == 1 )
+		return 0;
+
+	const int period = 2 * (size - 1);
+
+	i = abs(i) % period;
+	return (i < size) ? i : period - i;
+}
+
+
+// samples from the shared memory tile
+struct bayerTile
+{
+	const uint8_t (*tile)[BAYER_TILE_X];
+	int x;
+	int y;
+
+	inline __device__ float operator()( int dx, int dy ) const	{ return tile[y + dy][x + dx]; }
+};
+
+// samples from global memory, for when the output is resampled and few pixels share neighbours
+struct bayerImage
+{
+	const uint8_t* input;
+	int pitch;
+	int width;
+	int height;
+	int x;
+	int y;
+
+	inline __device__ float operator()( int dx, int dy ) const	{ return input[bayerMirror(y + dy, height) * pitch + bayerMirror(x + dx, width)]; }
+};
+
+
+// demosaic one pixel, where the site is 0 for red, 1 for green on a red row,
+// 2 for green on a blue row and 3 for blue
+template<bayerQuality quality, typename Samples>
+inline __device__ float3 bayerDemosaic( const Samples& p, int site )
+{
+	const float c = p(0,0);
+
+	if( quality == BAYER_BILINEAR )
+	{
+		const float across = (p(-1,0) + p(1,0)) * 0.5f;
+		const float upDown = (p(0,-1) + p(0,1)) * 0.5f;
+		const float cross  = (p(-1,0) + p(1,0) + p(0,-1) + p(0,1)) * 0.25f;
+		const float diag   = (p(-1,-1) + p(1,-1) + p(-1,1) + p(1,1)) * 0.25f;
+
+		if( site == 0 )	return make_float3(c, cross, diag);
+		if( site == 1 )	return make_float3(across, c, upDown);
+		if( site == 2 )	return make_float3(upDown, c, across);
+					return make_float3(diag, cross, c);
+	}
+
+	// Malvar-He-Cutler, "High-Quality Linear Interpolation for Demosaicing of Bayer-Patterned Color Images" (2004)
+	const float cross  = p(-1,0) + p(1,0) + p(0,-1) + p(0,1);
+	const float diag   = p(-1,-1) + p(1,-1) + p(-1,1) + p(1,1);
+	const float across = p(-1,0) + p(1,0);
+	const float upDown = p(0,-1) + p(0,1);
+	const float far_x  = p(-2,0) + p(2,0);
+	const float far_y  = p(0,-2) + p(0,2);
+
+	// green at red and blue sites
+	const float green = (4.0f * c + 2.0f * cross - far_x - far_y) * 0.125f;
+
+	// the color to the left and right of a green site, and the one above and below it
+	const float horizontal = (5.0f * c + 4.0f * across - far_x - diag + 0.5f * far_y) * 0.125f;
+	const float vertical   = (5.0f * c + 4.0f * upDown - far_y - diag + 0.5f * far_x) * 0.125f;
+
+	// the opposite color at red and blue sites
+	const float opposite = (6.0f * c + 2.0f * diag - 1.5f * (far_x + far_y)) * 0.125f;
+
+	if( site == 0 )	return make_float3(c, green, opposite);
+	if( site == 1 )	return make_float3(horizontal, c, vertical);
+	if( site == 2 )	return make_float3(vertical, c, horizontal);
+				return make_float3(opposite, green, c);
+}
+
+
+// site of a pixel in the pattern, from the position of the red pixel
+static inline __device__ int bayerSite( int x, int y, int2 red )
+{
+	return ((x ^ red.x) & 1) | (((y ^ red.y) & 1) << 1);
+}
+
+static inline int2 bayerRed( bayerPattern pattern )
+{
+	switch(pattern)
+	{
+		case BAYER_RGGB:	return make_int2(0, 0);
+		case BAYER_BGGR:	return make_int2(1, 1);
+		case BAYER_GRBG:	return make_int2(1, 0);
+		case BAYER_GBRG:	return make_int2(0, 1);
+	}
+
+	return make_int2(0, 0);
+}
+
+
+// white balance, clamped to the 0-255 range of the input
+static inline __device__ float3 bayerBalance( const float3& rgb, const float3& wb )
+{
+	return make_float3(fminf(fmaxf(rgb.x * wb.x, 0.0f), 255.0f),
+				    fminf(fmaxf(rgb.y * wb.y, 0.0f), 255.0f),
+				    fminf(fmaxf(rgb.z * wb.z, 0.0f), 255.0f));
+}
+
+
+// output formats
+struct bayerOutputRGBAf
+{
+	float4* output;
+	size_t  pitch;
+
+	inline __device__ void operator()( int x, int y, const float3& rgb ) const
+	{
+		((float4*)((uint8_t*)output + y * pitch))[x] = make_float4(rgb.x, rgb.y, rgb.z, 255.0f);
+	}
+};
+
+struct bayerOutputRGBA8
+{
+	uchar4* output;
+	size_t  pitch;
+
+	inline __device__ void operator()( int x, int y, const float3& rgb ) const
+	{
+		((uchar4*)((uint8_t*)output + y * pitch))[x] = make_uchar4(rgb.x + 0.5f, rgb.y + 0.5f, rgb.z + 0.5f, 255);
+	}
+};
+
+struct bayerOutputTensor
+{
+	float* output;
+	int    width;
+	int    planeSize;
+	float3 mean;
+
+	inline __device__ void operator()( int x, int y, const float3& rgb ) const
+	{
+		const int i = y * width + x;
+
+		output[planeSize * 0 + i] = rgb.z - mean.x;
+		output[planeSize * 1 + i] = rgb.y - mean.y;
+		output[planeSize * 2 + i] = rgb.x - mean.z;
+	}
+};
+
+
+// gpuBayer
+template<bayerQuality quality, typename Output>
+__global__ void gpuBayer( const uint8_t* input, int inputPitch, Output output, int width, int height, int2 red, float3 wb )
+{
+	__shared__ uint8_t tile[BAYER_TILE_Y][BAYER_TILE_X];
+
+	// load the block's pixels and the apron around them, mirrored at the borders
+	const int tileX = blockIdx.x * BAYER_BLOCK_X - BAYER_APRON;
+	const int tileY = blockIdx.y * BAYER_BLOCK_Y - BAYER_APRON;
+
+	for( int i = threadIdx.y * BAYER_BLOCK_X + threadIdx.x; i < BAYER_TILE_X * BAYER_TILE_Y; i += BAYER_BLOCK_X * BAYER_BLOCK_Y )
+	{
+		const int tx = i % BAYER_TILE_X;
+		const int ty = i / BAYER_TILE_X;
+
+		tile[ty][tx] = input[bayerMirror(tileY + ty, height) * inputPitch + bayerMirror(tileX + tx, width)];
+	}
+
+	__syncthreads();
+
+	const int x = blockIdx.x * BAYER_BLOCK_X + threadIdx.x;
+	const int y = blockIdx.y * BAYER_BLOCK_Y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	bayerTile samples;
+
+	samples.tile = tile;
+	samples.x    = threadIdx.x + BAYER_APRON;
+	samples.y    = threadIdx.y + BAYER_APRON;
+
+	output(x, y, bayerBalance(bayerDemosaic<quality>(samples, bayerSite(x, y, red)), wb));
+}
+
+
+// gpuBayerResample
+template<bayerQuality quality>
+__global__ void gpuBayerResample( float2 scale, const uint8_t* input, int inputPitch, int inputWidth, int inputHeight,
+						    bayerOutputTensor output, int outputWidth, int outputHeight, int2 red, float3 wb )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= outputWidth || y >= outputHeight )
+		return;
+
+	bayerImage samples;
+
+	samples.input  = input;
+	samples.pitch  = inputPitch;
+	samples.width  = inputWidth;
+	samples.height = inputHeight;
+	samples.x      = (float)x * scale.x;
+	samples.y      = (float)y * scale.y;
+
+	output(x, y, bayerBalance(bayerDemosaic<quality>(samples, bayerSite(samples.x, samples.y, red)), wb));
+}
+
+
+// launchBayer
+template<typename Output>
+static cudaError_t launchBayer( uint8_t* input, size_t inputPitch, const Output& output, size_t width, size_t height,
+						  bayerPattern pattern, bayerQuality quality, const float3& whiteBalance )
+{
+	if( !input )
+		return cudaErrorInvalidDevicePointer;
+
+	if( inputPitch == 0 || width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
+
+	const dim3 blockDim(BAYER_BLOCK_X, BAYER_BLOCK_Y);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y));
+
+	const int2 red = bayerRed(pattern);
+
+	if( quality == BAYER_BILINEAR )
+		gpuBayer<BAYER_BILINEAR><<<gridDim, blockDim>>>(input, inputPitch, output, width, height, red, whiteBalance);
+	else
+		gpuBayer<BAYER_MALVAR><<<gridDim, blockDim>>>(input, inputPitch, output, width, height, red, whiteBalance);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// cudaBayerToRGBA (float4)
+cudaError_t cudaBayerToRGBA( uint8_t* input, size_t inputPitch, float4* output, size_t outputPitch, size_t width, size_t height,
+					    bayerPattern pattern, bayerQuality quality, const float3& whiteBalance )
+{
+	if( !output || outputPitch == 0 )
+		return cudaErrorInvalidValue;
+
+	bayerOutputRGBAf out;
+
+	out.output = output;
+	out.pitch  = outputPitch;
+
+	return launchBayer(input, inputPitch, out, width, height, pattern, quality, whiteBalance);
+}
+
+
+// cudaBayerToRGBA (uchar4)
+cudaError_t cudaBayerToRGBA( uint8_t* input, size_t inputPitch, uchar4* output, size_t outputPitch, size_t width, size_t height,
+					    bayerPattern pattern, bayerQuality quality, const float3& whiteBalance )
+{
+	if( !output || outputPitch == 0 )
+		return cudaErrorInvalidValue;
+
+	bayerOutputRGBA8 out;
+
+	out.output = output;
+	out.pitch  = outputPitch;
+
+	return launchBayer(input, inputPitch, out, width, height, pattern, quality, whiteBalance);
+}
+
+
+// cudaBayerToTensor
+cudaError_t cudaBayerToTensor( uint8_t* input, size_t inputPitch, size_t inputWidth, size_t inputHeight,
+					      float* output, size_t outputWidth, size_t outputHeight,
+					      bayerPattern pattern, bayerQuality quality, const float3& whiteBalance, const float3& mean )
+{
+	if( !input || !output )
+		return cudaErrorInvalidDevicePointer;
+
+	if( inputPitch == 0 || inputWidth == 0 || inputHeight == 0 || outputWidth == 0 || outputHeight == 0 )
+		return cudaErrorInvalidValue;
+
+	bayerOutputTensor out;
+
+	out.output    = output;
+	out.width     = outputWidth;
+	out.planeSize = outputWidth * outputHeight;
+	out.mean      = mean;
+
+	// at the same size, neighbouring pixels share samples through the tiles
+	if( inputWidth == outputWidth && inputHeight == outputHeight )
+		return launchBayer(input, inputPitch, out, inputWidth, inputHeight, pattern, quality, whiteBalance);
+
+	const float2 scale = make_float2( float(inputWidth) / float(outputWidth),
+							    float(inputHeight) / float(outputHeight) );
+
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(outputWidth,blockDim.x), iDivUp(outputHeight,blockDim.y));
+
+	const int2 red = bayerRed(pattern);
+
+	if( quality == BAYER_BILINEAR )
+		gpuBayerResample<BAYER_BILINEAR><<<gridDim, blockDim>>>(scale, input, inputPitch, inputWidth, inputHeight, out, outputWidth, outputHeight, red, whiteBalance);
+	else
+		gpuBayerResample<BAYER_MALVAR><<<gridDim, blockDim>>>(scale, input, inputPitch, inputWidth, inputHeight, out, outputWidth, outputHeight, red, whiteBalance);
+
+	return CUDA(cudaGetLastError());
+}
+
+
+// cudaBAYER_GR8toRGBA
+cudaError_t cudaBAYER_GR8toRGBA( uint8_t* input, float4* output, size_t width, size_t height )
+{
+	return cudaBayerToRGBA(input, width, output, width * sizeof(float4), width, height, BAYER_GRBG, BAYER_BILINEAR);
+}
+
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CUDA_BAYER_H__
+#define __CUDA_BAYER_H__
+
+
+#include "cudaUtility.h"
+#include <stdint.h>
+
+
+/**
+ * Ordering of the color filter array, by the colors of the top-left 2x2 block.
+ * @ingroup util
+ */
+enum bayerPattern
+{
+	BAYER_RGGB = 0,	/**< RG/GB */
+	BAYER_BGGR,		/**< BG/GR */
+	BAYER_GRBG,		/**< GR/BG */
+	BAYER_GBRG		/**< GB/RG */
+};
+
+/**
+ * Interpolation used to fill in the two missing colors of each pixel.
+ * @ingroup util
+ */
+enum bayerQuality
+{
+	BAYER_BILINEAR = 0,	/**< average of the nearest samples of each color (3x3) */
+	BAYER_MALVAR		/**< Malvar-He-Cutler gradient-corrected interpolation (5x5), sharper edges with less color fringing */
+};
+
+
+/**
+ * Demosaic an 8-bit bayer image to float4 RGBA (0-255), with the white balance gains
+ * applied to the red, green and blue channels.  The borders are mirrored.
+ * @ingroup util
+ */
+cudaError_t cudaBayerToRGBA( uint8_t* input, size_t inputPitch, float4* output, size_t outputPitch, size_t width, size_t height,
+					    bayerPattern pattern, bayerQuality quality=BAYER_MALVAR, const float3& whiteBalance=make_float3(1.0f, 1.0f, 1.0f) );
+
+/**
+ * Demosaic an 8-bit bayer image to uchar4 RGBA, with the white balance gains
+ * applied to the red, green and blue channels.  The borders are mirrored.
+ * @ingroup util
+ */
+cudaError_t cudaBayerToRGBA( uint8_t* input, size_t inputPitch, uchar4* output, size_t outputPitch, size_t width, size_t height,
+					    bayerPattern pattern, bayerQuality quality=BAYER_MALVAR, const float3& whiteBalance=make_float3(1.0f, 1.0f, 1.0f) );
+
+/**
+ * Demosaic an 8-bit bayer image straight into a network's input tensor:  planar BGR
+ * with the mean (in BGR order) subtracted, like cudaPreImageNetMean().  If the tensor
+ * is a different size than the image, it's resampled with the nearest pixels.
+ * @ingroup util
+ */
+cudaError_t cudaBayerToTensor( uint8_t* input, size_t inputPitch, size_t inputWidth, size_t inputHeight,
+					      float* output, size_t outputWidth, size_t outputHeight,
+					      bayerPattern pattern, bayerQuality quality=BAYER_MALVAR,
+					      const float3& whiteBalance=make_float3(1.0f, 1.0f, 1.0f), const float3& mean=make_float3(0.0f, 0.0f, 0.0f) );
+
+
+#endif
@@ -62,3 +62,57 @@ cudaError_t cudaRGBToRGBAf( uchar3* srcDev, float4* destDev, size_t width, size_
 	return CUDA(cudaGetLastError());
 }
 
+//-------------------------------------------------------------------------------------------------------------------------
+
+// packed 8-bit RGB/BGR/RGBA with padded rows, read by the byte since the rows needn't be aligned
+template<int channels, bool bgr>
+__global__ void packedToRGBAf( const uint8_t* srcImage, size_t srcPitch,
+                               float4* dstImage, size_t dstPitch,
+                               int width, int height )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= width || y >= height )
+		return;
+
+	const uint8_t* px = srcImage + y * srcPitch + x * channels;
+
+	const float r = bgr ? px[2] : px[0];
+	const float b = bgr ? px[0] : px[2];
+	const float a = (channels == 4) ? px[3] : 255.0f;
+
+	((float4*)((uint8_t*)dstImage + y * dstPitch))[x] = make_float4(r, px[1], b, a);
+}
+
+template<int channels, bool bgr>
+static cudaError_t launchPacked( void* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	if( !srcDev || !destDev )
+		return cudaErrorInvalidDevicePointer;
+
+	if( srcPitch == 0 || destPitch == 0 || width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
+
+	const dim3 blockDim(32,8,1);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y), 1);
+
+	packedToRGBAf<channels, bgr><<<gridDim, blockDim>>>( (const uint8_t*)srcDev, srcPitch, destDev, destPitch, width, height );
+
+	return CUDA(cudaGetLastError());
+}
+
+cudaError_t cudaRGBToRGBAf( uchar3* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchPacked<3, false>(srcDev, srcPitch, destDev, destPitch, width, height);
+}
+
+cudaError_t cudaBGRToRGBAf( uchar3* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchPacked<3, true>(srcDev, srcPitch, destDev, destPitch, width, height);
+}
+
+cudaError_t cudaRGBA8ToRGBAf( uchar4* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchPacked<4, false>(srcDev, srcPitch, destDev, destPitch, width, height);
+}
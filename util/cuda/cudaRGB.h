@@ -33,6 +33,21 @@
  * @ingroup util
  */
 cudaError_t cudaRGBToRGBAf( uchar3* input, float4* output, size_t width, size_t height );
+
+/**
+ * Convert 8-bit RGB, BGR or RGBA images with padded rows (the pitches are in bytes)
+ * to 32-bit floating-point RGBA, with the alpha of RGB and BGR at 255.
+ * @ingroup util
+ */
+cudaError_t cudaRGBToRGBAf( uchar3* input, size_t inputPitch, float4* output, size_t outputPitch, size_t width, size_t height );
+cudaError_t cudaBGRToRGBAf( uchar3* input, size_t inputPitch, float4* output, size_t outputPitch, size_t width, size_t height );
+cudaError_t cudaRGBA8ToRGBAf( uchar4* input, size_t inputPitch, float4* output, size_t outputPitch, size_t width, size_t height );
+
+/**
+ * Bilinear demosaic of a tightly-packed 8-bit GRBG bayer image to 32-bit floating-point RGBA.
+ * Kept for existing callers, see cudaBayerToRGBA() in cudaBayer.h for the other patterns.
+ * @ingroup util
+ */
 cudaError_t cudaBAYER_GR8toRGBA( uint8_t* input, float4* output, size_t width, size_t height );
 
 #endif
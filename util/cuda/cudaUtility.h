@@ -104,5 +104,19 @@ inline cudaError_t cudaCheckError(cudaError_t retval, const char* txt, const cha
 inline __device__ __host__ int iDivUp( int a, int b )  		{ return (a % b != 0) ? (a / b + 1) : (a / b); }
 
 
+/**
+ * Warp shuffle of a register from another lane of the warp.
+ * Uses the synchronizing variants of the intrinsics on CUDA 9 and newer.
+ * @ingroup util
+ */
+#if CUDART_VERSION >= 9000
+#define WARP_SHFL(var, lane)			__shfl_sync(0xFFFFFFFF, var, lane)
+#define WARP_SHFL_DOWN(var, delta)		__shfl_down_sync(0xFFFFFFFF, var, delta)
+#else
+#define WARP_SHFL(var, lane)			__shfl(var, lane)
+#define WARP_SHFL_DOWN(var, delta)		__shfl_down(var, delta)
+#endif
+
+
 
 #endif
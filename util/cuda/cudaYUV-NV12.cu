@@ -23,253 +23,231 @@
 #include "cudaYUV.h"
 
 
-#define COLOR_COMPONENT_MASK            0x3FF
-#define COLOR_COMPONENT_BIT_SIZE        10
-
-#define FIXED_DECIMAL_POINT             24
-#define FIXED_POINT_MULTIPLIER          1.0f
-#define FIXED_COLOR_COMPONENT_MASK      0xffffffff
-
-#define MUL(x,y)    (x*y)
-#define LIMIT_RGB(x)    (((x)<0)?0:((x)>255)?255:(x))
+// YCbCr to RGB, with the range offsets subtracted first (see cudaYUVSetColorspace)
+struct yuvCoefficients
+{
+	float  matrix[9];	// rows of R, G and B, columns of Y, Cb and Cr
+	float  inverse[9];	// rows of Y, Cb and Cr, columns of R, G and B
+	float  offset[3];	// the zero of Y, Cb and Cr
+	float2 siting;		// position of the first chroma sample, in luma pixels
+};
 
+__constant__ yuvCoefficients constYUV;
 
-__constant__ uint32_t constAlpha;
-__constant__ float  constHueColorSpaceMat[9];
 
+// the conversion the kernels use, and whether constYUV holds it yet
+static yuvColorspace yuvCurrentColorspace = make_yuvColorspace();
+static bool          yuvColorspaceSetup   = false;
 
 
-__device__ void YUV2RGB(uint32_t *yuvi, float *red, float *green, float *blue)
+// convert one pixel to RGB (0-255)
+inline __device__ float3 yuvToRGB( float luma, float cb, float cr )
 {
+	luma -= constYUV.offset[0];
+	cb   -= constYUV.offset[1];
+	cr   -= constYUV.offset[2];
 
+	const float r = constYUV.matrix[0] * luma + constYUV.matrix[1] * cb + constYUV.matrix[2] * cr;
+	const float g = constYUV.matrix[3] * luma + constYUV.matrix[4] * cb + constYUV.matrix[5] * cr;
+	const float b = constYUV.matrix[6] * luma + constYUV.matrix[7] * cb + constYUV.matrix[8] * cr;
 
-    // Prepare for hue adjustment
-    /*
-	 float luma, chromaCb, chromaCr;
-
-	luma     = (float)yuvi[0];
-    chromaCb = (float)((int)yuvi[1] - 512.0f);
-    chromaCr = (float)((int)yuvi[2] - 512.0f);
-
-    // Convert YUV To RGB with hue adjustment
-    *red  = MUL(luma,     constHueColorSpaceMat[0]) +
-            MUL(chromaCb, constHueColorSpaceMat[1]) +
-            MUL(chromaCr, constHueColorSpaceMat[2]);
-    *green= MUL(luma,     constHueColorSpaceMat[3]) +
-            MUL(chromaCb, constHueColorSpaceMat[4]) +
-            MUL(chromaCr, constHueColorSpaceMat[5]);
-    *blue = MUL(luma,     constHueColorSpaceMat[6]) +
-            MUL(chromaCb, constHueColorSpaceMat[7]) +
-            MUL(chromaCr, constHueColorSpaceMat[8]);*/
-
-	const float luma = float(yuvi[0]);
-	const float u    = float(yuvi[1]) - 512.0f;
-	const float v    = float(yuvi[2]) - 512.0f;
+	return make_float3(fminf(fmaxf(r, 0.0f), 255.0f),
+				    fminf(fmaxf(g, 0.0f), 255.0f),
+				    fminf(fmaxf(b, 0.0f), 255.0f));
+}
 
-   /*R = Y + 1.140V
-   G = Y - 0.395U - 0.581V
-   B = Y + 2.032U*/
 
-	/**green = luma + 1.140f * v;
-	*blue  = luma - 0.395f * u - 0.581f * v;
-	*red   = luma + 2.032f * u;*/
+// convert one pixel from RGB (0-255), rounded to the nearest code
+inline __device__ uchar3 rgbToYUV( const float3& rgb )
+{
+	const float y  = constYUV.inverse[0] * rgb.x + constYUV.inverse[1] * rgb.y + constYUV.inverse[2] * rgb.z + constYUV.offset[0];
+	const float cb = constYUV.inverse[3] * rgb.x + constYUV.inverse[4] * rgb.y + constYUV.inverse[5] * rgb.z + constYUV.offset[1];
+	const float cr = constYUV.inverse[6] * rgb.x + constYUV.inverse[7] * rgb.y + constYUV.inverse[8] * rgb.z + constYUV.offset[2];
 
-	*red    = luma + 1.140f * v;
-	*green  = luma - 0.395f * u - 0.581f * v;
-	*blue   = luma + 2.032f * u;
+	return make_uchar3(fminf(fmaxf(y,  0.0f), 255.0f) + 0.5f,
+				    fminf(fmaxf(cb, 0.0f), 255.0f) + 0.5f,
+				    fminf(fmaxf(cr, 0.0f), 255.0f) + 0.5f);
 }
 
 
-__device__ void YUV82RGB(uint8_t *yuvi, float *red, float *green, float *blue)
+// linear position between two samples, clamped to the edges of the plane
+inline __device__ void chromaSample( float pos, int size, int* i0, int* i1, float* weight )
 {
-	const float y0 = float(yuvi[0]);
-	const float cb0    = float(yuvi[1]);
-	const float cr0    = float(yuvi[2]);
-
-    //printf("YUV luma=%f, u=%f, v=%f\n", y0, cb0, cr0);
+	pos = fminf(fmaxf(pos, 0.0f), float(size - 1));
 
-	unsigned char r0(LIMIT_RGB(round((298.082 * y0) / 256.0 + (408.583 * cr0) / 256.0 - 222.921)));
+	*i0     = int(pos);
+	*i1     = min(*i0 + 1, size - 1);
+	*weight = pos - float(*i0);
+}
 
 
-	unsigned char g0(LIMIT_RGB(round((298.082 * y0) / 256.0 - (100.291 * cb0) / 256.0
-			- (208.120 * cr0) / 256.0 + 135.576)));
+// interpolate the 4:2:0 chroma plane at a luma pixel, from where the chroma was sited
+inline __device__ float2 nv12Chroma( const uint8_t* chroma, size_t pitch, int chromaWidth, int chromaHeight, int x, int y )
+{
+	int x0, x1, y0, y1;
+	float wx, wy;
 
+	chromaSample((float(x) - constYUV.siting.x) * 0.5f, chromaWidth, &x0, &x1, &wx);
+	chromaSample((float(y) - constYUV.siting.y) * 0.5f, chromaHeight, &y0, &y1, &wy);
 
-	unsigned char b0(LIMIT_RGB(round((298.082 * y0) / 256.0 + (516.412 * cb0) / 256.0 - 276.836)));
+	const uchar2 c00 = ((const uchar2*)(chroma + y0 * pitch))[x0];
+	const uchar2 c01 = ((const uchar2*)(chroma + y0 * pitch))[x1];
+	const uchar2 c10 = ((const uchar2*)(chroma + y1 * pitch))[x0];
+	const uchar2 c11 = ((const uchar2*)(chroma + y1 * pitch))[x1];
 
-	*red    = (float)r0;
-	*green  = (float)g0;
-	*blue   = (float)b0;
+	const float cb0 = c00.x + (c01.x - c00.x) * wx;
+	const float cr0 = c00.y + (c01.y - c00.y) * wx;
+	const float cb1 = c10.x + (c11.x - c10.x) * wx;
+	const float cr1 = c10.y + (c11.y - c10.y) * wx;
 
-    //printf("RGB red=%f, green=%f, blue=%f\n", *red , *green, *blue);
+	return make_float2(cb0 + (cb1 - cb0) * wy, cr0 + (cr1 - cr0) * wy);
 }
 
 
-__device__ uint32_t RGBAPACK_8bit(float red, float green, float blue, uint32_t alpha)
+// interpolate the chroma planes of a 4:2:0 planar image at a luma pixel, from where the chroma was sited
+inline __device__ float2 planarChroma( const uint8_t* cb, const uint8_t* cr, size_t pitch, int chromaWidth, int chromaHeight, int x, int y )
 {
-    uint32_t ARGBpixel = 0;
+	int x0, x1, y0, y1;
+	float wx, wy;
 
-    // Clamp final 10 bit results
-    red   = min(max(red,   0.0f), 255.0f);
-    green = min(max(green, 0.0f), 255.0f);
-    blue  = min(max(blue,  0.0f), 255.0f);
+	chromaSample((float(x) - constYUV.siting.x) * 0.5f, chromaWidth, &x0, &x1, &wx);
+	chromaSample((float(y) - constYUV.siting.y) * 0.5f, chromaHeight, &y0, &y1, &wy);
 
-    // Convert to 8 bit unsigned integers per color component
-    ARGBpixel = ((((uint32_t)red)   << 24) |
-                 (((uint32_t)green) << 16) |
-		       (((uint32_t)blue)  <<  8) | (uint32_t)alpha);
+	const float cb0 = cb[y0 * pitch + x0] + (cb[y0 * pitch + x1] - cb[y0 * pitch + x0]) * wx;
+	const float cr0 = cr[y0 * pitch + x0] + (cr[y0 * pitch + x1] - cr[y0 * pitch + x0]) * wx;
+	const float cb1 = cb[y1 * pitch + x0] + (cb[y1 * pitch + x1] - cb[y1 * pitch + x0]) * wx;
+	const float cr1 = cr[y1 * pitch + x0] + (cr[y1 * pitch + x1] - cr[y1 * pitch + x0]) * wx;
 
-    return  ARGBpixel;
+	return make_float2(cb0 + (cb1 - cb0) * wy, cr0 + (cr1 - cr0) * wy);
 }
 
 
-__device__ uint32_t RGBAPACK_10bit(float red, float green, float blue, uint32_t alpha)
+// input formats, scaled to 0-255
+inline __device__ float3 rgbaLoad( const float4* row, int x, float scale )
 {
-    uint32_t ARGBpixel = 0;
-
-    // Clamp final 10 bit results
-    red   = min(max(red,   0.0f), 1023.f);
-    green = min(max(green, 0.0f), 1023.f);
-    blue  = min(max(blue,  0.0f), 1023.f);
-
-    // Convert to 8 bit unsigned integers per color component
-    ARGBpixel = ((((uint32_t)red   >> 2) << 24) |
-                 (((uint32_t)green >> 2) << 16) |
-                 (((uint32_t)blue  >> 2) <<  8) | (uint32_t)alpha);
+	const float4 px = row[x];
+	return make_float3(px.x * scale, px.y * scale, px.z * scale);
+}
 
-    return  ARGBpixel;
+inline __device__ float3 rgbaLoad( const uchar4* row, int x, float scale )
+{
+	const uchar4 px = row[x];
+	return make_float3(px.x, px.y, px.z);
 }
 
 
-// CUDA kernel for outputing the final ARGB output from NV12;
-/*extern "C"*/
-__global__ void Passthru(uint32_t *srcImage,   size_t nSourcePitch,
-                         uint32_t *dstImage,   size_t nDestPitch,
-                         uint32_t width,       uint32_t height)
+// output formats
+inline __device__ void rgbaStore( float4* row, int x, const float3& rgb )
 {
-    int x, y;
-    uint32_t yuv101010Pel[2];
-    uint32_t processingPitch = ((width) + 63) & ~63;
-    uint32_t dstImagePitch   = nDestPitch >> 2;
-    uint8_t *srcImageU8     = (uint8_t *)srcImage;
+	row[x] = make_float4(rgb.x, rgb.y, rgb.z, 1.0f);	// alpha has always been left at 1
+}
 
-    processingPitch = nSourcePitch;
+inline __device__ void rgbaStore( uchar4* row, int x, const float3& rgb )
+{
+	row[x] = make_uchar4(rgb.x + 0.5f, rgb.y + 0.5f, rgb.z + 0.5f, 255);
+}
 
-    // Pad borders with duplicate pixels, and we multiply by 2 because we process 2 pixels per thread
-    x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
-    y = blockIdx.y *  blockDim.y       +  threadIdx.y;
 
-    if (x >= width)
-        return; //x = width - 1;
+//-------------------------------------------------------------------------------------------------------------------------
 
-    if (y >= height)
-        return; // y = height - 1;
+// NV12ToRGBA
+template<typename T>
+__global__ void NV12ToRGBA( const uint8_t* srcImage, size_t srcPitch,
+                            T* dstImage, size_t dstPitch,
+                            int width, int height )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
 
-    // Read 2 Luma components at a time, so we don't waste processing since CbCr are decimated this way.
-    // if we move to texture we could read 4 luminance values
-    yuv101010Pel[0] = (srcImageU8[y * processingPitch + x    ]);
-    yuv101010Pel[1] = (srcImageU8[y * processingPitch + x + 1]);
+	if( x >= width || y >= height )
+		return;
 
-    // this steps performs the color conversion
-    float luma[2];
+	// the chroma plane holds a CbCr pair for every 2x2 block, rounded up at odd sizes
+	const uint8_t* chroma = srcImage + srcPitch * height;
+	const float2   cbcr   = nv12Chroma(chroma, srcPitch, (width + 1) >> 1, (height + 1) >> 1, x, y);
 
-    luma[0]   = (yuv101010Pel[0]        & 0x00FF);
-    luma[1]   = (yuv101010Pel[1]        & 0x00FF);
+	const float3 rgb = yuvToRGB(srcImage[y * srcPitch + x], cbcr.x, cbcr.y);
 
-    // Clamp the results to RGBA
-    dstImage[y * dstImagePitch + x     ] = RGBAPACK_8bit(luma[0], luma[0], luma[0], constAlpha);
-    dstImage[y * dstImagePitch + x + 1 ] = RGBAPACK_8bit(luma[1], luma[1], luma[1], constAlpha);
+	rgbaStore((T*)((uint8_t*)dstImage + y * dstPitch), x, rgb);
 }
 
 
-// CUDA kernel for outputing the final ARGB output from NV12;
-/*extern "C"*/
-__global__ void NV12ToARGB(uint32_t *srcImage,     size_t nSourcePitch,
-                           uint32_t *dstImage,     size_t nDestPitch,
-                           uint32_t width,         uint32_t height)
+// launchNV12
+template<typename T>
+static cudaError_t launchNV12( uint8_t* srcDev, size_t srcPitch, T* destDev, size_t destPitch, size_t width, size_t height )
 {
-    int x, y;
-    uint32_t yuv101010Pel[2];
-    uint32_t processingPitch = ((width) + 63) & ~63;
-    uint32_t dstImagePitch   = nDestPitch >> 2;
-    uint8_t *srcImageU8     = (uint8_t *)srcImage;
+	if( !srcDev || !destDev )
+		return cudaErrorInvalidDevicePointer;
 
-    processingPitch = nSourcePitch;
+	if( srcPitch == 0 || destPitch == 0 || width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
 
-    // Pad borders with duplicate pixels, and we multiply by 2 because we process 2 pixels per thread
-    x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
-    y = blockIdx.y *  blockDim.y       +  threadIdx.y;
+	if( !yuvColorspaceSetup && CUDA_FAILED(cudaYUVSetColorspace(yuvCurrentColorspace)) )
+		return cudaErrorInvalidSymbol;
 
-    if (x >= width)
-        return; //x = width - 1;
+	const dim3 blockDim(32,8,1);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y), 1);
 
-    if (y >= height)
-        return; // y = height - 1;
+	NV12ToRGBA<T><<<gridDim, blockDim>>>( srcDev, srcPitch, destDev, destPitch, width, height );
 
-    // Read 2 Luma components at a time, so we don't waste processing since CbCr are decimated this way.
-    // if we move to texture we could read 4 luminance values
-    yuv101010Pel[0] = (srcImageU8[y * processingPitch + x    ]) << 2;
-    yuv101010Pel[1] = (srcImageU8[y * processingPitch + x + 1]) << 2;
+	return CUDA(cudaGetLastError());
+}
 
-    uint32_t chromaOffset    = processingPitch * height;
-    int y_chroma = y >> 1;
 
-    if (y & 1)  // odd scanline ?
-    {
-        uint32_t chromaCb;
-        uint32_t chromaCr;
+// cudaNV12ToRGBA
+cudaError_t cudaNV12ToRGBA( uint8_t* srcDev, size_t srcPitch, uchar4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchNV12(srcDev, srcPitch, destDev, destPitch, width, height);
+}
 
-        chromaCb = srcImageU8[chromaOffset + y_chroma * processingPitch + x    ];
-        chromaCr = srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1];
+cudaError_t cudaNV12ToRGBA( uint8_t* srcDev, uchar4* destDev, size_t width, size_t height )
+{
+	return cudaNV12ToRGBA(srcDev, width * sizeof(uint8_t), destDev, width * sizeof(uchar4), width, height);
+}
 
-        if (y_chroma < ((height >> 1) - 1)) // interpolate chroma vertically
-        {
-            chromaCb = (chromaCb + srcImageU8[chromaOffset + (y_chroma + 1) * processingPitch + x    ] + 1) >> 1;
-            chromaCr = (chromaCr + srcImageU8[chromaOffset + (y_chroma + 1) * processingPitch + x + 1] + 1) >> 1;
-        }
 
-        yuv101010Pel[0] |= (chromaCb << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[0] |= (chromaCr << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
+// cudaNV12ToRGBAf
+cudaError_t cudaNV12ToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchNV12(srcDev, srcPitch, destDev, destPitch, width, height);
+}
 
-        yuv101010Pel[1] |= (chromaCb << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[1] |= (chromaCr << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
-    }
-    else
-    {
-        yuv101010Pel[0] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x    ] << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[0] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1] << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
+cudaError_t cudaNV12ToRGBAf( uint8_t* srcDev, float4* destDev, size_t width, size_t height )
+{
+	return cudaNV12ToRGBAf(srcDev, width * sizeof(uint8_t), destDev, width * sizeof(float4), width, height);
+}
 
-        yuv101010Pel[1] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x    ] << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[1] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1] << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
-    }
 
-    // this steps performs the color conversion
-    uint32_t yuvi[6];
-    float red[2], green[2], blue[2];
+//-------------------------------------------------------------------------------------------------------------------------
 
-    yuvi[0] = (yuv101010Pel[0] &   COLOR_COMPONENT_MASK);
-    yuvi[1] = ((yuv101010Pel[0] >>  COLOR_COMPONENT_BIT_SIZE)       & COLOR_COMPONENT_MASK);
-    yuvi[2] = ((yuv101010Pel[0] >> (COLOR_COMPONENT_BIT_SIZE << 1)) & COLOR_COMPONENT_MASK);
+// I420ToRGBAf
+__global__ void I420ToRGBAf( const uint8_t* srcImage, size_t srcPitch,
+                             float4* dstImage, size_t dstPitch,
+                             int width, int height )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
 
-    yuvi[3] = (yuv101010Pel[1] &   COLOR_COMPONENT_MASK);
-    yuvi[4] = ((yuv101010Pel[1] >>  COLOR_COMPONENT_BIT_SIZE)       & COLOR_COMPONENT_MASK);
-    yuvi[5] = ((yuv101010Pel[1] >> (COLOR_COMPONENT_BIT_SIZE << 1)) & COLOR_COMPONENT_MASK);
+	if( x >= width || y >= height )
+		return;
 
-    // YUV to RGB Transformation conversion
-    YUV2RGB(&yuvi[0], &red[0], &green[0], &blue[0]);
-    YUV2RGB(&yuvi[3], &red[1], &green[1], &blue[1]);
+	// the U and V planes follow the Y plane, at half the pitch and rounded up at odd sizes
+	const int    chromaWidth  = (width + 1) >> 1;
+	const int    chromaHeight = (height + 1) >> 1;
+	const size_t chromaPitch  = (srcPitch + 1) >> 1;
 
-    // Clamp the results to RGBA
-    dstImage[y * dstImagePitch + x     ] = RGBAPACK_10bit(red[0], green[0], blue[0], constAlpha);
-    dstImage[y * dstImagePitch + x + 1 ] = RGBAPACK_10bit(red[1], green[1], blue[1], constAlpha);
-}
+	const uint8_t* cb = srcImage + srcPitch * height;
+	const uint8_t* cr = cb + chromaPitch * chromaHeight;
 
+	const float2 cbcr = planarChroma(cb, cr, chromaPitch, chromaWidth, chromaHeight, x, y);
+	const float3 rgb  = yuvToRGB(srcImage[y * srcPitch + x], cbcr.x, cbcr.y);
 
-bool nv12ColorspaceSetup = false;
+	rgbaStore((float4*)((uint8_t*)dstImage + y * dstPitch), x, rgb);
+}
 
 
-// cudaNV12ToARGB32
-cudaError_t cudaNV12ToRGBA( uint8_t* srcDev, size_t srcPitch, uchar4* destDev, size_t destPitch, size_t width, size_t height )
+// cudaI420ToRGBAf
+cudaError_t cudaI420ToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
 {
 	if( !srcDev || !destDev )
 		return cudaErrorInvalidDevicePointer;
@@ -277,241 +255,244 @@ cudaError_t cudaNV12ToRGBA( uint8_t* srcDev, size_t srcPitch, uchar4* destDev, s
 	if( srcPitch == 0 || destPitch == 0 || width == 0 || height == 0 )
 		return cudaErrorInvalidValue;
 
-	if( !nv12ColorspaceSetup )
-		cudaNV12SetupColorspace();
+	if( !yuvColorspaceSetup && CUDA_FAILED(cudaYUVSetColorspace(yuvCurrentColorspace)) )
+		return cudaErrorInvalidSymbol;
 
-	const dim3 blockDim(32,16,1);
-	const dim3 gridDim((width+(2*blockDim.x-1))/(2*blockDim.x), (height+(blockDim.y-1))/blockDim.y, 1);
+	const dim3 blockDim(32,8,1);
+	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height,blockDim.y), 1);
 
-	NV12ToARGB<<<gridDim, blockDim>>>( (uint32_t*)srcDev, srcPitch, (uint32_t*)destDev, destPitch, width, height );
+	I420ToRGBAf<<<gridDim, blockDim>>>( srcDev, srcPitch, destDev, destPitch, width, height );
 
 	return CUDA(cudaGetLastError());
 }
 
-cudaError_t cudaNV12ToRGBA( uint8_t* srcDev, uchar4* destDev, size_t width, size_t height )
+cudaError_t cudaI420ToRGBAf( uint8_t* srcDev, float4* destDev, size_t width, size_t height )
 {
-	return cudaNV12ToRGBA(srcDev, width * sizeof(uint8_t), destDev, width * sizeof(uchar4), width, height);
+	return cudaI420ToRGBAf(srcDev, width * sizeof(uint8_t), destDev, width * sizeof(float4), width, height);
 }
 
 
 //-------------------------------------------------------------------------------------------------------------------------
 
-__global__ void NV12ToRGBAf(uint32_t* srcImage,  size_t nSourcePitch,
-                           float4* dstImage,     size_t nDestPitch,
-                           uint32_t width,       uint32_t height)
+// RGBAToNV12
+template<typename T>
+__global__ void RGBAToNV12( const T* srcImage, size_t srcPitch,
+                            uint8_t* dstImage, size_t dstPitch,
+                            int width, int height, float scale )
 {
-    int x, y;
-    uint32_t yuv101010Pel[2];
-    uint32_t processingPitch = ((width) + 63) & ~63;
-    uint8_t *srcImageU8     = (uint8_t *)srcImage;
-
-    processingPitch = nSourcePitch;
+	// each thread converts a 2x2 block, which shares one chroma sample
+	const int x = (blockIdx.x * blockDim.x + threadIdx.x) * 2;
+	const int y = (blockIdx.y * blockDim.y + threadIdx.y) * 2;
 
-    // Pad borders with duplicate pixels, and we multiply by 2 because we process 2 pixels per thread
-    x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
-    y = blockIdx.y *  blockDim.y       +  threadIdx.y;
+	if( x >= width || y >= height )
+		return;
 
-    if (x >= width)
-        return; //x = width - 1;
+	// odd sizes repeat the last column or row into the block
+	const int x1 = min(x + 1, width - 1);
+	const int y1 = min(y + 1, height - 1);
 
-    if (y >= height)
-        return; // y = height - 1;
+	const T* row0 = (const T*)((const uint8_t*)srcImage + y * srcPitch);
+	const T* row1 = (const T*)((const uint8_t*)srcImage + y1 * srcPitch);
 
-#if 1
-    // Read 2 Luma components at a time, so we don't waste processing since CbCr are decimated this way.
-    // if we move to texture we could read 4 luminance values
-    yuv101010Pel[0] = (srcImageU8[y * processingPitch + x    ]) << 2;
-    yuv101010Pel[1] = (srcImageU8[y * processingPitch + x + 1]) << 2;
+	const float3 px00 = rgbaLoad(row0, x, scale);
+	const float3 px01 = rgbaLoad(row0, x1, scale);
+	const float3 px10 = rgbaLoad(row1, x, scale);
+	const float3 px11 = rgbaLoad(row1, x1, scale);
 
-    uint32_t chromaOffset    = processingPitch * height;
-    int y_chroma = y >> 1;
+	uint8_t* luma0 = dstImage + y * dstPitch;
+	uint8_t* luma1 = dstImage + y1 * dstPitch;
 
-    if (y & 1)  // odd scanline ?
-    {
-        uint32_t chromaCb;
-        uint32_t chromaCr;
+	luma0[x]  = rgbToYUV(px00).x;
+	luma0[x1] = rgbToYUV(px01).x;
+	luma1[x]  = rgbToYUV(px10).x;
+	luma1[x1] = rgbToYUV(px11).x;
 
-        chromaCb = srcImageU8[chromaOffset + y_chroma * processingPitch + x    ];
-        chromaCr = srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1];
+	// the matrix is linear, so the chroma of the average is the average of the chroma
+	const float3 mean = make_float3((px00.x + px01.x + px10.x + px11.x) * 0.25f,
+							  (px00.y + px01.y + px10.y + px11.y) * 0.25f,
+							  (px00.z + px01.z + px10.z + px11.z) * 0.25f);
 
-        if (y_chroma < ((height >> 1) - 1)) // interpolate chroma vertically
-        {
-            chromaCb = (chromaCb + srcImageU8[chromaOffset + (y_chroma + 1) * processingPitch + x    ] + 1) >> 1;
-            chromaCr = (chromaCr + srcImageU8[chromaOffset + (y_chroma + 1) * processingPitch + x + 1] + 1) >> 1;
-        }
+	const uchar3 yuv = rgbToYUV(mean);
 
-        yuv101010Pel[0] |= (chromaCb << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[0] |= (chromaCr << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
+	uint8_t* chroma = dstImage + dstPitch * height + (y >> 1) * dstPitch;
 
-        yuv101010Pel[1] |= (chromaCb << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[1] |= (chromaCr << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
-    }
-    else
-    {
-        yuv101010Pel[0] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x    ] << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[0] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1] << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
+	chroma[x]     = yuv.y;
+	chroma[x + 1] = yuv.z;
+}
 
-        yuv101010Pel[1] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x    ] << (COLOR_COMPONENT_BIT_SIZE       + 2));
-        yuv101010Pel[1] |= ((uint32_t)srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1] << ((COLOR_COMPONENT_BIT_SIZE << 1) + 2));
-    }
 
-    // this steps performs the color conversion
-    uint32_t yuvi[6];
-    float red[2], green[2], blue[2];
+// launchRGBAToNV12
+template<typename T>
+static cudaError_t launchRGBAToNV12( T* srcDev, size_t srcPitch, uint8_t* destDev, size_t destPitch, size_t width, size_t height, float scale )
+{
+	if( !srcDev || !destDev )
+		return cudaErrorInvalidDevicePointer;
 
-    yuvi[0] = (yuv101010Pel[0] &   COLOR_COMPONENT_MASK);
-    yuvi[1] = ((yuv101010Pel[0] >>  COLOR_COMPONENT_BIT_SIZE)       & COLOR_COMPONENT_MASK);
-    yuvi[2] = ((yuv101010Pel[0] >> (COLOR_COMPONENT_BIT_SIZE << 1)) & COLOR_COMPONENT_MASK);
+	if( srcPitch == 0 || destPitch == 0 || width == 0 || height == 0 )
+		return cudaErrorInvalidValue;
 
-    yuvi[3] = (yuv101010Pel[1] &   COLOR_COMPONENT_MASK);
-    yuvi[4] = ((yuv101010Pel[1] >>  COLOR_COMPONENT_BIT_SIZE)       & COLOR_COMPONENT_MASK);
-    yuvi[5] = ((yuv101010Pel[1] >> (COLOR_COMPONENT_BIT_SIZE << 1)) & COLOR_COMPONENT_MASK);
+	if( !yuvColorspaceSetup && CUDA_FAILED(cudaYUVSetColorspace(yuvCurrentColorspace)) )
+		return cudaErrorInvalidSymbol;
 
-    // YUV to RGB Transformation conversion
-    YUV2RGB(&yuvi[0], &red[0], &green[0], &blue[0]);
-    YUV2RGB(&yuvi[3], &red[1], &green[1], &blue[1]);
+	const dim3 blockDim(16,8,1);
+	const dim3 gridDim(iDivUp(width,blockDim.x*2), iDivUp(height,blockDim.y*2), 1);
 
-    // Clamp the results to RGBA
-	//printf("cuda thread %i %i  %f %f %f\n", x, y, red[0], green[0], blue[0]);
+	RGBAToNV12<T><<<gridDim, blockDim>>>( srcDev, srcPitch, destDev, destPitch, width, height, scale );
 
-	const float s = 1.0f / 1024.0f * 255.0f;
+	return CUDA(cudaGetLastError());
+}
 
-	dstImage[y * width + x]     = make_float4(red[0] * s, green[0] * s, blue[0] * s, 1.0f);
-	dstImage[y * width + x + 1] = make_float4(red[1] * s, green[1] * s, blue[1] * s, 1.0f);
-#else
-	//printf("cuda thread %i %i  %i %i \n", x, y, width, height);
 
-	dstImage[y * width + x]     = make_float4(1.0f, 0.0f, 0.0f, 1.0f);
-	dstImage[y * width + x + 1] = make_float4(1.0f, 0.0f, 0.0f, 1.0f);
-#endif
+// cudaRGBAToNV12 (uchar4)
+cudaError_t cudaRGBAToNV12( uchar4* srcDev, size_t srcPitch, uint8_t* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchRGBAToNV12(srcDev, srcPitch, destDev, destPitch, width, height, 1.0f);
 }
 
+cudaError_t cudaRGBAToNV12( uchar4* srcDev, uint8_t* destDev, size_t width, size_t height )
+{
+	return cudaRGBAToNV12(srcDev, width * sizeof(uchar4), destDev, iDivUp(width,2) * 2, width, height);
+}
 
 
-// cudaNV12ToRGBA
-cudaError_t cudaNV12ToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+// cudaRGBAToNV12 (float4)
+cudaError_t cudaRGBAToNV12( float4* srcDev, size_t srcPitch, uint8_t* destDev, size_t destPitch, size_t width, size_t height, float max_pixel )
 {
-	if( !srcDev || !destDev )
-		return cudaErrorInvalidDevicePointer;
-
-	if( srcPitch == 0 || destPitch == 0 || width == 0 || height == 0 )
+	if( max_pixel <= 0.0f )
 		return cudaErrorInvalidValue;
 
-	if( !nv12ColorspaceSetup )
-		cudaNV12SetupColorspace();
-
-	const dim3 blockDim(8,8,1);
-	//const dim3 gridDim((width+(2*blockDim.x-1))/(2*blockDim.x), (height+(blockDim.y-1))/blockDim.y, 1);
-	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height, blockDim.y), 1);
-
-	NV12ToRGBAf<<<gridDim, blockDim>>>( (uint32_t*)srcDev, srcPitch, destDev, destPitch, width, height );
-
-	return CUDA(cudaGetLastError());
+	return launchRGBAToNV12(srcDev, srcPitch, destDev, destPitch, width, height, 255.0f / max_pixel);
 }
 
-cudaError_t cudaNV12ToRGBAf( uint8_t* srcDev, float4* destDev, size_t width, size_t height )
+cudaError_t cudaRGBAToNV12( float4* srcDev, uint8_t* destDev, size_t width, size_t height, float max_pixel )
 {
-	return cudaNV12ToRGBAf(srcDev, width * sizeof(uint8_t), destDev, width * sizeof(float4), width, height);
+	return cudaRGBAToNV12(srcDev, width * sizeof(float4), destDev, iDivUp(width,2) * 2, width, height, max_pixel);
 }
 
 
-// cudaNV12SetupColorspace
-cudaError_t cudaNV12SetupColorspace( float hue )
+//-------------------------------------------------------------------------------------------------------------------------
+
+// cudaYUVSetColorspace
+cudaError_t cudaYUVSetColorspace( const yuvColorspace& colorspace )
 {
-	const float hueSin = sin(hue);
-	const float hueCos = cos(hue);
-
-	float hueCSC[9];
-
-	const bool itu601 = false;
-
-	if( itu601 /*CSC == ITU601*/)
-	{
-		//CCIR 601
-		hueCSC[0] = 1.1644f;
-		hueCSC[1] = hueSin * 1.5960f;
-		hueCSC[2] = hueCos * 1.5960f;
-		hueCSC[3] = 1.1644f;
-		hueCSC[4] = (hueCos * -0.3918f) - (hueSin * 0.8130f);
-		hueCSC[5] = (hueSin *  0.3918f) - (hueCos * 0.8130f);
-		hueCSC[6] = 1.1644f;
-		hueCSC[7] = hueCos *  2.0172f;
-		hueCSC[8] = hueSin * -2.0172f;
-	}
-	else /*if(CSC == ITU709)*/
-	{
-		//CCIR 709
-		hueCSC[0] = 1.0f;
-		hueCSC[1] = hueSin * 1.57480f;
-		hueCSC[2] = hueCos * 1.57480f;
-		hueCSC[3] = 1.0;
-		hueCSC[4] = (hueCos * -0.18732f) - (hueSin * 0.46812f);
-		hueCSC[5] = (hueSin *  0.18732f) - (hueCos * 0.46812f);
-		hueCSC[6] = 1.0f;
-		hueCSC[7] = hueCos *  1.85560f;
-		hueCSC[8] = hueSin * -1.85560f;
-	}
-
-
-	if( CUDA_FAILED(cudaMemcpyToSymbol(constHueColorSpaceMat, hueCSC, sizeof(float) * 9)) )
+	// luma and color difference weights of the matrix
+	const float kr = (colorspace.matrix == YUV_BT709) ? 0.2126f : 0.299f;
+	const float kb = (colorspace.matrix == YUV_BT709) ? 0.0722f : 0.114f;
+	const float kg = 1.0f - kr - kb;
+
+	// limited range leaves headroom:  Y is 16-235 and CbCr 16-240
+	const bool  full   = (colorspace.range == YUV_RANGE_FULL);
+	const float yScale = full ? 1.0f : 255.0f / 219.0f;
+	const float cScale = full ? 1.0f : 255.0f / 224.0f;
+
+	const float crToR = cScale * 2.0f * (1.0f - kr);
+	const float cbToB = cScale * 2.0f * (1.0f - kb);
+	const float cbToG = cScale * 2.0f * (1.0f - kb) * kb / kg;
+	const float crToG = cScale * 2.0f * (1.0f - kr) * kr / kg;
+
+	// the hue rotates the CbCr plane
+	const float hueSin = sinf(colorspace.hue);
+	const float hueCos = cosf(colorspace.hue);
+
+	yuvCoefficients c;
+
+	c.matrix[0] = yScale;
+	c.matrix[1] = crToR * hueSin;
+	c.matrix[2] = crToR * hueCos;
+	c.matrix[3] = yScale;
+	c.matrix[4] = -cbToG * hueCos - crToG * hueSin;
+	c.matrix[5] =  cbToG * hueSin - crToG * hueCos;
+	c.matrix[6] = yScale;
+	c.matrix[7] =  cbToB * hueCos;
+	c.matrix[8] = -cbToB * hueSin;
+
+	// and back again, for the RGB to YUV conversions
+	const float det = c.matrix[0] * (c.matrix[4] * c.matrix[8] - c.matrix[5] * c.matrix[7]) -
+				   c.matrix[1] * (c.matrix[3] * c.matrix[8] - c.matrix[5] * c.matrix[6]) +
+				   c.matrix[2] * (c.matrix[3] * c.matrix[7] - c.matrix[4] * c.matrix[6]);
+
+	c.inverse[0] = (c.matrix[4] * c.matrix[8] - c.matrix[5] * c.matrix[7]) / det;
+	c.inverse[1] = (c.matrix[2] * c.matrix[7] - c.matrix[1] * c.matrix[8]) / det;
+	c.inverse[2] = (c.matrix[1] * c.matrix[5] - c.matrix[2] * c.matrix[4]) / det;
+	c.inverse[3] = (c.matrix[5] * c.matrix[6] - c.matrix[3] * c.matrix[8]) / det;
+	c.inverse[4] = (c.matrix[0] * c.matrix[8] - c.matrix[2] * c.matrix[6]) / det;
+	c.inverse[5] = (c.matrix[2] * c.matrix[3] - c.matrix[0] * c.matrix[5]) / det;
+	c.inverse[6] = (c.matrix[3] * c.matrix[7] - c.matrix[4] * c.matrix[6]) / det;
+	c.inverse[7] = (c.matrix[1] * c.matrix[6] - c.matrix[0] * c.matrix[7]) / det;
+	c.inverse[8] = (c.matrix[0] * c.matrix[4] - c.matrix[1] * c.matrix[3]) / det;
+
+	c.offset[0] = full ? 0.0f : 16.0f;
+	c.offset[1] = 128.0f;
+	c.offset[2] = 128.0f;
+
+	// the chroma of each 2x2 block is between its rows, unless it's co-sited with the top-left pixel,
+	// and between its columns only when it's centered
+	c.siting.x = (colorspace.siting == YUV_CHROMA_CENTER) ? 0.5f : 0.0f;
+	c.siting.y = (colorspace.siting == YUV_CHROMA_TOPLEFT) ? 0.0f : 0.5f;
+
+	if( CUDA_FAILED(cudaMemcpyToSymbol(constYUV, &c, sizeof(yuvCoefficients))) )
 		return cudaErrorInvalidSymbol;
 
-	uint32_t cudaAlpha = ((uint32_t)0xff<< 24);
+	yuvCurrentColorspace = colorspace;
+	yuvColorspaceSetup   = true;
 
-	if( CUDA_FAILED(cudaMemcpyToSymbol(constAlpha, &cudaAlpha, sizeof(uint32_t))) )
-		return cudaErrorInvalidSymbol;
-
-	nv12ColorspaceSetup = true;
 	return cudaSuccess;
 }
 
-//-------------------------------------------------------------------------------------------------------------------------
-// RTP YUV color space conversion
 
-__global__ void YUVToRGBAf(uint32_t* srcImage,  size_t nSourcePitch,
-    float4* dstImage,     size_t nDestPitch,
-    uint32_t width,       uint32_t height)
+// cudaYUVGetColorspace
+yuvColorspace cudaYUVGetColorspace()
 {
-    int x, y;
-    uint32_t processingPitch = ((width) + 63) & ~63;
-    uint8_t *srcImageU8     = (uint8_t *)srcImage;
+	return yuvCurrentColorspace;
+}
+
 
-    processingPitch = nSourcePitch * 2;
+// cudaNV12SetupColorspace
+cudaError_t cudaNV12SetupColorspace( float hue )
+{
+	yuvColorspace colorspace = yuvCurrentColorspace;
+	colorspace.hue = hue;
+
+	return cudaYUVSetColorspace(colorspace);
+}
 
-    // Pad borders with duplicate pixels, and we multiply by 2 because we process 2 pixels per thread
-    x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
-    y = blockIdx.y *  blockDim.y       +  threadIdx.y;
 
-    if (x >= width)
-    return; //x = width - 1;
+//-------------------------------------------------------------------------------------------------------------------------
+// RTP YUV color space conversion (UYVY), and YUYV from webcams
 
-    if (y >= height)
-    return; // y = height - 1;
+template<bool formatUYVY>
+__global__ void YUVToRGBAf( const uint8_t* srcImage, size_t srcPitch,
+                            float4* dstImage, size_t dstPitch,
+                            int width, int height )
+{
+	// two pixels per thread, which share their chroma
+	const int x = (blockIdx.x * blockDim.x + threadIdx.x) * 2;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
 
-    //printf(">>>>> processingPitch %u, x %u, y %u \n", processingPitch, x, y );
+	if( x >= width || y >= height )
+		return;
 
-    // this steps performs the color conversion
-    uint8_t yuvi[6];
-    float red[2], green[2], blue[2];
+	// UYVY [ U0 | Y0 | V0 | Y1 ]
+	// YUYV [ Y0 | U0 | Y1 | V0 ], read by the byte since the rows needn't be 4-byte aligned
+	const uint8_t* macroPx = srcImage + y * srcPitch + x * 2;
 
-    yuvi[0] = srcImageU8[y * processingPitch + x*2 +1]; //Y0
-    yuvi[1] = srcImageU8[y * processingPitch + x*2 ];//Cb
-    yuvi[2] = srcImageU8[y * processingPitch + x*2 + 2];//Cr
+	const float u  = formatUYVY ? macroPx[0] : macroPx[1];
+	const float v  = formatUYVY ? macroPx[2] : macroPx[3];
+	const float y0 = formatUYVY ? macroPx[1] : macroPx[0];
+	const float y1 = formatUYVY ? macroPx[3] : macroPx[2];
 
-    yuvi[3] = srcImageU8[y * processingPitch + x*2 + 3];//Y1
-    yuvi[4] = srcImageU8[y * processingPitch + x*2];//Cb
-    yuvi[5] = srcImageU8[y * processingPitch + x*2 + 2];//Cr
+	float4* dstRow = (float4*)((uint8_t*)dstImage + y * dstPitch);
 
-    // YUV to RGB Transformation conversion
-    YUV82RGB(&yuvi[0], &red[0], &green[0], &blue[0]);
-    YUV82RGB(&yuvi[3], &red[1], &green[1], &blue[1]);
+	rgbaStore(dstRow, x, yuvToRGB(y0, u, v));
 
-    dstImage[y * width + x]     = make_float4(red[0], green[0], blue[0], 1.0f);
-    dstImage[y * width + x + 1] = make_float4(red[1], green[1], blue[1], 1.0f);
+	if( x + 1 < width )
+		rgbaStore(dstRow, x + 1, yuvToRGB(y1, u, v));
 }
 
-// cudaNV12ToRGBA
-cudaError_t cudaYUVToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+
+// launchYUV422
+template<bool formatUYVY>
+static cudaError_t launchYUV422( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
 {
 	if( !srcDev || !destDev )
 		return cudaErrorInvalidDevicePointer;
@@ -519,19 +500,41 @@ cudaError_t cudaYUVToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, s
 	if( srcPitch == 0 || destPitch == 0 || width == 0 || height == 0 )
 		return cudaErrorInvalidValue;
 
-	if( !nv12ColorspaceSetup )
-		cudaNV12SetupColorspace(0);
+	if( !yuvColorspaceSetup && CUDA_FAILED(cudaYUVSetColorspace(yuvCurrentColorspace)) )
+		return cudaErrorInvalidSymbol;
 
-	const dim3 blockDim(8,8,1);
-	//const dim3 gridDim((width+(2*blockDim.x-1))/(2*blockDim.x), (height+(blockDim.y-1))/blockDim.y, 1);
-	const dim3 gridDim(iDivUp(width,blockDim.x), iDivUp(height, blockDim.y), 1);
+	const dim3 blockDim(32,8,1);
+	const dim3 gridDim(iDivUp(width,blockDim.x*2), iDivUp(height,blockDim.y), 1);
 
-	YUVToRGBAf<<<gridDim, blockDim>>>( (uint32_t*)srcDev, srcPitch, destDev, destPitch, width, height );
+	YUVToRGBAf<formatUYVY><<<gridDim, blockDim>>>( srcDev, srcPitch, destDev, destPitch, width, height );
 
 	return CUDA(cudaGetLastError());
 }
 
+
+// cudaYUVToRGBAf
+cudaError_t cudaYUVToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	// the pitch is counted in pixels, of two bytes each
+	return launchYUV422<true>(srcDev, srcPitch * 2, destDev, destPitch, width, height);
+}
+
 cudaError_t cudaYUVToRGBAf( uint8_t* srcDev, float4* destDev, size_t width, size_t height )
 {
 	return cudaYUVToRGBAf(srcDev, width * sizeof(uint8_t), destDev, width * sizeof(float4), width, height);
 }
+
+
+// cudaUYVYToRGBAf
+cudaError_t cudaUYVYToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchYUV422<true>(srcDev, srcPitch, destDev, destPitch, width, height);
+}
+
+
+// cudaYUYVToRGBAf
+cudaError_t cudaYUYVToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height )
+{
+	return launchYUV422<false>(srcDev, srcPitch, destDev, destPitch, width, height);
+}
+
@@ -68,7 +68,7 @@ __global__ void yuyvToRgba( uchar4* src, int srcAlignedWidth, uchar8* dst, int d
 	const int x = blockIdx.x * blockDim.x + threadIdx.x;
 	const int y = blockIdx.y * blockDim.y + threadIdx.y;
 
-	if( x >= srcAlignedWidth || y >= height )
+	if( x >= width / 2 || y >= height )		// the pitch can be wider than the image
 		return;
 
 	const uchar4 macroPx = src[y * srcAlignedWidth + x];
@@ -151,7 +151,7 @@ __global__ void yuyvToGray( uchar4* src, int srcAlignedWidth, float2* dst, int d
 	const int x = blockIdx.x * blockDim.x + threadIdx.x;
 	const int y = blockIdx.y * blockDim.y + threadIdx.y;
 
-	if( x >= srcAlignedWidth || y >= height )
+	if( x >= width / 2 || y >= height )
 		return;
 
 	const uchar4 macroPx = src[y * srcAlignedWidth + x];
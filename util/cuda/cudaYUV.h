@@ -28,6 +28,81 @@
 #include <stdint.h>
 
 
+//////////////////////////////////////////////////////////////////////////////////
+/// @name YUV colorspace
+/// @ingroup util
+//////////////////////////////////////////////////////////////////////////////////
+
+///@{
+
+/**
+ * Weights of the YCbCr matrix.  SD video is normally BT.601 and HD video BT.709.
+ */
+enum yuvMatrix
+{
+	YUV_BT601 = 0,	/**< ITU-R BT.601 (Kr 0.299, Kb 0.114) */
+	YUV_BT709		/**< ITU-R BT.709 (Kr 0.2126, Kb 0.0722) */
+};
+
+/**
+ * Range of the encoded values.
+ */
+enum yuvRange
+{
+	YUV_RANGE_LIMITED = 0,	/**< Y is 16-235 and CbCr 16-240, as broadcast and most cameras and encoders */
+	YUV_RANGE_FULL			/**< 0-255, as JPEG */
+};
+
+/**
+ * Where the chroma samples of 4:2:0 images are sited, relative to the 2x2 block of luma they cover.
+ */
+enum yuvChromaSiting
+{
+	YUV_CHROMA_LEFT = 0,	/**< in line with the left column, between the rows (MPEG-2, H.264) */
+	YUV_CHROMA_CENTER,		/**< in the center of the block (MPEG-1, JPEG) */
+	YUV_CHROMA_TOPLEFT		/**< on the top-left pixel (BT.2020) */
+};
+
+/**
+ * Describes how YUV images are converted to RGB.
+ */
+struct yuvColorspace
+{
+	yuvMatrix       matrix;
+	yuvRange        range;
+	yuvChromaSiting siting;
+	float           hue;		/**< rotation of the CbCr plane, in radians */
+};
+
+/**
+ * Fill out a yuvColorspace, by default BT.601 limited range with MPEG-2 siting.
+ */
+inline yuvColorspace make_yuvColorspace( yuvMatrix matrix=YUV_BT601, yuvRange range=YUV_RANGE_LIMITED, yuvChromaSiting siting=YUV_CHROMA_LEFT, float hue=0.0f )
+{
+	yuvColorspace c;
+
+	c.matrix = matrix;
+	c.range  = range;
+	c.siting = siting;
+	c.hue    = hue;
+
+	return c;
+}
+
+/**
+ * Set the colorspace that the YUV to RGBA conversions use, which they read from constant memory.
+ * It applies to every conversion in the process, so set it before streaming.
+ */
+cudaError_t cudaYUVSetColorspace( const yuvColorspace& colorspace );
+
+/**
+ * Retrieve the colorspace that the YUV to RGBA conversions use.
+ */
+yuvColorspace cudaYUVGetColorspace();
+
+///@}
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /// @name RGBA to YUV 4:2:0 planar (I420 & YV12)
 /// @ingroup util
@@ -58,6 +133,37 @@ cudaError_t cudaRGBAToYV12( uchar4* input, size_t inputPitch, uint8_t* output, s
 ///@}
 
 
+//////////////////////////////////////////////////////////////////////////////////
+/// @name RGBA to YUV NV12
+/// @ingroup util
+//////////////////////////////////////////////////////////////////////////////////
+
+///@{
+
+/**
+ * Convert an RGBA uchar4 image to NV12, in the colorspace set with cudaYUVSetColorspace().
+ * The CbCr plane follows the Y plane with the same pitch, and holds the average of each 2x2 block.
+ */
+cudaError_t cudaRGBAToNV12( uchar4* input, size_t inputPitch, uint8_t* output, size_t outputPitch, size_t width, size_t height );
+
+/**
+ * Convert an RGBA uchar4 image to NV12, with the pitch of odd widths rounded up to a whole CbCr pair.
+ */
+cudaError_t cudaRGBAToNV12( uchar4* input, uint8_t* output, size_t width, size_t height );
+
+/**
+ * Convert an RGBA float4 image, with pixel intensities from 0 to max_pixel, to NV12.
+ */
+cudaError_t cudaRGBAToNV12( float4* input, size_t inputPitch, uint8_t* output, size_t outputPitch, size_t width, size_t height, float max_pixel=255.0f );
+
+/**
+ * Convert an RGBA float4 image to NV12, with the pitch of odd widths rounded up to a whole CbCr pair.
+ */
+cudaError_t cudaRGBAToNV12( float4* input, uint8_t* output, size_t width, size_t height, float max_pixel=255.0f );
+
+///@}
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /// @name YUV 4:2:2 packed (UYVY & YUYV) to RGBA
 /// @ingroup util
@@ -126,21 +232,30 @@ cudaError_t cudaYUYVToGray( uchar2* input, size_t inputPitch, float* output, siz
 ///@{
 
 /**
- * Convert an NV12 texture (semi-planar 4:2:0) to ARGB uchar4 format.
- * NV12 = 8-bit Y plane followed by an interleaved U/V plane with 2x2 subsampling.
+ * Convert an NV12 texture (semi-planar 4:2:0) to RGBA uchar4 format, in the colorspace
+ * set with cudaYUVSetColorspace().  NV12 = 8-bit Y plane followed by an interleaved U/V
+ * plane with 2x2 subsampling, which is interpolated from where its samples are sited.
  */
 cudaError_t cudaNV12ToRGBA( uint8_t* input, size_t inputPitch, uchar4* output, size_t outputPitch, size_t width, size_t height );
 cudaError_t cudaNV12ToRGBA( uint8_t* input, uchar4* output, size_t width, size_t height );
 
+/**
+ * Convert an NV12 texture to RGBA float4 format (0-255), like cudaNV12ToRGBA().
+ */
 cudaError_t cudaNV12ToRGBAf( uint8_t* input, size_t inputPitch, float4* output, size_t outputPitch, size_t width, size_t height );
 cudaError_t cudaNV12ToRGBAf( uint8_t* input, float4* output, size_t width, size_t height );
 
 /**
- * Setup NV12 color conversion constants.
- * cudaNV12SetupColorspace() isn't necessary for the user to call, it will be
- * called automatically by cudaNV12ToRGBA() with a hue of 0.0.
- * However if you want to setup custom constants (ie with a hue different than 0),
- * then you can call cudaNV12SetupColorspace() at any time, overriding the default.
+ * Convert an I420 image (planar 4:2:0) to RGBA float4 format (0-255), like cudaNV12ToRGBA().
+ * The U and V planes follow the Y plane, with half its pitch (rounded up).
+ */
+cudaError_t cudaI420ToRGBAf( uint8_t* input, size_t inputPitch, float4* output, size_t outputPitch, size_t width, size_t height );
+cudaError_t cudaI420ToRGBAf( uint8_t* input, float4* output, size_t width, size_t height );
+
+/**
+ * Set the hue of the current colorspace (see cudaYUVSetColorspace).
+ * cudaNV12SetupColorspace() isn't necessary for the user to call, the
+ * conversions set up the default colorspace on first use.
  */
 cudaError_t cudaNV12SetupColorspace( float hue = 0.0f );
 
@@ -153,9 +268,25 @@ cudaError_t cudaNV12SetupColorspace( float hue = 0.0f );
 
 ///@{
 
+/**
+ * Convert a UYVY 422 packed image to RGBA float4 (0-255), in the colorspace set with
+ * cudaYUVSetColorspace().  The source pitch is in pixels, of two bytes each.
+ */
 cudaError_t cudaYUVToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height );
 cudaError_t cudaYUVToRGBAf( uint8_t* srcDev, float4* destDev, size_t width, size_t height );
 
+/**
+ * Convert a UYVY 422 packed image to RGBA float4 (0-255), in the colorspace set with
+ * cudaYUVSetColorspace().  Unlike cudaYUVToRGBAf(), the source pitch is in bytes.
+ */
+cudaError_t cudaUYVYToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height );
+
+/**
+ * Convert a YUYV 422 packed image (as from most UVC webcams) to RGBA float4 (0-255), in the
+ * colorspace set with cudaYUVSetColorspace().  The source pitch is in bytes.
+ */
+cudaError_t cudaYUYVToRGBAf( uint8_t* srcDev, size_t srcPitch, float4* destDev, size_t destPitch, size_t width, size_t height );
+
 ///@}
 
 
@@ -21,6 +21,7 @@
  */
  
 #include "glDisplay.h"
+#include "trace.h"
 
 
  
@@ -232,6 +233,7 @@ static timespec timeDiff( const timespec& start, const timespec& end)
 // Refresh
 void glDisplay::EndRender()
 {
+	TRACE_ZONE("swap");
 	glXSwapBuffers(mDisplayX, mWindowX);
 
 	// measure framerate
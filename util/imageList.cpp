@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "imageList.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+
+// constructor
+imageList::imageList()
+{
+
+}
+
+
+// IsImage
+bool imageList::IsImage( const char* filename )
+{
+	if( !filename )
+		return false;
+
+	const char* ext = strrchr(filename, '.');
+
+	if( !ext )
+		return false;
+
+	const char* formats[] = { ".jpg", ".jpeg", ".png", ".bmp", ".ppm", ".pgm", ".tga", ".tif", ".tiff" };
+
+	for( size_t n=0; n < sizeof(formats) / sizeof(formats[0]); n++ )
+		if( strcasecmp(ext, formats[n]) == 0 )
+			return true;
+
+	return false;
+}
+
+
+// Create
+imageList* imageList::Create( const char* path )
+{
+	if( !path )
+		return NULL;
+
+	struct stat st;
+
+	if( stat(path, &st) != 0 )
+	{
+		printf("imageList -- '%s' doesn't exist\n", path);
+		return NULL;
+	}
+
+	imageList* list = new imageList();
+
+	if( S_ISDIR(st.st_mode) )
+	{
+		DIR* dir = opendir(path);
+
+		if( !dir )
+		{
+			printf("imageList -- failed to open directory '%s'\n", path);
+			delete list;
+			return NULL;
+		}
+
+		struct dirent* entry = NULL;
+
+		while( (entry = readdir(dir)) != NULL )
+		{
+			if( entry->d_name[0] != '.' && IsImage(entry->d_name) )
+				list->mPaths.push_back(std::string(path) + "/" + entry->d_name);
+		}
+
+		closedir(dir);
+		std::sort(list->mPaths.begin(), list->mPaths.end());
+	}
+	else if( IsImage(path) )
+	{
+		list->mPaths.push_back(path);
+	}
+	else
+	{
+		FILE* file = fopen(path, "r");
+
+		if( !file )
+		{
+			printf("imageList -- failed to open list '%s'\n", path);
+			delete list;
+			return NULL;
+		}
+
+		// relative paths are resolved against the directory of the list
+		const char* slash = strrchr(path, '/');
+		const std::string base = slash ? std::string(path, slash - path + 1) : std::string();
+
+		char line[4096];
+
+		while( fgets(line, sizeof(line), file) != NULL )
+		{
+			size_t len = strlen(line);
+
+			while( len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' ' || line[len-1] == '\t') )
+				line[--len] = '\0';
+
+			if( len == 0 || line[0] == '#' )
+				continue;
+
+			list->mPaths.push_back(line[0] == '/' ? std::string(line) : base + line);
+		}
+
+		fclose(file);
+	}
+
+	printf("imageList -- found %u images in '%s'\n", list->GetCount(), path);
+	return list;
+}
+
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __IMAGE_LIST_H_
+#define __IMAGE_LIST_H_
+
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+/**
+ * List of image files to process in batch, gathered from either a directory,
+ * a text file listing one image path per line, or a single image.
+ * @ingroup util
+ */
+class imageList
+{
+public:
+	/**
+	 * Gather the images from a directory, a list file or a single image.
+	 * Directories are sorted by filename, and aren't searched recursively.
+	 * Relative paths in a list file are relative to the directory of the list.
+	 * Blank lines and lines starting with '#' are ignored.
+	 */
+	static imageList* Create( const char* path );
+
+	/**
+	 * Retrieve the number of images.
+	 */
+	inline uint32_t GetCount() const					{ return mPaths.size(); }
+
+	/**
+	 * Retrieve the path of an image.
+	 */
+	inline const char* GetPath( uint32_t index ) const	{ return mPaths[index].c_str(); }
+
+	/**
+	 * Query if a filename has the extension of a supported image format.
+	 */
+	static bool IsImage( const char* filename );
+
+protected:
+	imageList();
+
+	std::vector<std::string> mPaths;
+};
+
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "imageWriter.h"
+#include "loadImage.h"
+#include "cudaMappedMemory.h"
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <stdio.h>
+#include <strings.h>
+
+
+// encoding thread
+class imageWriterThread : public QThread
+{
+public:
+	imageWriterThread( imageWriter* writer ) : mWriter(writer)	{ }
+
+protected:
+	virtual void run()		{ mWriter->process(); }
+
+	imageWriter* mWriter;
+};
+
+
+// constructor
+imageWriter::imageWriter()
+{
+	mFormat     = FORMAT_AUTO;
+	mQuality    = -1;
+	mMaxBuffers = 0;
+	mAllocated  = 0;
+	mQueue      = NULL;
+	mMutex      = new QMutex();
+	mIdle       = new QWaitCondition();
+	mPending    = 0;
+	mWritten    = 0;
+	mDropped    = 0;
+	mFailed     = 0;
+}
+
+
+// destructor
+imageWriter::~imageWriter()
+{
+	if( mQueue != NULL )
+		mQueue->Close();
+
+	for( size_t n=0; n < mThreads.size(); n++ )
+	{
+		mThreads[n]->wait();
+		delete mThreads[n];
+	}
+
+	for( size_t n=0; n < mBuffers.size(); n++ )
+		CUDA(cudaFreeHost(mBuffers[n].buffer));
+
+	if( mWritten > 0 || mDropped > 0 || mFailed > 0 )
+		printf("imageWriter -- wrote %u images (%u dropped, %u failed)\n", mWritten, mDropped, mFailed);
+
+	delete mQueue;
+	delete mIdle;
+	delete mMutex;
+}
+
+
+// Create
+imageWriter* imageWriter::Create( uint32_t threads, uint32_t queueDepth, Format format, int quality )
+{
+	if( threads == 0 )
+		threads = 1;
+
+	if( queueDepth == 0 )
+		queueDepth = 1;
+
+	imageWriter* writer = new imageWriter();
+
+	writer->mFormat     = format;
+	writer->mQuality    = quality;
+	writer->mMaxBuffers = queueDepth + threads;
+	writer->mQueue      = new threadQueue<writeJob*>(queueDepth);
+
+	for( uint32_t n=0; n < threads; n++ )
+	{
+		writer->mThreads.push_back(new imageWriterThread(writer));
+		writer->mThreads[n]->start();
+	}
+
+	return writer;
+}
+
+
+// ParseFormat
+imageWriter::Format imageWriter::ParseFormat( const char* str )
+{
+	if( !str )
+		return FORMAT_AUTO;
+
+	if( strcasecmp(str, "png") == 0 )
+		return FORMAT_PNG;
+	else if( strcasecmp(str, "jpg") == 0 || strcasecmp(str, "jpeg") == 0 )
+		return FORMAT_JPEG;
+	else if( strcasecmp(str, "raw") == 0 )
+		return FORMAT_RAW;
+
+	return FORMAT_AUTO;
+}
+
+
+// allocBuffer
+bool imageWriter::allocBuffer( writeJob* job, size_t size )
+{
+	mMutex->lock();
+
+	// take the smallest free buffer that fits
+	int best = -1;
+
+	for( size_t n=0; n < mBuffers.size(); n++ )
+	{
+		if( mBuffers[n].bufferSize >= size && (best < 0 || mBuffers[n].bufferSize < mBuffers[best].bufferSize) )
+			best = n;
+	}
+
+	if( best >= 0 )
+	{
+		job->buffer     = mBuffers[best].buffer;
+		job->bufferSize = mBuffers[best].bufferSize;
+
+		mBuffers.erase(mBuffers.begin() + best);
+		mMutex->unlock();
+		return true;
+	}
+
+	// replace a free buffer that's too small, or allocate another if under the limit
+	float4* smaller = NULL;
+
+	if( mBuffers.size() > 0 )
+	{
+		smaller = mBuffers.back().buffer;
+		mBuffers.pop_back();
+	}
+	else if( mAllocated < mMaxBuffers )
+	{
+		mAllocated++;
+	}
+	else
+	{
+		mMutex->unlock();
+		return false;
+	}
+
+	mMutex->unlock();
+
+	if( smaller != NULL )
+		CUDA(cudaFreeHost(smaller));
+
+	void* gpu = NULL;
+
+	if( !cudaAllocMapped((void**)&job->buffer, &gpu, size) )
+	{
+		mMutex->lock();
+		mAllocated--;
+		mMutex->unlock();
+		return false;
+	}
+
+	job->bufferSize = size;
+	return true;
+}
+
+
+// freeBuffer
+void imageWriter::freeBuffer( writeJob* job )
+{
+	mMutex->lock();
+
+	writeJob buffer;
+
+	buffer.buffer     = job->buffer;
+	buffer.bufferSize = job->bufferSize;
+
+	mBuffers.push_back(buffer);
+	mMutex->unlock();
+}
+
+
+// Write
+bool imageWriter::Write( const char* filename, const float4* image, int width, int height, float max_pixel )
+{
+	if( !filename || !image || width <= 0 || height <= 0 )
+		return false;
+
+	const size_t size = width * height * sizeof(float4);
+
+	writeJob* job = new writeJob();
+
+	job->filename  = filename;
+	job->width     = width;
+	job->height    = height;
+	job->max_pixel = max_pixel;
+
+	// drop the image instead of waiting for a buffer
+	if( !allocBuffer(job, size) )
+	{
+		mMutex->lock();
+		mDropped++;
+		mMutex->unlock();
+
+		delete job;
+		return false;
+	}
+
+	if( CUDA_FAILED(cudaMemcpy(job->buffer, image, size, cudaMemcpyDeviceToHost)) )
+	{
+		freeBuffer(job);
+		delete job;
+		return false;
+	}
+
+	mMutex->lock();
+	mPending++;
+	mMutex->unlock();
+
+	if( !mQueue->TryPush(job) )
+	{
+		freeBuffer(job);
+		delete job;
+
+		mMutex->lock();
+		mPending--;
+		mDropped++;
+		mIdle->wakeAll();
+		mMutex->unlock();
+		return false;
+	}
+
+	return true;
+}
+
+
+// Flush
+void imageWriter::Flush()
+{
+	mMutex->lock();
+
+	while( mPending > 0 )
+		mIdle->wait(mMutex);
+
+	mMutex->unlock();
+}
+
+
+// process
+void imageWriter::process()
+{
+	writeJob* job = NULL;
+
+	while( mQueue->Pop(&job) )
+	{
+		const bool result = encode(job);
+
+		if( !result )
+			printf("imageWriter -- failed to write '%s'\n", job->filename.c_str());
+
+		freeBuffer(job);
+		delete job;
+
+		mMutex->lock();
+
+		if( result )
+			mWritten++;
+		else
+			mFailed++;
+
+		mPending--;
+		mIdle->wakeAll();
+		mMutex->unlock();
+	}
+}
+
+
+// encode
+bool imageWriter::encode( const writeJob* job )
+{
+	if( mFormat == FORMAT_RAW )
+	{
+		FILE* file = fopen(job->filename.c_str(), "wb");
+
+		if( !file )
+			return false;
+
+		const size_t size = job->width * job->height * sizeof(float4);
+		const bool result = (fwrite(job->buffer, 1, size, file) == size);
+
+		return (fclose(file) == 0) && result;
+	}
+
+	const char* format = NULL;
+
+	if( mFormat == FORMAT_PNG )
+		format = "PNG";
+	else if( mFormat == FORMAT_JPEG )
+		format = "JPEG";
+
+	return saveImageRGBA(job->filename.c_str(), job->buffer, job->width, job->height, job->max_pixel, mQuality, format);
+}
+
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __IMAGE_WRITER_H_
+#define __IMAGE_WRITER_H_
+
+
+#include "threadQueue.h"
+#include "cudaUtility.h"
+
+#include <string>
+#include <vector>
+
+
+class QThread;
+class QMutex;
+class QWaitCondition;
+
+
+/**
+ * Saves images to disk in the background, so that the encoding doesn't stall
+ * the capture or inference loops.
+ *
+ * Write() copies the image from CUDA memory into a recycled pinned buffer and
+ * queues it to a pool of worker threads, which encode it.  When the queue is full
+ * or every buffer is in use, the image is dropped and counted instead of blocking.
+ *
+ * @ingroup util
+ */
+class imageWriter
+{
+public:
+	/**
+	 * Encoders
+	 */
+	enum Format
+	{
+		FORMAT_AUTO = 0,	/**< deduced from the file extension */
+		FORMAT_PNG,		/**< lossless PNG */
+		FORMAT_JPEG,		/**< JPEG, with the configured quality */
+		FORMAT_RAW		/**< the float4 RGBA pixels without a header, the fastest to write */
+	};
+
+	/**
+	 * Create the writer and start its threads.
+	 * @param threads number of encoding threads.
+	 * @param queueDepth maximum number of images waiting to be encoded.
+	 * @param format the encoder to use.
+	 * @param quality compression quality from 0 to 100, or -1 for the default of the format.
+	 */
+	static imageWriter* Create( uint32_t threads=2, uint32_t queueDepth=8, Format format=FORMAT_AUTO, int quality=-1 );
+
+	/**
+	 * Parse the encoder from a string ("auto", "png", "jpg"/"jpeg" or "raw")
+	 * @returns FORMAT_AUTO if the string wasn't recognized.
+	 */
+	static Format ParseFormat( const char* str );
+
+	/**
+	 * Finish the queued images and stop the threads.
+	 */
+	~imageWriter();
+
+	/**
+	 * Queue an image to be saved.  Returns immediately after copying the image.
+	 * @param filename path of the file to write.
+	 * @param image RGBA image in CUDA device memory (or shared CPU/GPU memory)
+	 * @param max_pixel the pixel intensity that's saved as 255.
+	 * @returns true if the image was queued, or false if it was dropped.
+	 */
+	bool Write( const char* filename, const float4* image, int width, int height, float max_pixel=255.0f );
+
+	/**
+	 * Wait for the queued images to be written.
+	 */
+	void Flush();
+
+	/**
+	 * Retrieve the number of images written successfully.
+	 */
+	inline uint32_t GetWritten() const			{ return mWritten; }
+
+	/**
+	 * Retrieve the number of images dropped because the writer was saturated.
+	 */
+	inline uint32_t GetDropped() const			{ return mDropped; }
+
+	/**
+	 * Retrieve the number of images that failed to be encoded or written.
+	 */
+	inline uint32_t GetFailed() const			{ return mFailed; }
+
+	/**
+	 * Retrieve the encoder.
+	 */
+	inline Format GetFormat() const			{ return mFormat; }
+
+protected:
+	imageWriter();
+
+	struct writeJob
+	{
+		std::string filename;
+		float4*     buffer;
+		size_t      bufferSize;
+		int         width;
+		int         height;
+		float       max_pixel;
+	};
+
+	friend class imageWriterThread;
+
+	void process();
+	bool encode( const writeJob* job );
+	bool allocBuffer( writeJob* job, size_t size );
+	void freeBuffer( writeJob* job );
+
+	Format   mFormat;
+	int      mQuality;
+	uint32_t mMaxBuffers;
+	uint32_t mAllocated;
+
+	std::vector<QThread*>  mThreads;
+	threadQueue<writeJob*>* mQueue;
+	std::vector<writeJob>  mBuffers;	/**< free buffers available for recycling */
+
+	QMutex*         mMutex;
+	QWaitCondition* mIdle;
+	uint32_t        mPending;
+
+	volatile uint32_t mWritten;
+	volatile uint32_t mDropped;
+	volatile uint32_t mFailed;
+};
+
+
+#endif
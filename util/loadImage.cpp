@@ -24,10 +24,258 @@
 #include "cudaMappedMemory.h"
 
 #include <QImage>
+#include <QImageReader>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 
-bool saveImageRGBA( const char* filename, float4* cpu, int width, int height, float max_pixel )
+/*
+ * The images are converted to QImage::Format_ARGB32 and then processed a whole scanline
+ * at a time, instead of calling QImage::pixel() for every pixel.  On little-endian
+ * systems each pixel of the scanline is stored in memory as the bytes B,G,R,A.
+ */
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN && (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define LOAD_IMAGE_SIMD
+#endif
+
+
+// convert a scanline of ARGB32 pixels to float4 RGBA
+static void scanlineToRGBA( const QRgb* in, float4* out, uint32_t width )
+{
+	uint32_t x = 0;
+
+#if defined(LOAD_IMAGE_SIMD) && defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+
+	for( ; x + 4 <= width; x += 4 )
+	{
+		const __m128i px = _mm_loadu_si128((const __m128i*)(in + x));
+		const __m128i lo = _mm_unpacklo_epi8(px, zero);
+		const __m128i hi = _mm_unpackhi_epi8(px, zero);
+
+		// BGRA -> RGBA
+		const __m128 p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+		const __m128 p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+		const __m128 p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+		const __m128 p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+
+		float* dst = (float*)(out + x);
+
+		_mm_storeu_ps(dst + 0,  _mm_shuffle_ps(p0, p0, _MM_SHUFFLE(3,0,1,2)));
+		_mm_storeu_ps(dst + 4,  _mm_shuffle_ps(p1, p1, _MM_SHUFFLE(3,0,1,2)));
+		_mm_storeu_ps(dst + 8,  _mm_shuffle_ps(p2, p2, _MM_SHUFFLE(3,0,1,2)));
+		_mm_storeu_ps(dst + 12, _mm_shuffle_ps(p3, p3, _MM_SHUFFLE(3,0,1,2)));
+	}
+#elif defined(LOAD_IMAGE_SIMD)
+	for( ; x + 8 <= width; x += 8 )
+	{
+		const uint8x8x4_t px = vld4_u8((const uint8_t*)(in + x));
+
+		const uint16x8_t b = vmovl_u8(px.val[0]);
+		const uint16x8_t g = vmovl_u8(px.val[1]);
+		const uint16x8_t r = vmovl_u8(px.val[2]);
+		const uint16x8_t a = vmovl_u8(px.val[3]);
+
+		float32x4x4_t lo;
+		float32x4x4_t hi;
+
+		lo.val[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(r)));
+		lo.val[1] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(g)));
+		lo.val[2] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(b)));
+		lo.val[3] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(a)));
+
+		hi.val[0] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(r)));
+		hi.val[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(g)));
+		hi.val[2] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(b)));
+		hi.val[3] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(a)));
+
+		vst4q_f32((float*)(out + x), lo);
+		vst4q_f32((float*)(out + x + 4), hi);
+	}
+#endif
+
+	for( ; x < width; x++ )
+	{
+		const QRgb rgb = in[x];
+		out[x] = make_float4(float(qRed(rgb)), float(qGreen(rgb)), float(qBlue(rgb)), float(qAlpha(rgb)));
+	}
+}
+
+
+// convert a scanline of ARGB32 pixels to band-sequential planes, subtracting the mean
+static void scanlineToPlanar( const QRgb* in, float* p0, float* p1, float* p2, uint32_t width, const float3& mean, bool bgr )
+{
+	uint32_t x = 0;
+
+	// the planes are ordered B,G,R for BGR, and R,G,B otherwise
+	float* r = bgr ? p2 : p0;
+	float* g = p1;
+	float* b = bgr ? p0 : p2;
+
+	const float mean_r = bgr ? mean.z : mean.x;
+	const float mean_g = mean.y;
+	const float mean_b = bgr ? mean.x : mean.z;
+
+#if defined(LOAD_IMAGE_SIMD) && defined(__SSE2__)
+	const __m128i mask = _mm_set1_epi32(0xFF);
+
+	const __m128 vmean_r = _mm_set1_ps(mean_r);
+	const __m128 vmean_g = _mm_set1_ps(mean_g);
+	const __m128 vmean_b = _mm_set1_ps(mean_b);
+
+	for( ; x + 4 <= width; x += 4 )
+	{
+		const __m128i px = _mm_loadu_si128((const __m128i*)(in + x));
+
+		_mm_storeu_ps(b + x, _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(px, mask)), vmean_b));
+		_mm_storeu_ps(g + x, _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), mask)), vmean_g));
+		_mm_storeu_ps(r + x, _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), mask)), vmean_r));
+	}
+#elif defined(LOAD_IMAGE_SIMD)
+	const float32x4_t vmean_r = vdupq_n_f32(mean_r);
+	const float32x4_t vmean_g = vdupq_n_f32(mean_g);
+	const float32x4_t vmean_b = vdupq_n_f32(mean_b);
+
+	for( ; x + 8 <= width; x += 8 )
+	{
+		const uint8x8x4_t px = vld4_u8((const uint8_t*)(in + x));
+
+		const uint16x8_t vb = vmovl_u8(px.val[0]);
+		const uint16x8_t vg = vmovl_u8(px.val[1]);
+		const uint16x8_t vr = vmovl_u8(px.val[2]);
+
+		vst1q_f32(b + x,     vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(vb))), vmean_b));
+		vst1q_f32(b + x + 4, vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(vb))), vmean_b));
+		vst1q_f32(g + x,     vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(vg))), vmean_g));
+		vst1q_f32(g + x + 4, vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(vg))), vmean_g));
+		vst1q_f32(r + x,     vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(vr))), vmean_r));
+		vst1q_f32(r + x + 4, vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(vr))), vmean_r));
+	}
+#endif
+
+	for( ; x < width; x++ )
+	{
+		const QRgb rgb = in[x];
+
+		r[x] = float(qRed(rgb))   - mean_r;
+		g[x] = float(qGreen(rgb)) - mean_g;
+		b[x] = float(qBlue(rgb))  - mean_b;
+	}
+}
+
+
+// convert a scanline of float4 RGBA to RGB32 pixels, clamping to [0,255]
+static void scanlineFromRGBA( const float4* in, QRgb* out, uint32_t width, float scale )
+{
+	uint32_t x = 0;
+
+#if defined(LOAD_IMAGE_SIMD) && defined(__SSE2__)
+	const __m128  vscale = _mm_setr_ps(scale, scale, scale, 0.0f);
+	const __m128i alpha  = _mm_set1_epi32(0xFF000000);
+
+	for( ; x + 4 <= width; x += 4 )
+	{
+		const float* src = (const float*)(in + x);
+
+		// RGBA -> BGRA, with the alpha set to opaque afterwards
+		__m128 p0 = _mm_mul_ps(_mm_loadu_ps(src + 0),  vscale);
+		__m128 p1 = _mm_mul_ps(_mm_loadu_ps(src + 4),  vscale);
+		__m128 p2 = _mm_mul_ps(_mm_loadu_ps(src + 8),  vscale);
+		__m128 p3 = _mm_mul_ps(_mm_loadu_ps(src + 12), vscale);
+
+		p0 = _mm_shuffle_ps(p0, p0, _MM_SHUFFLE(3,0,1,2));
+		p1 = _mm_shuffle_ps(p1, p1, _MM_SHUFFLE(3,0,1,2));
+		p2 = _mm_shuffle_ps(p2, p2, _MM_SHUFFLE(3,0,1,2));
+		p3 = _mm_shuffle_ps(p3, p3, _MM_SHUFFLE(3,0,1,2));
+
+		// truncate like the integer conversion of qRgb(), then saturate to 8-bit
+		const __m128i lo = _mm_packs_epi32(_mm_cvttps_epi32(p0), _mm_cvttps_epi32(p1));
+		const __m128i hi = _mm_packs_epi32(_mm_cvttps_epi32(p2), _mm_cvttps_epi32(p3));
+
+		_mm_storeu_si128((__m128i*)(out + x), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+	}
+#elif defined(LOAD_IMAGE_SIMD)
+	const float32x4_t vscale = vdupq_n_f32(scale);
+
+	for( ; x + 8 <= width; x += 8 )
+	{
+		const float32x4x4_t lo = vld4q_f32((const float*)(in + x));
+		const float32x4x4_t hi = vld4q_f32((const float*)(in + x + 4));
+
+		// truncate like the integer conversion of qRgb(), then saturate to 8-bit
+		uint8x8x4_t bgra;
+
+		bgra.val[0] = vqmovn_u16(vcombine_u16(vqmovn_u32(vcvtq_u32_f32(vmulq_f32(lo.val[2], vscale))),
+									   vqmovn_u32(vcvtq_u32_f32(vmulq_f32(hi.val[2], vscale)))));
+		bgra.val[1] = vqmovn_u16(vcombine_u16(vqmovn_u32(vcvtq_u32_f32(vmulq_f32(lo.val[1], vscale))),
+									   vqmovn_u32(vcvtq_u32_f32(vmulq_f32(hi.val[1], vscale)))));
+		bgra.val[2] = vqmovn_u16(vcombine_u16(vqmovn_u32(vcvtq_u32_f32(vmulq_f32(lo.val[0], vscale))),
+									   vqmovn_u32(vcvtq_u32_f32(vmulq_f32(hi.val[0], vscale)))));
+		bgra.val[3] = vdup_n_u8(0xFF);
+
+		vst4_u8((uint8_t*)(out + x), bgra);
+	}
+#endif
+
+	for( ; x < width; x++ )
+	{
+		const float4 px = in[x];
+
+		const int r = int(px.x * scale);
+		const int g = int(px.y * scale);
+		const int b = int(px.z * scale);
+
+		out[x] = qRgb(r < 0 ? 0 : (r > 255 ? 255 : r), 
+				    g < 0 ? 0 : (g > 255 ? 255 : g), 
+				    b < 0 ? 0 : (b > 255 ? 255 : b));
+	}
+}
+
+
+// load an image in ARGB32 format, optionally rescaling it
+static bool loadImage( const char* filename, QImage& qImg, int* width, int* height )
+{
+	if( !qImg.load(filename) )
+	{
+		printf("failed to load image %s\n", filename);
+		return false;
+	}
+
+	if( *width != 0 && *height != 0 )
+		qImg = qImg.scaled(*width, *height, Qt::IgnoreAspectRatio);
+
+	if( qImg.format() != QImage::Format_ARGB32 )
+		qImg = qImg.convertToFormat(QImage::Format_ARGB32);
+
+	return !qImg.isNull();
+}
+
+
+// loadImageSize
+bool loadImageSize( const char* filename, int* width, int* height )
+{
+	if( !filename || !width || !height )
+		return false;
+
+	// only the header is read
+	QImageReader reader(filename);
+	const QSize size = reader.size();
+
+	if( !size.isValid() )
+		return false;
+
+	*width  = size.width();
+	*height = size.height();
+	return true;
+}
+
+
+// saveImageRGBA
+bool saveImageRGBA( const char* filename, float4* cpu, int width, int height, float max_pixel, int quality, const char* format )
 {
 	if( !filename || !cpu || !width || !height )
 	{
@@ -39,20 +287,13 @@ bool saveImageRGBA( const char* filename, float4* cpu, int width, int height, fl
 	QImage img(width, height, QImage::Format_RGB32);
 
 	for( int y=0; y < height; y++ )
-	{
-		for( int x=0; x < width; x++ )
-		{
-			const float4 px = cpu[y * width + x];
-			//printf("%03u %03u   %f\n", x, y, normPx);
-			img.setPixel(x, y, qRgb(px.x * scale, px.y * scale, px.z * scale));
-		}
-	}
+		scanlineFromRGBA(cpu + y * width, (QRgb*)img.scanLine(y), width, scale);
 
 
 	/*
 	 * save file
 	 */
-	if( !img.save(filename/*, "PNG", 100*/) )
+	if( !img.save(filename, format, quality) )
 	{
 		printf("failed to save %ix%i output image to %s\n", width, height, filename);
 		return false;
@@ -63,9 +304,9 @@ bool saveImageRGBA( const char* filename, float4* cpu, int width, int height, fl
 
 
 // loadImageRGBA
-bool loadImageRGBA( const char* filename, float4** cpu, float4** gpu, int* width, int* height )
+bool loadImageRGBA( const char* filename, float4* cpu, size_t size, int* width, int* height )
 {
-	if( !filename || !cpu || !gpu || !width || !height )
+	if( !filename || !cpu || !width || !height )
 	{
 		printf("loadImageRGBA - invalid parameter\n");
 		return false;
@@ -74,44 +315,21 @@ bool loadImageRGBA( const char* filename, float4** cpu, float4** gpu, int* width
 	// load original image
 	QImage qImg;
 
-	if( !qImg.load(filename) )
-	{
-		printf("failed to load image %s\n", filename);
+	if( !loadImage(filename, qImg, width, height) )
 		return false;
-	}
 
-	if( *width != 0 && *height != 0 )
-		qImg = qImg.scaled(*width, *height, Qt::IgnoreAspectRatio);
-	
 	const uint32_t imgWidth  = qImg.width();
 	const uint32_t imgHeight = qImg.height();
-	const uint32_t imgPixels = imgWidth * imgHeight;
 	const size_t   imgSize   = imgWidth * imgHeight * sizeof(float) * 4;
 
-	printf("loaded image  %s  (%u x %u)  %zu bytes\n", filename, imgWidth, imgHeight, imgSize);
-
-	// allocate buffer for the image
-	if( !cudaAllocMapped((void**)cpu, (void**)gpu, imgSize) )
+	if( imgSize > size )
 	{
-		printf(LOG_CUDA "failed to allocated %zu bytes for image %s\n", imgSize, filename);
+		printf("loadImageRGBA - image %s (%u x %u) doesn't fit in the %zu byte buffer\n", filename, imgWidth, imgHeight, size);
 		return false;
 	}
 
-	float4* cpuPtr = *cpu;
-	
 	for( uint32_t y=0; y < imgHeight; y++ )
-	{
-		for( uint32_t x=0; x < imgWidth; x++ )
-		{
-			const QRgb rgb  = qImg.pixel(x,y);
-			const float4 px = make_float4(float(qRed(rgb)), 
-										  float(qGreen(rgb)), 
-										  float(qBlue(rgb)),
-										  float(qAlpha(rgb)));
-			
-			cpuPtr[y*imgWidth+x] = px;
-		}
-	}
+		scanlineToRGBA((const QRgb*)qImg.constScanLine(y), cpu + y * imgWidth, imgWidth);
 	
 	*width  = imgWidth;
 	*height = imgHeight;	
@@ -119,31 +337,24 @@ bool loadImageRGBA( const char* filename, float4** cpu, float4** gpu, int* width
 }
 
 
-// loadImageRGB
-bool loadImageRGB( const char* filename, float3** cpu, float3** gpu, int* width, int* height, const float3& mean )
+// loadImageRGBA
+bool loadImageRGBA( const char* filename, float4** cpu, float4** gpu, int* width, int* height )
 {
 	if( !filename || !cpu || !gpu || !width || !height )
 	{
-		printf("loadImageRGB - invalid parameter\n");
+		printf("loadImageRGBA - invalid parameter\n");
 		return false;
 	}
 	
 	// load original image
 	QImage qImg;
 
-	if( !qImg.load(filename) )
-	{
-		printf("failed to load image %s\n", filename);
+	if( !loadImage(filename, qImg, width, height) )
 		return false;
-	}
-
-	if( *width != 0 && *height != 0 )
-		qImg = qImg.scaled(*width, *height, Qt::IgnoreAspectRatio);
 	
 	const uint32_t imgWidth  = qImg.width();
 	const uint32_t imgHeight = qImg.height();
-	const uint32_t imgPixels = imgWidth * imgHeight;
-	const size_t   imgSize   = imgWidth * imgHeight * sizeof(float) * 3;
+	const size_t   imgSize   = imgWidth * imgHeight * sizeof(float) * 4;
 
 	printf("loaded image  %s  (%u x %u)  %zu bytes\n", filename, imgWidth, imgHeight, imgSize);
 
@@ -154,51 +365,23 @@ bool loadImageRGB( const char* filename, float3** cpu, float3** gpu, int* width,
 		return false;
 	}
 
-	float* cpuPtr = (float*)*cpu;
-	
 	for( uint32_t y=0; y < imgHeight; y++ )
-	{
-		for( uint32_t x=0; x < imgWidth; x++ )
-		{
-			const QRgb rgb  = qImg.pixel(x,y);
-			const float mul = 1.0f; 	//1.0f / 255.0f;
-			const float3 px = make_float3((float(qRed(rgb))   - mean.x) * mul, 
-										  (float(qGreen(rgb)) - mean.y) * mul, 
-										  (float(qBlue(rgb))  - mean.z) * mul );
-			
-			// note:  caffe/GIE is band-sequential (as opposed to the typical Band Interleaved by Pixel)
-			cpuPtr[imgPixels * 0 + y * imgWidth + x] = px.x; 
-			cpuPtr[imgPixels * 1 + y * imgWidth + x] = px.y; 
-			cpuPtr[imgPixels * 2 + y * imgWidth + x] = px.z; 
-		}
-	}
-		
+		scanlineToRGBA((const QRgb*)qImg.constScanLine(y), *cpu + y * imgWidth, imgWidth);
+	
 	*width  = imgWidth;
-	*height = imgHeight;
+	*height = imgHeight;	
 	return true;
 }
 
 
-// loadImageBGR
-bool loadImageBGR( const char* filename, float3** cpu, float3** gpu, int* width, int* height, const float3& mean )
+// load an image into band-sequential RGB or BGR planes
+static bool loadImagePlanar( const char* filename, float3** cpu, float3** gpu, int* width, int* height, const float3& mean, bool bgr )
 {
-	if( !filename || !cpu || !gpu || !width || !height )
-	{
-		printf("loadImageRGB - invalid parameter\n");
-		return false;
-	}
-	
 	// load original image
 	QImage qImg;
 
-	if( !qImg.load(filename) )
-	{
-		printf("failed to load image %s\n", filename);
+	if( !loadImage(filename, qImg, width, height) )
 		return false;
-	}
-
-	if( *width != 0 && *height != 0 )
-		qImg = qImg.scaled(*width, *height, Qt::IgnoreAspectRatio);
 	
 	const uint32_t imgWidth  = qImg.width();
 	const uint32_t imgHeight = qImg.height();
@@ -216,22 +399,43 @@ bool loadImageBGR( const char* filename, float3** cpu, float3** gpu, int* width,
 
 	float* cpuPtr = (float*)*cpu;
 	
+	// note:  caffe/GIE is band-sequential (as opposed to the typical Band Interleaved by Pixel)
 	for( uint32_t y=0; y < imgHeight; y++ )
 	{
-		for( uint32_t x=0; x < imgWidth; x++ )
-		{
-			const QRgb rgb  = qImg.pixel(x,y);
-			const float mul = 1.0f; 	//1.0f / 255.0f;
-			const float3 px = make_float3((float(qBlue(rgb))  - mean.x) * mul, 
-										  (float(qGreen(rgb)) - mean.y) * mul, 
-										  (float(qRed(rgb))   - mean.z) * mul );
-			
-			// note:  caffe/GIE is band-sequential (as opposed to the typical Band Interleaved by Pixel)
-			cpuPtr[imgPixels * 0 + y * imgWidth + x] = px.x; 
-			cpuPtr[imgPixels * 1 + y * imgWidth + x] = px.y; 
-			cpuPtr[imgPixels * 2 + y * imgWidth + x] = px.z; 
-		}
-	}
-			
+		const uint32_t offset = y * imgWidth;
+
+		scanlineToPlanar((const QRgb*)qImg.constScanLine(y), cpuPtr + imgPixels * 0 + offset, 
+					  cpuPtr + imgPixels * 1 + offset, cpuPtr + imgPixels * 2 + offset, 
+					  imgWidth, mean, bgr);
+	}
+		
+	*width  = imgWidth;
+	*height = imgHeight;
 	return true;
 }
+
+
+// loadImageRGB
+bool loadImageRGB( const char* filename, float3** cpu, float3** gpu, int* width, int* height, const float3& mean )
+{
+	if( !filename || !cpu || !gpu || !width || !height )
+	{
+		printf("loadImageRGB - invalid parameter\n");
+		return false;
+	}
+
+	return loadImagePlanar(filename, cpu, gpu, width, height, mean, false);
+}
+
+
+// loadImageBGR
+bool loadImageBGR( const char* filename, float3** cpu, float3** gpu, int* width, int* height, const float3& mean )
+{
+	if( !filename || !cpu || !gpu || !width || !height )
+	{
+		printf("loadImageBGR - invalid parameter\n");
+		return false;
+	}
+
+	return loadImagePlanar(filename, cpu, gpu, width, height, mean, true);
+}
@@ -42,11 +42,35 @@
 bool loadImageRGBA( const char* filename, float4** cpu, float4** gpu, int* width, int* height );
 
 
+/**
+ * Load a color image from disk into a buffer provided by the caller, without allocating memory.
+ * This allows the buffers to be recycled between images, i.e. from a pool of cudaAllocMapped() memory.
+ *
+ * @param filename Path to the image file on disk.
+ * @param cpu Pointer to the buffer that receives the RGBA image.
+ * @param size Size of the buffer in bytes.  Loading fails if the image doesn't fit.
+ * @param width Variable containing width in pixels of the image.
+ * @param height Variable containing height in pixels of the image.
+ *
+ * @ingroup util
+ */
+bool loadImageRGBA( const char* filename, float4* cpu, size_t size, int* width, int* height );
+
+
+/**
+ * Retrieve the dimensions of an image from its header, without decoding it.
+ * @ingroup util
+ */
+bool loadImageSize( const char* filename, int* width, int* height );
+
+
 /**
  * Save an image to disk
+ * @param quality compression quality from 0 to 100, or -1 for the default of the format.
+ * @param format image format (i.e. "PNG" or "JPEG"), or NULL to deduce it from the file extension.
  * @ingroup util
  */
-bool saveImageRGBA( const char* filename, float4* cpu, int width, int height, float max_pixel=255.0f );
+bool saveImageRGBA( const char* filename, float4* cpu, int width, int height, float max_pixel=255.0f, int quality=-1, const char* format=NULL );
 
 
 /**
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "displaySink.h"
+#include "videoOutput.h"
+#include "glSink.h"
+#include "shmSink.h"
+
+#include "commandLine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+// discards the frames
+class nullSink : public displaySink
+{
+public:
+	virtual uint32_t GetFormats() const		{ return FORMAT_NONE; }
+
+	virtual bool Render( float4* image, uint32_t width, uint32_t height, float max_pixel )		{ return true; }
+};
+
+
+// forwards the frames to each of its sinks, and needs what any of them needs
+class sinkGroup : public displaySink
+{
+public:
+	virtual ~sinkGroup()
+	{
+		for( size_t n=0; n < mSinks.size(); n++ )
+			delete mSinks[n];
+	}
+
+	virtual uint32_t GetFormats() const
+	{
+		uint32_t formats = FORMAT_NONE;
+
+		for( size_t n=0; n < mSinks.size(); n++ )
+			formats |= mSinks[n]->GetFormats();
+
+		return formats;
+	}
+
+	virtual bool Render( float4* image, uint32_t width, uint32_t height, float max_pixel )
+	{
+		bool result = true;
+
+		for( size_t n=0; n < mSinks.size(); n++ )
+		{
+			if( !mSinks[n]->Render(image, width, height, max_pixel) )
+				result = false;
+		}
+
+		return result;
+	}
+
+	virtual void SetStatus( const char* str )
+	{
+		for( size_t n=0; n < mSinks.size(); n++ )
+			mSinks[n]->SetStatus(str);
+	}
+
+	inline void Add( displaySink* sink )		{ mSinks.push_back(sink); }
+
+protected:
+	std::vector<displaySink*> mSinks;
+};
+
+
+// Create
+displaySink* displaySink::Create( const char* uri, uint32_t width, uint32_t height )
+{
+	if( !uri || strlen(uri) == 0 )
+		return NULL;
+
+	if( strcmp(uri, "display://") == 0 )
+		return glSink::Create(width, height);
+	else if( strcmp(uri, "null://") == 0 )
+		return new nullSink();
+	else if( strncmp(uri, "shm://", 6) == 0 )
+		return shmSink::Create(uri + 6, width, height);
+
+	return videoOutput::Create(uri, width, height);
+}
+
+
+// Create
+displaySink* displaySink::Create( int argc, char** argv, uint32_t width, uint32_t height )
+{
+	commandLine cmdLine(argc, argv);
+
+	std::vector<std::string> uris;
+
+	const char* list = cmdLine.GetString("sink");
+
+	if( list != NULL )
+	{
+		std::string str = list;
+		size_t start = 0;
+
+		while( start <= str.size() )
+		{
+			const size_t end = std::min(str.find(',', start), str.size());
+
+			if( end > start )
+				uris.push_back(str.substr(start, end - start));
+
+			start = end + 1;
+		}
+	}
+	else if( !cmdLine.GetFlag("headless") && getenv("DISPLAY") != NULL )
+	{
+		// without an X server, the window would fail anyway
+		uris.push_back("display://");
+	}
+
+	sinkGroup* group = new sinkGroup();
+
+	for( size_t n=0; n < uris.size(); n++ )
+	{
+		displaySink* sink = Create(uris[n].c_str(), width, height);
+
+		if( !sink )
+		{
+			printf("displaySink -- failed to create sink '%s'\n", uris[n].c_str());
+			delete group;
+			return NULL;
+		}
+
+		group->Add(sink);
+	}
+
+	if( videoOutput::IsRequested(argc, argv) )
+	{
+		videoOutput* output = videoOutput::Create(argc, argv, width, height);
+
+		if( !output )
+		{
+			delete group;
+			return NULL;
+		}
+
+		uris.push_back(output->GetURI());
+		group->Add(output);
+	}
+
+	const uint32_t formats = group->GetFormats();
+
+	if( uris.size() == 0 )
+		printf("displaySink -- no sinks, the frames won't be drawn\n");
+
+	for( size_t n=0; n < uris.size(); n++ )
+		printf("displaySink -- rendering to '%s'\n", uris[n].c_str());
+
+	printf("displaySink -- overlays %s, normalization %s\n", (formats & FORMAT_RGBA) ? "enabled" : "disabled", 
+		  (formats & FORMAT_NORMALIZED) ? "enabled" : "disabled");
+
+	return group;
+}
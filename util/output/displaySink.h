@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __DISPLAY_SINK_H_
+#define __DISPLAY_SINK_H_
+
+
+#include "cudaUtility.h"
+
+
+/**
+ * Destination of the frames that come out of a pipeline:  an openGL window, an encoder or
+ * file (videoOutput), a shared-memory segment, or nothing at all.  Sinks are created from URIs:
+ *
+ *   - display://                  an openGL window, which needs an X server
+ *   - shm://<name>                a POSIX shared-memory segment (/dev/shm/<name>), see shmSink
+ *   - null://                     discards the frames, for headless benchmarking
+ *   - anything else               a videoOutput, i.e. my_video.mp4, rtp://<host>:<port> or my_video.y4m
+ *
+ * Each sink declares the image formats it needs with GetFormats(), so the pipeline feeding
+ * it can leave out the work nobody would see:  without a FORMAT_NORMALIZED consumer, the
+ * frames aren't rescaled to 0-1, and without a FORMAT_RGBA consumer, the overlays and text
+ * aren't drawn at all.
+ *
+ * Render() is called from the thread that created the sink, since the openGL window's
+ * context belongs to that thread.
+ *
+ * @ingroup util
+ */
+class displaySink
+{
+public:
+	/**
+	 * The image formats a sink can consume, as flags.
+	 */
+	enum Format
+	{
+		FORMAT_NONE       = 0,			/**< consumes no images (the null sink) */
+		FORMAT_RGBA       = (1 << 0),	/**< float4 RGBA with the overlays drawn, in either range */
+		FORMAT_NORMALIZED = (1 << 1)	/**< float4 RGBA rescaled to 0-1, as openGL textures take it */
+	};
+
+	/**
+	 * Create a sink from its URI.
+	 */
+	static displaySink* Create( const char* uri, uint32_t width, uint32_t height );
+
+	/**
+	 * Create the sinks requested on the command line, as one sink that forwards to each of them:
+	 *
+	 *   --sink=<uri>[,<uri>...]    by default display:// when there's an X server ($DISPLAY), or else null://
+	 *   --output=<uri>             adds a videoOutput, with its --codec, --bitrate and --output_fps
+	 *   --headless                 leaves out the default display:// window
+	 *
+	 * Returns NULL if a requested sink couldn't be created.
+	 */
+	static displaySink* Create( int argc, char** argv, uint32_t width, uint32_t height );
+
+	/**
+	 * Destroy
+	 */
+	virtual ~displaySink()		{ }
+
+	/**
+	 * Retrieve the formats the sink needs, as Format flags.
+	 */
+	virtual uint32_t GetFormats() const = 0;
+
+	/**
+	 * Check if the sink needs a format.
+	 */
+	inline bool Needs( Format format ) const		{ return (GetFormats() & format) != 0; }
+
+	/**
+	 * Consume a frame, in the formats the sink asked for.
+	 * @param max_pixel the range of the pixel intensities, 1.0 once the frame is normalized.
+	 */
+	virtual bool Render( float4* image, uint32_t width, uint32_t height, float max_pixel ) = 0;
+
+	/**
+	 * Set the status line of the sink (the title of a window), if it has one.
+	 */
+	virtual void SetStatus( const char* str )		{ }
+};
+
+
+#endif
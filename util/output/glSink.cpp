@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "glSink.h"
+#include "glDisplay.h"
+#include "glTexture.h"
+
+#include <stdio.h>
+
+
+// constructor
+glSink::glSink()
+{
+	mDisplay = NULL;
+	mTexture = NULL;
+}
+
+
+// destructor
+glSink::~glSink()
+{
+	if( mTexture != NULL )
+	{
+		delete mTexture;
+		mTexture = NULL;
+	}
+
+	if( mDisplay != NULL )
+	{
+		delete mDisplay;
+		mDisplay = NULL;
+	}
+}
+
+
+// Create
+glSink* glSink::Create( uint32_t width, uint32_t height )
+{
+	glSink* sink = new glSink();
+
+	sink->mDisplay = glDisplay::Create();
+
+	if( !sink->mDisplay )
+	{
+		printf("glSink -- failed to create openGL display\n");
+		delete sink;
+		return NULL;
+	}
+
+	sink->mTexture = glTexture::Create(width, height, GL_RGBA32F_ARB/*GL_RGBA8*/);
+
+	if( !sink->mTexture )
+	{
+		printf("glSink -- failed to create openGL texture\n");
+		delete sink;
+		return NULL;
+	}
+
+	return sink;
+}
+
+
+// SetStatus
+void glSink::SetStatus( const char* str )
+{
+	mStatus = (str != NULL) ? str : "";
+}
+
+
+// Render
+bool glSink::Render( float4* image, uint32_t width, uint32_t height, float max_pixel )
+{
+	if( width != mTexture->GetWidth() || height != mTexture->GetHeight() )
+	{
+		printf("glSink -- expected a %ux%u image (got %ux%u)\n", mTexture->GetWidth(), mTexture->GetHeight(), width, height);
+		return false;
+	}
+
+	char str[512];
+	snprintf(str, sizeof(str), "%s%s%04.1f FPS", mStatus.c_str(), mStatus.empty() ? "" : " | ", mDisplay->GetFPS());
+	mDisplay->SetTitle(str);
+
+	mDisplay->UserEvents();
+	mDisplay->BeginRender();
+
+	// map from CUDA to openGL using GL interop
+	void* tex_map = mTexture->MapCUDA();
+
+	if( tex_map != NULL )
+	{
+		cudaMemcpy(tex_map, image, mTexture->GetSize(), cudaMemcpyDeviceToDevice);
+		mTexture->Unmap();
+	}
+
+	// draw the texture
+	mTexture->Render(10, 10);
+
+	mDisplay->EndRender();
+	return (tex_map != NULL);
+}
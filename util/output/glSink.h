@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __GL_SINK_H_
+#define __GL_SINK_H_
+
+
+#include "displaySink.h"
+
+#include <string>
+
+
+class glDisplay;
+class glTexture;
+
+
+/**
+ * Shows the frames in an openGL window (display://), through a texture that's filled
+ * from CUDA.  The window needs an X server, and the frames normalized to 0-1.
+ * @ingroup util
+ */
+class glSink : public displaySink
+{
+public:
+	/**
+	 * Open the window, and create a texture for width x height frames.
+	 */
+	static glSink* Create( uint32_t width, uint32_t height );
+
+	/**
+	 * Destroy
+	 */
+	virtual ~glSink();
+
+	/**
+	 * The texture takes the frames normalized, with the overlays drawn.
+	 */
+	virtual uint32_t GetFormats() const			{ return FORMAT_RGBA | FORMAT_NORMALIZED; }
+
+	/**
+	 * Process the window's events, and draw the frame.
+	 */
+	virtual bool Render( float4* image, uint32_t width, uint32_t height, float max_pixel );
+
+	/**
+	 * Set the window title, which is followed by the frame rate.
+	 */
+	virtual void SetStatus( const char* str );
+
+protected:
+	glSink();
+
+	glDisplay*  mDisplay;
+	glTexture*  mTexture;
+	std::string mStatus;
+};
+
+
+#endif
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "gstEncoder.h"
+#include "gstUtility.h"
+
+#include <gst/app/gstappsrc.h>
+
+#include <sstream>
+#include <string.h>
+#include <strings.h>
+
+
+// constructor
+gstEncoder::gstEncoder( const char* uri, uint32_t width, uint32_t height, float framerate ) : videoOutput(uri, width, height, framerate)
+{
+	mLive     = false;
+	mOpen     = false;
+	mBus      = NULL;
+	mAppSrc   = NULL;
+	mPipeline = NULL;
+
+	for( uint32_t n=0; n < NumBuffers; n++ )
+	{
+		mRefs[n].encoder = this;
+		mRefs[n].index   = n;
+	}
+}
+
+
+// destructor
+gstEncoder::~gstEncoder()
+{
+	Close();
+
+	if( mPipeline != NULL )
+	{
+		gst_element_set_state(mPipeline, GST_STATE_NULL);
+		gst_object_unref(mPipeline);
+		mPipeline = NULL;
+	}
+
+	if( mBus != NULL )
+	{
+		gst_object_unref(mBus);
+		mBus = NULL;
+	}
+}
+
+
+// Create
+gstEncoder* gstEncoder::Create( const char* uri, uint32_t width, uint32_t height, float framerate, uint32_t bitrate, const char* codec )
+{
+	if( (width & 1) != 0 || (height & 1) != 0 )
+	{
+		printf(LOG_GSTREAMER "gstreamer encoder -- %ux%u isn't supported, the width and height must be even\n", width, height);
+		return NULL;
+	}
+
+	if( !gstreamerInit() )
+	{
+		printf(LOG_GSTREAMER "failed to initialize gstreamer API\n");
+		return NULL;
+	}
+
+	gstEncoder* enc = new gstEncoder(uri, width, height, framerate);
+
+	if( !enc->allocBuffers(NumBuffers) || !enc->init(bitrate, codec) )
+	{
+		printf(LOG_GSTREAMER "gstreamer encoder -- failed to create '%s'\n", uri);
+		delete enc;
+		return NULL;
+	}
+
+	return enc;
+}
+
+
+// buildLaunchStr
+bool gstEncoder::buildLaunchStr( uint32_t bitrate, const char* codec )
+{
+	// gst-launch-1.0 appsrc ! video/x-raw, format=(string)NV12, width=(int)1280, height=(int)720, framerate=(fraction)30/1 !
+	// omxh264enc bitrate=4000000 ! video/x-h264 ! h264parse ! qtmux ! filesink location=my_video.mp4
+	if( !codec || strlen(codec) == 0 )
+		codec = "h264";
+
+	if( strcasecmp(codec, "h264") != 0 && strcasecmp(codec, "h265") != 0 )
+	{
+		printf(LOG_GSTREAMER "gstreamer encoder -- unsupported codec '%s' (expected h264 or h265)\n", codec);
+		return false;
+	}
+
+	const std::string enc = strcasecmp(codec, "h265") == 0 ? "h265" : "h264";
+	const std::string uri = mURI;
+
+	mLive = (uri.compare(0, 6, "rtp://") == 0 || uri.compare(0, 7, "rtsp://") == 0);
+
+	// the frame rate, as a ratio in thousandths unless it's a whole number
+	uint32_t rateNum = (uint32_t)(mFramerate * 1000.0f + 0.5f);
+	uint32_t rateDen = 1000;
+
+	if( rateNum % 1000 == 0 )
+	{
+		rateNum /= 1000;
+		rateDen  = 1;
+	}
+
+	std::ostringstream ss;
+
+	// the network streams are timestamped as the frames arrive, and the files at the nominal rate
+	ss << "appsrc name=mysource format=time is-live=" << (mLive ? "true do-timestamp=true" : "false") << " ! ";
+	ss << "video/x-raw, format=(string)NV12, width=(int)" << mWidth << ", height=(int)" << mHeight << ", ";
+	ss << "framerate=(fraction)" << rateNum << "/" << rateDen << " ! ";
+	ss << "omx" << enc << "enc bitrate=" << bitrate << " ! video/x-" << enc << " ! ";
+
+	if( uri.compare(0, 6, "rtp://") == 0 )
+	{
+		const size_t port = uri.find_last_of(':');
+
+		if( port == std::string::npos || port < 6 || port + 1 >= uri.size() )
+		{
+			printf(LOG_GSTREAMER "gstreamer encoder -- invalid RTP address '%s' (expected rtp://<host>:<port>)\n", mURI.c_str());
+			return false;
+		}
+
+		ss << "rtp" << enc << "pay config-interval=1 pt=96 ! ";
+		ss << "udpsink host=" << uri.substr(6, port - 6) << " port=" << uri.substr(port + 1) << " sync=false async=false";
+	}
+	else if( uri.compare(0, 7, "rtsp://") == 0 )
+	{
+		ss << enc << "parse ! rtspclientsink location=" << uri;
+	}
+	else
+	{
+		const size_t ext = uri.find_last_of('.');
+		const std::string extension = (ext != std::string::npos) ? uri.substr(ext + 1) : "";
+
+		ss << enc << "parse ! ";
+
+		if( strcasecmp(extension.c_str(), "mp4") == 0 || strcasecmp(extension.c_str(), "mov") == 0 )
+			ss << "qtmux ! ";
+		else if( strcasecmp(extension.c_str(), "mkv") == 0 )
+			ss << "matroskamux ! ";
+		else if( strcasecmp(extension.c_str(), enc.c_str()) != 0 )
+		{
+			printf(LOG_GSTREAMER "gstreamer encoder -- unsupported file extension '%s' (expected mp4, mov, mkv or %s)\n", extension.c_str(), enc.c_str());
+			return false;
+		}
+
+		ss << "filesink location=" << uri;
+	}
+
+	mLaunchStr = ss.str();
+
+	printf(LOG_GSTREAMER "gstreamer encoder pipeline string:\n");
+	printf("%s\n", mLaunchStr.c_str());
+	return true;
+}
+
+
+// init
+bool gstEncoder::init( uint32_t bitrate, const char* codec )
+{
+	GError* err = NULL;
+
+	// build pipeline string
+	if( !buildLaunchStr(bitrate, codec) )
+	{
+		printf(LOG_GSTREAMER "gstreamer encoder failed to build pipeline string\n");
+		return false;
+	}
+
+	// launch pipeline
+	mPipeline = gst_parse_launch(mLaunchStr.c_str(), &err);
+
+	if( err != NULL )
+	{
+		printf(LOG_GSTREAMER "gstreamer encoder failed to create pipeline\n");
+		printf(LOG_GSTREAMER "   (%s)\n", err->message);
+		g_error_free(err);
+		return false;
+	}
+
+	GstPipeline* pipeline = GST_PIPELINE(mPipeline);
+
+	if( !pipeline )
+	{
+		printf(LOG_GSTREAMER "gstreamer failed to cast GstElement into GstPipeline\n");
+		return false;
+	}
+
+	// retrieve pipeline bus
+	mBus = gst_pipeline_get_bus(pipeline);
+
+	if( !mBus )
+	{
+		printf(LOG_GSTREAMER "gstreamer failed to retrieve GstBus from pipeline\n");
+		return false;
+	}
+
+	// get the appsrc
+	GstElement* appsrcElement = gst_bin_get_by_name(GST_BIN(pipeline), "mysource");
+	GstAppSrc* appsrc = GST_APP_SRC(appsrcElement);
+
+	if( !appsrcElement || !appsrc )
+	{
+		printf(LOG_GSTREAMER "gstreamer failed to retrieve AppSrc element from pipeline\n");
+		return false;
+	}
+
+	mAppSrc = appsrc;
+
+	// transition pipeline to STATE_PLAYING (it completes asynchronously, once the first frames are encoded)
+	printf(LOG_GSTREAMER "gstreamer transitioning encoder pipeline to GST_STATE_PLAYING\n");
+
+	const GstStateChangeReturn result = gst_element_set_state(mPipeline, GST_STATE_PLAYING);
+
+	if( result != GST_STATE_CHANGE_SUCCESS && result != GST_STATE_CHANGE_ASYNC )
+	{
+		printf(LOG_GSTREAMER "gstreamer failed to set encoder pipeline state to PLAYING (error %u)\n", result);
+		checkMsgBus();
+		return false;
+	}
+
+	mOpen = true;
+	return true;
+}
+
+
+// onBufferFree
+void gstEncoder::onBufferFree( void* user_data )
+{
+	bufferRef* ref = (bufferRef*)user_data;
+	ref->encoder->releaseBuffer(ref->index);
+}
+
+
+// render
+bool gstEncoder::render( uint32_t buffer )
+{
+	if( !mOpen )
+	{
+		releaseBuffer(buffer);
+		return false;
+	}
+
+	// wrap the mapped memory, which is handed back by onBufferFree() once the encoder is done with it
+	GstBuffer* gstBuffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, mBufferCPU[buffer], mFrameSize, 0, mFrameSize, &mRefs[buffer], onBufferFree);
+
+	if( !gstBuffer )
+	{
+		printf(LOG_GSTREAMER "gstreamer encoder -- failed to wrap NV12 buffer %u\n", buffer);
+		releaseBuffer(buffer);
+		return false;
+	}
+
+	if( !mLive )
+	{
+		const double duration = (double)GST_SECOND / mFramerate;
+
+		GST_BUFFER_PTS(gstBuffer)      = (GstClockTime)(mFrames * duration);
+		GST_BUFFER_DURATION(gstBuffer) = (GstClockTime)duration;
+	}
+
+	// the appsrc takes ownership of the buffer, even if it fails
+	const GstFlowReturn result = gst_app_src_push_buffer(mAppSrc, gstBuffer);
+
+	if( result != GST_FLOW_OK )
+	{
+		printf(LOG_GSTREAMER "gstreamer encoder -- failed to push frame to '%s' (error %i)\n", mURI.c_str(), (int)result);
+		checkMsgBus();
+		return false;
+	}
+
+	return true;
+}
+
+
+// Close
+void gstEncoder::Close()
+{
+	if( !mOpen )
+		return;
+
+	mOpen = false;
+
+	// finish the stream, so the muxer writes the index of a file
+	if( gst_app_src_end_of_stream(mAppSrc) == GST_FLOW_OK )
+	{
+		GstMessage* msg = gst_bus_timed_pop_filtered(mBus, 5 * GST_SECOND, (GstMessageType)(GST_MESSAGE_EOS|GST_MESSAGE_ERROR));
+
+		if( msg != NULL )
+		{
+			gst_message_print(mBus, msg, this);
+			gst_message_unref(msg);
+		}
+		else
+			printf(LOG_GSTREAMER "gstreamer encoder -- timed out waiting for the end of '%s'\n", mURI.c_str());
+	}
+
+	// stop pipeline, which releases the buffers still in flight
+	printf(LOG_GSTREAMER "gstreamer transitioning encoder pipeline to GST_STATE_NULL\n");
+
+	const GstStateChangeReturn result = gst_element_set_state(mPipeline, GST_STATE_NULL);
+
+	if( result != GST_STATE_CHANGE_SUCCESS )
+		printf(LOG_GSTREAMER "gstreamer failed to set encoder pipeline state to NULL (error %u)\n", result);
+
+	checkMsgBus();
+
+	printf(LOG_GSTREAMER "gstreamer encoder -- encoded %llu frames to '%s' (%llu dropped, %llu failed)\n", (unsigned long long)mFrames, 
+		  mURI.c_str(), (unsigned long long)mDropped, (unsigned long long)mFailed);
+}
+
+
+// checkMsgBus
+void gstEncoder::checkMsgBus()
+{
+	while(true)
+	{
+		GstMessage* msg = gst_bus_pop(mBus);
+
+		if( !msg )
+			break;
+
+		gst_message_print(mBus, msg, this);
+		gst_message_unref(msg);
+	}
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __GSTREAMER_ENCODER_H_
+#define __GSTREAMER_ENCODER_H_
+
+
+#include <gst/gst.h>
+#include "videoOutput.h"
+
+
+struct _GstAppSrc;
+
+
+/**
+ * Encodes NV12 frames to H.264 or H.265 with the Jetson's hardware encoder, through a
+ * GStreamer pipeline fed by an appsrc.  The encoded stream goes to a file (MP4, MKV or
+ * a raw elementary stream, by the extension), to rtp://<host>:<port> as RTP over UDP, or
+ * to an RTSP server at rtsp://<host>:<port>/<path>.
+ *
+ * The frames are pushed without copying, as buffers that wrap the mapped memory the
+ * frames were converted into.  GStreamer hands each buffer back once the encoder has
+ * consumed it, and the frames are dropped while all of them are in flight.
+ *
+ * Files are timestamped at the nominal frame rate, and the network streams as the frames
+ * arrive.  The width and height must be even.
+ *
+ * @ingroup util
+ */
+class gstEncoder : public videoOutput
+{
+public:
+	/**
+	 * Create the encoder and start its pipeline.
+	 * @param codec "h264" (the default) or "h265".
+	 */
+	static gstEncoder* Create( const char* uri, uint32_t width, uint32_t height, float framerate, uint32_t bitrate=DEFAULT_OUTPUT_BITRATE, const char* codec=NULL );
+
+	/**
+	 * Destroy
+	 */
+	virtual ~gstEncoder();
+
+	/**
+	 * Send the end of the stream and wait for the encoder to finish it, so the
+	 * container of a file is complete, then stop the pipeline.
+	 */
+	virtual void Close();
+
+	/**
+	 * Number of NV12 buffers that can be in flight in the pipeline.
+	 */
+	static const uint32_t NumBuffers = 4;
+
+protected:
+	gstEncoder( const char* uri, uint32_t width, uint32_t height, float framerate );
+
+	virtual bool render( uint32_t buffer );
+
+	bool init( uint32_t bitrate, const char* codec );
+	bool buildLaunchStr( uint32_t bitrate, const char* codec );
+	void checkMsgBus();
+
+	// ties a buffer in flight back to its slot
+	struct bufferRef
+	{
+		gstEncoder* encoder;
+		uint32_t    index;
+	};
+
+	static void onBufferFree( void* user_data );
+
+	std::string  mLaunchStr;
+	bool         mLive;
+	bool         mOpen;
+	_GstBus*     mBus;
+	_GstAppSrc*  mAppSrc;
+	_GstElement* mPipeline;
+	bufferRef    mRefs[NumBuffers];
+};
+
+
+#endif
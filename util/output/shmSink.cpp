@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "shmSink.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+// constructor
+shmSink::shmSink( const char* name )
+{
+	mName   = name;
+	mHeader = NULL;
+	mSize   = 0;
+
+	// POSIX shared-memory names start with a slash
+	if( mName.empty() || mName[0] != '/' )
+		mName = "/" + mName;
+}
+
+
+// destructor
+shmSink::~shmSink()
+{
+	if( mHeader != NULL )
+	{
+		munmap(mHeader, mSize);
+		shm_unlink(mName.c_str());
+		mHeader = NULL;
+	}
+}
+
+
+// Create
+shmSink* shmSink::Create( const char* name, uint32_t width, uint32_t height )
+{
+	if( !name || strlen(name) == 0 || strchr(name + 1, '/') != NULL )
+	{
+		printf("shmSink -- invalid shared memory name '%s' (expected shm://<name>)\n", name != NULL ? name : "");
+		return NULL;
+	}
+
+	shmSink* sink = new shmSink(name);
+
+	const size_t imageOffset = 4096;
+	const size_t pitch       = width * sizeof(float4);
+
+	sink->mSize = imageOffset + pitch * height;
+
+	const int fd = shm_open(sink->mName.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+	if( fd < 0 )
+	{
+		printf("shmSink -- failed to create shared memory '%s'\n", sink->mName.c_str());
+		delete sink;
+		return NULL;
+	}
+
+	if( ftruncate(fd, sink->mSize) != 0 )
+	{
+		printf("shmSink -- failed to size shared memory '%s' to %zu bytes\n", sink->mName.c_str(), sink->mSize);
+		close(fd);
+		shm_unlink(sink->mName.c_str());
+		delete sink;
+		return NULL;
+	}
+
+	void* ptr = mmap(NULL, sink->mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if( ptr == MAP_FAILED )
+	{
+		printf("shmSink -- failed to map shared memory '%s'\n", sink->mName.c_str());
+		shm_unlink(sink->mName.c_str());
+		delete sink;
+		return NULL;
+	}
+
+	shmSinkHeader* header = (shmSinkHeader*)ptr;
+
+	header->version     = SHM_SINK_VERSION;
+	header->width       = width;
+	header->height      = height;
+	header->pitch       = pitch;
+	header->imageOffset = imageOffset;
+	header->maxPixel    = 255.0f;
+	header->sequence    = 0;
+	header->timestamp   = 0;
+
+	// the magic goes last, so readers never see a half-written header
+	__sync_synchronize();
+	memcpy(header->magic, SHM_SINK_MAGIC, sizeof(header->magic));
+
+	sink->mHeader = header;
+
+	printf("shmSink -- publishing %ux%u frames to /dev/shm%s\n", width, height, sink->mName.c_str());
+	return sink;
+}
+
+
+// Render
+bool shmSink::Render( float4* image, uint32_t width, uint32_t height, float max_pixel )
+{
+	if( width != mHeader->width || height != mHeader->height )
+	{
+		printf("shmSink -- expected a %ux%u image (got %ux%u)\n", mHeader->width, mHeader->height, width, height);
+		return false;
+	}
+
+	// odd while the frame is being written
+	mHeader->sequence++;
+	__sync_synchronize();
+
+	const cudaError_t result = cudaMemcpy((uint8_t*)mHeader + mHeader->imageOffset, image, mHeader->pitch * height, cudaMemcpyDeviceToHost);
+
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	mHeader->maxPixel  = max_pixel;
+	mHeader->timestamp = uint64_t(time.tv_sec) * 1000000000ULL + time.tv_nsec;
+
+	__sync_synchronize();
+	mHeader->sequence++;
+
+	return !CUDA_FAILED(result);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __SHM_SINK_H_
+#define __SHM_SINK_H_
+
+
+#include "displaySink.h"
+
+#include <string>
+
+
+/**
+ * Magic number at the start of a shmSink segment.
+ * @ingroup util
+ */
+#define SHM_SINK_MAGIC	"JISHMFRM"
+
+/**
+ * Version of the shmSink segment layout.
+ * @ingroup util
+ */
+#define SHM_SINK_VERSION	1
+
+
+/**
+ * Header at the start of a shmSink segment, followed by the latest frame at imageOffset.
+ *
+ * The sequence is odd while a frame is being written, and even once it's complete.  Readers
+ * copy the frame out, then check that the sequence is the same even number it was before
+ * they started, or else try again.
+ *
+ * @ingroup util
+ */
+struct shmSinkHeader
+{
+	char     magic[8];		/**< SHM_SINK_MAGIC */
+	uint32_t version;		/**< SHM_SINK_VERSION */
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;		/**< bytes between the rows of the frame */
+	uint32_t imageOffset;	/**< offset of the frame from the start of the segment */
+	float    maxPixel;		/**< range of the pixel intensities of the latest frame (255, or 1 once normalized) */
+	volatile uint64_t sequence;	/**< number of frames written times two, plus one while writing */
+	uint64_t timestamp;		/**< time the latest frame was written (CLOCK_MONOTONIC nanoseconds) */
+};
+
+
+/**
+ * Publishes the latest frame, as float4 RGBA with the overlays drawn, to a POSIX
+ * shared-memory segment (shm://<name>, i.e. /dev/shm/<name>) that other processes
+ * on the device can map, without going through a window or an encoder.
+ *
+ * The segment holds one frame that's overwritten in place, so readers that fall behind
+ * skip frames rather than holding back the pipeline.  It's removed when the sink is destroyed.
+ *
+ * @ingroup util
+ */
+class shmSink : public displaySink
+{
+public:
+	/**
+	 * Create the shared-memory segment, replacing one that exists.
+	 */
+	static shmSink* Create( const char* name, uint32_t width, uint32_t height );
+
+	/**
+	 * Destroy, and remove the segment.
+	 */
+	virtual ~shmSink();
+
+	/**
+	 * The frames are published with the overlays drawn, in either range.
+	 */
+	virtual uint32_t GetFormats() const			{ return FORMAT_RGBA; }
+
+	/**
+	 * Copy the frame into the segment.
+	 */
+	virtual bool Render( float4* image, uint32_t width, uint32_t height, float max_pixel );
+
+protected:
+	shmSink( const char* name );
+
+	std::string    mName;
+	shmSinkHeader* mHeader;
+	size_t         mSize;
+};
+
+
+#endif
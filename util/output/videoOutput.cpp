@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "videoOutput.h"
+#include "gstEncoder.h"
+#include "y4mWriter.h"
+
+#include "cudaMappedMemory.h"
+#include "cudaYUV.h"
+#include "commandLine.h"
+
+#include <string.h>
+#include <strings.h>
+
+
+// constructor
+videoOutput::videoOutput( const char* uri, uint32_t width, uint32_t height, float framerate )
+{
+	mURI        = uri;
+	mWidth      = width;
+	mHeight     = height;
+	mPitch      = (width + 3) & ~3;	// the default stride of GStreamer's NV12
+	mFrameSize  = mPitch * height + mPitch * ((height + 1) / 2);
+	mFramerate  = framerate;
+	mNumBuffers = 0;
+	mFrames     = 0;
+	mDropped    = 0;
+	mFailed     = 0;
+
+	for( uint32_t n=0; n < MaxBuffers; n++ )
+	{
+		mBufferCPU[n]  = NULL;
+		mBufferGPU[n]  = NULL;
+		mBufferBusy[n] = false;
+	}
+}
+
+
+// destructor
+videoOutput::~videoOutput()
+{
+	freeBuffers();
+}
+
+
+// IsRequested
+bool videoOutput::IsRequested( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+	return cmdLine.GetString("output") != NULL;
+}
+
+
+// hasExtension
+static bool hasExtension( const std::string& path, const char* ext )
+{
+	const size_t len = strlen(ext);
+	return path.size() > len && strcasecmp(path.c_str() + path.size() - len, ext) == 0;
+}
+
+
+// Create
+videoOutput* videoOutput::Create( const char* uri, uint32_t width, uint32_t height, float framerate, uint32_t bitrate, const char* codec )
+{
+	if( !uri || strlen(uri) == 0 || width == 0 || height == 0 || framerate <= 0.0f )
+	{
+		printf("videoOutput -- invalid output '%s' (%ux%u at %f FPS)\n", uri != NULL ? uri : "", width, height, framerate);
+		return NULL;
+	}
+
+	const std::string str = uri;
+	videoOutput* output = NULL;
+
+	if( hasExtension(str, ".y4m") )
+		output = y4mWriter::Create(uri, width, height, framerate);
+	else
+		output = gstEncoder::Create(uri, width, height, framerate, bitrate, codec);
+
+	if( !output )
+	{
+		printf("videoOutput -- failed to create '%s'\n", uri);
+		return NULL;
+	}
+
+	printf("videoOutput -- created '%s'  (%ux%u at %g FPS)\n", uri, width, height, framerate);
+	return output;
+}
+
+
+// Create
+videoOutput* videoOutput::Create( int argc, char** argv, uint32_t width, uint32_t height )
+{
+	commandLine cmdLine(argc, argv);
+
+	const char* uri = cmdLine.GetString("output");
+
+	if( !uri )
+		return NULL;
+
+	const float framerate = cmdLine.GetFloat("output_fps");
+	const int   bitrate   = cmdLine.GetInt("bitrate");
+
+	return Create(uri, width, height, framerate > 0.0f ? framerate : 30.0f,
+			    bitrate > 0 ? bitrate : DEFAULT_OUTPUT_BITRATE, cmdLine.GetString("codec"));
+}
+
+
+// allocBuffers
+bool videoOutput::allocBuffers( uint32_t count )
+{
+	if( count > MaxBuffers )
+		count = MaxBuffers;
+
+	for( uint32_t n=0; n < count; n++ )
+	{
+		if( !cudaAllocMapped((void**)&mBufferCPU[n], (void**)&mBufferGPU[n], mFrameSize) )
+		{
+			printf("videoOutput -- failed to allocate %u bytes for NV12 buffer %u\n", mFrameSize, n);
+			return false;
+		}
+
+		mNumBuffers++;
+	}
+
+	return true;
+}
+
+
+// freeBuffers
+void videoOutput::freeBuffers()
+{
+	for( uint32_t n=0; n < mNumBuffers; n++ )
+	{
+		if( mBufferBusy[n] )
+			printf("videoOutput -- '%s' NV12 buffer %u is still held by the sink\n", mURI.c_str(), n);
+
+		CUDA(cudaFreeHost(mBufferCPU[n]));
+
+		mBufferCPU[n] = NULL;
+		mBufferGPU[n] = NULL;
+	}
+
+	mNumBuffers = 0;
+}
+
+
+// acquireBuffer
+int videoOutput::acquireBuffer()
+{
+	for( uint32_t n=0; n < mNumBuffers; n++ )
+	{
+		bool expected = false;
+
+		if( mBufferBusy[n].compare_exchange_strong(expected, true) )
+			return n;
+	}
+
+	return -1;
+}
+
+
+// releaseBuffer
+void videoOutput::releaseBuffer( uint32_t buffer )
+{
+	if( buffer < mNumBuffers )
+		mBufferBusy[buffer] = false;
+}
+
+
+// checkFrame
+bool videoOutput::checkFrame( void* image, uint32_t width, uint32_t height )
+{
+	if( !image || width != mWidth || height != mHeight )
+	{
+		printf("videoOutput -- '%s' expected a %ux%u image (got %ux%u)\n", mURI.c_str(), mWidth, mHeight, width, height);
+		mFailed++;
+		return false;
+	}
+
+	return true;
+}
+
+
+// submitFrame
+bool videoOutput::submitFrame( int buffer, cudaError_t result )
+{
+	// the sink reads the buffer from the CPU, once the conversion is finished
+	if( CUDA_FAILED(result) || CUDA_FAILED(cudaStreamSynchronize(0)) )
+	{
+		releaseBuffer(buffer);
+		mFailed++;
+		return false;
+	}
+
+	if( !render(buffer) )
+	{
+		mFailed++;
+		return false;
+	}
+
+	mFrames++;
+	return true;
+}
+
+
+// Render (float4)
+bool videoOutput::Render( float4* image, uint32_t width, uint32_t height, float max_pixel )
+{
+	if( !checkFrame(image, width, height) )
+		return false;
+
+	const int buffer = acquireBuffer();
+
+	if( buffer < 0 )
+	{
+		mDropped++;
+		return false;
+	}
+
+	return submitFrame(buffer, cudaRGBAToNV12(image, width * sizeof(float4), mBufferGPU[buffer], mPitch, width, height, max_pixel));
+}
+
+
+// Render (uchar4)
+bool videoOutput::Render( uchar4* image, uint32_t width, uint32_t height )
+{
+	if( !checkFrame(image, width, height) )
+		return false;
+
+	const int buffer = acquireBuffer();
+
+	if( buffer < 0 )
+	{
+		mDropped++;
+		return false;
+	}
+
+	return submitFrame(buffer, cudaRGBAToNV12(image, width * sizeof(uchar4), mBufferGPU[buffer], mPitch, width, height));
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __VIDEO_OUTPUT_H_
+#define __VIDEO_OUTPUT_H_
+
+
+#include "displaySink.h"
+
+#include <atomic>
+#include <string>
+
+
+/**
+ * Default bitrate of the encoded outputs, in bits per second.
+ * @ingroup util
+ */
+#define DEFAULT_OUTPUT_BITRATE	4000000
+
+
+/**
+ * Stream of video frames leaving the device, that's created from a URI:
+ *
+ *   - my_video.mp4, .mkv, .h264 or .h265   encoded to a file, in the container of the extension
+ *   - rtp://<host>:<port>                  encoded and sent as RTP over UDP
+ *   - rtsp://<host>:<port>/<path>          encoded and published to an RTSP server
+ *   - my_video.y4m                         uncompressed YUV4MPEG2, for testing without an encoder
+ *
+ * Render() converts an RGBA image to NV12 on the GPU, into one of a ring of buffers in
+ * mapped memory that the sink then reads in place, so the CPU never copies the frame.
+ * When every buffer is still held by the sink (i.e. the encoder fell behind), the frame is
+ * dropped and counted instead of stalling the caller.
+ *
+ * The frames are converted in the colorspace set with cudaYUVSetColorspace().  As a
+ * displaySink, an output takes the frames with their overlays, but doesn't need them normalized.
+ *
+ * @ingroup util
+ */
+class videoOutput : public displaySink
+{
+public:
+	/**
+	 * Create an output from its URI.
+	 * @param framerate the nominal frame rate, that the frames of a file are timestamped with.
+	 * @param codec "h264" (the default) or "h265", ignored by the uncompressed outputs.
+	 */
+	static videoOutput* Create( const char* uri, uint32_t width, uint32_t height, float framerate=30.0f, uint32_t bitrate=DEFAULT_OUTPUT_BITRATE, const char* codec=NULL );
+
+	/**
+	 * Create an output from the command line:  --output=<uri>, with --output_fps=N,
+	 * --bitrate=N and --codec=h264|h265.  Returns NULL if there's no --output.
+	 */
+	static videoOutput* Create( int argc, char** argv, uint32_t width, uint32_t height );
+
+	/**
+	 * Check if the command line requests an output (--output=<uri>).
+	 */
+	static bool IsRequested( int argc, char** argv );
+
+	/**
+	 * Destroy
+	 */
+	virtual ~videoOutput();
+
+	/**
+	 * The frames are encoded with the overlays drawn, in either range.
+	 */
+	virtual uint32_t GetFormats() const			{ return FORMAT_RGBA; }
+
+	/**
+	 * Convert and queue a float4 RGBA frame, with pixel intensities from 0 to max_pixel.
+	 * @returns true if the frame was queued, or false if it was dropped or failed.
+	 */
+	virtual bool Render( float4* image, uint32_t width, uint32_t height, float max_pixel=255.0f );
+
+	/**
+	 * Convert and queue a uchar4 RGBA frame.
+	 * @returns true if the frame was queued, or false if it was dropped or failed.
+	 */
+	bool Render( uchar4* image, uint32_t width, uint32_t height );
+
+	/**
+	 * Finish the stream, once the queued frames have been written.
+	 * It's called by the destructor if it hasn't been already.
+	 */
+	virtual void Close() = 0;
+
+	/**
+	 * Retrieve the URI of the output.
+	 */
+	inline const char* GetURI() const			{ return mURI.c_str(); }
+
+	/**
+	 * Retrieve the width of the frames.
+	 */
+	inline uint32_t GetWidth() const			{ return mWidth; }
+
+	/**
+	 * Retrieve the height of the frames.
+	 */
+	inline uint32_t GetHeight() const			{ return mHeight; }
+
+	/**
+	 * Retrieve the number of frames queued to the sink.
+	 */
+	inline uint64_t GetFrames() const			{ return mFrames; }
+
+	/**
+	 * Retrieve the number of frames dropped because every buffer was held by the sink.
+	 */
+	inline uint64_t GetDropped() const			{ return mDropped; }
+
+	/**
+	 * Retrieve the number of frames that failed, or didn't match the size of the output.
+	 */
+	inline uint64_t GetFailed() const			{ return mFailed; }
+
+	/**
+	 * Maximum number of NV12 buffers in the ring.
+	 */
+	static const uint32_t MaxBuffers = 8;
+
+protected:
+	videoOutput( const char* uri, uint32_t width, uint32_t height, float framerate );
+
+	/**
+	 * Hand a converted NV12 buffer to the sink, that returns it with releaseBuffer()
+	 * once it's done with it (even if it fails).
+	 */
+	virtual bool render( uint32_t buffer ) = 0;
+
+	bool allocBuffers( uint32_t count );
+	void freeBuffers();
+	int  acquireBuffer();
+	void releaseBuffer( uint32_t buffer );
+	bool checkFrame( void* image, uint32_t width, uint32_t height );
+	bool submitFrame( int buffer, cudaError_t result );
+
+	std::string mURI;
+	uint32_t    mWidth;
+	uint32_t    mHeight;
+	uint32_t    mPitch;		// of the Y and CbCr planes, rounded up to 4 bytes
+	uint32_t    mFrameSize;	// of a whole NV12 frame
+	float       mFramerate;
+
+	uint8_t*          mBufferCPU[MaxBuffers];
+	uint8_t*          mBufferGPU[MaxBuffers];
+	std::atomic<bool> mBufferBusy[MaxBuffers];
+	uint32_t          mNumBuffers;
+
+	std::atomic<uint64_t> mFrames;
+	std::atomic<uint64_t> mDropped;
+	std::atomic<uint64_t> mFailed;
+};
+
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "y4mWriter.h"
+#include "cudaYUV.h"
+
+#include <string.h>
+
+
+// constructor
+y4mWriter::y4mWriter( const char* path, uint32_t width, uint32_t height, float framerate ) : videoOutput(path, width, height, framerate)
+{
+	mFile = NULL;
+}
+
+
+// destructor
+y4mWriter::~y4mWriter()
+{
+	Close();
+}
+
+
+// Create
+y4mWriter* y4mWriter::Create( const char* path, uint32_t width, uint32_t height, float framerate )
+{
+	y4mWriter* writer = new y4mWriter(path, width, height, framerate);
+
+	// frames are written before Render() returns, so one buffer is enough
+	if( !writer->allocBuffers(1) )
+	{
+		delete writer;
+		return NULL;
+	}
+
+	writer->mFile = fopen(path, "wb");
+
+	if( !writer->mFile )
+	{
+		printf("y4mWriter -- failed to open '%s' for writing\n", path);
+		delete writer;
+		return NULL;
+	}
+
+	const uint32_t chromaWidth  = (width + 1) / 2;
+	const uint32_t chromaHeight = (height + 1) / 2;
+
+	writer->mPlanes.resize(width * height + chromaWidth * chromaHeight * 2);
+
+	// the chroma siting and range of the frames
+	const yuvColorspace colorspace = cudaYUVGetColorspace();
+
+	const char* chroma = "420mpeg2";
+
+	if( colorspace.siting == YUV_CHROMA_CENTER )
+		chroma = "420jpeg";
+	else if( colorspace.siting == YUV_CHROMA_TOPLEFT )
+		chroma = "420paldv";
+
+	// the frame rate, as a ratio in thousandths unless it's a whole number
+	uint32_t rateNum = (uint32_t)(framerate * 1000.0f + 0.5f);
+	uint32_t rateDen = 1000;
+
+	if( rateNum % 1000 == 0 )
+	{
+		rateNum /= 1000;
+		rateDen  = 1;
+	}
+
+	if( fprintf(writer->mFile, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C%s XCOLORRANGE=%s\n", width, height, rateNum, rateDen, chroma,
+			  colorspace.range == YUV_RANGE_FULL ? "FULL" : "LIMITED") < 0 )
+	{
+		printf("y4mWriter -- failed to write the header of '%s'\n", path);
+		delete writer;
+		return NULL;
+	}
+
+	return writer;
+}
+
+
+// Close
+void y4mWriter::Close()
+{
+	if( !mFile )
+		return;
+
+	fclose(mFile);
+	mFile = NULL;
+
+	printf("y4mWriter -- wrote %llu frames to '%s' (%llu dropped, %llu failed)\n", (unsigned long long)mFrames, 
+		  mURI.c_str(), (unsigned long long)mDropped, (unsigned long long)mFailed);
+}
+
+
+// render
+bool y4mWriter::render( uint32_t buffer )
+{
+	if( !mFile )
+	{
+		releaseBuffer(buffer);
+		return false;
+	}
+
+	const uint32_t chromaWidth  = (mWidth + 1) / 2;
+	const uint32_t chromaHeight = (mHeight + 1) / 2;
+
+	const uint8_t* nv12 = mBufferCPU[buffer];
+	uint8_t* planeY  = mPlanes.data();
+	uint8_t* planeCb = planeY + mWidth * mHeight;
+	uint8_t* planeCr = planeCb + chromaWidth * chromaHeight;
+
+	for( uint32_t y=0; y < mHeight; y++ )
+		memcpy(planeY + y * mWidth, nv12 + y * mPitch, mWidth);
+
+	const uint8_t* chroma = nv12 + mPitch * mHeight;
+
+	for( uint32_t y=0; y < chromaHeight; y++ )
+	{
+		const uint8_t* row = chroma + y * mPitch;
+
+		for( uint32_t x=0; x < chromaWidth; x++ )
+		{
+			planeCb[y * chromaWidth + x] = row[x * 2];
+			planeCr[y * chromaWidth + x] = row[x * 2 + 1];
+		}
+	}
+
+	releaseBuffer(buffer);
+
+	if( fwrite("FRAME\n", 1, 6, mFile) != 6 ||
+	    fwrite(mPlanes.data(), 1, mPlanes.size(), mFile) != mPlanes.size() )
+	{
+		printf("y4mWriter -- failed to write frame to '%s'\n", mURI.c_str());
+		return false;
+	}
+
+	return true;
+}
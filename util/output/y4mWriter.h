@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __Y4M_WRITER_H_
+#define __Y4M_WRITER_H_
+
+
+#include "videoOutput.h"
+
+#include <stdio.h>
+#include <vector>
+
+
+/**
+ * Writes uncompressed 4:2:0 frames to a YUV4MPEG2 file (i.e. my_video.y4m), that most
+ * players and tools (ffmpeg, mpv, x264) read, so the output can be checked without an encoder.
+ *
+ * The header carries the chroma siting and range of the colorspace set with cudaYUVSetColorspace().
+ * The frames are written from the calling thread, so the file can grow by tens of MB/s.
+ *
+ * @ingroup util
+ */
+class y4mWriter : public videoOutput
+{
+public:
+	/**
+	 * Create the file and write its header.
+	 */
+	static y4mWriter* Create( const char* path, uint32_t width, uint32_t height, float framerate );
+
+	/**
+	 * Destroy
+	 */
+	virtual ~y4mWriter();
+
+	/**
+	 * Flush and close the file.
+	 */
+	virtual void Close();
+
+protected:
+	y4mWriter( const char* path, uint32_t width, uint32_t height, float framerate );
+
+	virtual bool render( uint32_t buffer );
+
+	FILE* mFile;
+	std::vector<uint8_t> mPlanes;	// I420 frame, deinterleaved from NV12
+};
+
+
+#endif
@@ -0,0 +1,552 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "pipeline.h"
+#include "camera.h"
+#include "cudaMappedMemory.h"
+#include "trace.h"
+
+#include <QThread>
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+
+// stage thread
+class pipelineThread : public QThread
+{
+public:
+	pipelineThread( pipeline* p, uint32_t stage ) : mPipeline(p), mStage(stage)	{ }
+
+protected:
+	virtual void run()		{ mPipeline->process(mStage); }
+
+	pipeline* mPipeline;
+	uint32_t  mStage;
+};
+
+
+// reset
+void pipeline::stageCounters::reset()
+{
+	frames.store(0);
+	dropped.store(0);
+	failed.store(0);
+	busyTime.store(0);
+	maxTime.store(0);
+	waitTime.store(0);
+}
+
+
+// copy
+void pipeline::stageCounters::copy( pipelineStats* stats ) const
+{
+	stats->frames   = frames.load(std::memory_order_relaxed);
+	stats->dropped  = dropped.load(std::memory_order_relaxed);
+	stats->failed   = failed.load(std::memory_order_relaxed);
+	stats->busyTime = busyTime.load(std::memory_order_relaxed);
+	stats->maxTime  = maxTime.load(std::memory_order_relaxed);
+	stats->waitTime = waitTime.load(std::memory_order_relaxed);
+}
+
+
+// add
+void pipeline::stageCounters::add( uint64_t time )
+{
+	frames.fetch_add(1, std::memory_order_relaxed);
+	busyTime.fetch_add(time, std::memory_order_relaxed);
+
+	// each counter has a single writer
+	if( time > maxTime.load(std::memory_order_relaxed) )
+		maxTime.store(time, std::memory_order_relaxed);
+}
+
+
+// capture stage
+static bool captureFrame( pipelineFrame* frame, void* user_data )
+{
+	camera* cam = (camera*)user_data;
+
+	const uint64_t starved = cam->GetStarvedFrames();
+
+	frame->capture = cam->CaptureFrame(1000);
+
+	if( !frame->capture )
+	{
+		if( cam->IsEOS() )
+		{
+			frame->endOfStream = true;
+		}
+		else if( cam->GetStarvedFrames() != starved )
+		{
+			// every buffer is leased downstream, so give the stages time to release one
+			usleep(5000);
+		}
+		else
+		{
+			printf("pipeline -- failed to capture frame\n");
+		}
+
+		return false;
+	}
+
+	frame->traceFrame = frame->capture->sequence;
+
+	return true;
+}
+
+
+// convert stage
+static bool convertFrame( pipelineFrame* frame, void* user_data )
+{
+	if( !frame->capture || frame->capture->width != frame->width || frame->capture->height != frame->height )
+		return false;
+
+	bool result = camera::ConvertRGBA(*frame->capture, frame->rgba);
+
+	// the camera can reuse its buffer once the conversion is done
+	if( result && CUDA_FAILED(cudaStreamSynchronize(0)) )
+		result = false;
+
+	frame->capture->Release();
+	frame->capture = NULL;
+
+	return result;
+}
+
+
+// constructor
+pipeline::pipeline()
+{
+	mFree         = NULL;
+	mOutput       = NULL;
+	mOutputPolicy = DROP_OLDEST;
+	mWidth        = 0;
+	mHeight       = 0;
+	mResultsSize  = 0;
+	mSequence     = 0;
+	mStartTime    = 0;
+	mStopTime     = 0;
+
+	mRunning.store(false);
+	mEOS.store(false);
+	mOutputStats.reset();
+}
+
+
+// destructor
+pipeline::~pipeline()
+{
+	Stop();
+
+	for( size_t n=0; n < mStages.size(); n++ )
+	{
+		delete mStages[n]->thread;
+		delete mStages[n]->input;
+		delete mStages[n];
+	}
+
+	for( size_t n=0; n < mFrames.size(); n++ )
+	{
+		CUDA(cudaFreeHost(mFrames[n]->rgba));
+
+		if( mFrames[n]->resultsCPU != NULL )
+			CUDA(cudaFreeHost(mFrames[n]->resultsCPU));
+
+		delete mFrames[n];
+	}
+
+	delete mFree;
+	delete mOutput;
+}
+
+
+// Create
+pipeline* pipeline::Create( uint32_t width, uint32_t height, size_t resultsSize, uint32_t outputDepth, Policy outputPolicy )
+{
+	if( width == 0 || height == 0 )
+		return NULL;
+
+	pipeline* p = new pipeline();
+
+	p->mWidth        = width;
+	p->mHeight       = height;
+	p->mResultsSize  = resultsSize;
+	p->mOutput       = new pipelineQueue(outputDepth);
+	p->mOutputPolicy = outputPolicy;
+
+	return p;
+}
+
+
+// AddStage
+bool pipeline::AddStage( const char* name, StageFunction function, void* user_data, uint32_t queueDepth, Policy policy )
+{
+	if( !name || !function || mRunning.load() )
+		return false;
+
+	stage* s = new stage();
+
+	s->name      = name;
+	s->traceName = trace::Name(name);
+	s->function  = function;
+	s->user_data = user_data;
+	s->input     = mStages.empty() ? NULL : new pipelineQueue(queueDepth);
+	s->policy    = policy;
+	s->thread    = NULL;
+
+	s->stats.reset();
+
+	mStages.push_back(s);
+	return true;
+}
+
+
+// AddCamera
+bool pipeline::AddCamera( camera* cam, uint32_t queueDepth, Policy policy )
+{
+	if( !cam || !mStages.empty() )
+		return false;
+
+	return AddStage("capture", captureFrame, cam) && AddStage("convert", convertFrame, NULL, queueDepth, policy);
+}
+
+
+// Start
+bool pipeline::Start()
+{
+	if( mStages.empty() || mRunning.load() )
+		return false;
+
+	if( mFrames.empty() )
+	{
+		// enough frames to fill every queue, with one in each stage and one held by the caller of Next()
+		uint32_t numFrames = mOutput->GetCapacity() + mStages.size() + 1;
+
+		for( size_t n=1; n < mStages.size(); n++ )
+			numFrames += mStages[n]->input->GetCapacity();
+
+		mFree = new pipelineQueue(numFrames);
+
+		for( uint32_t n=0; n < numFrames; n++ )
+		{
+			pipelineFrame* frame = new pipelineFrame();
+			memset(frame, 0, sizeof(pipelineFrame));
+
+			void* gpu = NULL;
+
+			if( !cudaAllocMapped((void**)&frame->rgba, &gpu, mWidth * mHeight * sizeof(float4)) )
+			{
+				delete frame;
+				return false;
+			}
+
+			frame->width  = mWidth;
+			frame->height = mHeight;
+
+			if( mResultsSize > 0 && !cudaAllocMapped(&frame->resultsCPU, &frame->resultsCUDA, mResultsSize) )
+			{
+				CUDA(cudaFreeHost(frame->rgba));
+				delete frame;
+				return false;
+			}
+
+			frame->resultsSize = mResultsSize;
+
+			mFrames.push_back(frame);
+			mFree->TryPush(frame);
+		}
+
+		printf("pipeline -- allocated %u %ux%u frames for %zu stages\n", numFrames, mWidth, mHeight, mStages.size());
+	}
+
+	mStartTime = cameraTimestamp();
+	mRunning.store(true);
+
+	for( size_t n=0; n < mStages.size(); n++ )
+	{
+		mStages[n]->thread = new pipelineThread(this, n);
+		mStages[n]->thread->start();
+	}
+
+	return true;
+}
+
+
+// Stop
+void pipeline::Stop()
+{
+	if( !mRunning.exchange(false) )
+		return;
+
+	mFree->Close();
+	mOutput->Close();
+
+	for( size_t n=1; n < mStages.size(); n++ )
+		mStages[n]->input->Close();
+
+	for( size_t n=0; n < mStages.size(); n++ )
+		mStages[n]->thread->wait();
+
+	mStopTime = cameraTimestamp();
+
+	// the frames left in the queues hold camera frames
+	for( size_t n=0; n < mFrames.size(); n++ )
+	{
+		if( mFrames[n]->capture != NULL )
+		{
+			mFrames[n]->capture->Release();
+			mFrames[n]->capture = NULL;
+		}
+	}
+
+	PrintStats();
+}
+
+
+// process
+void pipeline::process( uint32_t index )
+{
+	stage* s = mStages[index];
+
+	if( trace::IsEnabled() )
+		trace::SetThreadName(s->traceName);
+
+	while( mRunning.load(std::memory_order_acquire) )
+	{
+		pipelineFrame* frame = NULL;
+
+		if( index == 0 )
+		{
+			if( !mFree->Pop(&frame) )
+				break;
+
+			frame->sequence    = ++mSequence;
+			frame->timestamp   = cameraTimestamp();
+			frame->traceFrame  = frame->sequence;
+			frame->endOfStream = false;
+		}
+		else
+		{
+			if( !s->input->Pop(&frame) )
+				break;
+
+			s->stats.waitTime.fetch_add(cameraTimestamp() - frame->queued, std::memory_order_relaxed);
+		}
+
+		const uint64_t begin = cameraTimestamp();
+		bool result = false;
+
+		// the frame moves on once the stage's kernels are done
+		{
+			TRACE_FRAME(frame->traceFrame);
+			TRACE_ZONE(s->traceName);
+
+			result = s->function(frame, s->user_data);
+
+			if( result && CUDA_FAILED(cudaStreamSynchronize(0)) )
+				result = false;
+		}
+
+		if( !result && index == 0 && frame->endOfStream )
+		{
+			printf("pipeline -- end of stream, finishing the frames in flight\n");
+			mEOS.store(true);
+			recycle(frame);
+			break;
+		}
+
+		if( !result )
+		{
+			s->stats.failed.fetch_add(1, std::memory_order_relaxed);
+			recycle(frame);
+			continue;
+		}
+
+		s->stats.add(cameraTimestamp() - begin);
+		forward(frame, index + 1);
+	}
+
+	// at the end of the stream, the next stage finishes the frames left in its queue and stops too
+	if( mEOS.load() )
+	{
+		if( index + 1 < mStages.size() )
+			mStages[index + 1]->input->Close();
+		else
+			mOutput->Close();
+	}
+}
+
+
+// IsEOS
+bool pipeline::IsEOS() const
+{
+	return mEOS.load() && mOutput->IsClosed() && mOutput->GetSize() == 0;
+}
+
+
+// forward
+void pipeline::forward( pipelineFrame* frame, uint32_t next )
+{
+	const bool output = (next >= mStages.size());
+
+	pipelineQueue* queue = output ? mOutput : mStages[next]->input;
+	stageCounters* stats = output ? &mOutputStats : &mStages[next]->stats;
+	const Policy  policy = output ? mOutputPolicy : mStages[next]->policy;
+
+	frame->queued = cameraTimestamp();
+
+	if( policy == BACKPRESSURE )
+	{
+		if( !queue->Push(frame) )
+			recycle(frame);
+
+		return;
+	}
+
+	// make space by dropping the oldest frames
+	while( !queue->TryPush(frame) )
+	{
+		if( queue->IsClosed() )
+		{
+			recycle(frame);
+			return;
+		}
+
+		pipelineFrame* oldest = NULL;
+
+		if( queue->TryPop(&oldest) )
+		{
+			stats->dropped.fetch_add(1, std::memory_order_relaxed);
+			recycle(oldest);
+		}
+	}
+}
+
+
+// recycle
+void pipeline::recycle( pipelineFrame* frame )
+{
+	if( frame->capture != NULL )
+	{
+		frame->capture->Release();
+		frame->capture = NULL;
+	}
+
+	// the pool has room for every frame, so a push only fails while another thread
+	// is midway through popping the cell it needs, or once the pool is closed
+	while( !mFree->TryPush(frame) )
+	{
+		if( mFree->IsClosed() )
+			return;		// the frame is still owned by mFrames
+
+		sched_yield();
+	}
+}
+
+
+// Next
+bool pipeline::Next( pipelineFrame** frame, unsigned long timeout )
+{
+	if( !frame || !mOutput )
+		return false;
+
+	if( !mOutput->Pop(frame, timeout) )
+		return false;
+
+	mOutputStats.waitTime.fetch_add(cameraTimestamp() - (*frame)->queued, std::memory_order_relaxed);
+	mOutputStats.add(cameraTimestamp() - (*frame)->timestamp);
+	return true;
+}
+
+
+// Release
+void pipeline::Release( pipelineFrame* frame )
+{
+	if( frame != NULL )
+		recycle(frame);
+}
+
+
+// GetStats
+bool pipeline::GetStats( uint32_t stage, pipelineStats* stats ) const
+{
+	if( stage >= mStages.size() || !stats )
+		return false;
+
+	mStages[stage]->stats.copy(stats);
+	return true;
+}
+
+
+// GetOutputStats
+void pipeline::GetOutputStats( pipelineStats* stats ) const
+{
+	if( stats != NULL )
+		mOutputStats.copy(stats);
+}
+
+
+// PrintStats
+void pipeline::PrintStats() const
+{
+	const uint64_t end     = mRunning.load() ? cameraTimestamp() : mStopTime;
+	const double   elapsed = (end - mStartTime) / 1000000000.0;
+
+	if( mStartTime == 0 || elapsed <= 0.0 )
+		return;
+
+	pipelineStats output;
+	GetOutputStats(&output);
+
+	printf("pipeline -- %llu frames in %.1f seconds (%.1f FPS), latency %.2f ms average, %.2f ms max\n",
+		  (unsigned long long)output.frames, elapsed, output.frames / elapsed,
+		  output.frames > 0 ? output.busyTime / (output.frames * 1000000.0) : 0.0, output.maxTime / 1000000.0);
+
+	printf("pipeline -- %-12s %8s %8s %8s %8s %8s %8s %8s\n", "stage", "frames", "FPS", "dropped", "failed", "avg ms", "max ms", "wait ms");
+
+	for( size_t n=0; n <= mStages.size(); n++ )
+	{
+		pipelineStats stats;
+
+		if( n < mStages.size() )
+			GetStats(n, &stats);
+		else
+			stats = output;
+
+		// for the output, the times are the latencies, so only the wait is shown
+		const bool   isOutput = (n == mStages.size());
+		const double frames   = (stats.frames > 0) ? stats.frames : 1;
+
+		printf("pipeline -- %-12s %8llu %8.1f %8llu %8llu ", isOutput ? "(output)" : mStages[n]->name.c_str(),
+			  (unsigned long long)stats.frames, stats.frames / elapsed, (unsigned long long)stats.dropped, (unsigned long long)stats.failed);
+
+		if( isOutput )
+			printf("%8s %8s ", "-", "-");
+		else
+			printf("%8.2f %8.2f ", stats.busyTime / (frames * 1000000.0), stats.maxTime / 1000000.0);
+
+		printf("%8.2f\n", n > 0 ? stats.waitTime / (frames * 1000000.0) : 0.0);
+	}
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __PIPELINE_H_
+#define __PIPELINE_H_
+
+
+#include "pipelineQueue.h"
+#include "cameraFrame.h"
+#include "cudaUtility.h"
+
+#include <string>
+#include <vector>
+
+
+class QThread;
+class camera;
+
+
+/**
+ * Frame flowing through a pipeline, with an RGBA image and storage for the results of its stages.
+ * @ingroup util
+ */
+struct pipelineFrame
+{
+	uint64_t     sequence;		/**< order the frame entered the pipeline, starting from 1 */
+	uint64_t     timestamp;		/**< time the frame entered the pipeline (CLOCK_MONOTONIC nanoseconds) */
+	uint64_t     traceFrame;		/**< frame that tags the stages' trace zones, the camera's sequence for captured frames */
+	cameraFrame* capture;		/**< lease on a camera frame, that's released when the frame is recycled (may be NULL) */
+	float4*      rgba;			/**< RGBA image in mapped CPU/GPU memory */
+	uint32_t     width;			/**< width of the RGBA image */
+	uint32_t     height;		/**< height of the RGBA image */
+	void*        resultsCPU;		/**< storage for the results of the stages, in mapped memory (NULL if none was requested) */
+	void*        resultsCUDA;		/**< CUDA pointer to the storage for the results */
+	size_t       resultsSize;		/**< size of the results storage in bytes */
+	uint64_t     queued;			/**< time the frame was queued to its next stage */
+	bool         endOfStream;		/**< set by the source instead of filling the frame, once its stream ended */
+};
+
+
+/**
+ * Counters of a pipeline stage.
+ * @ingroup util
+ */
+struct pipelineStats
+{
+	uint64_t frames;		/**< number of frames processed */
+	uint64_t dropped;		/**< number of frames dropped from the stage's input queue */
+	uint64_t failed;		/**< number of frames the stage failed to process */
+	uint64_t busyTime;		/**< total processing time in nanoseconds (for the output, the total latency) */
+	uint64_t maxTime;		/**< longest processing time in nanoseconds (for the output, the longest latency) */
+	uint64_t waitTime;		/**< total time the frames waited in the input queue, in nanoseconds */
+};
+
+
+/**
+ * Runs a chain of processing stages over a stream of frames, each stage on its own thread,
+ * so the frame rate is limited by the slowest stage rather than the sum of all of them.
+ *
+ * The first stage is the source, that fills frames taken from the pipeline's pool (i.e. by
+ * capturing them from a camera).  Each frame is then handed from stage to stage through
+ * bounded lock-free queues, and comes out of the last one to the thread calling Next(),
+ * which hands it back with Release() once it's done with it (i.e. after displaying it).
+ *
+ * When a queue is full, its policy either makes the previous stage wait for space
+ * (BACKPRESSURE), or drops the oldest frame in the queue (DROP_OLDEST), which keeps the
+ * latency low by always working on the newest frames.  When every frame of the pool is
+ * in flight, the source waits for one to be released.
+ *
+ * A stage's CUDA work is finished before the frame moves on, by synchronizing the thread's
+ * stream.  The library is built with per-thread default streams, so the kernels of the
+ * different stages run concurrently and only wait on their own stage.
+ *
+ * Each stage counts its frames, drops, failures and processing and queueing times, and
+ * the latency from the source to Next() is measured too.  They're printed by Stop().
+ *
+ * @ingroup util
+ */
+class pipeline
+{
+public:
+	/**
+	 * Queue policies
+	 */
+	enum Policy
+	{
+		BACKPRESSURE = 0,	/**< the previous stage waits for space in the queue */
+		DROP_OLDEST		/**< the oldest frame in the queue is dropped to make space */
+	};
+
+	/**
+	 * Function processing a frame in a stage.
+	 * The source sets frame->endOfStream and returns false once its stream ended, after which
+	 * the frames in flight drain through the stages and the pipeline reports IsEOS().
+	 * @returns false if the frame failed, in which case it's dropped.
+	 */
+	typedef bool (*StageFunction)( pipelineFrame* frame, void* user_data );
+
+	/**
+	 * Create a pipeline for frames of the specified size.
+	 * @param width width of the RGBA image of each frame.
+	 * @param height height of the RGBA image of each frame.
+	 * @param resultsSize size of the results storage of each frame, in bytes.
+	 * @param outputDepth number of processed frames that can be waiting for Next().
+	 * @param outputPolicy policy of the queue to Next().
+	 */
+	static pipeline* Create( uint32_t width, uint32_t height, size_t resultsSize=0,
+						uint32_t outputDepth=1, Policy outputPolicy=DROP_OLDEST );
+
+	/**
+	 * Stop the pipeline and free the frames.
+	 */
+	~pipeline();
+
+	/**
+	 * Add a stage to the end of the pipeline, before Start() is called.
+	 * The first stage added is the source.
+	 * @param name name of the stage, for the statistics.
+	 * @param function the function processing each frame.
+	 * @param user_data passed to the function.
+	 * @param queueDepth number of frames that can be waiting for the stage (ignored for the source).
+	 * @param policy policy of the stage's input queue (ignored for the source).
+	 */
+	bool AddStage( const char* name, StageFunction function, void* user_data=NULL, uint32_t queueDepth=2, Policy policy=BACKPRESSURE );
+
+	/**
+	 * Add a "capture" source stage, that leases the frames from the camera, followed by a
+	 * "convert" stage that converts them to RGBA and hands the camera its buffers back.
+	 * @param queueDepth number of captured frames that can be waiting for the conversion,
+	 *                   which is limited by the number of frames the camera can lease.
+	 */
+	bool AddCamera( camera* cam, uint32_t queueDepth=1, Policy policy=DROP_OLDEST );
+
+	/**
+	 * Allocate the frames and start the threads.
+	 */
+	bool Start();
+
+	/**
+	 * Stop the threads, release the camera frames and print the statistics.
+	 * A stopped pipeline can't be started again.
+	 */
+	void Stop();
+
+	/**
+	 * Retrieve the next frame out of the last stage, waiting for it if needed.
+	 * @param timeout the maximum time to wait in milliseconds, or ULONG_MAX to wait forever.
+	 * @returns false on timeout, or once the pipeline is stopped.
+	 */
+	bool Next( pipelineFrame** frame, unsigned long timeout=ULONG_MAX );
+
+	/**
+	 * Hand back a frame retrieved with Next(), so it can be reused.
+	 */
+	void Release( pipelineFrame* frame );
+
+	/**
+	 * Query if the source's stream ended and every frame left in the stages came out of Next().
+	 */
+	bool IsEOS() const;
+
+	/**
+	 * Retrieve the number of stages.
+	 */
+	inline uint32_t GetNumStages() const			{ return mStages.size(); }
+
+	/**
+	 * Retrieve the name of a stage.
+	 */
+	inline const char* GetStageName( uint32_t stage ) const	{ return mStages[stage]->name.c_str(); }
+
+	/**
+	 * Retrieve the counters of a stage.
+	 */
+	bool GetStats( uint32_t stage, pipelineStats* stats ) const;
+
+	/**
+	 * Retrieve the counters of the output, where busyTime and maxTime are the latencies from the source to Next().
+	 */
+	void GetOutputStats( pipelineStats* stats ) const;
+
+	/**
+	 * Print the counters of every stage.
+	 */
+	void PrintStats() const;
+
+protected:
+	pipeline();
+
+	struct stageCounters
+	{
+		std::atomic<uint64_t> frames;
+		std::atomic<uint64_t> dropped;
+		std::atomic<uint64_t> failed;
+		std::atomic<uint64_t> busyTime;
+		std::atomic<uint64_t> maxTime;
+		std::atomic<uint64_t> waitTime;
+
+		void reset();
+		void copy( pipelineStats* stats ) const;
+		void add( uint64_t time );
+	};
+
+	struct stage
+	{
+		std::string    name;
+		const char*    traceName;
+		StageFunction  function;
+		void*          user_data;
+		pipelineQueue* input;
+		Policy         policy;
+		QThread*       thread;
+		stageCounters  stats;
+	};
+
+	friend class pipelineThread;
+
+	void process( uint32_t index );
+	void forward( pipelineFrame* frame, uint32_t next );
+	void recycle( pipelineFrame* frame );
+
+	std::vector<stage*>         mStages;
+	std::vector<pipelineFrame*> mFrames;
+
+	pipelineQueue* mFree;		/**< frames available to the source */
+	pipelineQueue* mOutput;	/**< processed frames waiting for Next() */
+	Policy         mOutputPolicy;
+	stageCounters  mOutputStats;
+
+	uint32_t mWidth;
+	uint32_t mHeight;
+	size_t   mResultsSize;
+	uint64_t mSequence;
+	uint64_t mStartTime;
+	uint64_t mStopTime;
+
+	std::atomic<bool> mRunning;
+	std::atomic<bool> mEOS;
+};
+
+
+#endif
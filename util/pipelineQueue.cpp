@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "pipelineQueue.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+
+// futex wrappers
+static inline int futexWait( std::atomic<uint32_t>* addr, uint32_t expected, const timespec* timeout )
+{
+	return syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+}
+
+static inline void futexWake( std::atomic<uint32_t>* addr )
+{
+	syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
+// constructor
+pipelineQueue::pipelineQueue( uint32_t capacity ) : mCapacity(capacity > 0 ? capacity : 1), mNumCells(capacity > 2 ? capacity : 2)
+{
+	mCells = new cell[mNumCells];
+
+	for( uint32_t n=0; n < mNumCells; n++ )
+	{
+		mCells[n].sequence.store(n, std::memory_order_relaxed);
+		mCells[n].frame = NULL;
+	}
+
+	mPushPos.store(0);
+	mPopPos.store(0);
+	mPushed.store(0);
+	mPopped.store(0);
+	mSleepers.store(0);
+	mClosed.store(false);
+}
+
+
+// destructor
+pipelineQueue::~pipelineQueue()
+{
+	delete[] mCells;
+}
+
+
+// TryPush
+bool pipelineQueue::TryPush( pipelineFrame* frame )
+{
+	if( IsClosed() )
+		return false;
+
+	uint64_t pos = mPushPos.load(std::memory_order_relaxed);
+	cell* c = NULL;
+
+	while( true )
+	{
+		// other threads may have pushed and popped past a stale position, so reload it
+		// instead of letting the subtraction wrap around into a spurious 'full'
+		const int64_t size = int64_t(pos - mPopPos.load(std::memory_order_acquire));
+
+		if( size < 0 )
+		{
+			pos = mPushPos.load(std::memory_order_relaxed);
+			continue;
+		}
+
+		if( size >= int64_t(mCapacity) )
+			return false;	// full
+
+		c = &mCells[pos % mNumCells];
+
+		// the cell is free for this position once the consumer of the previous lap released it
+		const int64_t diff = int64_t(c->sequence.load(std::memory_order_acquire)) - int64_t(pos);
+
+		if( diff == 0 )
+		{
+			if( mPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+				break;
+		}
+		else
+		{
+			// diff < 0 means the consumer that claimed the previous lap's frame hasn't released
+			// the cell yet (the queue isn't full by position), so retry rather than report 'full'
+			pos = mPushPos.load(std::memory_order_relaxed);
+		}
+	}
+
+	c->frame = frame;
+	c->sequence.store(pos + 1, std::memory_order_release);
+
+	wake(&mPushed);
+	return true;
+}
+
+
+// TryPop
+bool pipelineQueue::TryPop( pipelineFrame** frame )
+{
+	uint64_t pos = mPopPos.load(std::memory_order_relaxed);
+	cell* c = NULL;
+
+	while( true )
+	{
+		c = &mCells[pos % mNumCells];
+
+		// the cell holds a frame for this position once its producer published it
+		const int64_t diff = int64_t(c->sequence.load(std::memory_order_acquire)) - int64_t(pos + 1);
+
+		if( diff == 0 )
+		{
+			if( mPopPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+				break;
+		}
+		else if( diff < 0 )
+		{
+			return false;	// empty
+		}
+		else
+		{
+			pos = mPopPos.load(std::memory_order_relaxed);
+		}
+	}
+
+	*frame = c->frame;
+	c->sequence.store(pos + mNumCells, std::memory_order_release);
+
+	wake(&mPopped);
+	return true;
+}
+
+
+// Push
+bool pipelineQueue::Push( pipelineFrame* frame, unsigned long timeout )
+{
+	if( TryPush(frame) )
+		return true;
+
+	return wait(false, &frame, timeout);
+}
+
+
+// Pop
+bool pipelineQueue::Pop( pipelineFrame** frame, unsigned long timeout )
+{
+	if( TryPop(frame) )
+		return true;
+
+	return wait(true, frame, timeout);
+}
+
+
+// Close
+void pipelineQueue::Close()
+{
+	mClosed.store(true, std::memory_order_seq_cst);
+
+	mPushed.fetch_add(1, std::memory_order_seq_cst);
+	mPopped.fetch_add(1, std::memory_order_seq_cst);
+
+	futexWake(&mPushed);
+	futexWake(&mPopped);
+}
+
+
+// GetSize
+uint32_t pipelineQueue::GetSize() const
+{
+	const uint64_t pushed = mPushPos.load(std::memory_order_acquire);
+	const uint64_t popped = mPopPos.load(std::memory_order_acquire);
+
+	return (pushed > popped) ? uint32_t(pushed - popped) : 0;
+}
+
+
+// wake
+void pipelineQueue::wake( std::atomic<uint32_t>* futex )
+{
+	futex->fetch_add(1, std::memory_order_seq_cst);
+
+	// skip the system call unless a thread is sleeping
+	if( mSleepers.load(std::memory_order_seq_cst) > 0 )
+		futexWake(futex);
+}
+
+
+// wait
+bool pipelineQueue::wait( bool popping, pipelineFrame** frame, unsigned long timeout )
+{
+	// consumers sleep until the next push, producers until the next pop
+	std::atomic<uint32_t>* futex = popping ? &mPushed : &mPopped;
+
+	timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	if( timeout != ULONG_MAX )
+	{
+		deadline.tv_sec  += timeout / 1000;
+		deadline.tv_nsec += (timeout % 1000) * 1000000;
+
+		if( deadline.tv_nsec >= 1000000000 )
+		{
+			deadline.tv_sec  += 1;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	while( true )
+	{
+		mSleepers.fetch_add(1, std::memory_order_seq_cst);
+
+		// read the futex word before checking, so a push or pop in between makes the wait return
+		const uint32_t word   = futex->load(std::memory_order_seq_cst);
+		const bool     closed = IsClosed();
+		const bool     result = popping ? TryPop(frame) : TryPush(*frame);
+
+		if( result || closed )
+		{
+			mSleepers.fetch_sub(1, std::memory_order_seq_cst);
+			return result;
+		}
+
+		if( timeout == ULONG_MAX )
+		{
+			futexWait(futex, word, NULL);
+			mSleepers.fetch_sub(1, std::memory_order_seq_cst);
+			continue;
+		}
+
+		// FUTEX_WAIT takes a relative timeout
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		timespec remaining;
+		remaining.tv_sec  = deadline.tv_sec - now.tv_sec;
+		remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+
+		if( remaining.tv_nsec < 0 )
+		{
+			remaining.tv_sec  -= 1;
+			remaining.tv_nsec += 1000000000;
+		}
+
+		if( remaining.tv_sec < 0 )
+		{
+			mSleepers.fetch_sub(1, std::memory_order_seq_cst);
+			return false;
+		}
+
+		futexWait(futex, word, &remaining);
+		mSleepers.fetch_sub(1, std::memory_order_seq_cst);
+	}
+}
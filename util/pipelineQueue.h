@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __PIPELINE_QUEUE_H_
+#define __PIPELINE_QUEUE_H_
+
+
+#include <stdint.h>
+#include <atomic>
+#include <climits>
+
+
+struct pipelineFrame;
+
+
+/**
+ * Bounded lock-free queue of frames, that any number of threads can push to and pop from.
+ *
+ * Each cell carries a sequence number that tells the producers and consumers whose turn
+ * it is, so pushing and popping are a compare-and-swap on the queue's position plus a store
+ * to the cell.  Push() and Pop() sleep on a futex while the queue is full or empty, and
+ * threads only enter the kernel to wake each other when someone is actually sleeping.
+ *
+ * @ingroup util
+ */
+class pipelineQueue
+{
+public:
+	/**
+	 * Create a queue that holds up to capacity frames.
+	 */
+	pipelineQueue( uint32_t capacity );
+
+	/**
+	 * Destructor
+	 */
+	~pipelineQueue();
+
+	/**
+	 * Add a frame to the back of the queue without waiting.
+	 * @returns false if the queue is full or was closed.
+	 */
+	bool TryPush( pipelineFrame* frame );
+
+	/**
+	 * Remove the frame at the front of the queue without waiting.
+	 * @returns false if the queue is empty.
+	 */
+	bool TryPop( pipelineFrame** frame );
+
+	/**
+	 * Add a frame to the back of the queue, waiting for space if it's full.
+	 * @param timeout the maximum time to wait in milliseconds, or ULONG_MAX to wait forever.
+	 * @returns false on timeout, or if the queue was closed.
+	 */
+	bool Push( pipelineFrame* frame, unsigned long timeout=ULONG_MAX );
+
+	/**
+	 * Remove the frame at the front of the queue, waiting for one if it's empty.
+	 * @param timeout the maximum time to wait in milliseconds, or ULONG_MAX to wait forever.
+	 * @returns false on timeout, or if the queue was closed and is empty.
+	 */
+	bool Pop( pipelineFrame** frame, unsigned long timeout=ULONG_MAX );
+
+	/**
+	 * Stop accepting frames, and wake the threads waiting on the queue.
+	 * The frames left in the queue can still be popped.
+	 */
+	void Close();
+
+	/**
+	 * Query if the queue was closed.
+	 */
+	inline bool IsClosed() const				{ return mClosed.load(std::memory_order_acquire); }
+
+	/**
+	 * Retrieve the number of frames in the queue (approximate while it's in use)
+	 */
+	uint32_t GetSize() const;
+
+	/**
+	 * Retrieve the maximum number of frames in the queue.
+	 */
+	inline uint32_t GetCapacity() const		{ return mCapacity; }
+
+protected:
+	struct cell
+	{
+		std::atomic<uint64_t> sequence;
+		pipelineFrame*        frame;
+	};
+
+	bool wait( bool popping, pipelineFrame** frame, unsigned long timeout );
+	void wake( std::atomic<uint32_t>* futex );
+
+	const uint32_t mCapacity;
+	const uint32_t mNumCells;	/**< at least 2, because with one cell a full queue looks empty */
+	cell*          mCells;
+
+	alignas(64) std::atomic<uint64_t> mPushPos;
+	alignas(64) std::atomic<uint64_t> mPopPos;
+
+	std::atomic<uint32_t> mPushed;	/**< bumped on every push, for consumers to sleep on */
+	std::atomic<uint32_t> mPopped;	/**< bumped on every pop, for producers to sleep on */
+	std::atomic<uint32_t> mSleepers;
+	std::atomic<bool>     mClosed;
+};
+
+
+#endif
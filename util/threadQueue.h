@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __THREAD_QUEUE_H_
+#define __THREAD_QUEUE_H_
+
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <deque>
+#include <stddef.h>
+
+
+/**
+ * Bounded FIFO queue for passing work between threads.
+ *
+ * Push() blocks while the queue is full, and Pop() blocks while it's empty,
+ * which lets a slower consumer throttle its producers.  Once Close() is called,
+ * Push() fails and Pop() drains the remaining items before failing.
+ *
+ * @ingroup util
+ */
+template<typename T> class threadQueue
+{
+public:
+	/**
+	 * Create a queue that holds up to capacity items.
+	 */
+	threadQueue( size_t capacity ) : mCapacity(capacity > 0 ? capacity : 1), mClosed(false)	{ }
+
+	/**
+	 * Add an item to the back of the queue, waiting for space if it's full.
+	 * @returns false if the queue was closed.
+	 */
+	bool Push( const T& item )
+	{
+		mMutex.lock();
+
+		while( !mClosed && mItems.size() >= mCapacity )
+			mNotFull.wait(&mMutex);
+
+		if( mClosed )
+		{
+			mMutex.unlock();
+			return false;
+		}
+
+		mItems.push_back(item);
+		mNotEmpty.wakeOne();
+		mMutex.unlock();
+		return true;
+	}
+
+	/**
+	 * Add an item to the back of the queue without waiting.
+	 * @returns false if the queue is full or was closed.
+	 */
+	bool TryPush( const T& item )
+	{
+		mMutex.lock();
+
+		const bool result = !mClosed && mItems.size() < mCapacity;
+
+		if( result )
+		{
+			mItems.push_back(item);
+			mNotEmpty.wakeOne();
+		}
+
+		mMutex.unlock();
+		return result;
+	}
+
+	/**
+	 * Remove the item from the front of the queue, waiting for one if it's empty.
+	 * @returns false if the queue was closed and is empty.
+	 */
+	bool Pop( T* item )
+	{
+		mMutex.lock();
+
+		while( !mClosed && mItems.empty() )
+			mNotEmpty.wait(&mMutex);
+
+		const bool result = pop(item);
+		mMutex.unlock();
+		return result;
+	}
+
+	/**
+	 * Remove the item from the front of the queue without waiting.
+	 * @returns false if the queue is empty.
+	 */
+	bool TryPop( T* item )
+	{
+		mMutex.lock();
+		const bool result = pop(item);
+		mMutex.unlock();
+		return result;
+	}
+
+	/**
+	 * Stop accepting new items, and wake any threads waiting on the queue.
+	 */
+	void Close()
+	{
+		mMutex.lock();
+		mClosed = true;
+		mNotEmpty.wakeAll();
+		mNotFull.wakeAll();
+		mMutex.unlock();
+	}
+
+	/**
+	 * Retrieve the number of items in the queue.
+	 */
+	size_t GetSize()
+	{
+		mMutex.lock();
+		const size_t size = mItems.size();
+		mMutex.unlock();
+		return size;
+	}
+
+protected:
+	bool pop( T* item )
+	{
+		if( mItems.empty() )
+			return false;
+
+		*item = mItems.front();
+		mItems.pop_front();
+		mNotFull.wakeOne();
+		return true;
+	}
+
+	std::deque<T>  mItems;
+	size_t         mCapacity;
+	bool           mClosed;
+
+	QMutex         mMutex;
+	QWaitCondition mNotEmpty;
+	QWaitCondition mNotFull;
+};
+
+
+#endif
@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include "trace.h"
+#include "commandLine.h"
+
+#include <QThread>
+#include <QMutex>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+// number of events kept per thread (a power of two)
+#define TRACE_EVENTS 32768
+
+
+struct traceEvent
+{
+	const char* name;
+	uint64_t    begin;
+	uint64_t    end;
+	uint64_t    frame;
+};
+
+
+// ring of the events recorded by one thread, which is the only writer
+struct traceBuffer
+{
+	traceEvent            events[TRACE_EVENTS];
+	std::atomic<uint64_t> head;		// number of events ever recorded
+	uint64_t              frame;		// current frame, only used by the owning thread
+	pid_t                 tid;
+	std::string           name;		// guarded by gMutex
+};
+
+
+std::atomic<bool> trace::sEnabled(false);
+
+static QMutex gMutex;
+static std::vector<traceBuffer*> gBuffers;		// buffers outlive their threads, so that their zones are still dumped
+static thread_local traceBuffer* gLocal = NULL;
+
+static char* gFilename   = NULL;
+static char* gSignalFile = NULL;
+static int   gSignalPipe[2] = { -1, -1 };
+static int   gSignal = 0;
+
+static struct sigaction gPrevAction;
+
+
+// wakes up on the self-pipe written by the signal handler, and dumps the trace
+class traceSignalThread : public QThread
+{
+protected:
+	virtual void run()
+	{
+		char c = 0;
+
+		while( read(gSignalPipe[0], &c, 1) == 1 )
+			trace::Dump(gSignalFile);
+	}
+};
+
+static traceSignalThread* gSignalThread = NULL;
+
+
+// onSignal
+static void onSignal( int signo )
+{
+	const int err = errno;
+	const char c  = 0;
+
+	if( write(gSignalPipe[1], &c, 1) < 0 ) { /* a dump is pending already */ }
+
+	errno = err;
+}
+
+
+// localBuffer
+static inline traceBuffer* localBuffer()
+{
+	if( gLocal != NULL )
+		return gLocal;
+
+	traceBuffer* buffer = new traceBuffer();
+
+	buffer->head.store(0);
+	buffer->frame = 0;
+	buffer->tid   = syscall(SYS_gettid);
+	buffer->name  = "thread " + std::to_string(buffer->tid);
+
+	gMutex.lock();
+	gBuffers.push_back(buffer);
+	gMutex.unlock();
+
+	gLocal = buffer;
+	return buffer;
+}
+
+
+// ticksToMicroseconds
+static double ticksToMicroseconds()
+{
+#if defined(__aarch64__)
+	uint64_t freq = 0;
+	asm volatile("mrs %0, cntfrq_el0" : "=r" (freq));
+	return 1000000.0 / double(freq);
+#elif defined(__x86_64__)
+	static double scale = 0.0;
+
+	// the TSC rate isn't exposed, so measure it against the monotonic clock
+	if( scale == 0.0 )
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		const uint64_t beginTicks = trace::Now();
+		const uint64_t beginTime  = uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+
+		usleep(20000);
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		const uint64_t endTicks = trace::Now();
+		const uint64_t endTime  = uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+
+		scale = double(endTime - beginTime) * 0.001 / double(endTicks - beginTicks);
+	}
+
+	return scale;
+#else
+	return 0.001;
+#endif
+}
+
+
+// writeString
+static void writeString( FILE* file, const char* str )
+{
+	fputc('"', file);
+
+	for( const char* c=str; *c != 0; c++ )
+	{
+		if( *c == '"' || *c == '\\' )
+			fputc('\\', file);
+
+		if( (unsigned char)*c >= 0x20 )
+			fputc(*c, file);
+	}
+
+	fputc('"', file);
+}
+
+
+// Init
+bool trace::Init( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	const char* filename = cmdLine.GetString("trace");
+
+	if( !filename )
+		return false;
+
+#ifndef ENABLE_TRACE
+	printf("trace -- tracing was compiled out, reconfigure with -DBUILD_TRACE=YES to use --trace\n");
+	return false;
+#else
+	free(gFilename);
+	gFilename = strdup(filename);
+
+	SetThreadName("main");
+	Enable();
+
+	if( !DumpOnSignal(gFilename, SIGUSR1) )
+		printf("trace -- recording to '%s' on exit\n", gFilename);
+	else
+		printf("trace -- recording to '%s' on exit, or when sent SIGUSR1\n", gFilename);
+
+	return true;
+#endif
+}
+
+
+// Shutdown
+void trace::Shutdown()
+{
+	if( gSignalThread != NULL )
+	{
+		sigaction(gSignal, &gPrevAction, NULL);
+
+		// the thread exits once the pipe is closed
+		close(gSignalPipe[1]);
+		gSignalThread->wait();
+
+		close(gSignalPipe[0]);
+		delete gSignalThread;
+
+		gSignalThread  = NULL;
+		gSignalPipe[0] = -1;
+		gSignalPipe[1] = -1;
+	}
+
+	if( gFilename != NULL )
+	{
+		Dump(gFilename);
+		free(gFilename);
+		gFilename = NULL;
+	}
+
+	Enable(false);
+}
+
+
+// Enable
+void trace::Enable( bool enable )
+{
+	sEnabled.store(enable, std::memory_order_relaxed);
+}
+
+
+// Record
+void trace::Record( const char* name, uint64_t begin, uint64_t end )
+{
+	traceBuffer* buffer = localBuffer();
+
+	const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+	traceEvent& event   = buffer->events[head & (TRACE_EVENTS - 1)];
+
+	event.name  = name;
+	event.begin = begin;
+	event.end   = end;
+	event.frame = buffer->frame;
+
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+
+// SetFrame
+void trace::SetFrame( uint64_t frame )
+{
+	localBuffer()->frame = frame;
+}
+
+
+// SetThreadName
+void trace::SetThreadName( const char* name )
+{
+	if( !name )
+		return;
+
+	traceBuffer* buffer = localBuffer();
+
+	gMutex.lock();
+	buffer->name = name;
+	gMutex.unlock();
+}
+
+
+// Name
+const char* trace::Name( const char* name )
+{
+	return strdup(name != NULL ? name : "");
+}
+
+
+// Dump
+bool trace::Dump( const char* filename )
+{
+	if( !filename )
+		return false;
+
+	struct threadEvents
+	{
+		pid_t       tid;
+		std::string name;
+		std::vector<traceEvent> events;
+	};
+
+	std::vector<threadEvents> threads;
+
+	gMutex.lock();
+
+	for( size_t n=0; n < gBuffers.size(); n++ )
+	{
+		traceBuffer* buffer = gBuffers[n];
+
+		threads.push_back(threadEvents());
+		threadEvents& t = threads.back();
+
+		t.tid  = buffer->tid;
+		t.name = buffer->name;
+
+		// the thread keeps recording while the events are copied, so the oldest
+		// ones might be overwritten in the meantime and are discarded afterwards
+		const uint64_t head  = buffer->head.load(std::memory_order_acquire);
+		const uint64_t first = (head > TRACE_EVENTS) ? head - TRACE_EVENTS : 0;
+
+		t.events.reserve(head - first);
+
+		for( uint64_t i=first; i < head; i++ )
+			t.events.push_back(buffer->events[i & (TRACE_EVENTS - 1)]);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		// (including the slot of the event that might be being written now)
+		const uint64_t after = buffer->head.load(std::memory_order_relaxed) + 1;
+
+		if( after > first + TRACE_EVENTS )
+			t.events.erase(t.events.begin(), t.events.begin() + std::min<uint64_t>(after - first - TRACE_EVENTS, t.events.size()));
+	}
+
+	gMutex.unlock();
+
+	// times are relative to the oldest event
+	uint64_t origin = UINT64_MAX;
+
+	for( size_t n=0; n < threads.size(); n++ )
+		for( size_t i=0; i < threads[n].events.size(); i++ )
+			origin = std::min(origin, threads[n].events[i].begin);
+
+	const double scale = ticksToMicroseconds();
+	const int    pid   = getpid();
+
+	// write to a temporary file first, so there's never a partial trace under the name
+	const std::string tmpFilename = std::string(filename) + ".tmp";
+
+	FILE* file = fopen(tmpFilename.c_str(), "w");
+
+	if( !file )
+	{
+		printf("trace -- failed to open '%s' for writing\n", tmpFilename.c_str());
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	size_t numEvents = 0;
+
+	for( size_t n=0; n < threads.size(); n++ )
+	{
+		const threadEvents& t = threads[n];
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%i,\"args\":{\"name\":", (n > 0) ? ",\n" : "", pid, (int)t.tid);
+		writeString(file, t.name.c_str());
+		fprintf(file, "}}");
+
+		for( size_t i=0; i < t.events.size(); i++ )
+		{
+			const traceEvent& e = t.events[i];
+
+			fprintf(file, ",\n{\"name\":");
+			writeString(file, e.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":%i,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f", pid, (int)t.tid,
+				   double(e.begin - origin) * scale, double(e.end - e.begin) * scale);
+
+			if( e.frame != 0 )
+				fprintf(file, ",\"args\":{\"frame\":%llu}", (unsigned long long)e.frame);
+
+			fprintf(file, "}");
+			numEvents++;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	const bool failed = ferror(file) != 0;
+
+	if( fclose(file) != 0 || failed || rename(tmpFilename.c_str(), filename) != 0 )
+	{
+		printf("trace -- failed to write '%s'\n", filename);
+		unlink(tmpFilename.c_str());
+		return false;
+	}
+
+	printf("trace -- wrote %zu events from %zu threads to '%s'\n", numEvents, threads.size(), filename);
+	return true;
+}
+
+
+// DumpOnSignal
+bool trace::DumpOnSignal( const char* filename, int signo )
+{
+	if( !filename )
+		return false;
+
+	if( gSignalThread != NULL )
+	{
+		printf("trace -- already dumping on signal %i\n", gSignal);
+		return false;
+	}
+
+	if( pipe(gSignalPipe) != 0 )
+	{
+		printf("trace -- failed to create pipe for the signal handler\n");
+		return false;
+	}
+
+	free(gSignalFile);
+	gSignalFile = strdup(filename);
+	gSignal     = signo;
+
+	gSignalThread = new traceSignalThread();
+	gSignalThread->start();
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+
+	action.sa_handler = onSignal;
+	action.sa_flags   = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	if( sigaction(signo, &action, &gPrevAction) != 0 )
+	{
+		printf("trace -- failed to install the handler for signal %i\n", signo);
+
+		close(gSignalPipe[1]);
+		gSignalThread->wait();
+		close(gSignalPipe[0]);
+		delete gSignalThread;
+
+		gSignalThread  = NULL;
+		gSignalPipe[0] = -1;
+		gSignalPipe[1] = -1;
+		return false;
+	}
+
+	return true;
+}
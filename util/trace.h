@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include <atomic>
+
+
+/**
+ * Records where the time of each frame goes, as zones on a timeline per thread,
+ * and writes them out in the Chrome trace format (open in chrome://tracing or Perfetto).
+ *
+ * Zones are recorded into a ring per thread, so recording takes no locks and
+ * old events are overwritten once a thread's ring is full.  Each zone is tagged
+ * with the frame its thread is working on, as set with TRACE_FRAME().
+ *
+ * Tracing is compiled in with ENABLE_TRACE (the BUILD_TRACE cmake option) and
+ * starts disabled, in which case a zone costs a load and a branch.  Without
+ * ENABLE_TRACE the macros compile to nothing.
+ *
+ * @ingroup util
+ */
+class trace
+{
+public:
+	/**
+	 * Enable tracing with --trace=<file>, which is written when Shutdown() is
+	 * called or the process receives SIGUSR1.
+	 * @returns false if tracing wasn't requested.
+	 */
+	static bool Init( int argc, char** argv );
+
+	/**
+	 * Write the trace file requested to Init(), and stop the signal handler.
+	 */
+	static void Shutdown();
+
+	/**
+	 * Start or stop recording zones.
+	 */
+	static void Enable( bool enable=true );
+
+	/**
+	 * Is recording enabled?
+	 */
+	static inline bool IsEnabled()			{ return sEnabled.load(std::memory_order_relaxed); }
+
+	/**
+	 * Write the recorded zones of every thread to a Chrome trace JSON file.
+	 * This is safe to call while other threads keep recording.
+	 */
+	static bool Dump( const char* filename );
+
+	/**
+	 * Dump() to the file whenever the process receives the signal.
+	 * The file is written by a background thread, not from the signal handler.
+	 */
+	static bool DumpOnSignal( const char* filename, int signo=SIGUSR1 );
+
+	/**
+	 * Name the calling thread in the trace.
+	 */
+	static void SetThreadName( const char* name );
+
+	/**
+	 * Set the frame the calling thread is working on, which tags its zones.
+	 * Zero means no frame.
+	 */
+	static void SetFrame( uint64_t frame );
+
+	/**
+	 * Copy a string that's used as a zone name, for names that aren't literals.
+	 * The copy is never freed, so it stays valid for every later Dump().
+	 */
+	static const char* Name( const char* name );
+
+	/**
+	 * Record a zone on the calling thread, with times from Now().
+	 * @param name a string literal, or a string from Name().
+	 */
+	static void Record( const char* name, uint64_t begin, uint64_t end );
+
+	/**
+	 * Current time in clock ticks, which are only converted when dumping.
+	 * This reads the CPU's counter where there is one (the virtual counter on aarch64, the TSC
+	 * on x86_64), which is much cheaper than clock_gettime().
+	 */
+	static inline uint64_t Now()
+	{
+	#if defined(__aarch64__)
+		uint64_t ticks;
+		asm volatile("mrs %0, cntvct_el0" : "=r" (ticks));
+		return ticks;
+	#elif defined(__x86_64__)
+		uint32_t lo, hi;
+		asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+		return (uint64_t(hi) << 32) | lo;
+	#else
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+	#endif
+	}
+
+protected:
+	static std::atomic<bool> sEnabled;
+};
+
+
+/**
+ * Records a zone from its construction to the end of its scope.
+ * @ingroup util
+ */
+class traceZone
+{
+public:
+	inline traceZone( const char* name )	{ mName = trace::IsEnabled() ? name : NULL; if( mName != NULL ) mBegin = trace::Now(); }
+	inline ~traceZone()					{ if( mName != NULL ) trace::Record(mName, mBegin, trace::Now()); }
+
+private:
+	const char* mName;
+	uint64_t    mBegin;
+};
+
+
+#define TRACE_CONCAT_(a, b)	a ## b
+#define TRACE_CONCAT(a, b)	TRACE_CONCAT_(a, b)
+
+#ifdef ENABLE_TRACE
+
+/**
+ * Record a zone until the end of the enclosing scope.
+ * @ingroup util
+ */
+#define TRACE_ZONE(name)		traceZone TRACE_CONCAT(_traceZone, __LINE__)(name)
+
+/**
+ * Tag the calling thread's zones with a frame.
+ * @ingroup util
+ */
+#define TRACE_FRAME(frame)		{ if( trace::IsEnabled() ) trace::SetFrame(frame); }
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_FRAME(frame)
+
+#endif
+
+#endif